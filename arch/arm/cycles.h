@@ -0,0 +1,116 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef ARM_CYCLES_H_
+#define ARM_CYCLES_H_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+#if defined(CONFIG_ARCH_ARMV7A) || defined(CONFIG_ARCH_ARMV7M)
+/** The core has a free-running cycle counter */
+#define ARCH_HAVE_CYCLE_COUNTER
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Public functions
+ *----------------------------------------------------------------------------*/
+
+#if defined(CONFIG_ARCH_ARMV7A)
+
+/* PMCR: E - enable all counters, C - reset cycle counter */
+#define PMCR_E (1u << 0)
+#define PMCR_C (1u << 2)
+/* PMCNTENSET: C - cycle counter enable */
+#define PMCNTENSET_C (1u << 31)
+
+/**
+ * \brief Start the PMU cycle counter (PMCCNTR), counting CPU clock cycles.
+ */
+static inline void arch_cycles_enable(void)
+{
+	uint32_t pmcr;
+	asm volatile("mrc p15, 0, %0, c9, c12, 0" : "=r"(pmcr));
+	asm volatile("mcr p15, 0, %0, c9, c12, 0" :: "r"(pmcr | PMCR_E | PMCR_C));
+	asm volatile("mcr p15, 0, %0, c9, c12, 1" :: "r"(PMCNTENSET_C));
+}
+
+/**
+ * \brief Read the cycle counter, which wraps around after 2^32 cycles.
+ */
+static inline uint32_t arch_cycles_read(void)
+{
+	uint32_t cycles;
+	asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(cycles));
+	return cycles;
+}
+
+#elif defined(CONFIG_ARCH_ARMV7M)
+
+#define DEMCR       (*(volatile uint32_t*)0xE000EDFCu)
+#define DWT_CTRL    (*(volatile uint32_t*)0xE0001000u)
+#define DWT_CYCCNT  (*(volatile uint32_t*)0xE0001004u)
+#define DWT_LAR     (*(volatile uint32_t*)0xE0001FB0u)
+
+/* DEMCR: TRCENA - enable DWT and ITM */
+#define DEMCR_TRCENA (1u << 24)
+/* DWT_CTRL: CYCCNTENA - enable cycle counter */
+#define DWT_CTRL_CYCCNTENA (1u << 0)
+/* DWT_LAR: key unlocking the DWT registers on Cortex-M7 */
+#define DWT_LAR_KEY 0xC5ACCE55u
+
+/**
+ * \brief Start the DWT cycle counter (CYCCNT), counting CPU clock cycles.
+ */
+static inline void arch_cycles_enable(void)
+{
+	DEMCR |= DEMCR_TRCENA;
+	DWT_LAR = DWT_LAR_KEY;
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+/**
+ * \brief Read the cycle counter, which wraps around after 2^32 cycles.
+ */
+static inline uint32_t arch_cycles_read(void)
+{
+	return DWT_CYCCNT;
+}
+
+#endif
+
+#endif /* ARM_CYCLES_H_ */
@@ -39,6 +39,7 @@
 #include "irq/irq.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
+#include "timer.h"
 #include "trace.h"
 
 /*----------------------------------------------------------------------------
@@ -75,6 +76,92 @@ static void _adcd_transfer_buffer_dma(struct _adcd_desc* desc)
 	dma_start_transfer(desc->xfer.dma.channel);
 }
 
+/**
+ * \brief Sum the conversions of each channel by groups of
+ * stream->oversampling and store the results in the per-channel arrays.
+ * Channels are identified by the LCDR tag, so a buffer does not need to
+ * start on the first channel of a sequence.
+ * \return number of samples produced for the busiest channel
+ */
+static uint32_t _adcd_stream_demux(struct _adcd_stream* stream, const uint16_t* raw)
+{
+	uint32_t sum[ADCD_MAX_CHANNELS];
+	uint32_t pos[ADCD_MAX_CHANNELS];
+	uint8_t count[ADCD_MAX_CHANNELS];
+	uint32_t frames = 0;
+	uint32_t i;
+
+	memset(sum, 0, sizeof(sum));
+	memset(pos, 0, sizeof(pos));
+	memset(count, 0, sizeof(count));
+
+	for (i = 0; i < stream->buffer_samples; i++) {
+		uint32_t chan = raw[i] >> ADC_LCDR_CHNB_Pos;
+
+		if (chan >= ADCD_MAX_CHANNELS)
+			continue;
+		sum[chan] += raw[i] & ADC_LCDR_LDATA_Msk;
+		if (++count[chan] < stream->oversampling)
+			continue;
+
+		if (stream->channel_data[chan])
+			stream->channel_data[chan][pos[chan]] = sum[chan] >> stream->oversampling_shift;
+		pos[chan]++;
+		if (pos[chan] > frames)
+			frames = pos[chan];
+		sum[chan] = 0;
+		count[chan] = 0;
+	}
+
+	return frames;
+}
+
+static int _adcd_stream_dma_callback(void* arg, void* arg2)
+{
+	struct _adcd_desc* desc = (struct _adcd_desc*)arg;
+	struct _adcd_stream* stream = desc->stream;
+	struct _adcd_stream_block block;
+	uint64_t tick = timer_get_tick();
+	uint32_t latency;
+
+	if (!stream)
+		return 0;
+
+	/* The DMA already moved on to the following buffer, how far it got
+	 * tells how late this interrupt is serviced */
+	latency = dma_get_transferred_data_len(desc->xfer.dma.channel,
+			DMA_CHUNK_SIZE_1, stream->buffer_samples);
+	stream->stats.latency_last = latency;
+	if (latency > stream->stats.latency_max)
+		stream->stats.latency_max = latency;
+	if (latency > stream->buffer_samples / 2)
+		stream->stats.late++;
+
+	if (stream->stats.buffers) {
+		uint32_t period = (uint32_t)timer_get_interval(stream->last_tick, tick);
+		if (period < stream->stats.period_min)
+			stream->stats.period_min = period;
+		if (period > stream->stats.period_max)
+			stream->stats.period_max = period;
+	}
+	stream->last_tick = tick;
+	stream->stats.buffers++;
+	stream->stats.samples += stream->buffer_samples;
+
+	block.index = stream->index;
+	block.half = block.index < (stream->buffer_count + 1) / 2;
+	block.raw = &stream->ring[block.index * stream->buffer_samples];
+
+	cache_invalidate_region((uint32_t*)block.raw, stream->buffer_samples * sizeof(uint16_t));
+	block.frames = _adcd_stream_demux(stream, block.raw);
+
+	stream->index = (block.index + 1) % stream->buffer_count;
+
+	callback_call(&stream->callback, &block);
+
+	return 0;
+}
+
 /**
  * \brief Interrupt handler for the ADC.
  */
@@ -306,3 +393,88 @@ void adcd_wait_transfer(struct _adcd_desc* desc)
 			dma_poll();
 	}
 }
+
+uint32_t adcd_stream_start(struct _adcd_desc* desc, struct _adcd_stream* stream)
+{
+	struct _dma_transfer_cfg list[DMA_SG_ITEM_POOL_SIZE];
+	struct _callback _cb;
+	uint32_t size;
+	int i;
+
+	size = stream->buffer_samples * sizeof(uint16_t);
+	if (stream->buffer_count < 2 || stream->buffer_count > DMA_SG_ITEM_POOL_SIZE)
+		return ADCD_ERROR_CONFIG;
+	if (!stream->ring || ((uint32_t)stream->ring & (L1_CACHE_BYTES - 1)))
+		return ADCD_ERROR_CONFIG;
+	if (size == 0 || (size & (L1_CACHE_BYTES - 1)))
+		return ADCD_ERROR_CONFIG;
+	if (stream->oversampling == 0)
+		stream->oversampling = 1;
+
+	if (!mutex_try_lock(&desc->mutex))
+		return ADCD_ERROR_LOCK;
+
+	stream->index = 0;
+	memset(&stream->stats, 0, sizeof(stream->stats));
+	stream->stats.period_min = UINT32_MAX;
+	stream->start_tick = timer_get_tick();
+	stream->last_tick = stream->start_tick;
+	desc->stream = stream;
+
+	adcd_configure(desc);
+	desc->xfer.dma.cfg_dma.loop = true;
+
+	for (i = 0; i < stream->buffer_count; i++) {
+		list[i].saddr = (void*)&ADC->ADC_LCDR;
+		list[i].daddr = &stream->ring[i * stream->buffer_samples];
+		list[i].len = stream->buffer_samples;
+	}
+	cache_invalidate_region(stream->ring, size * stream->buffer_count);
+
+	/* Discard a conversion left over from a previous acquisition */
+	adc_get_status();
+	(void)ADC->ADC_LCDR;
+
+	if (dma_configure_transfer(desc->xfer.dma.channel, &desc->xfer.dma.cfg_dma,
+				   list, stream->buffer_count) < 0) {
+		desc->stream = NULL;
+		mutex_unlock(&desc->mutex);
+		return ADCD_ERROR_TRANSFER;
+	}
+	callback_set(&_cb, _adcd_stream_dma_callback, desc);
+	dma_set_callback(desc->xfer.dma.channel, &_cb);
+	dma_start_transfer(desc->xfer.dma.channel);
+
+	return ADCD_SUCCESS;
+}
+
+void adcd_stream_stop(struct _adcd_desc* desc)
+{
+	if (!desc->stream)
+		return;
+
+	adc_set_trigger_mode(ADC_TRGR_TRGMOD_NO_TRIGGER);
+	dma_stop_transfer(desc->xfer.dma.channel);
+	dma_reset_channel(desc->xfer.dma.channel);
+	desc->xfer.dma.cfg_dma.loop = false;
+	desc->stream = NULL;
+
+	mutex_unlock(&desc->mutex);
+}
+
+void adcd_stream_get_stats(struct _adcd_stream* stream, struct _adcd_stream_stats* stats, bool reset)
+{
+	uint64_t tick = timer_get_tick();
+	uint64_t elapsed = timer_get_interval(stream->start_tick, tick);
+
+	*stats = stream->stats;
+	stats->rate = elapsed ? (uint32_t)(((uint64_t)stats->samples * 1000) / elapsed) : 0;
+	if (stats->period_min == UINT32_MAX)
+		stats->period_min = 0;
+
+	if (reset) {
+		memset(&stream->stats, 0, sizeof(stream->stats));
+		stream->stats.period_min = UINT32_MAX;
+		stream->start_tick = tick;
+	}
+}
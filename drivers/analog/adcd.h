@@ -49,6 +49,7 @@
 #define ADCD_SUCCESS         (0)
 #define ADCD_ERROR_LOCK      (1)
 #define ADCD_ERROR_TRANSFER  (2)
+#define ADCD_ERROR_CONFIG    (3)
 
 #define ADCD_MAX_CHANNELS    (12)
 
@@ -87,6 +88,51 @@ struct _adcd_cfg {
 	uint32_t channel_mask;
 };
 
+/* statistics of a streaming acquisition */
+struct _adcd_stream_stats {
+	uint32_t buffers;      /*< buffers completed */
+	uint32_t samples;      /*< raw conversions received */
+	uint32_t late;         /*< buffers serviced after half of the next one was filled */
+	uint32_t latency_last; /*< conversions already in the next buffer when serviced */
+	uint32_t latency_max;
+	uint32_t period_min;   /*< shortest interval between two buffers (ticks) */
+	uint32_t period_max;   /*< longest interval between two buffers (ticks) */
+	uint32_t rate;         /*< measured conversions per second */
+};
+
+/* buffer handed to the streaming callback (arg2) */
+struct _adcd_stream_block {
+	uint8_t index;         /*< index of the completed buffer in the ring */
+	bool half;             /*< completed buffer lies in the first half of the ring */
+	const uint16_t* raw;   /*< tagged conversions as read from ADC_LCDR */
+	uint32_t frames;       /*< samples written to each demultiplexed array */
+};
+
+/* streaming acquisition: a circular DMA list over a ring of buffers */
+struct _adcd_stream {
+	uint16_t* ring;        /*< buffer_count * buffer_samples entries, cache aligned */
+	uint8_t buffer_count;  /*< number of buffers in the ring (2 for half/full) */
+	uint32_t buffer_samples; /*< conversions per buffer, multiple of 16 */
+
+	/* conversions of the same channel summed into one output sample,
+	 * the sum is shifted right by oversampling_shift (log2 of
+	 * oversampling to average, half of it to gain resolution) */
+	uint8_t oversampling;
+	uint8_t oversampling_shift;
+
+	/* optional per-channel destination, each array is filled from its
+	 * start with the frames of the buffer that just completed */
+	uint16_t* channel_data[ADCD_MAX_CHANNELS];
+
+	struct _callback callback;
+
+	/* following fields are used internally */
+	volatile uint8_t index;
+	uint64_t last_tick;
+	uint64_t start_tick;
+	struct _adcd_stream_stats stats;
+};
+
 /* structure to define ADC state */
 struct _adcd_desc {
 	struct _adcd_cfg cfg;
@@ -104,6 +150,8 @@ struct _adcd_desc {
 			struct _dma_cfg cfg_dma;
 		} dma;
 	} xfer;
+
+	struct _adcd_stream* stream;
 };
 
 /*------------------------------------------------------------------------------
@@ -118,4 +166,27 @@ extern bool adcd_is_busy(struct _adcd_desc* desc);
 
 extern void adcd_wait_transfer(struct _adcd_desc* desc);
 
+/**
+ * \brief Start a continuous acquisition into the ring of buffers of
+ * \a stream. The DMA list loops over the ring, so conversions are never
+ * dropped between buffers; the sample rate is set by the trigger source
+ * (TC, PWM or ADC timer) selected in the descriptor configuration.
+ * The stream callback is invoked from the DMA interrupt once per buffer
+ * with a struct _adcd_stream_block as second argument, after the buffer
+ * was oversampled and demultiplexed into the channel_data arrays.
+ * \return ADCD_SUCCESS, ADCD_ERROR_LOCK if the ADC is busy or
+ * ADCD_ERROR_CONFIG if the stream geometry is invalid.
+ */
+extern uint32_t adcd_stream_start(struct _adcd_desc* desc, struct _adcd_stream* stream);
+
+/**
+ * \brief Stop the acquisition started by adcd_stream_start().
+ */
+extern void adcd_stream_stop(struct _adcd_desc* desc);
+
+/**
+ * \brief Copy the statistics of \a stream, optionally clearing them.
+ */
+extern void adcd_stream_get_stats(struct _adcd_stream* stream, struct _adcd_stream_stats* stats, bool reset);
+
 #endif /* ADCD_H_ */
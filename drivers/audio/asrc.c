@@ -0,0 +1,362 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "audio/asrc.h"
+#include "errno.h"
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+#define ONE (1ull << 32)
+
+/** Constants in Q15 */
+#define Q15_ONE     (32768)
+#define Q15_PI      (102944)
+
+/** Odd polynomial for sin(pi / 2 z) on [-1, 1], coefficients in Q30 */
+#define SIN_C1      (1686623980ll)
+#define SIN_C3      (-693521959ll)
+#define SIN_C5      (85291562ll)
+#define SIN_C7      (-4652386ll)
+
+/** Filter cutoff relative to the lowest Nyquist frequency, 0.9 in Q15 */
+#define CUTOFF      (29491)
+
+/** Binary angle of a quarter turn (full turn is 2^32) */
+#define QUARTER_TURN (1u << 30)
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Sine of a binary angle (2^32 per turn), in Q15.
+ * Seventh order polynomial on the folded quarter wave, within 1e-6 of the
+ * exact value before rounding.
+ */
+static int32_t _sin_q15(uint32_t angle)
+{
+	int32_t a = (int32_t)angle;
+	int64_t z, z2, r;
+
+	/* Fold to [-pi/2, pi/2] with sin(a) = sin(pi - a), z in quarter
+	 * turns (Q30) */
+	if (a > (int32_t)QUARTER_TURN || a < -(int32_t)QUARTER_TURN)
+		a = (int32_t)(0x80000000u - angle);
+	z = a;
+
+	z2 = (z * z) >> 30;
+	r = SIN_C5 + ((SIN_C7 * z2) >> 30);
+	r = SIN_C3 + ((r * z2) >> 30);
+	r = SIN_C1 + ((r * z2) >> 30);
+	return (int32_t)((((r * z) >> 30) + (1 << 14)) >> 15);
+}
+
+/**
+ * \brief Blackman windowed sinc, in Q30.
+ * \param x  Position, in 1 / ASRC_PHASES input samples.
+ * \param fc Cutoff relative to the input Nyquist frequency (Q15).
+ */
+static int32_t _kernel(int32_t x, int32_t fc)
+{
+	uint32_t angle;
+	int32_t w, s;
+
+	if (x >= ASRC_TAPS * ASRC_PHASES / 2 || x <= -ASRC_TAPS * ASRC_PHASES / 2)
+		return 0;
+
+	/* 0.42 + 0.5 cos(2 pi x / TAPS) + 0.08 cos(4 pi x / TAPS), in Q15 */
+	angle = (uint32_t)(((int64_t)x << 32) / (ASRC_TAPS * ASRC_PHASES));
+	w = 13763 + (_sin_q15(angle + QUARTER_TURN) >> 1)
+		+ ((2621 * _sin_q15(2 * angle + QUARTER_TURN)) >> 15);
+
+	/* sin(pi fc x) / (pi x), half a turn being 2^31 */
+	if (x == 0) {
+		s = fc;
+	} else {
+		angle = (uint32_t)((int64_t)fc * x * (1 << (16 - ASRC_PHASES_LOG2)));
+		s = ((int64_t)_sin_q15(angle) * ASRC_PHASES * Q15_ONE)
+			/ ((int64_t)Q15_PI * x);
+	}
+
+	return s * w;
+}
+
+/**
+ * \brief Divide, rounding to the nearest integer.
+ */
+static int32_t _div_round(int64_t n, int64_t d)
+{
+	if ((n < 0) != (d < 0))
+		return (n - d / 2) / d;
+	return (n + d / 2) / d;
+}
+
+/**
+ * \brief Compute the filter bank. Row p holds the taps for an output
+ * located p / ASRC_PHASES input samples after the filter center, each row
+ * being normalized to unity DC gain.
+ */
+static void _build_coefs(struct _asrc *asrc)
+{
+	int32_t fc, h[ASRC_TAPS];
+	int64_t sum;
+	int32_t c, total;
+	int p, k, center;
+
+	/* Cutoff below the lowest of both Nyquist frequencies */
+	fc = CUTOFF;
+	if (asrc->cfg.out_rate < asrc->cfg.in_rate)
+		fc = ((uint64_t)fc * asrc->cfg.out_rate) / asrc->cfg.in_rate;
+
+	for (p = 0; p <= ASRC_PHASES; p++) {
+		sum = 0;
+		for (k = 0; k < ASRC_TAPS; k++) {
+			h[k] = _kernel((k - ASRC_TAPS / 2) * ASRC_PHASES + p, fc);
+			sum += h[k];
+		}
+
+		total = 0;
+		center = 0;
+		for (k = 0; k < ASRC_TAPS; k++) {
+			c = _div_round((int64_t)h[k] * Q15_ONE, sum);
+			if (c > INT16_MAX)
+				c = INT16_MAX;
+			if (c < INT16_MIN)
+				c = INT16_MIN;
+			asrc->coefs[p][k] = c;
+			total += c;
+			if (h[k] > h[center])
+				center = k;
+		}
+		/* Put the rounding error on the largest tap */
+		c = asrc->coefs[p][center] + Q15_ONE - total;
+		asrc->coefs[p][center] = c > INT16_MAX ? INT16_MAX : c;
+	}
+}
+
+/**
+ * \brief Multiply-accumulate one filter phase over a history window.
+ * Not declared inline: it is called twice per channel and output frame and
+ * left to the compiler, which would otherwise fail -Winline at -Os.
+ */
+static int64_t _dot(const int16_t *c, const int32_t *x)
+{
+	int64_t acc = 0;
+	int k;
+
+	for (k = 0; k < ASRC_TAPS; k += 4) {
+		acc += (int64_t)c[k] * x[k];
+		acc += (int64_t)c[k + 1] * x[k + 1];
+		acc += (int64_t)c[k + 2] * x[k + 2];
+		acc += (int64_t)c[k + 3] * x[k + 3];
+	}
+	return acc;
+}
+
+static inline int32_t _saturate(int64_t v, int32_t max)
+{
+	if (v > max)
+		return max;
+	if (v < -max - 1)
+		return -max - 1;
+	return (int32_t)v;
+}
+
+/**
+ * \brief Push one input frame into the history.
+ */
+static inline void _push(struct _asrc *asrc, const void *in, uint32_t frame)
+{
+	uint8_t channels = asrc->cfg.channels;
+	uint8_t ch;
+	int32_t s;
+
+	asrc->head = asrc->head ? asrc->head - 1 : ASRC_TAPS - 1;
+	for (ch = 0; ch < channels; ch++) {
+		if (asrc->cfg.bits_per_sample == 16)
+			s = ((const int16_t *)in)[frame * channels + ch];
+		else
+			s = ((const int32_t *)in)[frame * channels + ch];
+		asrc->history[ch][asrc->head] = s;
+		asrc->history[ch][asrc->head + ASRC_TAPS] = s;
+	}
+}
+
+/**
+ * \brief Compute one output frame at the current position.
+ */
+static inline void _emit(struct _asrc *asrc, void *out, uint32_t frame)
+{
+	uint32_t frac = (uint32_t)asrc->pos;
+	uint32_t phase = frac >> (32 - ASRC_PHASES_LOG2);
+	int32_t mu = (frac >> (16 - ASRC_PHASES_LOG2)) & 0xffff;
+	const int16_t *c0 = asrc->coefs[phase];
+	const int16_t *c1 = asrc->coefs[phase + 1];
+	uint8_t channels = asrc->cfg.channels;
+	int64_t y0, y1, y;
+	uint8_t ch;
+
+	for (ch = 0; ch < channels; ch++) {
+		const int32_t *x = &asrc->history[ch][asrc->head];
+
+		y0 = _dot(c0, x);
+		y1 = _dot(c1, x);
+		y = (y0 + (((y1 - y0) * mu) >> 16) + (1 << 14)) >> 15;
+
+		if (asrc->cfg.bits_per_sample == 16)
+			((int16_t *)out)[frame * channels + ch] = _saturate(y, INT16_MAX);
+		else
+			((int32_t *)out)[frame * channels + ch] = _saturate(y, 0x7fffff);
+	}
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+void asrc_get_default_cfg(struct _asrc_cfg *cfg, uint32_t in_rate,
+		uint32_t out_rate, uint8_t channels, uint8_t bits,
+		uint32_t fill_max)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->in_rate = in_rate;
+	cfg->out_rate = out_rate;
+	cfg->channels = channels;
+	cfg->bits_per_sample = bits;
+	cfg->target_fill = fill_max / 2;
+	/* Full correction when an eighth of the buffer away from target */
+	cfg->kp = fill_max ? 8000000 / fill_max : 0;
+	cfg->ki = cfg->kp / 2048;
+	cfg->max_ppm = 1000;
+}
+
+int asrc_init(struct _asrc *asrc, const struct _asrc_cfg *cfg)
+{
+	if (!cfg->in_rate || !cfg->out_rate)
+		return -EINVAL;
+	if (!cfg->channels || cfg->channels > ASRC_MAX_CHANNELS)
+		return -EINVAL;
+	if (cfg->bits_per_sample != 16 && cfg->bits_per_sample != 24)
+		return -EINVAL;
+	/* Decimation by more than 4 would need a longer filter */
+	if (cfg->in_rate > 4 * cfg->out_rate)
+		return -EINVAL;
+
+	asrc->cfg = *cfg;
+	asrc->nominal_step = ((uint64_t)cfg->in_rate << 32) / cfg->out_rate;
+	_build_coefs(asrc);
+	asrc_reset(asrc);
+
+	return 0;
+}
+
+void asrc_reset(struct _asrc *asrc)
+{
+	memset(asrc->history, 0, sizeof(asrc->history));
+	asrc->head = 0;
+	asrc->pos = 0;
+	asrc->step = asrc->nominal_step;
+	asrc->fill_error = 0;
+	asrc->integral = 0;
+	asrc->correction = 0;
+}
+
+uint32_t asrc_process(struct _asrc *asrc, const void *in,
+		uint32_t *in_frames, void *out, uint32_t out_frames)
+{
+	uint32_t consumed = 0;
+	uint32_t produced = 0;
+
+	for (;;) {
+		/* Outputs located before the newest input sample */
+		while (asrc->pos < ONE) {
+			if (produced == out_frames)
+				goto exit;
+			_emit(asrc, out, produced++);
+			asrc->pos += asrc->step;
+		}
+		if (consumed == *in_frames)
+			break;
+		_push(asrc, in, consumed++);
+		asrc->pos -= ONE;
+	}
+
+exit:
+	*in_frames = consumed;
+	return produced;
+}
+
+void asrc_track_fill(struct _asrc *asrc, uint32_t fill)
+{
+	int32_t max = asrc->cfg.max_ppm * 1000;
+	int32_t error = ((int32_t)fill - (int32_t)asrc->cfg.target_fill) * 256;
+	int64_t integral, correction;
+
+	/* First order low-pass to reject packet jitter */
+	asrc->fill_error += (error - asrc->fill_error) / 64;
+
+	integral = asrc->integral + (((int64_t)asrc->fill_error * asrc->cfg.ki) >> 8);
+	if (integral > max)
+		integral = max;
+	if (integral < -max)
+		integral = -max;
+	asrc->integral = integral;
+
+	correction = integral + (((int64_t)asrc->fill_error * asrc->cfg.kp) >> 8);
+	if (correction > max)
+		correction = max;
+	if (correction < -max)
+		correction = -max;
+	asrc->correction = correction;
+
+	/* More data waiting than expected: consume the input faster */
+	asrc->step = asrc->nominal_step
+		+ ((int64_t)asrc->nominal_step * correction) / 1000000000;
+}
+
+int32_t asrc_get_correction(const struct _asrc *asrc)
+{
+	return asrc->correction;
+}
+
+uint32_t asrc_get_max_output(const struct _asrc *asrc, uint32_t in_frames)
+{
+	uint64_t min_step = asrc->nominal_step
+		- (asrc->nominal_step * asrc->cfg.max_ppm) / 1000000;
+
+	return (uint32_t)(((uint64_t)in_frames << 32) / min_step) + 2;
+}
@@ -0,0 +1,173 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file
+ *
+ * Asynchronous sample rate converter.
+ *
+ * Converts a stream between two nominal rates with a polyphase windowed-sinc
+ * filter (ASRC_PHASES phases of ASRC_TAPS taps, linear interpolation between
+ * adjacent phases). The conversion ratio is trimmed by a PI loop fed with
+ * the fill level of the buffer that sits between the producer (e.g. USB)
+ * and the consumer (e.g. audio_transfer()), so that the two clock domains
+ * can drift without retuning the audio PLL.
+ *
+ * Samples are interleaved, 16-bit in int16_t or 24-bit right-aligned in
+ * int32_t.
+ */
+
+#ifndef ASRC_H_
+#define ASRC_H_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Maximum number of interleaved channels */
+#define ASRC_MAX_CHANNELS (8)
+
+/** Filter taps per phase */
+#define ASRC_TAPS (16)
+
+/** Number of filter phases, must be a power of 2 */
+#define ASRC_PHASES_LOG2 (5)
+#define ASRC_PHASES (1 << ASRC_PHASES_LOG2)
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** \brief ASRC configuration */
+struct _asrc_cfg {
+	uint32_t in_rate;        /**< Nominal input rate (Hz) */
+	uint32_t out_rate;       /**< Nominal output rate (Hz) */
+	uint8_t  channels;       /**< Interleaved channels */
+	uint8_t  bits_per_sample;/**< 16 or 24 */
+
+	/** Buffer fill level (frames) the drift loop converges to */
+	uint32_t target_fill;
+	/** Proportional gain, in ppb of ratio per frame of fill error */
+	uint32_t kp;
+	/** Integral gain, in ppb per frame of fill error and per update */
+	uint32_t ki;
+	/** Maximum ratio correction, in ppm */
+	uint32_t max_ppm;
+};
+
+/** \brief ASRC instance */
+struct _asrc {
+	struct _asrc_cfg cfg;
+
+	/** Filter bank, ASRC_PHASES + 1 rows so that phase p + 1 exists */
+	int16_t coefs[ASRC_PHASES + 1][ASRC_TAPS];
+	/** Per channel history, stored twice for a contiguous window */
+	int32_t history[ASRC_MAX_CHANNELS][2 * ASRC_TAPS];
+	uint8_t head;
+
+	uint64_t pos;          /**< Next output position (32.32) */
+	uint64_t nominal_step; /**< Input frames per output frame (32.32) */
+	uint64_t step;         /**< Corrected step */
+
+	int32_t fill_error;    /**< Filtered fill error (frames, 24.8) */
+	int32_t integral;      /**< Integral term (ppb) */
+	int32_t correction;    /**< Applied correction (ppb) */
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Fill cfg with the drift loop defaults for a given stream.
+ * Defaults correct up to +/-1000ppm and target half of fill_max.
+ * \param cfg      Configuration to initialize.
+ * \param in_rate  Input rate (Hz).
+ * \param out_rate Output rate (Hz).
+ * \param channels Number of channels.
+ * \param bits     Bits per sample (16 or 24).
+ * \param fill_max Capacity of the buffer monitored for drift (frames).
+ */
+extern void asrc_get_default_cfg(struct _asrc_cfg *cfg, uint32_t in_rate,
+		uint32_t out_rate, uint8_t channels, uint8_t bits,
+		uint32_t fill_max);
+
+/**
+ * \brief Initialize an ASRC instance and compute its filter bank.
+ * \return 0 on success, -EINVAL for unsupported parameters.
+ */
+extern int asrc_init(struct _asrc *asrc, const struct _asrc_cfg *cfg);
+
+/**
+ * \brief Clear history and drift state, keeping the configuration.
+ */
+extern void asrc_reset(struct _asrc *asrc);
+
+/**
+ * \brief Convert interleaved frames.
+ * Conversion stops when either all input is consumed or the output buffer
+ * is full; remaining input must be passed again on the next call.
+ * \param asrc      ASRC instance.
+ * \param in        Input frames.
+ * \param in_frames In: number of input frames. Out: frames consumed.
+ * \param out       Output frames.
+ * \param out_frames Capacity of out, in frames.
+ * \return Number of frames written to out.
+ */
+extern uint32_t asrc_process(struct _asrc *asrc, const void *in,
+		uint32_t *in_frames, void *out, uint32_t out_frames);
+
+/**
+ * \brief Feed the drift loop with the current buffer fill level.
+ * Must be called at a regular interval (e.g. for each USB packet) from the
+ * same context as asrc_process().
+ * \param asrc ASRC instance.
+ * \param fill Frames waiting in the monitored buffer.
+ */
+extern void asrc_track_fill(struct _asrc *asrc, uint32_t fill);
+
+/**
+ * \brief Get the current ratio correction, in ppb.
+ * Positive values mean the input is consumed faster than nominal.
+ */
+extern int32_t asrc_get_correction(const struct _asrc *asrc);
+
+/**
+ * \brief Get the maximum number of frames produced for in_frames input
+ * frames, including the maximum drift correction.
+ */
+extern uint32_t asrc_get_max_output(const struct _asrc *asrc,
+		uint32_t in_frames);
+
+#endif /* ASRC_H_ */
@@ -39,6 +39,7 @@
 #include "callback.h"
 #include "chip.h"
 #include "dma/dma.h"
+#include "errno.h"
 #include "mm/cache.h"
 #include "trace.h"
 
@@ -46,6 +47,34 @@
  *        Local functions
  *----------------------------------------------------------------------------*/
 
+static uint32_t _dsp_frames(struct _audio_desc *desc, uint32_t size)
+{
+	uint32_t sample_size = desc->dsp->bits_per_sample == 16 ? 2 : 4;
+
+	return size / (sample_size * desc->dsp->channels);
+}
+
+/**
+ * Capture completion: run the processing chain on the received buffer
+ * (already invalidated by the device driver) then notify the user.
+ */
+static int _dsp_rx_callback(void* arg, void* arg2)
+{
+	struct _audio_desc *desc = (struct _audio_desc *)arg;
+	struct _callback cb;
+
+	if (desc->dsp)
+		audio_dsp_process(desc->dsp, desc->dsp_rx.buffer,
+				_dsp_frames(desc, desc->dsp_rx.size));
+
+	/* Release the context first: the user callback may queue the next
+	 * capture */
+	callback_copy(&cb, &desc->dsp_rx.callback);
+	desc->dsp_rx.buffer = NULL;
+
+	return callback_call(&cb, arg2);
+}
+
 #if defined(CONFIG_HAVE_CLASSD)
 /**
  * Configure the CLASSD for audio output.
@@ -378,8 +407,26 @@ void audio_stop(struct _audio_desc *desc)
 	}
 }
 
-void audio_transfer(struct _audio_desc *desc, void *buffer, uint32_t size, struct _callback* cb)
+int audio_transfer(struct _audio_desc *desc, void *buffer, uint32_t size, struct _callback* cb)
 {
+	struct _callback _cb;
+	int err = -ENODEV;
+
+	if (desc->dsp) {
+		if (desc->direction == AUDIO_DEVICE_PLAY) {
+			audio_dsp_process(desc->dsp, buffer, _dsp_frames(desc, size));
+		} else {
+			/* One processing context: captures cannot be queued */
+			if (desc->dsp_rx.buffer)
+				return -EBUSY;
+			desc->dsp_rx.buffer = buffer;
+			desc->dsp_rx.size = size;
+			callback_copy(&desc->dsp_rx.callback, cb);
+			callback_set(&_cb, _dsp_rx_callback, (void*)desc);
+			cb = &_cb;
+		}
+	}
+
 	switch (desc->type) {
 #if defined(CONFIG_HAVE_CLASSD)
 	case AUDIO_DEVICE_CLASSD:
@@ -392,13 +439,14 @@ void audio_transfer(struct _audio_desc *desc, void *buffer, uint32_t size, struc
 					.attr = CLASSD_BUF_ATTR_WRITE,
 				};
 
-				classd_transfer(&desc->device.classd.desc, &_tx, cb);
+				err = classd_transfer(&desc->device.classd.desc, &_tx, cb);
 			}
 			break;
 
 		case AUDIO_DEVICE_RECORD:
 			/* Do not supported */
-			return;
+			err = -ENOTSUP;
+			break;
 		}
 		break;
 #endif
@@ -413,7 +461,7 @@ void audio_transfer(struct _audio_desc *desc, void *buffer, uint32_t size, struc
 					.attr = SSC_BUF_ATTR_WRITE,
 				};
 
-				ssc_transfer(&desc->device.ssc.desc, &tx, cb);
+				err = ssc_transfer(&desc->device.ssc.desc, &tx, cb);
 			}
 			break;
 
@@ -425,7 +473,7 @@ void audio_transfer(struct _audio_desc *desc, void *buffer, uint32_t size, struc
 					.attr = SSC_BUF_ATTR_READ,
 				};
 
-				ssc_transfer(&desc->device.ssc.desc, &rx, cb);
+				err = ssc_transfer(&desc->device.ssc.desc, &rx, cb);
 			}
 			break;
 		}
@@ -436,7 +484,8 @@ void audio_transfer(struct _audio_desc *desc, void *buffer, uint32_t size, struc
 		switch (desc->direction) {
 		case AUDIO_DEVICE_PLAY:
 			/* Do not supported */
-			return;
+			err = -ENOTSUP;
+			break;
 
 		case AUDIO_DEVICE_RECORD:
 			{
@@ -446,7 +495,7 @@ void audio_transfer(struct _audio_desc *desc, void *buffer, uint32_t size, struc
 					.attr = PDMIC_BUF_ATTR_READ,
 				};
 
-				pdmic_transfer(&desc->device.pdmic.desc, &rx, cb);
+				err = pdmic_transfer(&desc->device.pdmic.desc, &rx, cb);
 			}
 			break;
 		}
@@ -454,8 +503,14 @@ void audio_transfer(struct _audio_desc *desc, void *buffer, uint32_t size, struc
 #endif
 	default:
 		/* No audio device */
-		return;
+		break;
 	}
+
+	/* Transfer not started, no completion to wait for */
+	if (err < 0 && desc->dsp_rx.buffer == buffer)
+		desc->dsp_rx.buffer = NULL;
+
+	return err;
 }
 
 bool audio_transfer_is_done(struct _audio_desc *desc)
@@ -495,3 +550,10 @@ void audio_sync_adjust(struct _audio_desc *desc, int32_t adjust)
 #endif
 #endif
 }
+
+void audio_set_dsp(struct _audio_desc *desc, struct _audio_dsp *dsp)
+{
+	desc->dsp = dsp;
+	if (dsp)
+		audio_dsp_reset(dsp);
+}
@@ -50,6 +50,7 @@
 #include "audio/ad1934.h"
 #endif
 #endif /* CONFIG_HAVE_SSC */
+#include "audio/audio_dsp.h"
 #include "callback.h"
 #include "dma/dma.h"
 #include "gpio/pio.h"
@@ -143,6 +144,14 @@ struct _audio_desc {
 	uint16_t num_channels;
 	/* 8 bits = 8, 16 bits = 16, etc. */
 	uint16_t bits_per_sample;
+	/* Optional processing chain, see audio_set_dsp() */
+	struct _audio_dsp *dsp;
+	/* Capture transfer pending processing, only one at a time */
+	struct {
+		void *buffer;
+		uint32_t size;
+		struct _callback callback;
+	} dsp_rx;
 };
 
 
@@ -188,8 +197,11 @@ extern void audio_stop(struct _audio_desc *desc);
  * \param buffer   Data buffer (input/output according to configuration in descriptor)
  * \param size     Data buffer size
  * \param cb       Callback at end of DMA transfer
+ * \return 0 on success, -EBUSY if a capture is already pending processing
+ * by the attached chain, -ENOTSUP if the device cannot transfer in this
+ * direction, or the device driver error code.
  */
-extern void audio_transfer(struct _audio_desc *desc, void *buffer, uint32_t size, struct _callback* cb);
+extern int audio_transfer(struct _audio_desc *desc, void *buffer, uint32_t size, struct _callback* cb);
 
 /**
  * \brief Check the audio transfer status
@@ -204,4 +216,15 @@ extern bool audio_transfer_is_done(struct _audio_desc *desc);
  */
 extern void audio_sync_adjust(struct _audio_desc *desc, int32_t adjust);
 
+/**
+ * \brief Attach a processing chain to the audio channel. Playback buffers
+ * are processed in place before being transferred, capture buffers are
+ * processed in place before the transfer callback is called. While a chain
+ * is attached, a capture transfer must complete before the next one is
+ * started.
+ * \param desc     Audio descriptor
+ * \param dsp      Initialized processing chain, or NULL to detach it
+ */
+extern void audio_set_dsp(struct _audio_desc *desc, struct _audio_dsp *dsp);
+
 #endif /* AUDIO_DEVICE_API_H */
@@ -0,0 +1,653 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "audio/audio_dsp.h"
+#include "errno.h"
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** Fixed-point format of the design computations, Q30 */
+#define FRAC_BITS (30)
+#define FRAC_ONE  (1ll << FRAC_BITS)
+
+/** Fractional bits of the biquad design intermediates */
+#define DESIGN_BITS (26)
+#define DESIGN_ONE  (1ll << DESIGN_BITS)
+
+/** Odd polynomial for sin(pi / 2 z) - pi / 2 z on [-1, 1] (Q30), within
+ * 5e-9 of the exact value */
+#define SIN_C1 (1686629713ll)
+#define SIN_C3 (-693598255ll)
+#define SIN_C5 (85565989ll)
+#define SIN_C7 (-5018110ll)
+#define SIN_C9 (162492ll)
+
+/** Polynomial for 2^f - 1 on [0, 1) (Q30), within 3e-9 relative */
+#define EXP2_C1 (744260926ll)
+#define EXP2_C2 (257944911ll)
+#define EXP2_C3 (59573806ll)
+#define EXP2_C4 (10395148ll)
+#define EXP2_C5 (1333008ll)
+#define EXP2_C6 (234022ll)
+
+/** log2(10) / 20, log2(10) / 40 and log2(e), in Q30 */
+#define LOG2_10_DIV_20 (178344657ll)
+#define LOG2_10_DIV_40 (89172328ll)
+#define LOG2_E         (1549082005ll)
+
+/** Binary angle of a quarter turn (full turn is 2^32) */
+#define QUARTER_TURN (1u << 30)
+
+/** Design limits of audio_dsp_design_biquad() */
+#define DESIGN_MAX_GAIN_DB (24)
+#define DESIGN_MIN_Q       (AUDIO_DSP_FIXED(1) / 256)
+
+/** Lowest gain applied by the AGC (-24dB) */
+#define AGC_MIN_GAIN (AUDIO_DSP_GAIN_UNITY / 16)
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static inline int32_t _saturate(int64_t v, int32_t max)
+{
+	if (v > max)
+		return max;
+	if (v < -max - 1)
+		return -max - 1;
+	return (int32_t)v;
+}
+
+/**
+ * \brief Divide, rounding to the nearest integer.
+ */
+static int64_t _div_round(int64_t n, int64_t d)
+{
+	if ((n < 0) != (d < 0))
+		return (n - d / 2) / d;
+	return (n + d / 2) / d;
+}
+
+/**
+ * \brief Multiply two design intermediates (Q26).
+ */
+static int64_t _mul(int64_t a, int64_t b)
+{
+	return (a * b + (DESIGN_ONE / 2)) >> DESIGN_BITS;
+}
+
+/**
+ * \brief Sine of a binary angle (2^32 per turn), in Q30.
+ */
+static int64_t _sin(uint32_t angle)
+{
+	int32_t a = (int32_t)angle;
+	int64_t z, z2, r;
+
+	/* Fold to [-pi/2, pi/2] with sin(a) = sin(pi - a), z in quarter
+	 * turns (Q30) */
+	if (a > (int32_t)QUARTER_TURN || a < -(int32_t)QUARTER_TURN)
+		a = (int32_t)(0x80000000u - angle);
+	z = a;
+
+	z2 = (z * z) >> FRAC_BITS;
+	r = SIN_C7 + ((SIN_C9 * z2) >> FRAC_BITS);
+	r = SIN_C5 + ((r * z2) >> FRAC_BITS);
+	r = SIN_C3 + ((r * z2) >> FRAC_BITS);
+	r = SIN_C1 + ((r * z2) >> FRAC_BITS);
+	return (r * z) >> FRAC_BITS;
+}
+
+/**
+ * \brief Power of two, 2^x with x and the result in Q30.
+ */
+static int64_t _exp2(int64_t x)
+{
+	int64_t i = x >> FRAC_BITS;
+	int64_t f = x - (i << FRAC_BITS);
+	int64_t r;
+
+	r = EXP2_C5 + ((EXP2_C6 * f) >> FRAC_BITS);
+	r = EXP2_C4 + ((r * f) >> FRAC_BITS);
+	r = EXP2_C3 + ((r * f) >> FRAC_BITS);
+	r = EXP2_C2 + ((r * f) >> FRAC_BITS);
+	r = EXP2_C1 + ((r * f) >> FRAC_BITS);
+	r = FRAC_ONE + ((r * f) >> FRAC_BITS);
+
+	if (i >= 0)
+		return i < 32 ? r << i : INT64_MAX;
+	return i > -62 ? r >> -i : 0;
+}
+
+/**
+ * \brief 10^(db / 20) in Q30, db in 16.16.
+ */
+static int64_t _db_to_ratio(int32_t db)
+{
+	return _exp2(((int64_t)db * LOG2_10_DIV_20) >> 16);
+}
+
+/**
+ * \brief Set a biquad coefficient (AUDIO_DSP_COEF_BITS) from design values.
+ * \return false if the coefficient is out of range.
+ */
+static bool _set_coef(int32_t *coef, int64_t v, int64_t a0)
+{
+	int64_t c = _div_round(v * (1 << AUDIO_DSP_COEF_BITS), a0);
+
+	if (c > INT32_MAX || c < INT32_MIN)
+		return false;
+	*coef = (int32_t)c;
+	return true;
+}
+
+/**
+ * \brief Smoothing coefficient (Q15) of a one-pole detector updated every
+ * block, for a time constant in ms: 1 - exp(-block / samples).
+ */
+static int16_t _time_coef(uint16_t ms, uint32_t sample_rate)
+{
+	uint64_t samples_x1000 = (uint64_t)ms * sample_rate;
+	int64_t t, e;
+
+	if (samples_x1000 < AUDIO_DSP_BLOCK * 1000ull)
+		return 32767;
+
+	/* block / samples, at most 1 (Q30) */
+	t = ((int64_t)AUDIO_DSP_BLOCK * 1000 << FRAC_BITS) / samples_x1000;
+	e = _exp2(-((t * LOG2_E) >> FRAC_BITS));
+	return (int16_t)((32767 * (FRAC_ONE - e)) >> FRAC_BITS);
+}
+
+static int32_t _dbfs_to_level(int8_t dbfs)
+{
+	int64_t level = _db_to_ratio(AUDIO_DSP_FIXED(dbfs))
+		>> (FRAC_BITS - AUDIO_DSP_SAMPLE_BITS);
+
+	return level > INT32_MAX ? INT32_MAX : (int32_t)level;
+}
+
+static int32_t _block_peak(const int32_t *w, uint32_t count)
+{
+	int32_t peak = 0;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		int32_t v = w[i] < 0 ? -w[i] : w[i];
+		if (v > peak)
+			peak = v;
+	}
+	return peak;
+}
+
+static void _ramp_to(struct _audio_dsp_ramp *ramp, int32_t gain, uint32_t frames)
+{
+	ramp->target = gain;
+	if (frames == 0 || gain == ramp->gain) {
+		ramp->gain = gain;
+		ramp->step = 0;
+		ramp->remaining = 0;
+	} else {
+		ramp->step = (gain - ramp->gain) / (int32_t)frames;
+		ramp->remaining = frames;
+	}
+}
+
+static void _ramp_reset(struct _audio_dsp_ramp *ramp, int32_t gain)
+{
+	ramp->gain = gain;
+	_ramp_to(ramp, gain, 0);
+}
+
+static void _apply_ramp(struct _audio_dsp_ramp *ramp, int32_t *w,
+		uint32_t frames, uint8_t channels)
+{
+	uint32_t i;
+	uint8_t c;
+
+	if (!ramp->remaining && ramp->gain == AUDIO_DSP_GAIN_UNITY)
+		return;
+
+	for (i = 0; i < frames; i++, w += channels) {
+		if (ramp->remaining) {
+			ramp->gain += ramp->step;
+			if (--ramp->remaining == 0)
+				ramp->gain = ramp->target;
+		}
+		for (c = 0; c < channels; c++)
+			w[c] = _saturate(((int64_t)w[c] * ramp->gain) >> 16, INT32_MAX);
+	}
+}
+
+static void _process_biquad(struct _audio_dsp_stage *stage, int32_t *w,
+		uint32_t frames, uint8_t channels)
+{
+	uint8_t s, c;
+	uint32_t i;
+
+	for (s = 0; s < stage->biquad.count; s++) {
+		const struct _audio_dsp_biquad *k = &stage->biquad.coefs[s];
+		for (c = 0; c < channels; c++) {
+			int32_t *st = stage->biquad.state[s][c];
+			int32_t x1 = st[0], x2 = st[1], y1 = st[2], y2 = st[3];
+			int32_t *p = w + c;
+			for (i = 0; i < frames; i++, p += channels) {
+				int32_t x = *p, y;
+				int64_t acc = 1ll << (AUDIO_DSP_COEF_BITS - 1);
+				acc += (int64_t)k->b0 * x;
+				acc += (int64_t)k->b1 * x1;
+				acc += (int64_t)k->b2 * x2;
+				acc -= (int64_t)k->a1 * y1;
+				acc -= (int64_t)k->a2 * y2;
+				y = _saturate(acc >> AUDIO_DSP_COEF_BITS, INT32_MAX);
+				x2 = x1;
+				x1 = x;
+				y2 = y1;
+				y1 = y;
+				*p = y;
+			}
+			st[0] = x1;
+			st[1] = x2;
+			st[2] = y1;
+			st[3] = y2;
+		}
+	}
+}
+
+/**
+ * \brief FIR filter. The history of each channel is a double buffer of
+ * 2 * count words so that the newest count samples are always contiguous,
+ * starting at head.
+ */
+static void _process_fir(struct _audio_dsp_stage *stage, int32_t *w,
+		uint32_t frames, uint8_t channels)
+{
+	const int16_t *taps = stage->fir.taps;
+	uint16_t count = stage->fir.count;
+	uint16_t head = stage->fir.head;
+	uint32_t i;
+	uint16_t k;
+	uint8_t c;
+
+	for (c = 0; c < channels; c++) {
+		int32_t *hist = stage->fir.history + c * 2 * count;
+		int32_t *p = w + c;
+		head = stage->fir.head;
+		for (i = 0; i < frames; i++, p += channels) {
+			const int32_t *x;
+			int64_t acc = 1 << 14;
+			head = head ? head - 1 : count - 1;
+			hist[head] = hist[head + count] = *p;
+			x = hist + head;
+			for (k = 0; k < count; k++)
+				acc += (int64_t)taps[k] * x[k];
+			*p = _saturate(acc >> 15, INT32_MAX);
+		}
+	}
+	stage->fir.head = head;
+}
+
+static void _process_agc(struct _audio_dsp_stage *stage, int32_t *w,
+		uint32_t frames, uint8_t channels)
+{
+	int32_t peak = _block_peak(w, frames * channels);
+	int32_t env = stage->agc.envelope;
+	int32_t coef = peak > env ? stage->agc.attack : stage->agc.release;
+	int32_t gain;
+
+	env += (int32_t)(((int64_t)(peak - env) * coef) >> 15);
+	stage->agc.envelope = env;
+
+	if ((((int64_t)env * stage->agc.max_gain) >> 16) <= stage->agc.target) {
+		gain = stage->agc.max_gain;
+	} else {
+		gain = (int32_t)(((int64_t)stage->agc.target << 16) / env);
+		if (gain < AGC_MIN_GAIN)
+			gain = AGC_MIN_GAIN;
+	}
+
+	_ramp_to(&stage->agc.ramp, gain, frames);
+	_apply_ramp(&stage->agc.ramp, w, frames, channels);
+}
+
+static void _process_gate(struct _audio_dsp_stage *stage, int32_t *w,
+		uint32_t frames, uint8_t channels)
+{
+	int32_t peak = _block_peak(w, frames * channels);
+
+	if (peak >= stage->gate.threshold) {
+		stage->gate.hold_count = stage->gate.hold;
+		if (stage->gate.ramp.target != AUDIO_DSP_GAIN_UNITY)
+			_ramp_to(&stage->gate.ramp, AUDIO_DSP_GAIN_UNITY,
+					stage->gate.attack);
+	} else if (stage->gate.hold_count) {
+		stage->gate.hold_count--;
+	} else if (stage->gate.ramp.target != stage->gate.floor) {
+		_ramp_to(&stage->gate.ramp, stage->gate.floor,
+				stage->gate.release);
+	}
+
+	_apply_ramp(&stage->gate.ramp, w, frames, channels);
+}
+
+static void _load(const struct _audio_dsp *dsp, int32_t *w, const void *buffer,
+		uint32_t count)
+{
+	uint32_t i;
+
+	if (dsp->bits_per_sample == 16) {
+		const int16_t *s = buffer;
+		for (i = 0; i < count; i++)
+			w[i] = (int32_t)s[i] * (1 << (AUDIO_DSP_SAMPLE_BITS - 15));
+	} else {
+		const uint32_t *s = buffer;
+		for (i = 0; i < count; i++)
+			w[i] = ((int32_t)(s[i] << 8) >> 8) * (1 << (AUDIO_DSP_SAMPLE_BITS - 23));
+	}
+}
+
+static void _store(const struct _audio_dsp *dsp, void *buffer, const int32_t *w,
+		uint32_t count)
+{
+	uint32_t i;
+
+	if (dsp->bits_per_sample == 16) {
+		const int shift = AUDIO_DSP_SAMPLE_BITS - 15;
+		int16_t *d = buffer;
+		for (i = 0; i < count; i++)
+			d[i] = (int16_t)_saturate(((int64_t)w[i] + (1 << (shift - 1))) >> shift,
+					INT16_MAX);
+	} else {
+		const int shift = AUDIO_DSP_SAMPLE_BITS - 23;
+		int32_t *d = buffer;
+		for (i = 0; i < count; i++)
+			d[i] = _saturate(((int64_t)w[i] + (1 << (shift - 1))) >> shift,
+					0x7fffff);
+	}
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+int audio_dsp_init(struct _audio_dsp *dsp, uint32_t sample_rate,
+		uint8_t channels, uint8_t bits)
+{
+	if (channels == 0 || channels > AUDIO_DSP_MAX_CHANNELS)
+		return -EINVAL;
+	if (bits != 16 && bits != 24)
+		return -EINVAL;
+
+	memset(dsp, 0, sizeof(*dsp));
+	dsp->sample_rate = sample_rate;
+	dsp->channels = channels;
+	dsp->bits_per_sample = bits;
+	return 0;
+}
+
+int audio_dsp_add_stage(struct _audio_dsp *dsp, struct _audio_dsp_stage *stage)
+{
+	if (dsp->stage_count >= AUDIO_DSP_MAX_STAGES)
+		return -ENOMEM;
+
+	dsp->stages[dsp->stage_count++] = stage;
+	return 0;
+}
+
+void audio_dsp_reset(struct _audio_dsp *dsp)
+{
+	uint8_t i;
+
+	for (i = 0; i < dsp->stage_count; i++) {
+		struct _audio_dsp_stage *stage = dsp->stages[i];
+
+		switch (stage->type) {
+		case AUDIO_DSP_STAGE_BIQUAD:
+			memset(stage->biquad.state, 0, sizeof(stage->biquad.state));
+			break;
+		case AUDIO_DSP_STAGE_FIR:
+			memset(stage->fir.history, 0, 2 * stage->fir.count
+					* dsp->channels * sizeof(int32_t));
+			stage->fir.head = 0;
+			break;
+		case AUDIO_DSP_STAGE_GAIN:
+			_ramp_reset(&stage->gain, stage->gain.target);
+			break;
+		case AUDIO_DSP_STAGE_AGC:
+			stage->agc.envelope = 0;
+			_ramp_reset(&stage->agc.ramp, AUDIO_DSP_GAIN_UNITY);
+			break;
+		case AUDIO_DSP_STAGE_GATE:
+			stage->gate.hold_count = 0;
+			_ramp_reset(&stage->gate.ramp, stage->gate.floor);
+			break;
+		}
+	}
+}
+
+void audio_dsp_process(struct _audio_dsp *dsp, void *buffer, uint32_t frames)
+{
+	uint8_t channels = dsp->channels;
+	uint32_t sample_size = dsp->bits_per_sample == 16 ? 2 : 4;
+	uint8_t *p = buffer;
+	uint8_t i;
+
+	if (!dsp->stage_count)
+		return;
+
+	while (frames) {
+		uint32_t n = frames < AUDIO_DSP_BLOCK ? frames : AUDIO_DSP_BLOCK;
+
+		_load(dsp, dsp->work, p, n * channels);
+
+		for (i = 0; i < dsp->stage_count; i++) {
+			struct _audio_dsp_stage *stage = dsp->stages[i];
+
+			switch (stage->type) {
+			case AUDIO_DSP_STAGE_BIQUAD:
+				_process_biquad(stage, dsp->work, n, channels);
+				break;
+			case AUDIO_DSP_STAGE_FIR:
+				_process_fir(stage, dsp->work, n, channels);
+				break;
+			case AUDIO_DSP_STAGE_GAIN:
+				_apply_ramp(&stage->gain, dsp->work, n, channels);
+				break;
+			case AUDIO_DSP_STAGE_AGC:
+				_process_agc(stage, dsp->work, n, channels);
+				break;
+			case AUDIO_DSP_STAGE_GATE:
+				_process_gate(stage, dsp->work, n, channels);
+				break;
+			}
+		}
+
+		_store(dsp, p, dsp->work, n * channels);
+
+		p += n * channels * sample_size;
+		frames -= n;
+	}
+}
+
+int audio_dsp_design_biquad(struct _audio_dsp_biquad *coefs,
+		enum _audio_dsp_filter filter, uint32_t sample_rate,
+		uint32_t freq, int32_t q, int32_t gain_db)
+{
+	uint32_t angle;
+	int64_t sw, s2, cw, omc, alpha, a, sa, ap1, am1;
+	int64_t b0, b1, b2, a0, a1, a2;
+
+	if (freq == 0 || freq >= sample_rate / 2 || q < DESIGN_MIN_Q)
+		return -EINVAL;
+	if (gain_db > AUDIO_DSP_FIXED(DESIGN_MAX_GAIN_DB) ||
+	    gain_db < -AUDIO_DSP_FIXED(DESIGN_MAX_GAIN_DB))
+		return -EINVAL;
+
+	/* w0 = 2 pi freq / sample_rate as a binary angle */
+	angle = (uint32_t)(((uint64_t)freq << 32) / sample_rate);
+	sw = _sin(angle) >> (FRAC_BITS - DESIGN_BITS);
+	/* 1 - cos(w0) = 2 sin^2(w0 / 2), exact for low frequencies */
+	s2 = _sin(angle / 2);
+	omc = (s2 * s2) >> (2 * FRAC_BITS - DESIGN_BITS - 1);
+	cw = DESIGN_ONE - omc;
+	alpha = (sw * AUDIO_DSP_FIXED(1)) / (2 * q);
+	/* a = 10^(gain / 40), sa = 2 sqrt(a) alpha */
+	a = _exp2(((int64_t)gain_db * LOG2_10_DIV_40) >> 16)
+		>> (FRAC_BITS - DESIGN_BITS);
+	sa = 2 * _mul(_exp2(((int64_t)gain_db * LOG2_10_DIV_40) >> 17)
+			>> (FRAC_BITS - DESIGN_BITS), alpha);
+	ap1 = a + DESIGN_ONE;
+	am1 = a - DESIGN_ONE;
+
+	switch (filter) {
+	case AUDIO_DSP_LOWPASS:
+		b1 = omc;
+		b0 = b2 = b1 / 2;
+		a0 = DESIGN_ONE + alpha;
+		a1 = -2 * cw;
+		a2 = DESIGN_ONE - alpha;
+		break;
+	case AUDIO_DSP_HIGHPASS:
+		b1 = -(DESIGN_ONE + cw);
+		b0 = b2 = -b1 / 2;
+		a0 = DESIGN_ONE + alpha;
+		a1 = -2 * cw;
+		a2 = DESIGN_ONE - alpha;
+		break;
+	case AUDIO_DSP_PEAKING:
+		b0 = DESIGN_ONE + _mul(alpha, a);
+		b1 = -2 * cw;
+		b2 = DESIGN_ONE - _mul(alpha, a);
+		a0 = DESIGN_ONE + (alpha << DESIGN_BITS) / a;
+		a1 = -2 * cw;
+		a2 = DESIGN_ONE - (alpha << DESIGN_BITS) / a;
+		break;
+	case AUDIO_DSP_LOWSHELF:
+		b0 = _mul(a, ap1 - _mul(am1, cw) + sa);
+		b1 = 2 * _mul(a, am1 - _mul(ap1, cw));
+		b2 = _mul(a, ap1 - _mul(am1, cw) - sa);
+		a0 = ap1 + _mul(am1, cw) + sa;
+		a1 = -2 * (am1 + _mul(ap1, cw));
+		a2 = ap1 + _mul(am1, cw) - sa;
+		break;
+	case AUDIO_DSP_HIGHSHELF:
+	default:
+		b0 = _mul(a, ap1 + _mul(am1, cw) + sa);
+		b1 = -2 * _mul(a, am1 + _mul(ap1, cw));
+		b2 = _mul(a, ap1 + _mul(am1, cw) - sa);
+		a0 = ap1 - _mul(am1, cw) + sa;
+		a1 = 2 * (am1 - _mul(ap1, cw));
+		a2 = ap1 - _mul(am1, cw) - sa;
+		break;
+	}
+
+	if (!_set_coef(&coefs->b0, b0, a0) || !_set_coef(&coefs->b1, b1, a0) ||
+	    !_set_coef(&coefs->b2, b2, a0) || !_set_coef(&coefs->a1, a1, a0) ||
+	    !_set_coef(&coefs->a2, a2, a0))
+		return -ERANGE;
+	return 0;
+}
+
+int audio_dsp_biquad_init(struct _audio_dsp_stage *stage,
+		const struct _audio_dsp_biquad *coefs, uint8_t count)
+{
+	if (count == 0 || count > AUDIO_DSP_MAX_BIQUADS)
+		return -EINVAL;
+
+	memset(stage, 0, sizeof(*stage));
+	stage->type = AUDIO_DSP_STAGE_BIQUAD;
+	stage->biquad.count = count;
+	memcpy(stage->biquad.coefs, coefs, count * sizeof(*coefs));
+	return 0;
+}
+
+void audio_dsp_fir_init(struct _audio_dsp_stage *stage, const int16_t *taps,
+		uint16_t count, int32_t *history, uint8_t channels)
+{
+	memset(stage, 0, sizeof(*stage));
+	stage->type = AUDIO_DSP_STAGE_FIR;
+	stage->fir.taps = taps;
+	stage->fir.count = count;
+	stage->fir.history = history;
+	memset(history, 0, 2 * count * channels * sizeof(int32_t));
+}
+
+void audio_dsp_gain_init(struct _audio_dsp_stage *stage, int32_t gain)
+{
+	memset(stage, 0, sizeof(*stage));
+	stage->type = AUDIO_DSP_STAGE_GAIN;
+	_ramp_reset(&stage->gain, gain);
+}
+
+void audio_dsp_gain_set(struct _audio_dsp_stage *stage, int32_t gain,
+		uint32_t frames)
+{
+	_ramp_to(&stage->gain, gain, frames);
+}
+
+void audio_dsp_agc_init(struct _audio_dsp_stage *stage,
+		const struct _audio_dsp_agc_cfg *cfg, uint32_t sample_rate)
+{
+	memset(stage, 0, sizeof(*stage));
+	stage->type = AUDIO_DSP_STAGE_AGC;
+	stage->agc.target = _dbfs_to_level(cfg->target_dbfs);
+	stage->agc.max_gain = audio_dsp_db_to_gain(AUDIO_DSP_FIXED(cfg->max_gain_db));
+	stage->agc.attack = _time_coef(cfg->attack_ms, sample_rate);
+	stage->agc.release = _time_coef(cfg->release_ms, sample_rate);
+	_ramp_reset(&stage->agc.ramp, AUDIO_DSP_GAIN_UNITY);
+}
+
+void audio_dsp_gate_init(struct _audio_dsp_stage *stage,
+		const struct _audio_dsp_gate_cfg *cfg, uint32_t sample_rate)
+{
+	memset(stage, 0, sizeof(*stage));
+	stage->type = AUDIO_DSP_STAGE_GATE;
+	stage->gate.threshold = _dbfs_to_level(cfg->threshold_dbfs);
+	stage->gate.floor = audio_dsp_db_to_gain(AUDIO_DSP_FIXED(cfg->floor_db));
+	stage->gate.hold = (cfg->hold_ms * sample_rate / 1000) / AUDIO_DSP_BLOCK;
+	stage->gate.attack = cfg->attack_ms * sample_rate / 1000;
+	stage->gate.release = cfg->release_ms * sample_rate / 1000;
+	_ramp_reset(&stage->gate.ramp, stage->gate.floor);
+}
+
+int32_t audio_dsp_db_to_gain(int32_t db)
+{
+	int64_t gain = _db_to_ratio(db) >> (FRAC_BITS - 16);
+
+	return gain > INT32_MAX ? INT32_MAX : (int32_t)gain;
+}
@@ -0,0 +1,290 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file
+ *
+ * Block based fixed-point audio processing chain.
+ *
+ * A chain (struct _audio_dsp) runs a list of stages in place on interleaved
+ * 16-bit or 24-bit (in 32-bit words) buffers. Samples are processed in
+ * blocks of AUDIO_DSP_BLOCK frames in Q27, leaving 24dB of headroom above
+ * full scale between stages.
+ *
+ * Stages:
+ * - biquad cascade (high-pass/DC removal, parametric EQ, shelves)
+ * - FIR filter
+ * - gain with linear ramp
+ * - automatic gain control
+ * - noise gate
+ *
+ * A chain is attached to an audio device with audio_set_dsp(): playback
+ * buffers are processed before being sent, capture buffers before the
+ * transfer callback is called.
+ */
+
+#ifndef AUDIO_DSP_H_
+#define AUDIO_DSP_H_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+#define AUDIO_DSP_MAX_CHANNELS (8)
+#define AUDIO_DSP_MAX_STAGES   (8)
+#define AUDIO_DSP_MAX_BIQUADS  (6)
+
+/** Frames processed per block, also the AGC/gate analysis period */
+#define AUDIO_DSP_BLOCK (32)
+
+/** Fractional bits of the internal samples */
+#define AUDIO_DSP_SAMPLE_BITS (27)
+
+/** Fractional bits of biquad coefficients */
+#define AUDIO_DSP_COEF_BITS (28)
+
+/** Unity gain (16.16) */
+#define AUDIO_DSP_GAIN_UNITY (1 << 16)
+
+/** Convert a constant to 16.16, e.g. AUDIO_DSP_FIXED(0.707) for a Q factor
+ * or AUDIO_DSP_FIXED(-3.5) for a gain in dB */
+#define AUDIO_DSP_FIXED(v) ((int32_t)((v) * 65536))
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+enum _audio_dsp_stage_type {
+	AUDIO_DSP_STAGE_BIQUAD,
+	AUDIO_DSP_STAGE_FIR,
+	AUDIO_DSP_STAGE_GAIN,
+	AUDIO_DSP_STAGE_AGC,
+	AUDIO_DSP_STAGE_GATE,
+};
+
+/** Filter shapes for audio_dsp_design_biquad() */
+enum _audio_dsp_filter {
+	AUDIO_DSP_LOWPASS,
+	AUDIO_DSP_HIGHPASS,
+	AUDIO_DSP_PEAKING,
+	AUDIO_DSP_LOWSHELF,
+	AUDIO_DSP_HIGHSHELF,
+};
+
+/** Biquad coefficients, a0 normalized to 1 (AUDIO_DSP_COEF_BITS) */
+struct _audio_dsp_biquad {
+	int32_t b0, b1, b2;
+	int32_t a1, a2;
+};
+
+/** Gain ramp */
+struct _audio_dsp_ramp {
+	int32_t gain;      /**< Current gain (16.16) */
+	int32_t target;    /**< Gain at the end of the ramp */
+	int32_t step;      /**< Increment per frame */
+	uint32_t remaining;/**< Frames left in the ramp */
+};
+
+/** AGC settings */
+struct _audio_dsp_agc_cfg {
+	int8_t   target_dbfs;  /**< Output peak level to reach (dBFS, < 0) */
+	uint8_t  max_gain_db;  /**< Maximum gain (dB) */
+	uint16_t attack_ms;    /**< Envelope rise time constant */
+	uint16_t release_ms;   /**< Envelope fall time constant */
+};
+
+/** Noise gate settings */
+struct _audio_dsp_gate_cfg {
+	int8_t   threshold_dbfs; /**< Peak level opening the gate (dBFS) */
+	int8_t   floor_db;       /**< Gain when closed (dB, <= 0) */
+	uint16_t hold_ms;        /**< Time below threshold before closing */
+	uint16_t attack_ms;      /**< Opening ramp */
+	uint16_t release_ms;     /**< Closing ramp */
+};
+
+/** Processing stage, owned by the caller */
+struct _audio_dsp_stage {
+	enum _audio_dsp_stage_type type;
+	union {
+		struct {
+			uint8_t count;
+			struct _audio_dsp_biquad coefs[AUDIO_DSP_MAX_BIQUADS];
+			/** x1, x2, y1, y2 per section and channel */
+			int32_t state[AUDIO_DSP_MAX_BIQUADS][AUDIO_DSP_MAX_CHANNELS][4];
+		} biquad;
+		struct {
+			const int16_t *taps; /**< Q15 taps */
+			uint16_t count;
+			uint16_t head;
+			/** 2 * count words per channel */
+			int32_t *history;
+		} fir;
+		struct _audio_dsp_ramp gain;
+		struct {
+			struct _audio_dsp_ramp ramp;
+			int32_t target;    /**< Target peak (Q27) */
+			int32_t max_gain;  /**< 16.16 */
+			int32_t envelope;  /**< Q27 */
+			int16_t attack;    /**< Q15 smoothing coefficients */
+			int16_t release;
+		} agc;
+		struct {
+			struct _audio_dsp_ramp ramp;
+			int32_t threshold; /**< Q27 */
+			int32_t floor;     /**< 16.16 */
+			uint32_t hold;     /**< Blocks */
+			uint32_t hold_count;
+			uint32_t attack;   /**< Frames */
+			uint32_t release;  /**< Frames */
+		} gate;
+	};
+};
+
+/** Processing chain */
+struct _audio_dsp {
+	uint32_t sample_rate;
+	uint8_t  channels;
+	uint8_t  bits_per_sample;
+	uint8_t  stage_count;
+	struct _audio_dsp_stage *stages[AUDIO_DSP_MAX_STAGES];
+	int32_t  work[AUDIO_DSP_BLOCK * AUDIO_DSP_MAX_CHANNELS];
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize an empty chain.
+ * \param dsp         Chain to initialize.
+ * \param sample_rate Sample rate (Hz).
+ * \param channels    Interleaved channels.
+ * \param bits        Bits per sample, 16 or 24 (right-aligned in 32 bits).
+ * \return 0 on success, -EINVAL for unsupported parameters.
+ */
+extern int audio_dsp_init(struct _audio_dsp *dsp, uint32_t sample_rate,
+		uint8_t channels, uint8_t bits);
+
+/**
+ * \brief Append an initialized stage to the chain.
+ * \return 0 on success, -ENOMEM if the chain is full.
+ */
+extern int audio_dsp_add_stage(struct _audio_dsp *dsp,
+		struct _audio_dsp_stage *stage);
+
+/**
+ * \brief Clear the filter and level detector states of all stages.
+ */
+extern void audio_dsp_reset(struct _audio_dsp *dsp);
+
+/**
+ * \brief Run the chain in place.
+ * \param dsp    Chain.
+ * \param buffer Interleaved samples.
+ * \param frames Number of frames in buffer.
+ */
+extern void audio_dsp_process(struct _audio_dsp *dsp, void *buffer,
+		uint32_t frames);
+
+/**
+ * \brief Compute biquad coefficients (RBJ audio EQ cookbook), in fixed
+ * point.
+ * \param coefs       Computed coefficients.
+ * \param filter      Filter shape.
+ * \param sample_rate Sample rate (Hz).
+ * \param freq        Cutoff or center frequency (Hz), below sample_rate / 2.
+ * \param q           Quality factor (16.16, 1/256 minimum), e.g.
+ *                    AUDIO_DSP_FIXED(0.707) for Butterworth shapes.
+ * \param gain_db     Gain of peaking and shelving filters (16.16 dB,
+ *                    within +/-24dB).
+ * \return 0 on success, -EINVAL for out of range parameters, -ERANGE if a
+ * coefficient exceeds the AUDIO_DSP_COEF_BITS range (e.g. shelves boosting
+ * more than 12dB).
+ */
+extern int audio_dsp_design_biquad(struct _audio_dsp_biquad *coefs,
+		enum _audio_dsp_filter filter, uint32_t sample_rate,
+		uint32_t freq, int32_t q, int32_t gain_db);
+
+/**
+ * \brief Initialize a cascade of count biquad sections.
+ * \return 0 on success, -EINVAL if count is out of range.
+ */
+extern int audio_dsp_biquad_init(struct _audio_dsp_stage *stage,
+		const struct _audio_dsp_biquad *coefs, uint8_t count);
+
+/**
+ * \brief Initialize a FIR stage.
+ * \param stage    Stage to initialize.
+ * \param taps     Q15 taps, must stay valid while the stage is used.
+ * \param count    Number of taps.
+ * \param history  Buffer of 2 * count * channels words.
+ * \param channels Channels of the chain the stage is added to.
+ */
+extern void audio_dsp_fir_init(struct _audio_dsp_stage *stage,
+		const int16_t *taps, uint16_t count, int32_t *history,
+		uint8_t channels);
+
+/**
+ * \brief Initialize a gain stage at a fixed gain.
+ * \param gain Gain (16.16).
+ */
+extern void audio_dsp_gain_init(struct _audio_dsp_stage *stage, int32_t gain);
+
+/**
+ * \brief Ramp a gain stage to a new gain.
+ * \param gain   Gain (16.16).
+ * \param frames Duration of the ramp, 0 for an immediate change.
+ */
+extern void audio_dsp_gain_set(struct _audio_dsp_stage *stage, int32_t gain,
+		uint32_t frames);
+
+/**
+ * \brief Initialize an AGC stage.
+ */
+extern void audio_dsp_agc_init(struct _audio_dsp_stage *stage,
+		const struct _audio_dsp_agc_cfg *cfg, uint32_t sample_rate);
+
+/**
+ * \brief Initialize a noise gate stage.
+ */
+extern void audio_dsp_gate_init(struct _audio_dsp_stage *stage,
+		const struct _audio_dsp_gate_cfg *cfg, uint32_t sample_rate);
+
+/**
+ * \brief Convert a gain in dB to a 16.16 linear gain.
+ * \param db Gain in dB (16.16), e.g. AUDIO_DSP_FIXED(6).
+ */
+extern int32_t audio_dsp_db_to_gain(int32_t db);
+
+#endif /* AUDIO_DSP_H_ */
@@ -68,6 +68,7 @@ enum _cand_buf_attr {
 	CAND_BUF_ATTR_USING_FIFO1  = 0x300,
 };
 
+#include "can/can-rx-ring.h"
 #if defined(CONFIG_HAVE_CAN)
 #include "can/cand.h"
 #elif defined(CONFIG_HAVE_MCAN)
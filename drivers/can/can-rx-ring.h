@@ -0,0 +1,169 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef CAN_RX_RING_H_
+#define CAN_RX_RING_H_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "barriers.h"
+#include "callback.h"
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Payload capacity of a ring entry */
+#if defined(CONFIG_HAVE_MCAN)
+#define CAN_RX_FRAME_DATA_SIZE 64
+#else
+#define CAN_RX_FRAME_DATA_SIZE 8
+#endif
+
+/** \addtogroup can_rx_frame_attr Received frame attributes
+ *      @{*/
+#define CAN_RX_FRAME_EXTENDED  0x01 /**< 29-bit identifier */
+#define CAN_RX_FRAME_RTR       0x02 /**< Remote frame */
+#define CAN_RX_FRAME_FD        0x04 /**< CAN FD format */
+#define CAN_RX_FRAME_BRS       0x08 /**< CAN FD with bit rate switching */
+#define CAN_RX_FRAME_ESI       0x10 /**< Transmitter error passive */
+/**     @}*/
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** Frame stored in an RX ring */
+struct _can_rx_frame {
+	uint32_t id;        /**< Message identifier */
+	uint16_t timestamp; /**< Controller timestamp counter at reception */
+	uint8_t  len;       /**< Payload length, in bytes */
+	uint8_t  attr;      /**< CAN_RX_FRAME_xxx flags */
+	uint8_t  data[CAN_RX_FRAME_DATA_SIZE];
+};
+
+/**
+ * Driver-owned receive queue. Filled from the CAN interrupt handler and
+ * drained by the application; a single producer and a single consumer may
+ * use it concurrently without locking.
+ */
+struct _can_rx_ring {
+	struct _can_rx_frame *frames; /**< Storage for size frames */
+	uint16_t size;                /**< Number of frames, power of two */
+	volatile uint16_t head;       /**< Free running write counter */
+	volatile uint16_t tail;       /**< Free running read counter */
+	uint32_t received;            /**< Frames stored in the ring */
+	uint32_t overflows;           /**< Frames dropped, ring full */
+	uint32_t lost;                /**< Frames lost by the controller */
+	struct _callback cb;          /**< Called once per drained batch */
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize an RX ring.
+ * \param ring   Ring to initialize.
+ * \param frames Storage for size frames.
+ * \param size   Number of frames, must be a power of two.
+ * \param cb     Callback invoked from the interrupt handler after each batch
+ *               of frames was stored (can be NULL).
+ */
+static inline void can_rx_ring_init(struct _can_rx_ring *ring,
+		struct _can_rx_frame *frames, uint16_t size, struct _callback *cb)
+{
+	memset(ring, 0, sizeof(*ring));
+	ring->frames = frames;
+	ring->size = size;
+	callback_copy(&ring->cb, cb);
+}
+
+/**
+ * \brief Number of frames waiting in the ring.
+ */
+static inline uint32_t can_rx_ring_count(const struct _can_rx_ring *ring)
+{
+	return (uint16_t)(ring->head - ring->tail);
+}
+
+/**
+ * \brief Driver side: get the next free entry, or NULL if the ring is full
+ * (the overflow counter is then incremented).
+ */
+static inline struct _can_rx_frame *can_rx_ring_get_slot(struct _can_rx_ring *ring)
+{
+	if (can_rx_ring_count(ring) >= ring->size) {
+		ring->overflows++;
+		return NULL;
+	}
+	return &ring->frames[ring->head & (ring->size - 1)];
+}
+
+/**
+ * \brief Driver side: publish the entry returned by can_rx_ring_get_slot().
+ */
+static inline void can_rx_ring_commit(struct _can_rx_ring *ring)
+{
+	dmb();
+	ring->head++;
+	ring->received++;
+}
+
+/**
+ * \brief Copy up to max frames out of the ring.
+ * \param ring   RX ring.
+ * \param frames Destination array.
+ * \param max    Capacity of frames.
+ * \return Number of frames copied.
+ */
+static inline uint32_t can_rx_ring_read(struct _can_rx_ring *ring,
+		struct _can_rx_frame *frames, uint32_t max)
+{
+	uint16_t tail = ring->tail;
+	uint32_t count = can_rx_ring_count(ring);
+	uint32_t i;
+
+	if (count > max)
+		count = max;
+	dmb();
+	for (i = 0; i < count; i++, tail++)
+		frames[i] = ring->frames[tail & (ring->size - 1)];
+	dmb();
+	ring->tail = tail;
+
+	return count;
+}
+
+#endif /* CAN_RX_RING_H_ */
@@ -114,6 +114,8 @@ static uint8_t cand_allocate_mailbox(struct _can_desc* desc)
 	uint8_t mailbox;
 
 	for (mailbox = 0; mailbox < CAN_NUM_MAILBOX; mailbox++) {
+		if (desc->mailboxes[mailbox].ring)
+			continue;
 		if (desc->mailboxes[mailbox].state == CAND_XFR_DISABLED
 			|| desc->mailboxes[mailbox].state == CAND_XFR_IDLE)
 		break;
@@ -167,6 +169,50 @@ static void cand_error_handler(struct _can_desc* desc, uint32_t errors)
 		trace_error("Bit\n\r");
 }
 
+/**
+ * Move the frame of a ready mailbox into its RX ring and re-arm it.
+ * \return true if the mailbox held a frame.
+ */
+static bool cand_rx_ring_store(struct _can_desc* desc, uint8_t mailbox)
+{
+	Can *can = desc->addr;
+	struct _can_rx_ring *ring = desc->mailboxes[mailbox].ring;
+	struct _can_rx_frame *frame;
+	uint32_t sr = can_get_message_status(can, mailbox);
+	uint32_t mid;
+	uint32_t data[2];
+
+	if ((sr & CAN_MSR_MRDY) != CAN_MSR_MRDY)
+		return false;
+
+	frame = can_rx_ring_get_slot(ring);
+	if (frame) {
+		mid = can_get_message_id(can, mailbox);
+		if (mid & CAN_MID_MIDE) {
+			frame->id = mid & (CAN_MID_MIDvA_Msk | CAN_MID_MIDvB_Msk);
+			frame->attr = CAN_RX_FRAME_EXTENDED;
+		} else {
+			frame->id = (mid & CAN_MID_MIDvA_Msk) >> CAN_MID_MIDvA_Pos;
+			frame->attr = 0;
+		}
+		if (sr & CAN_MSR_MRTR)
+			frame->attr |= CAN_RX_FRAME_RTR;
+		frame->timestamp = (sr & CAN_MSR_MTIMESTAMP_Msk) >> CAN_MSR_MTIMESTAMP_Pos;
+		frame->len = (sr & CAN_MSR_MDLC_Msk) >> CAN_MSR_MDLC_Pos;
+		if (frame->len > 8)
+			frame->len = 8;
+		can_get_message(can, mailbox, data);
+		memcpy(frame->data, data, frame->len);
+		can_rx_ring_commit(ring);
+	}
+	if (sr & CAN_MSR_MMI)
+		ring->lost++;
+
+	/* Ready for the next frame */
+	can_message_rx(can, mailbox);
+	return true;
+}
+
 /**
  * Handler for messages
  * \param pCand Pointer to CAN Driver instance.
@@ -174,11 +220,19 @@ static void cand_error_handler(struct _can_desc* desc, uint32_t errors)
 static void cand_message_handler(struct _can_desc* desc)
 {
 	uint8_t mailbox;
+	uint8_t i;
 	uint32_t sr;
+	uint32_t notify = 0;
 	struct _buffer **buf;
 	Can *can = desc->addr;
 
 	for (mailbox = 0; mailbox < CAN_NUM_MAILBOX; mailbox++) {
+		if (desc->mailboxes[mailbox].ring) {
+			if (cand_rx_ring_store(desc, mailbox))
+				notify |= 1 << mailbox;
+			continue;
+		}
+
 		buf = &desc->mailboxes[mailbox].buf;
 		if (*buf == NULL)
 			continue;
@@ -217,6 +271,18 @@ static void cand_message_handler(struct _can_desc* desc)
 		callback_call(&desc->mailboxes[mailbox].cb, NULL);
 	}
 
+	/* One notification per ring, whatever the number of mailboxes */
+	for (mailbox = 0; mailbox < CAN_NUM_MAILBOX; mailbox++) {
+		struct _can_rx_ring *ring = desc->mailboxes[mailbox].ring;
+
+		if ((notify & (1 << mailbox)) == 0)
+			continue;
+		for (i = mailbox + 1; i < CAN_NUM_MAILBOX; i++)
+			if (desc->mailboxes[i].ring == ring)
+				notify &= ~(1 << i);
+		callback_call(&ring->cb, ring);
+	}
+
 	/* All transfer finished ? */
 	if ((can_get_it_mask(can) & CAN_MB_EVENTS) == 0)
 		desc->state = CAND_STATE_ACTIVATED;
@@ -475,3 +541,60 @@ int cand_transfer(struct _can_desc* desc, struct _buffer* buf,
 
 	return 0;
 }
+
+int cand_rx_ring_attach(struct _can_desc* desc, struct _can_rx_ring* ring,
+		uint32_t attr, uint8_t mailboxes)
+{
+	Can *can = desc->addr;
+	uint32_t mask;
+	uint32_t identifier;
+	uint8_t mailbox;
+	uint8_t i;
+
+	if (ring->size == 0 || (ring->size & (ring->size - 1)) || mailboxes == 0)
+		return -EINVAL;
+
+	if (attr & CAND_BUF_ATTR_EXTENDED) {
+		mask = CAN_MAM_MIDE | (desc->mask & 0x1fffffff);
+		identifier = CAN_MID_MIDE | (desc->identifier & 0x1fffffff);
+	} else {
+		mask = CAN_MAM_MIDE | CAN_MID_MIDvA(desc->mask);
+		identifier = CAN_MID_MIDvA(desc->identifier);
+	}
+
+	for (i = 0; i < mailboxes; i++) {
+		mailbox = cand_allocate_mailbox(desc);
+		if (mailbox >= CAN_NUM_MAILBOX) {
+			cand_rx_ring_detach(desc, ring);
+			return -ENOMEM;
+		}
+
+		cand_reset_mailbox(desc, mailbox, mask,
+			CAN_MMR_MOT_MB_RX >> CAN_MMR_MOT_Pos, 0);
+		can_configure_message_id(can, mailbox, identifier);
+		desc->mailboxes[mailbox].buf = NULL;
+		desc->mailboxes[mailbox].ring = ring;
+		desc->mailboxes[mailbox].state = CAND_XFR_TX;
+
+		can_message_rx(can, mailbox);
+		can_enable_it(can, 1 << mailbox | CAN_ERRS);
+	}
+
+	desc->state = CAND_STATE_XFR;
+
+	return 0;
+}
+
+void cand_rx_ring_detach(struct _can_desc* desc, struct _can_rx_ring* ring)
+{
+	uint8_t mailbox;
+
+	for (mailbox = 0; mailbox < CAN_NUM_MAILBOX; mailbox++) {
+		if (desc->mailboxes[mailbox].ring != ring)
+			continue;
+		cand_reset_mailbox(desc, mailbox, 0,
+			CAN_MMR_MOT_MB_DISABLED >> CAN_MMR_MOT_Pos, 0);
+		desc->mailboxes[mailbox].ring = NULL;
+		desc->mailboxes[mailbox].state = CAND_XFR_DISABLED;
+	}
+}
@@ -52,6 +52,7 @@ struct _cand_mailbox {
 	struct _buffer *buf;
 	struct _callback cb;
 	uint8_t state;
+	struct _can_rx_ring *ring; /**< RX ring fed by this mailbox */
 };
 
 struct _can_desc {
@@ -84,4 +85,26 @@ extern bool cand_is_enabled(struct _can_desc* desc);
 extern int cand_transfer(struct _can_desc* desc, struct _buffer* buf,
 			struct _callback* cb);
 
+/**
+ * Receive the frames matching the descriptor identifier and mask into an
+ * RX ring. Several mailboxes can be chained on the same identifier to
+ * absorb bursts: the interrupt handler drains all the ready ones, re-arms
+ * them and calls the ring callback once.
+ * \param desc      Pointer to CAN Driver descriptor instance.
+ * \param ring      Initialized RX ring.
+ * \param attr      CAND_BUF_ATTR_EXTENDED for a 29-bit identifier.
+ * \param mailboxes Number of mailboxes to allocate.
+ * \return 0 on success, otherwise a negative errno.
+ */
+extern int cand_rx_ring_attach(struct _can_desc* desc,
+			struct _can_rx_ring* ring, uint32_t attr, uint8_t mailboxes);
+
+/**
+ * Release the mailboxes feeding an RX ring.
+ * \param desc Pointer to CAN Driver descriptor instance.
+ * \param ring RX ring attached with cand_rx_ring_attach().
+ */
+extern void cand_rx_ring_detach(struct _can_desc* desc,
+			struct _can_rx_ring* ring);
+
 #endif /* CAND_H_ */
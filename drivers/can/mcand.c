@@ -45,6 +45,7 @@
 #include "irq/irq.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
+#include "timer.h"
 #include "trace.h"
 
 /*----------------------------------------------------------------------------
@@ -55,6 +56,14 @@
 
 #define MCAN_ERRS 0xFFFFFFFF
 
+/** \addtogroup mcand_tx_msg_states TX scheduler message states
+ *      @{*/
+#define TX_MSG_IDLE      0 /**< Not queued */
+#define TX_MSG_PENDING   1 /**< Waiting for a Tx element */
+#define TX_MSG_RAM       2 /**< Transmission requested */
+#define TX_MSG_REMOVED   3 /**< Removed while in a Tx element */
+/**     @}*/
+
 struct _mcan_quanta {
 	uint16_t before_sp; /* duration of the time segment before the
 			     * sample point (Sync_Seg + Prop_Seg +
@@ -89,8 +98,8 @@ struct _mcan_quanta {
 #define RAM_FILT_STD_CNT       (8u)
 #define RAM_FILT_EXT_CNT       (8u)
 #define RAM_RX_FIFO0_CNT       (12u)
-/* no Rx FIFO 1 in our Message RAM */
-#define RAM_RX_FIFO1_CNT       (0u)
+/* Rx FIFO 1 is meant for RX rings, see MCAND_RX_FIFO1_SIZE */
+#define RAM_RX_FIFO1_CNT       (MCAND_RX_FIFO1_SIZE)
 #define RAM_RX_BUF_CNT         (4u)
 /* no Tx Event FIFO in our Message RAM */
 #define RAM_TX_EVENT_CNT       (0u)
@@ -105,7 +114,7 @@ struct _mcan_quanta {
 
 #define MSG_RAM_SIZE1      ( 0 \
 	+ RAM_RX_FIFO0_CNT * RAM_BUF_SIZE \
-	+ RAM_RX_FIFO1_CNT * RAM_BUF_SIZE \
+	+ RAM_RX_FIFO1_CNT * (MCAN_RAM_BUF_HDR_SIZE + MCAND_RX_FIFO1_DATA_SIZE / 4u) \
 	+ RAM_RX_BUF_CNT * RAM_BUF_SIZE )
 
 #define MSG_RAM_ITEM_CNT (\
@@ -145,7 +154,7 @@ static struct mcan_config mcan_cfg = {
 	.item_count[MCAN_RAM_TX_FIFO]	 = RAM_TX_FIFO_CNT,
 
 	.buf_size_rx_fifo0 = 64,
-	.buf_size_rx_fifo1 = 0,
+	.buf_size_rx_fifo1 = MCAND_RX_FIFO1_DATA_SIZE,
 	.buf_size_rx = 64,
 	.buf_size_tx = 64,
 };
@@ -296,6 +305,9 @@ static int mcan_initialize(struct _mcan_desc* desc, const struct mcan_config *cf
 	/* Extended ID Filter AND mask */
 	mcan->MCAN_XIDAM = 0x1FFFFFFF;
 
+	/* Timestamp counter incremented every nominal bit time */
+	mcan->MCAN_TSCC = MCAN_TSCC_TSS_TCP_INC | MCAN_TSCC_TCP(0);
+
 	/* Interrupt configuration - leave initialization with all interrupts off
 	 * Disable all interrupts */
 	mcan_disable_it(mcan, MCAN_INT_ALL);
@@ -343,7 +355,10 @@ static int mcan_initialize(struct _mcan_desc* desc, const struct mcan_config *cf
 		MCAN_TXBC_TBSA((uint32_t)set->ram_array_tx >> 2)
 		| MCAN_TXBC_NDTB(cfg->item_count[MCAN_RAM_TX_BUFFER])
 		| MCAN_TXBC_TFQS(cfg->item_count[MCAN_RAM_TX_FIFO])
-		| 0;   /* clear MCAN_TXBC_TFQM */
+#if MCAND_TX_QUEUE
+		| MCAN_TXBC_TFQM    /* Tx Queue: transmission by identifier priority */
+#endif
+		| 0;
 
 	/* Configure the size of data fields in Rx and Tx Buffer Elements */
 	if (!mcan_set_rx_element_size(mcan,
@@ -364,7 +379,7 @@ static int mcan_initialize(struct _mcan_desc* desc, const struct mcan_config *cf
 	mcan->MCAN_CCCR = (mcan->MCAN_CCCR & ~(MCAN_CCCR_BRSE | MCAN_CCCR_FDOE)) |
 			MCAN_CCCR_PXHD | MCAN_CCCR_BRSE_DISABLED | MCAN_CCCR_FDOE_DISABLED;
 #endif
-	mcan_enable_it(mcan, MCAN_IE_BOE);
+	mcan_enable_it(mcan, MCAN_IE_BOE | MCAN_IE_TSWE);
 
 	return 0;
 }
@@ -450,6 +465,267 @@ static void mcand_release_ram(struct _mcan_desc *desc,
 	}
 }
 
+static void mcan_enqueue_outgoing_msg(struct _mcan_desc *desc,
+			uint8_t putIdx, uint32_t id, uint8_t len, const uint8_t *data)
+{
+	struct mcan_set *set = &desc->set;
+	assert(len <= set->cfg.buf_size_tx);
+
+	Mcan *mcan = desc->addr;
+	uint32_t val;
+	uint32_t *tx_buf = 0;
+	const enum can_mode mode = mcan_get_mode(mcan);
+	enum mcan_dlc dlc;
+
+	if (!mcan_get_length_code(len, &dlc))
+		dlc = CAN_DLC_0;
+	tx_buf = set->ram_array_tx + (uint32_t)
+		putIdx * (MCAN_RAM_BUF_HDR_SIZE + set->cfg.buf_size_tx / 4);
+	if (id & MCAN_RAM_T0_XTD)
+		*tx_buf++ = MCAN_RAM_T0_XTD | MCAN_RAM_T0_XTDID(id);
+	else
+		*tx_buf++ = MCAN_RAM_T0_STDID(id);
+	val = MCAN_RAM_T1_MM(0) | MCAN_RAM_T1_DLC((uint32_t)dlc);
+	if (mode == CAN_MODE_CAN_FD_CONST_RATE)
+		val |= MCAN_RAM_T1_FDF;
+	else if (mode == CAN_MODE_CAN_FD_DUAL_RATE)
+		val |= MCAN_RAM_T1_FDF | MCAN_RAM_T1_BRS;
+	*tx_buf++ = val;
+	memcpy(tx_buf, data, len);
+	dsb();
+	/* enable transmit from buffer to set TC interrupt bit in IR,
+	 * but interrupt will not happen unless TC interrupt is enabled
+	 */
+	mcan->MCAN_TXBTIE |= (1 << putIdx);
+	/* request to send */
+	mcan->MCAN_TXBAR = (1 << putIdx);
+}
+
+/**
+ * \brief Read the timestamp counter extended to 64 bits with the number of
+ * wrap-arounds, in nominal bit times.
+ */
+static uint64_t _mcand_timestamp(struct _mcan_desc *desc)
+{
+	Mcan *mcan = desc->addr;
+	uint32_t wraps;
+	uint32_t tsc;
+
+	do {
+		wraps = desc->ts_wraps;
+		tsc = (mcan->MCAN_TSCV & MCAN_TSCV_TSC_Msk) >> MCAN_TSCV_TSC_Pos;
+	} while (wraps != desc->ts_wraps);
+
+	/* wrap-around not serviced yet, interrupt masked */
+	if ((mcan_get_status(mcan) & MCAN_IR_TSW) && tsc < 0x8000)
+		wraps++;
+
+	return ((uint64_t)wraps << 16) | tsc;
+}
+
+/**
+ * \brief Worst case length of a frame including bit stuffing, interframe
+ * space included, counted in nominal bit times.
+ */
+static uint32_t _mcand_frame_bits(bool extended, uint32_t len)
+{
+	uint32_t stuffed = (extended ? 54 : 34) + 8 * len;
+
+	return stuffed + 13 + (stuffed - 1) / 4;
+}
+
+static void _mcand_account_rx(struct _mcan_desc *desc, const uint32_t *rx_buf)
+{
+	uint32_t len = get_data_length((enum mcan_dlc)
+			((rx_buf[1] & MCAN_RAM_R1_DLC_Msk) >> MCAN_RAM_R1_DLC_Pos));
+
+	desc->stats.rx_frames++;
+	desc->stats.bits += _mcand_frame_bits(rx_buf[0] & MCAN_RAM_R0_XTD, len);
+}
+
+static void _mcand_lock(struct _mcan_desc *desc)
+{
+	irq_disable(get_mcan_id_from_addr(desc->addr, 0));
+	irq_disable(get_mcan_id_from_addr(desc->addr, 1));
+}
+
+static void _mcand_unlock(struct _mcan_desc *desc)
+{
+	irq_enable(get_mcan_id_from_addr(desc->addr, 0));
+	irq_enable(get_mcan_id_from_addr(desc->addr, 1));
+}
+
+/**
+ * \brief Arbitration priority of a message, lower wins. A standard frame
+ * wins over an extended frame with the same base identifier.
+ */
+static uint32_t _mcand_tx_prio(const struct _mcand_tx_msg *msg)
+{
+	if (msg->attr & CAND_BUF_ATTR_EXTENDED)
+		return ((msg->id & 0x1fffffff) << 1) | 1;
+	return (msg->id & 0x7ff) << 19;
+}
+
+static void _mcand_tx_insert(struct _mcan_desc *desc, struct _mcand_tx_msg *msg)
+{
+	struct _mcand_tx_msg **prev = &desc->tx_pending;
+
+	while (*prev && (*prev)->prio <= msg->prio)
+		prev = &(*prev)->next;
+	msg->next = *prev;
+	*prev = msg;
+	msg->state = TX_MSG_PENDING;
+}
+
+static void _mcand_tx_unlink(struct _mcan_desc *desc, struct _mcand_tx_msg *msg)
+{
+	struct _mcand_tx_msg **prev = &desc->tx_pending;
+
+	while (*prev && *prev != msg)
+		prev = &(*prev)->next;
+	if (*prev)
+		*prev = msg->next;
+	msg->next = NULL;
+}
+
+static void _mcand_tx_queue(struct _mcan_desc *desc, struct _mcand_tx_msg *msg)
+{
+	msg->prio = _mcand_tx_prio(msg);
+	msg->queued_at = _mcand_timestamp(desc);
+	_mcand_tx_insert(desc, msg);
+}
+
+static void _mcand_tx_release_element(struct _mcan_desc *desc, uint32_t idx)
+{
+	uint32_t buf_count = desc->set.cfg.item_count[MCAN_RAM_TX_BUFFER];
+
+	desc->tx_slot[idx] = NULL;
+	desc->tx_cancel &= ~(1 << idx);
+	desc->addr->MCAN_TXBCIE &= ~(1 << idx);
+	if (idx >= buf_count)
+		mcand_release_ram(desc, MCAN_RAM_TX_FIFO, idx - buf_count);
+	else
+		mcand_release_ram(desc, MCAN_RAM_TX_BUFFER, idx);
+}
+
+/**
+ * \brief Request the cancellation of the lowest priority message held in
+ * the message RAM if it has a lower priority than prio.
+ */
+static void _mcand_tx_preempt(struct _mcan_desc *desc, uint32_t prio)
+{
+	uint32_t idx;
+	int32_t worst = -1;
+
+	/* one cancellation at a time */
+	if (desc->tx_cancel)
+		return;
+
+	for (idx = 0; idx < ARRAY_SIZE(desc->tx_slot); idx++) {
+		struct _mcand_tx_msg *msg = desc->tx_slot[idx];
+		if (msg && msg->state == TX_MSG_RAM && msg->prio > prio &&
+		    (worst < 0 || msg->prio > desc->tx_slot[worst]->prio))
+			worst = idx;
+	}
+	if (worst < 0)
+		return;
+
+	desc->tx_cancel |= 1 << worst;
+	desc->addr->MCAN_TXBCIE |= 1 << worst;
+	desc->addr->MCAN_TXBCR = 1 << worst;
+}
+
+/**
+ * \brief Move the highest priority pending messages to free Tx elements,
+ * Tx Queue first if MCAND_TX_QUEUE is set, then dedicated Tx Buffers.
+ */
+static void _mcand_tx_fill(struct _mcan_desc *desc)
+{
+	struct _mcand_tx_msg *msg;
+#if MCAND_TX_QUEUE
+	uint32_t buf_count = desc->set.cfg.item_count[MCAN_RAM_TX_BUFFER];
+#endif
+	uint32_t id;
+	uint8_t idx;
+
+	while ((msg = desc->tx_pending) != NULL) {
+#if MCAND_TX_QUEUE
+		if (mcand_get_ram(desc, MCAN_RAM_TX_FIFO, &idx) == 0) {
+			idx += buf_count;
+		} else
+#endif
+		if (mcand_get_ram(desc, MCAN_RAM_TX_BUFFER, &idx) < 0) {
+			_mcand_tx_preempt(desc, msg->prio);
+			break;
+		}
+
+		desc->tx_pending = msg->next;
+		msg->next = NULL;
+		msg->state = TX_MSG_RAM;
+		desc->tx_slot[idx] = msg;
+
+		id = (msg->attr & CAND_BUF_ATTR_EXTENDED) ?
+			MCAN_RAM_T0_XTD | MCAN_RAM_T0_XTDID(msg->id) : msg->id;
+		mcan_enqueue_outgoing_msg(desc, idx, id, msg->len, msg->data);
+	}
+}
+
+static void _mcand_tx_complete(struct _mcan_desc *desc, uint32_t idx)
+{
+	struct _mcand_tx_msg *msg = desc->tx_slot[idx];
+	uint32_t latency = (uint32_t)(_mcand_timestamp(desc) - msg->queued_at);
+
+	_mcand_tx_release_element(desc, idx);
+
+	msg->sent++;
+	msg->latency_last = latency;
+	if (latency > msg->latency_max)
+		msg->latency_max = latency;
+	msg->state = TX_MSG_IDLE;
+
+	desc->stats.tx_frames++;
+	desc->stats.bits += _mcand_frame_bits(msg->attr & CAND_BUF_ATTR_EXTENDED,
+					      msg->len);
+
+	callback_call(&msg->cb, msg);
+}
+
+/**
+ * \brief Handle finished cancellations: pre-empted messages go back to the
+ * pending list, removed ones are dropped.
+ */
+static void _mcand_tx_cancel_handler(struct _mcan_desc *desc)
+{
+	Mcan *mcan = desc->addr;
+	uint32_t done = mcan->MCAN_TXBCF & desc->tx_cancel;
+	uint32_t idx;
+
+	for (idx = 0; done; idx++) {
+		struct _mcand_tx_msg *msg;
+
+		if ((done & (1 << idx)) == 0)
+			continue;
+		done &= ~(1 << idx);
+
+		/* transmitted before the cancellation, see the TC handler */
+		if (mcan->MCAN_TXBTO & (1 << idx))
+			continue;
+
+		msg = desc->tx_slot[idx];
+		mcan->MCAN_TXBTIE &= ~(1 << idx);
+		_mcand_tx_release_element(desc, idx);
+
+		if (msg->state == TX_MSG_REMOVED) {
+			msg->state = TX_MSG_IDLE;
+		} else {
+			desc->stats.cancellations++;
+			_mcand_tx_insert(desc, msg);
+		}
+	}
+
+	_mcand_tx_fill(desc);
+}
+
 static void _mcand_tx_buffer_handler(struct _mcan_desc *desc)
 {
 	uint32_t buf_idx;
@@ -458,13 +734,18 @@ static void _mcand_tx_buffer_handler(struct _mcan_desc *desc)
 	uint32_t *tx_buf;
 
 	uint32_t buf_count = desc->set.cfg.item_count[MCAN_RAM_TX_BUFFER];
+	uint32_t elem_count = buf_count + desc->set.cfg.item_count[MCAN_RAM_TX_FIFO];
 	uint32_t ram_idx =	desc->set.cfg.ram_index[MCAN_RAM_TX_BUFFER];
 	Mcan *mcan = desc->addr;
 
 	status = mcan->MCAN_TXBTO;
-	for (buf_idx = 0; buf_idx < buf_count; buf_idx ++) {
+	for (buf_idx = 0; buf_idx < elem_count; buf_idx ++) {
 		if (status & (1 << buf_idx) & mcan->MCAN_TXBTIE) {
 			mcan->MCAN_TXBTIE &= ~(1 << buf_idx);
+			if (desc->tx_slot[buf_idx]) {
+				_mcand_tx_complete(desc, buf_idx);
+				continue;
+			}
 			ram_item = &desc->ram_item[ram_idx + buf_idx];
 			tx_buf = desc->set.ram_array_tx +
 				buf_idx *
@@ -483,13 +764,15 @@ static void _mcand_tx_buffer_handler(struct _mcan_desc *desc)
 				trace_error("tx_buf null, idx=%u\n\r", (unsigned)buf_idx);
 
 			if (buf_idx >= buf_count)
-				mcand_release_ram(desc, MCAN_RAM_TX_FIFO, buf_idx);
+				mcand_release_ram(desc, MCAN_RAM_TX_FIFO, buf_idx - buf_count);
 			else
 				mcand_release_ram(desc, MCAN_RAM_TX_BUFFER, buf_idx);
 
 			callback_call(&ram_item->cb, NULL);
 		}
 	}
+
+	_mcand_tx_fill(desc);
 }
 
 static void _mcand_tx_fifo_handler(struct _mcan_desc *desc)
@@ -560,6 +843,7 @@ static void _mcand_rx_proc(struct _mcan_desc *desc, enum _mcan_ram ram, uint32_t
 	enum _mcan_ram filter;
 	uint8_t filter_idx;
 	uint8_t filter_cnt;
+	bool overwrite;
 
 	if (MCAN_RAM_RX_FIFO0 == ram) {
 		ram_size = desc->set.cfg.buf_size_rx_fifo0;
@@ -574,6 +858,7 @@ static void _mcand_rx_proc(struct _mcan_desc *desc, enum _mcan_ram ram, uint32_t
 		assert(false);
 
 	rx_buf += buf_idx * (MCAN_RAM_BUF_HDR_SIZE + ram_size / sizeof(uint32_t));
+	_mcand_account_rx(desc, rx_buf);
 
 	if (rx_buf[0] & MCAN_RAM_R0_ESI) {
 		// Error State Indicator
@@ -606,15 +891,17 @@ static void _mcand_rx_proc(struct _mcan_desc *desc, enum _mcan_ram ram, uint32_t
 		trace_error("rx_buf null, idx=%u\n\r", (unsigned)buf_idx);
 	}
 
+	overwrite = ram_item->buf &&
+		(ram_item->buf->attr & CAND_BUF_ATTR_RX_OVERWRITE);
 	if (0 == (rx_buf[1] & MCAN_RAM_R1_ANMF)) {
 		if (filter_idx >= filter_cnt)
 			trace_warning("Total %d filters, item %d is invalid!\n\r",
 				filter_cnt, filter_idx);
 		else
-			if ((ram_item->buf->attr & CAND_BUF_ATTR_RX_OVERWRITE) == 0)
+			if (!overwrite)
 				mcand_release_ram(desc, filter, filter_idx);
 	}
-	if ((ram_item->buf->attr & CAND_BUF_ATTR_RX_OVERWRITE) == 0)
+	if (!overwrite)
 		mcand_release_ram(desc, ram, buf_idx);
 
 	callback_call(&ram_item->cb, NULL);
@@ -646,27 +933,205 @@ static void _mcand_rx_buffer_handler(struct _mcan_desc *desc)
 	}
 }
 
+/**
+ * \brief Find the RX ring fed by the filter that accepted a frame.
+ */
+static struct _mcand_rx_route* _mcand_rx_route(struct _mcan_desc *desc,
+					       const uint32_t *rx_buf)
+{
+	struct _mcand_rx_route *route;
+	uint32_t filter_idx;
+
+	if (rx_buf[1] & MCAN_RAM_R1_ANMF)
+		return NULL;
+
+	filter_idx = (rx_buf[1] & MCAN_RAM_R1_FIDX_Msk) >> MCAN_RAM_R1_FIDX_Pos;
+	if (filter_idx >= MCAND_RX_RING_FILTERS)
+		return NULL;
+
+	if (rx_buf[0] & MCAN_RAM_R0_XTD)
+		route = &desc->rx_route_ext[filter_idx];
+	else
+		route = &desc->rx_route_std[filter_idx];
+
+	return route->ring ? route : NULL;
+}
+
+/**
+ * \brief Copy a Rx FIFO element into an RX ring.
+ */
+static void _mcand_rx_ring_store(struct _can_rx_ring *ring,
+				 const uint32_t *rx_buf, uint32_t ram_size)
+{
+	struct _can_rx_frame *frame = can_rx_ring_get_slot(ring);
+	uint32_t r0 = rx_buf[0];
+	uint32_t r1 = rx_buf[1];
+	uint32_t len;
+
+	if (!frame)
+		return;
+
+	if (r0 & MCAN_RAM_R0_XTD) {
+		frame->id = (r0 & MCAN_RAM_R0_XTDID_Msk) >> MCAN_RAM_R0_XTDID_Pos;
+		frame->attr = CAN_RX_FRAME_EXTENDED;
+	} else {
+		frame->id = (r0 & MCAN_RAM_R0_STDID_Msk) >> MCAN_RAM_R0_STDID_Pos;
+		frame->attr = 0;
+	}
+	if (r0 & MCAN_RAM_R0_RTR)
+		frame->attr |= CAN_RX_FRAME_RTR;
+	if (r0 & MCAN_RAM_R0_ESI)
+		frame->attr |= CAN_RX_FRAME_ESI;
+	if (r1 & MCAN_RAM_R1_FDF)
+		frame->attr |= CAN_RX_FRAME_FD;
+	if (r1 & MCAN_RAM_R1_BRS)
+		frame->attr |= CAN_RX_FRAME_BRS;
+	frame->timestamp = (r1 & MCAN_RAM_R1_RXTS_Msk) >> MCAN_RAM_R1_RXTS_Pos;
+
+	len = get_data_length((enum mcan_dlc)
+			((r1 & MCAN_RAM_R1_DLC_Msk) >> MCAN_RAM_R1_DLC_Pos));
+	if (len > ram_size)
+		len = ram_size;
+	frame->len = len;
+	memcpy(frame->data, &rx_buf[2], len);
+
+	can_rx_ring_commit(ring);
+}
+
+static void _mcand_rx_fifo_ack(struct _mcan_desc *desc, enum _mcan_ram fifo,
+			       uint32_t index)
+{
+	if (fifo == MCAN_RAM_RX_FIFO0)
+		mcan_rx_fifo0_ack(desc->addr, index);
+	else
+		mcan_rx_fifo1_ack(desc->addr, index);
+}
+
+/**
+ * \brief Drain all the elements pending in a Rx FIFO. Frames routed to an RX
+ * ring are acknowledged in one go and each ring callback is called once per
+ * pass; other frames are delivered to their application buffer.
+ */
 static void _mcand_rx_fifo_handler(struct _mcan_desc *desc, enum _mcan_ram fifo)
 {
 	uint32_t cnt;
 	uint32_t get;
 	uint32_t total;
+	uint32_t ram_size;
+	uint32_t *fifo_base;
+	uint32_t notify_std = 0;
+	uint32_t notify_ext = 0;
+	int32_t ack;
+	uint32_t i;
 	Mcan *mcan = desc->addr;
 
 	if (fifo == MCAN_RAM_RX_FIFO0) {
-		cnt = (mcan->MCAN_RXF0S & MCAN_RXF0S_F0FL_Msk) >> MCAN_RXF0S_F0FL_Pos;
-		get = (mcan->MCAN_RXF0S & MCAN_RXF0S_F0GI_Msk) >> MCAN_RXF0S_F0GI_Pos;
-	} else if (fifo == MCAN_RAM_RX_FIFO1) {
-		cnt = (mcan->MCAN_RXF1S & MCAN_RXF1S_F1FL_Msk) >> MCAN_RXF1S_F1FL_Pos;
-		get = (mcan->MCAN_RXF1S & MCAN_RXF1S_F1GI_Msk) >> MCAN_RXF1S_F1GI_Pos;
+		ram_size = desc->set.cfg.buf_size_rx_fifo0;
+		fifo_base = desc->set.ram_fifo_rx0;
+	} else {
+		ram_size = desc->set.cfg.buf_size_rx_fifo1;
+		fifo_base = desc->set.ram_fifo_rx1;
 	}
 	total = desc->set.cfg.item_count[fifo];
 
-	while (cnt--) {
-		_mcand_rx_proc(desc, fifo, get);
-		get ++;
-		if (get >= total)
-			get = 0;
+	for (;;) {
+		if (fifo == MCAN_RAM_RX_FIFO0) {
+			cnt = (mcan->MCAN_RXF0S & MCAN_RXF0S_F0FL_Msk) >> MCAN_RXF0S_F0FL_Pos;
+			get = (mcan->MCAN_RXF0S & MCAN_RXF0S_F0GI_Msk) >> MCAN_RXF0S_F0GI_Pos;
+		} else {
+			cnt = (mcan->MCAN_RXF1S & MCAN_RXF1S_F1FL_Msk) >> MCAN_RXF1S_F1FL_Pos;
+			get = (mcan->MCAN_RXF1S & MCAN_RXF1S_F1GI_Msk) >> MCAN_RXF1S_F1GI_Pos;
+		}
+		if (cnt == 0)
+			break;
+
+		ack = -1;
+		while (cnt--) {
+			uint32_t *rx_buf = fifo_base +
+				get * (MCAN_RAM_BUF_HDR_SIZE + ram_size / sizeof(uint32_t));
+			struct _mcand_rx_route *route = _mcand_rx_route(desc, rx_buf);
+
+			if (route) {
+				_mcand_account_rx(desc, rx_buf);
+				_mcand_rx_ring_store(route->ring, rx_buf, ram_size);
+				if (rx_buf[0] & MCAN_RAM_R0_XTD)
+					notify_ext |= 1 << (route - desc->rx_route_ext);
+				else
+					notify_std |= 1 << (route - desc->rx_route_std);
+				ack = get;
+			} else {
+				/* acknowledging an element releases all the
+				 * previous ones, flush before handing over */
+				if (ack >= 0) {
+					_mcand_rx_fifo_ack(desc, fifo, ack);
+					ack = -1;
+				}
+				_mcand_rx_proc(desc, fifo, get);
+			}
+
+			get ++;
+			if (get >= total)
+				get = 0;
+		}
+		if (ack >= 0)
+			_mcand_rx_fifo_ack(desc, fifo, ack);
+	}
+
+	for (i = 0; i < MCAND_RX_RING_FILTERS; i++) {
+		if (notify_std & (1 << i))
+			callback_call(&desc->rx_route_std[i].ring->cb,
+				      desc->rx_route_std[i].ring);
+		if (notify_ext & (1 << i))
+			callback_call(&desc->rx_route_ext[i].ring->cb,
+				      desc->rx_route_ext[i].ring);
+	}
+}
+
+/**
+ * \brief Check whether RX rings are fed by a Rx FIFO.
+ */
+static bool _mcand_rx_fifo_has_rings(struct _mcan_desc *desc,
+				     enum _mcan_ram fifo)
+{
+	uint32_t i;
+
+	for (i = 0; i < MCAND_RX_RING_FILTERS; i++) {
+		if (desc->rx_route_std[i].ring && desc->rx_route_std[i].fifo == fifo)
+			return true;
+		if (desc->rx_route_ext[i].ring && desc->rx_route_ext[i].fifo == fifo)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * \brief Check whether application buffers hold elements of a Rx FIFO.
+ */
+static bool _mcand_rx_fifo_has_buffers(struct _mcan_desc *desc,
+				       enum _mcan_ram fifo)
+{
+	uint32_t *status = &desc->set.cfg.ram_status[(uint32_t)fifo];
+	uint32_t cnt = desc->set.cfg.item_count[fifo];
+	uint32_t i;
+
+	for (i = 0; i < (cnt + 31) / 32; i++)
+		if (status[i])
+			return true;
+	return false;
+}
+
+/**
+ * \brief Account frames lost by the controller on the rings fed by a FIFO.
+ */
+static void _mcand_rx_fifo_lost(struct _mcan_desc *desc, enum _mcan_ram fifo)
+{
+	uint32_t i;
+
+	for (i = 0; i < MCAND_RX_RING_FILTERS; i++) {
+		if (desc->rx_route_std[i].ring && desc->rx_route_std[i].fifo == fifo)
+			desc->rx_route_std[i].ring->lost++;
+		if (desc->rx_route_ext[i].ring && desc->rx_route_ext[i].fifo == fifo)
+			desc->rx_route_ext[i].ring->lost++;
 	}
 }
 
@@ -722,6 +1187,7 @@ static void _mcan_handler(uint32_t source, void* user_arg)
 	}
 	if (status & MCAN_IR_RF0L) {
 		mcan_clear_status(mcan, MCAN_IR_RF0L);
+		_mcand_rx_fifo_lost(desc, MCAN_RAM_RX_FIFO0);
 		trace_warning("Receive FIFO 0 Message Lost\n\r");
 	}
 	if (status & MCAN_IR_RF1F) {
@@ -734,6 +1200,7 @@ static void _mcan_handler(uint32_t source, void* user_arg)
 	}
 	if (status & MCAN_IR_RF1L) {
 		mcan_clear_status(mcan, MCAN_IR_RF1L);
+		_mcand_rx_fifo_lost(desc, MCAN_RAM_RX_FIFO1);
 		trace_warning("Receive FIFO 1 Message Lost\n\r");
 	}
 	if (status & MCAN_IR_HPM) {
@@ -748,7 +1215,7 @@ static void _mcan_handler(uint32_t source, void* user_arg)
 
 	if (status & MCAN_IR_TCF) {
 		mcan_clear_status(mcan, MCAN_IR_TCF);
-		trace_info("Transmission Cancellation Finished\n\r");
+		_mcand_tx_cancel_handler(desc);
 	}
 	if (status & MCAN_IR_TFE) {
 		mcan_clear_status(mcan, MCAN_IR_TFE);
@@ -772,7 +1239,7 @@ static void _mcan_handler(uint32_t source, void* user_arg)
 	}
 	if (status & MCAN_IR_TSW) {
 		mcan_clear_status(mcan, MCAN_IR_TSW);
-		trace_info("Timestamp counter wrapped around\n\r");
+		desc->ts_wraps++;
 	}
 
 	if (status & MCAN_IR_DRX) {
@@ -960,46 +1427,10 @@ static uint8_t* mcan_prepare_tx_buffer(struct _mcan_desc *desc, uint8_t buf_idx,
 	*tx_buf++ = val;
 	/* enable transmit from buffer to set TC interrupt bit in IR,
 	 * but interrupt will not happen unless TC interrupt is enabled */
-	mcan->MCAN_TXBTIE = (1 << buf_idx);
+	mcan->MCAN_TXBTIE |= (1 << buf_idx);
 	return (uint8_t *)tx_buf;   /* now it points to the data field */
 }
 
-static void mcan_enqueue_outgoing_msg(struct _mcan_desc *desc,
-			uint8_t putIdx, uint32_t id, uint8_t len, const uint8_t *data)
-{
-	struct mcan_set *set = &desc->set;
-	assert(len <= set->cfg.buf_size_tx);
-
-	Mcan *mcan = desc->addr;
-	uint32_t val;
-	uint32_t *tx_buf = 0;
-	const enum can_mode mode = mcan_get_mode(mcan);
-	enum mcan_dlc dlc;
-
-	if (!mcan_get_length_code(len, &dlc))
-		dlc = CAN_DLC_0;
-	tx_buf = set->ram_array_tx + (uint32_t)
-		putIdx * (MCAN_RAM_BUF_HDR_SIZE + set->cfg.buf_size_tx / 4);
-	if (id & MCAN_RAM_T0_XTD)
-		*tx_buf++ = MCAN_RAM_T0_XTD | MCAN_RAM_T0_XTDID(id);
-	else
-		*tx_buf++ = MCAN_RAM_T0_STDID(id);
-	val = MCAN_RAM_T1_MM(0) | MCAN_RAM_T1_DLC((uint32_t)dlc);
-	if (mode == CAN_MODE_CAN_FD_CONST_RATE)
-		val |= MCAN_RAM_T1_FDF;
-	else if (mode == CAN_MODE_CAN_FD_DUAL_RATE)
-		val |= MCAN_RAM_T1_FDF | MCAN_RAM_T1_BRS;
-	*tx_buf++ = val;
-	memcpy(tx_buf, data, len);
-	dsb();
-	/* enable transmit from buffer to set TC interrupt bit in IR,
-	 * but interrupt will not happen unless TC interrupt is enabled
-	 */
-	mcan->MCAN_TXBTIE = (1 << putIdx);
-	/* request to send */
-	mcan->MCAN_TXBAR = (1 << putIdx);
-}
-
 static int mcand_tx(struct _mcan_desc *desc, struct _buffer *buf,
 			struct _callback* cb)
 {
@@ -1045,6 +1476,32 @@ static int mcand_tx(struct _mcan_desc *desc, struct _buffer *buf,
 	return 0;
 }
 
+/**
+ * \brief Route the descriptor identifier to a Rx FIFO through a filter.
+ */
+static void mcand_set_fifo_filter(struct _mcan_desc *desc, bool extended,
+				  uint8_t filt_idx, enum _mcan_ram fifo)
+{
+	struct mcan_set *set = &desc->set;
+	uint32_t *filter;
+
+	if (extended) {
+		filter = set->ram_filt_ext + filt_idx * MCAN_RAM_FILT_EXT_SIZE;
+		*filter++ =
+			((fifo == MCAN_RAM_RX_FIFO1) ?
+				MCAN_RAM_F0_EFEC_FIFO1 : MCAN_RAM_F0_EFEC_FIFO0)
+			| MCAN_RAM_F0_EFID1(desc->identifier);
+		*filter = MCAN_RAM_F1_EFID2(desc->identifier);
+	} else {
+		filter = set->ram_filt_std + filt_idx * MCAN_RAM_FILT_STD_SIZE;
+		*filter =
+			((fifo == MCAN_RAM_RX_FIFO1) ?
+				MCAN_RAM_S0_SFEC_FIFO1 : MCAN_RAM_S0_SFEC_FIFO0)
+			| MCAN_RAM_S0_SFID1(desc->identifier)
+			| MCAN_RAM_S0_SFID2(desc->identifier);
+	}
+}
+
 static int mcand_rx(struct _mcan_desc *desc, struct _buffer *buf,
 			struct _callback* cb)
 {
@@ -1067,6 +1524,10 @@ static int mcand_rx(struct _mcan_desc *desc, struct _buffer *buf,
 			ram = MCAN_RAM_RX_FIFO0;
 			it = MCAN_IE_RF0NE | MCAN_IE_RF0WE | MCAN_IE_RF0FE | MCAN_IE_RF0LE;
 		}
+		/* the element reserved at the put index would not be the one
+		 * written next if rings consume frames from the same FIFO */
+		if (_mcand_rx_fifo_has_rings(desc, ram))
+			return -EBUSY;
 	} else {
 		ram = MCAN_RAM_RX_BUFFER;
 		it = MCAN_IE_DRXE;
@@ -1107,21 +1568,8 @@ static int mcand_rx(struct _mcan_desc *desc, struct _buffer *buf,
 
 	// filter configuration
 	if (buf->attr & CAND_BUF_ATTR_USING_FIFO) {
-		if (buf->attr & CAND_BUF_ATTR_EXTENDED) {
-			filter = set->ram_filt_ext + filt_idx * MCAN_RAM_FILT_EXT_SIZE;
-			*filter++ =
-				((ram == MCAN_RAM_RX_FIFO1) ?
-					MCAN_RAM_F0_EFEC_FIFO1 : MCAN_RAM_F0_EFEC_FIFO0)
-				| MCAN_RAM_F0_EFID1(desc->identifier);
-			*filter = MCAN_RAM_F1_EFID2(desc->identifier);
-		} else {
-			filter = set->ram_filt_std + filt_idx * MCAN_RAM_FILT_STD_SIZE;
-			*filter =
-				((ram == MCAN_RAM_RX_FIFO1) ?
-					MCAN_RAM_S0_SFEC_FIFO1 : MCAN_RAM_S0_SFEC_FIFO0)
-				| MCAN_RAM_S0_SFID1(desc->identifier)
-				| MCAN_RAM_S0_SFID2(desc->identifier);
-		}
+		mcand_set_fifo_filter(desc, buf->attr & CAND_BUF_ATTR_EXTENDED,
+				      filt_idx, ram);
 		ram_item = &desc->ram_item[set->cfg.ram_index[ram] + buf_idx];
 	} else {
 		if (buf->attr & CAND_BUF_ATTR_EXTENDED) {
@@ -1220,6 +1668,14 @@ int mcand_configure(struct _mcan_desc* desc)
 		return err;
 	}
 
+	desc->tx_pending = NULL;
+	desc->tx_periodic = NULL;
+	memset(desc->tx_slot, 0, sizeof(desc->tx_slot));
+	desc->tx_cancel = 0;
+	desc->ts_wraps = 0;
+	desc->stats_start = 0;
+	memset(&desc->stats, 0, sizeof(desc->stats));
+
 	err = mcand_set_baudrate(mcan, desc->freq, desc->freq_fd);
 	if (err < 0) {
 		trace_error("Set baudrate for can bus failed!");
@@ -1247,3 +1703,194 @@ int mcand_transfer(struct _mcan_desc *desc, struct _buffer *buf,
 		return mcand_rx(desc, buf, cb);
 	return -EINVAL;
 }
+
+int mcand_rx_ring_attach(struct _mcan_desc *desc, struct _can_rx_ring *ring,
+			 uint32_t attr)
+{
+	struct _mcand_rx_route *route;
+	enum _mcan_ram fifo;
+	enum _mcan_ram filter;
+	uint8_t filt_idx;
+	uint32_t it;
+	int status;
+
+	if (ring->size == 0 || (ring->size & (ring->size - 1)))
+		return -EINVAL;
+
+	if (CAND_BUF_ATTR_USING_FIFO1 == (attr & CAND_BUF_ATTR_USING_FIFO1)) {
+		fifo = MCAN_RAM_RX_FIFO1;
+		it = MCAN_IE_RF1NE | MCAN_IE_RF1LE;
+	} else {
+		fifo = MCAN_RAM_RX_FIFO0;
+		it = MCAN_IE_RF0NE | MCAN_IE_RF0LE;
+	}
+	if (desc->set.cfg.item_count[fifo] == 0)
+		return -EINVAL;
+	/* rings and application buffers cannot share a FIFO */
+	if (_mcand_rx_fifo_has_buffers(desc, fifo))
+		return -EBUSY;
+
+	if (attr & CAND_BUF_ATTR_EXTENDED) {
+		if (desc->identifier > 0x1fffffff || desc->mask != 0x1fffffff)
+			return -ENOTSUP;
+		filter = MCAN_RAM_EXT_FILTER;
+	} else {
+		if (desc->identifier > 0x7ff || desc->mask != 0x7ff)
+			return -ENOTSUP;
+		filter = MCAN_RAM_STD_FILTER;
+	}
+
+	status = mcand_get_ram(desc, filter, &filt_idx);
+	if (status < 0)
+		return status;
+	if (filt_idx >= MCAND_RX_RING_FILTERS) {
+		mcand_release_ram(desc, filter, filt_idx);
+		return -ENOMEM;
+	}
+
+	if (filter == MCAN_RAM_EXT_FILTER)
+		route = &desc->rx_route_ext[filt_idx];
+	else
+		route = &desc->rx_route_std[filt_idx];
+	route->fifo = fifo;
+	route->ring = ring;
+
+	mcand_set_fifo_filter(desc, filter == MCAN_RAM_EXT_FILTER, filt_idx, fifo);
+	dsb();
+
+	mcan_enable_it(desc->addr, it);
+	return 0;
+}
+
+void mcand_rx_ring_detach(struct _mcan_desc *desc, struct _can_rx_ring *ring)
+{
+	uint8_t i;
+
+	for (i = 0; i < MCAND_RX_RING_FILTERS; i++) {
+		if (desc->rx_route_std[i].ring == ring) {
+			mcand_release_ram(desc, MCAN_RAM_STD_FILTER, i);
+			desc->rx_route_std[i].ring = NULL;
+		}
+		if (desc->rx_route_ext[i].ring == ring) {
+			mcand_release_ram(desc, MCAN_RAM_EXT_FILTER, i);
+			desc->rx_route_ext[i].ring = NULL;
+		}
+	}
+}
+
+int mcand_tx_sched_send(struct _mcan_desc *desc, struct _mcand_tx_msg *msg)
+{
+	if (msg->len > desc->set.cfg.buf_size_tx)
+		return -EINVAL;
+
+	_mcand_lock(desc);
+	if (msg->state != TX_MSG_IDLE) {
+		_mcand_unlock(desc);
+		return -EBUSY;
+	}
+	_mcand_tx_queue(desc, msg);
+	_mcand_tx_fill(desc);
+	mcan_enable_it(desc->addr, MCAN_IE_TCE | MCAN_IE_TCFE);
+	_mcand_unlock(desc);
+
+	return 0;
+}
+
+int mcand_tx_sched_add_periodic(struct _mcan_desc *desc,
+				struct _mcand_tx_msg *msg)
+{
+	struct _mcand_tx_msg *it;
+
+	if (msg->period == 0 || msg->len > desc->set.cfg.buf_size_tx)
+		return -EINVAL;
+
+	_mcand_lock(desc);
+	for (it = desc->tx_periodic; it; it = it->next_periodic) {
+		if (it == msg) {
+			_mcand_unlock(desc);
+			return -EBUSY;
+		}
+	}
+	msg->next_due = timer_get_tick();
+	msg->next_periodic = desc->tx_periodic;
+	desc->tx_periodic = msg;
+	mcan_enable_it(desc->addr, MCAN_IE_TCE | MCAN_IE_TCFE);
+	_mcand_unlock(desc);
+
+	return 0;
+}
+
+void mcand_tx_sched_remove(struct _mcan_desc *desc, struct _mcand_tx_msg *msg)
+{
+	struct _mcand_tx_msg **prev;
+	uint32_t idx;
+
+	_mcand_lock(desc);
+
+	for (prev = &desc->tx_periodic; *prev; prev = &(*prev)->next_periodic) {
+		if (*prev == msg) {
+			*prev = msg->next_periodic;
+			break;
+		}
+	}
+	msg->next_periodic = NULL;
+
+	if (msg->state == TX_MSG_PENDING) {
+		_mcand_tx_unlink(desc, msg);
+		msg->state = TX_MSG_IDLE;
+	} else if (msg->state == TX_MSG_RAM) {
+		for (idx = 0; idx < ARRAY_SIZE(desc->tx_slot); idx++) {
+			if (desc->tx_slot[idx] == msg) {
+				msg->state = TX_MSG_REMOVED;
+				desc->tx_cancel |= 1 << idx;
+				desc->addr->MCAN_TXBCIE |= 1 << idx;
+				desc->addr->MCAN_TXBCR = 1 << idx;
+				break;
+			}
+		}
+	}
+
+	_mcand_unlock(desc);
+}
+
+void mcand_tx_sched_poll(struct _mcan_desc *desc)
+{
+	struct _mcand_tx_msg *msg;
+	uint64_t now = timer_get_tick();
+
+	_mcand_lock(desc);
+	for (msg = desc->tx_periodic; msg; msg = msg->next_periodic) {
+		if (now < msg->next_due)
+			continue;
+
+		msg->next_due += msg->period;
+		if (msg->next_due <= now)
+			msg->next_due = now + msg->period;
+
+		if (msg->state != TX_MSG_IDLE) {
+			msg->overruns++;
+			continue;
+		}
+		_mcand_tx_queue(desc, msg);
+	}
+	_mcand_tx_fill(desc);
+	_mcand_unlock(desc);
+}
+
+void mcand_get_bus_stats(struct _mcan_desc *desc,
+			 struct _mcand_bus_stats *stats, bool reset)
+{
+	uint64_t now;
+
+	_mcand_lock(desc);
+	now = _mcand_timestamp(desc);
+	*stats = desc->stats;
+	stats->elapsed = now - desc->stats_start;
+	stats->load = stats->elapsed ?
+		(uint32_t)((stats->bits * 1000) / stats->elapsed) : 0;
+	if (reset) {
+		memset(&desc->stats, 0, sizeof(desc->stats));
+		desc->stats_start = now;
+	}
+	_mcand_unlock(desc);
+}
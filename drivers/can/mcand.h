@@ -41,6 +41,31 @@
  *        Definitions
  *----------------------------------------------------------------------------*/
 
+/** Number of standard and extended filters that can feed an RX ring */
+#define MCAND_RX_RING_FILTERS 8
+
+/** Number of Rx FIFO 1 elements in the Message RAM, 0 for no Rx FIFO 1.
+ * Giving the RX rings their own FIFO leaves Rx FIFO 0 to the application
+ * buffers. */
+#ifndef MCAND_RX_FIFO1_SIZE
+#define MCAND_RX_FIFO1_SIZE 0
+#endif
+
+/** Data field size of the Rx FIFO 1 elements, in bytes (8, 12, 16, 20,
+ * 24, 32, 48 or 64) */
+#ifndef MCAND_RX_FIFO1_DATA_SIZE
+#define MCAND_RX_FIFO1_DATA_SIZE 64
+#endif
+
+/** Set to 1 to run the Tx FIFO area as a Tx Queue, transmitted by
+ * identifier priority, for the TX scheduler. The Tx FIFO area then no
+ * longer keeps the order of the frames sent with CAND_BUF_ATTR_USING_FIFO,
+ * and frames with the same identifier can go out of order. With 0, the TX
+ * scheduler only uses the dedicated Tx Buffers. */
+#ifndef MCAND_TX_QUEUE
+#define MCAND_TX_QUEUE 0
+#endif
+
 /*----------------------------------------------------------------------------
  *        Types
  *----------------------------------------------------------------------------*/
@@ -51,6 +76,46 @@ struct _cand_ram_item {
 	uint8_t state;
 };
 
+/** Message handled by the TX scheduler, owned by the application */
+struct _mcand_tx_msg {
+	uint32_t id;              /**< Message identifier */
+	uint32_t attr;            /**< CAND_BUF_ATTR_EXTENDED for a 29-bit id */
+	uint8_t  len;             /**< Payload length, in bytes */
+	uint8_t  data[64];
+	uint32_t period;          /**< Period in timer ticks, 0 for one-shot */
+	struct _callback cb;      /**< Called once transmitted */
+
+	/* statistics, in nominal bit times */
+	uint32_t sent;            /**< Frames transmitted */
+	uint32_t overruns;        /**< Periods skipped, previous frame pending */
+	uint32_t latency_last;    /**< Queueing to end of transmission */
+	uint32_t latency_max;
+
+	/* private to the scheduler */
+	uint32_t prio;
+	uint64_t queued_at;
+	uint64_t next_due;
+	uint8_t  state;
+	struct _mcand_tx_msg *next;
+	struct _mcand_tx_msg *next_periodic;
+};
+
+/** Bus statistics, in nominal bit times */
+struct _mcand_bus_stats {
+	uint32_t tx_frames;
+	uint32_t rx_frames;
+	uint32_t cancellations;   /**< Frames pulled back for a higher priority */
+	uint64_t bits;            /**< Estimated bits of the frames sent and received */
+	uint64_t elapsed;         /**< Bit times since the last reset */
+	uint32_t load;            /**< Bus load caused by these frames, per mille */
+};
+
+/** Routing of a message filter to an RX ring */
+struct _mcand_rx_route {
+	struct _can_rx_ring *ring;
+	uint8_t fifo;               /**< MCAN_RAM_RX_FIFO0 or MCAN_RAM_RX_FIFO1 */
+};
+
 enum _mcan_ram {
 	MCAN_RAM_STD_FILTER = 0,   /* 11-bit Message ID Rx Filters */
 	MCAN_RAM_EXT_FILTER = 4,   /* 29-bit Message ID Rx Filters */
@@ -110,6 +175,20 @@ struct _mcan_desc {
 
 	struct _cand_ram_item * ram_item;
 	struct mcan_set set;
+
+	struct _mcand_rx_route rx_route_std[MCAND_RX_RING_FILTERS];
+	struct _mcand_rx_route rx_route_ext[MCAND_RX_RING_FILTERS];
+
+	/* TX scheduler */
+	struct _mcand_tx_msg *tx_pending;    /**< Sorted by priority */
+	struct _mcand_tx_msg *tx_periodic;
+	struct _mcand_tx_msg *tx_slot[32];   /**< Message in each Tx element */
+	uint32_t tx_cancel;                  /**< Cancellations requested */
+
+	/* bus statistics */
+	volatile uint32_t ts_wraps;
+	uint64_t stats_start;
+	struct _mcand_bus_stats stats;
 };
 
 /*----------------------------------------------------------------------------
@@ -127,5 +206,73 @@ extern int mcand_configure(struct _mcan_desc* desc);
  */
 extern int mcand_transfer(struct _mcan_desc* desc, struct _buffer *buf,
 			  struct _callback* cb);
+
+/**
+ * Route the frames matching the descriptor identifier to an RX ring. The
+ * interrupt handler drains the selected Rx FIFO in one pass, storing every
+ * frame with its timestamp, then calls the ring callback once.
+ * A Rx FIFO feeds either RX rings or application buffers
+ * (CAND_BUF_ATTR_USING_FIFO), never both: application buffers reserve the
+ * element at the FIFO put index, which frames consumed by the rings would
+ * shift. Rx FIFO 1 needs MCAND_RX_FIFO1_SIZE elements.
+ * \param desc Pointer to CAN Driver descriptor instance.
+ * \param ring Initialized RX ring.
+ * \param attr CAND_BUF_ATTR_EXTENDED for a 29-bit identifier,
+ *             CAND_BUF_ATTR_USING_FIFO1 to use Rx FIFO 1 instead of Rx FIFO 0.
+ * \return 0 on success, -EBUSY if application buffers are pending on the
+ * selected Rx FIFO, otherwise a negative errno.
+ */
+extern int mcand_rx_ring_attach(struct _mcan_desc* desc,
+				struct _can_rx_ring *ring, uint32_t attr);
+
+/**
+ * Queue a message in the TX scheduler. Pending messages are placed in the
+ * Tx queue (transmitted by identifier priority) when MCAND_TX_QUEUE is set,
+ * and in free dedicated Tx buffers, lowest identifiers first; when the
+ * message RAM is full, the
+ * lowest priority frame in it is cancelled and re-queued if a higher
+ * priority one is waiting.
+ * \param desc Pointer to CAN Driver descriptor instance.
+ * \param msg  Message, must not be modified until its callback is called.
+ * \return 0 on success, -EBUSY if the message is already queued.
+ */
+extern int mcand_tx_sched_send(struct _mcan_desc* desc,
+			       struct _mcand_tx_msg *msg);
+
+/**
+ * Register a periodic message, sent every msg->period timer ticks by
+ * mcand_tx_sched_poll().
+ */
+extern int mcand_tx_sched_add_periodic(struct _mcan_desc* desc,
+				       struct _mcand_tx_msg *msg);
+
+/**
+ * Remove a message from the scheduler, cancelling it if it is pending.
+ */
+extern void mcand_tx_sched_remove(struct _mcan_desc* desc,
+				  struct _mcand_tx_msg *msg);
+
+/**
+ * Queue the periodic messages that are due. To be called from a periodic
+ * timer handler or from the application loop.
+ */
+extern void mcand_tx_sched_poll(struct _mcan_desc* desc);
+
+/**
+ * Get the bus statistics.
+ * \param desc  Pointer to CAN Driver descriptor instance.
+ * \param stats Filled with the statistics since the last reset.
+ * \param reset Restart the statistics.
+ */
+extern void mcand_get_bus_stats(struct _mcan_desc* desc,
+				struct _mcand_bus_stats *stats, bool reset);
+
+/**
+ * Stop routing frames to an RX ring and release its filters.
+ * \param desc Pointer to CAN Driver descriptor instance.
+ * \param ring RX ring attached with mcand_rx_ring_attach().
+ */
+extern void mcand_rx_ring_detach(struct _mcan_desc* desc,
+				 struct _can_rx_ring *ring);
 /**@}*/
 #endif /* #ifndef _MCAN_H_ */
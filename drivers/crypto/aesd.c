@@ -32,6 +32,7 @@
  *----------------------------------------------------------------------------*/
 
 #include <assert.h>
+#include <errno.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
@@ -40,15 +41,41 @@
 #include "crypto/aes.h"
 #include "crypto/aesd.h"
 #include "dma/dma.h"
+#include "intmath.h"
 #include "irq/irq.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
 #include "trace.h"
 
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+/* Held while the engine registers belong to someone: a transfer of any
+ * descriptor or a direct user (aesd_engine_try_lock()) */
+static mutex_t _aesd_engine;
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
 
+static bool _aesd_lock(struct _aesd_desc* desc)
+{
+	if (!mutex_try_lock(&desc->mutex))
+		return false;
+	if (!mutex_try_lock(&_aesd_engine)) {
+		mutex_unlock(&desc->mutex);
+		return false;
+	}
+	return true;
+}
+
+static void _aesd_unlock(struct _aesd_desc* desc)
+{
+	mutex_unlock(&_aesd_engine);
+	mutex_unlock(&desc->mutex);
+}
+
 static int _aesd_dma_read_callback(void* arg, void* arg2)
 {
 	struct _aesd_desc* desc = (struct _aesd_desc*)arg;
@@ -59,7 +86,7 @@ static int _aesd_dma_read_callback(void* arg, void* arg2)
 
 	cache_invalidate_region((uint32_t*)desc->xfer.bufout->data, desc->xfer.bufout->size);
 
-	mutex_unlock(&desc->mutex);
+	_aesd_unlock(desc);
 
 	return callback_call(&desc->xfer.callback, NULL);
 }
@@ -198,12 +225,13 @@ static void _aesd_transfer_buffer_polling(struct _aesd_desc* desc)
 		while ((aes_get_status() & AES_ISR_DATRDY) != AES_ISR_DATRDY);
 		aes_get_output((void *)((desc->xfer.bufout->data) + i), num_of_data_words);
 	}
-	mutex_unlock(&desc->mutex);
 #ifdef CONFIG_HAVE_AES_GCM
 	if(desc->cfg.mode == AESD_MODE_GCM) {
 		_aesd_gcm_tag(desc);
 	}
 #endif
+	/* release the engine only once the tag has been read */
+	_aesd_unlock(desc);
 	callback_call(&desc->xfer.callback, NULL);
 }
 
@@ -220,6 +248,277 @@ static void _aesd_write_key(uint32_t* key, enum _aesd_key_size size, bool subkey
 	/* Set KEYW in AES_KEYWRx and wait until DATRDY bit of AES_ISR is set (GCM hash subkey generation complete */
 	while ((aes_get_status() & AES_ISR_DATRDY) != AES_ISR_DATRDY);
 }
+#ifdef CONFIG_HAVE_AES_GCM
+
+/* Items of a per-record linked list: one bounce block and one direct run per
+ * fragment, plus the trailing partial block */
+#define AESD_GCM_MAX_ITEMS  (2 * AESD_GCM_MAX_FRAGMENTS + 1)
+
+CACHE_ALIGNED static uint32_t _aesd_gcm_tx_bounce[AESD_GCM_MAX_FRAGMENTS][4];
+CACHE_ALIGNED static uint32_t _aesd_gcm_rx_bounce[AESD_GCM_MAX_FRAGMENTS][4];
+
+struct _aesd_sg_cursor {
+	struct _buffer* frag;
+	uint32_t offset;
+};
+
+static uint32_t _aesd_sg_size(const struct _buffer* frags, uint8_t count)
+{
+	uint32_t size = 0;
+	uint8_t i;
+
+	for (i = 0; i < count; i++)
+		size += frags[i].size;
+	return size;
+}
+
+/* Copy len bytes between a block and the fragment list, moving the cursor */
+static void _aesd_sg_copy(struct _aesd_sg_cursor* cur, uint8_t* block,
+		uint32_t len, bool gather)
+{
+	uint32_t n;
+
+	while (len) {
+		n = min_u32(len, cur->frag->size - cur->offset);
+		if (gather)
+			memcpy(block, cur->frag->data + cur->offset, n);
+		else
+			memcpy(cur->frag->data + cur->offset, block, n);
+		block += n;
+		len -= n;
+		cur->offset += n;
+		if (cur->offset == cur->frag->size) {
+			cur->frag++;
+			cur->offset = 0;
+		}
+	}
+}
+
+/* Start a record: fresh GHASH, inc32(J0) as counter, lengths and AAD.
+ * The AAD is short and fed by the CPU as in aesd_transfer() */
+static void _aesd_gcm_record_setup(struct _aesd_gcm_record* rec, uint32_t len)
+{
+	uint32_t j0[4] = { rec->iv[0], rec->iv[1], rec->iv[2], BIG_ENDIAN_TO_HOST(2) };
+	uint32_t block[AES_BLOCK_SIZE / sizeof(uint32_t)];
+	uint32_t aadlen = rec->aad ? rec->aad->size : 0;
+	uint32_t i, n;
+
+	aes_set_start_mode(AESD_TRANS_POLLING_AUTO);
+	memset(block, 0, sizeof(block));
+	aes_set_gcm_hash(block);
+	aes_set_vector(j0);
+	aes_set_aad_len(aadlen);
+	aes_set_data_len(len);
+
+	for (i = 0; i < aadlen; i += AES_BLOCK_SIZE) {
+		n = min_u32(aadlen - i, AES_BLOCK_SIZE);
+		memset(block, 0, sizeof(block));
+		memcpy(block, rec->aad->data + i, n);
+		aes_set_input(block, AES_BLOCK_SIZE);
+		while ((aes_get_status() & AES_ISR_DATRDY) != AES_ISR_DATRDY);
+	}
+}
+
+static void _aesd_gcm_record_polling(struct _aesd_gcm_record* rec, uint32_t len)
+{
+	struct _aesd_sg_cursor in = { rec->in, 0 };
+	struct _aesd_sg_cursor out = { rec->out, 0 };
+	uint32_t block[AES_BLOCK_SIZE / sizeof(uint32_t)];
+	uint32_t i, n;
+
+	for (i = 0; i < len; i += AES_BLOCK_SIZE) {
+		n = min_u32(len - i, AES_BLOCK_SIZE);
+		memset(block, 0, sizeof(block));
+		_aesd_sg_copy(&in, (uint8_t*)block, n, true);
+		aes_set_input(block, AES_BLOCK_SIZE);
+		while ((aes_get_status() & AES_ISR_DATRDY) != AES_ISR_DATRDY);
+		aes_get_output(block, AES_BLOCK_SIZE);
+		_aesd_sg_copy(&out, (uint8_t*)block, n, false);
+	}
+}
+
+/* Build the linked list for one direction of a record. Whole blocks are
+ * transferred in place, blocks straddling fragments (and the final partial
+ * block) through bounce blocks: filled now on tx, recorded in desc for a
+ * copy on completion on rx. Everything is cleaned from the cache so that no
+ * dirty line can be evicted over the DMA output. */
+static int _aesd_gcm_build_list(struct _aesd_desc* desc,
+		struct _buffer* frags, uint8_t count, bool tx,
+		struct _dma_transfer_cfg* items, uint8_t* nitems)
+{
+	uint32_t (*bounce)[4] = tx ? _aesd_gcm_tx_bounce : _aesd_gcm_rx_bounce;
+	void* reg = tx ? (void*)AES->AES_IDATAR : (void*)AES->AES_ODATAR;
+	uint32_t fill = 0, left, take, direct;
+	uint8_t* data;
+	uint8_t nb = 0, i;
+
+	*nitems = 0;
+	for (i = 0; i < count; i++) {
+		data = frags[i].data;
+		left = frags[i].size;
+		if (fill) {
+			take = min_u32(AES_BLOCK_SIZE - fill, left);
+			if (tx) {
+				memcpy((uint8_t*)bounce[nb] + fill, data, take);
+			} else {
+				desc->xfer.gcm.copy[desc->xfer.gcm.copies].src = (uint8_t*)bounce[nb] + fill;
+				desc->xfer.gcm.copy[desc->xfer.gcm.copies].dst = data;
+				desc->xfer.gcm.copy[desc->xfer.gcm.copies].len = take;
+				desc->xfer.gcm.copies++;
+			}
+			fill += take;
+			data += take;
+			left -= take;
+			if (fill < AES_BLOCK_SIZE)
+				continue;
+			items[*nitems].saddr = tx ? (void*)bounce[nb] : reg;
+			items[*nitems].daddr = tx ? reg : (void*)bounce[nb];
+			items[*nitems].len = AES_BLOCK_SIZE / 4;
+			(*nitems)++;
+			nb++;
+			fill = 0;
+		}
+		direct = left & ~(AES_BLOCK_SIZE - 1);
+		if (direct) {
+			if ((uint32_t)data & 3)
+				return -EINVAL;
+			cache_clean_region(data, direct);
+			items[*nitems].saddr = tx ? (void*)data : reg;
+			items[*nitems].daddr = tx ? reg : (void*)data;
+			items[*nitems].len = direct / 4;
+			(*nitems)++;
+			data += direct;
+			left -= direct;
+		}
+		if (left) {
+			if (i + 1 < count && (left & 3))
+				return -EINVAL;
+			if (nb >= AESD_GCM_MAX_FRAGMENTS)
+				return -ENOMEM;
+			if (tx) {
+				memset(bounce[nb], 0, AES_BLOCK_SIZE);
+				memcpy(bounce[nb], data, left);
+			} else {
+				desc->xfer.gcm.copy[desc->xfer.gcm.copies].src = (uint8_t*)bounce[nb];
+				desc->xfer.gcm.copy[desc->xfer.gcm.copies].dst = data;
+				desc->xfer.gcm.copy[desc->xfer.gcm.copies].len = left;
+				desc->xfer.gcm.copies++;
+			}
+			fill = left;
+		}
+	}
+	if (fill) {
+		items[*nitems].saddr = tx ? (void*)bounce[nb] : reg;
+		items[*nitems].daddr = tx ? reg : (void*)bounce[nb];
+		items[*nitems].len = AES_BLOCK_SIZE / 4;
+		(*nitems)++;
+		nb++;
+	}
+	if (nb)
+		cache_clean_region(bounce, nb * AES_BLOCK_SIZE);
+	return 0;
+}
+
+static int _aesd_gcm_dma_callback(void* arg, void* arg2);
+
+/* Program and start the payload DMA of a record, returns an error if the
+ * fragment layout does not suit the DMA */
+static int _aesd_gcm_record_dma(struct _aesd_desc* desc, struct _aesd_gcm_record* rec)
+{
+	struct _dma_transfer_cfg tx_items[AESD_GCM_MAX_ITEMS];
+	struct _dma_transfer_cfg rx_items[AESD_GCM_MAX_ITEMS];
+	uint8_t tx_count, rx_count;
+	struct _dma_cfg cfg_dma;
+	struct _callback _cb;
+	int err;
+
+	desc->xfer.gcm.copies = 0;
+	err = _aesd_gcm_build_list(desc, rec->in, rec->in_count, true, tx_items, &tx_count);
+	if (err < 0)
+		return err;
+	err = _aesd_gcm_build_list(desc, rec->out, rec->out_count, false, rx_items, &rx_count);
+	if (err < 0)
+		return err;
+
+	memset(&cfg_dma, 0, sizeof(cfg_dma));
+	cfg_dma.data_width = DMA_DATA_WIDTH_WORD;
+	cfg_dma.chunk_size = DMA_CHUNK_SIZE_4;
+	cfg_dma.incr_saddr = true;
+	cfg_dma.incr_daddr = false;
+	err = dma_configure_transfer(desc->xfer.dma.tx.channel, &cfg_dma, tx_items, tx_count);
+	if (err < 0)
+		return err;
+	dma_set_callback(desc->xfer.dma.tx.channel, NULL);
+
+	cfg_dma.incr_saddr = false;
+	cfg_dma.incr_daddr = true;
+	err = dma_configure_transfer(desc->xfer.dma.rx.channel, &cfg_dma, rx_items, rx_count);
+	if (err < 0) {
+		dma_reset_channel(desc->xfer.dma.tx.channel);
+		return err;
+	}
+	callback_set(&_cb, _aesd_gcm_dma_callback, (void*)desc);
+	dma_set_callback(desc->xfer.dma.rx.channel, &_cb);
+
+	/* Payload blocks are written to IDATAR0 only from now on */
+	aes_set_start_mode(AESD_TRANS_DMA);
+	dma_start_transfer(desc->xfer.dma.rx.channel);
+	dma_start_transfer(desc->xfer.dma.tx.channel);
+	return 0;
+}
+
+static void _aesd_gcm_record_tag(struct _aesd_desc* desc)
+{
+	while ((aes_get_status() & AES_ISR_TAGRDY) != AES_ISR_TAGRDY);
+	aes_get_gcm_tag(desc->xfer.gcm.tags[desc->xfer.gcm.index]);
+	desc->xfer.gcm.index++;
+}
+
+/* Run the batch from the current record on, until a DMA transfer is in
+ * flight or all records are done */
+static void _aesd_gcm_batch_run(struct _aesd_desc* desc)
+{
+	struct _aesd_gcm_record* rec;
+	uint32_t len;
+
+	while (desc->xfer.gcm.index < desc->xfer.gcm.count) {
+		rec = &desc->xfer.gcm.records[desc->xfer.gcm.index];
+		len = _aesd_sg_size(rec->in, rec->in_count);
+		_aesd_gcm_record_setup(rec, len);
+		if (len && desc->cfg.transfer_mode == AESD_TRANS_DMA) {
+			if (_aesd_gcm_record_dma(desc, rec) == 0)
+				return;
+			aes_set_start_mode(AESD_TRANS_POLLING_AUTO);
+		}
+		_aesd_gcm_record_polling(rec, len);
+		_aesd_gcm_record_tag(desc);
+	}
+	_aesd_unlock(desc);
+	callback_call(&desc->xfer.callback, NULL);
+}
+
+static int _aesd_gcm_dma_callback(void* arg, void* arg2)
+{
+	struct _aesd_desc* desc = (struct _aesd_desc*)arg;
+	struct _aesd_gcm_record* rec = &desc->xfer.gcm.records[desc->xfer.gcm.index];
+	uint8_t i;
+
+	dma_reset_channel(desc->xfer.dma.tx.channel);
+	dma_reset_channel(desc->xfer.dma.rx.channel);
+
+	for (i = 0; i < rec->out_count; i++)
+		cache_invalidate_region(rec->out[i].data, rec->out[i].size);
+	cache_invalidate_region(_aesd_gcm_rx_bounce, sizeof(_aesd_gcm_rx_bounce));
+	for (i = 0; i < desc->xfer.gcm.copies; i++)
+		memcpy(desc->xfer.gcm.copy[i].dst, desc->xfer.gcm.copy[i].src,
+		       desc->xfer.gcm.copy[i].len);
+
+	_aesd_gcm_record_tag(desc);
+	_aesd_gcm_batch_run(desc);
+	return 0;
+}
+#endif /* CONFIG_HAVE_AES_GCM */
+
 /*----------------------------------------------------------------------------
  *        Public functions
 
@@ -245,6 +544,11 @@ uint32_t aesd_transfer(struct _aesd_desc* desc,
 	static uint32_t one[AES_BLOCK_SIZE / sizeof(uint32_t)] = {BIG_ENDIAN_TO_HOST(1), };
 #endif
 
+	if (!_aesd_lock(desc)) {
+		trace_error("AESD mutex already locked!\r\n");
+		return ADES_ERROR_LOCK;
+	}
+
 	aes_soft_reset();
 	if (desc->cfg.mode != AESD_MODE_XTS) {
 		aes_set_op_mode(desc->cfg.mode);
@@ -367,10 +671,6 @@ uint32_t aesd_transfer(struct _aesd_desc* desc,
 	assert(!(desc->xfer.bufin->size % _aesd_get_size_per_trans(desc)));
 	assert(!(desc->xfer.bufout->size % _aesd_get_size_per_trans(desc)));
 
-	if (!mutex_try_lock(&desc->mutex)) {
-		trace_error("AESD mutex already locked!\r\n");
-		return ADES_ERROR_LOCK;
-	}
 	switch (desc->cfg.transfer_mode) {
 	case AESD_TRANS_POLLING_MANUAL:
 	case AESD_TRANS_POLLING_AUTO:
@@ -382,7 +682,7 @@ uint32_t aesd_transfer(struct _aesd_desc* desc,
 		break;
 
 	default:
-		mutex_unlock(&desc->mutex);
+		_aesd_unlock(desc);
 		trace_fatal("Unknown AES transfer mode\r\n");
 	}
 
@@ -402,6 +702,16 @@ void aesd_wait_transfer(struct _aesd_desc* desc)
 	}
 }
 
+bool aesd_engine_try_lock(void)
+{
+	return mutex_try_lock(&_aesd_engine);
+}
+
+void aesd_engine_unlock(void)
+{
+	mutex_unlock(&_aesd_engine);
+}
+
 void aesd_init(struct _aesd_desc* desc)
 {
 	/* Enable peripheral clock */
@@ -415,3 +725,47 @@ void aesd_init(struct _aesd_desc* desc)
 	desc->xfer.dma.rx.channel = dma_allocate_channel(ID_AES, DMA_PERIPH_MEMORY);
 	assert(desc->xfer.dma.rx.channel);
 }
+
+#ifdef CONFIG_HAVE_AES_GCM
+uint32_t aesd_gcm_batch(struct _aesd_desc* desc,
+						struct _aesd_gcm_record* records,
+						uint32_t count,
+						uint32_t (*tags)[4],
+						struct _callback* cb)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		if (records[i].in_count > AESD_GCM_MAX_FRAGMENTS ||
+		    records[i].out_count > AESD_GCM_MAX_FRAGMENTS)
+			return AESD_ERROR_TRANSFER;
+		if (_aesd_sg_size(records[i].in, records[i].in_count) !=
+		    _aesd_sg_size(records[i].out, records[i].out_count))
+			return AESD_ERROR_TRANSFER;
+	}
+
+	if (!_aesd_lock(desc)) {
+		trace_error("AESD mutex already locked!\r\n");
+		return ADES_ERROR_LOCK;
+	}
+
+	desc->xfer.gcm.records = records;
+	desc->xfer.gcm.count = count;
+	desc->xfer.gcm.index = 0;
+	desc->xfer.gcm.tags = tags;
+	callback_copy(&desc->xfer.callback, cb);
+
+	/* The key and hash subkey are computed once for the whole batch */
+	aes_soft_reset();
+	aes_set_op_mode(AESD_MODE_GCM);
+	aes_encrypt_enable(desc->cfg.encrypt);
+	aes_set_start_mode(AESD_TRANS_POLLING_AUTO);
+	aes_tag_enable(true);
+	aes_set_key_size(desc->cfg.key_size);
+	_aesd_write_key(&desc->cfg.key[0], desc->cfg.key_size, true);
+
+	_aesd_gcm_batch_run(desc);
+
+	return AESD_SUCCESS;
+}
+#endif
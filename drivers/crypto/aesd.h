@@ -84,6 +84,21 @@ enum _aesd_cipher_size {
 	AESD_CFBS_8
 };
 
+#ifdef CONFIG_HAVE_AES_GCM
+/** Maximum number of payload fragments in one GCM batch record */
+#define AESD_GCM_MAX_FRAGMENTS  8
+
+/** One AEAD record of a GCM batch, see aesd_gcm_batch() */
+struct _aesd_gcm_record {
+	struct _buffer *aad;           /*< additional authenticated data, may be NULL */
+	uint32_t iv[3];                /*< 96-bit IV */
+	struct _buffer *in;            /*< payload fragments */
+	uint8_t in_count;
+	struct _buffer *out;           /*< output fragments, same total size as in */
+	uint8_t out_count;
+};
+#endif
+
 struct _aesd_desc {
 	/* structure to define AES parameter */
 
@@ -117,6 +132,21 @@ struct _aesd_desc {
 				struct _dma_channel *channel;
 			} rx, tx;
 		} dma;
+#ifdef CONFIG_HAVE_AES_GCM
+		struct {
+			struct _aesd_gcm_record *records;
+			uint32_t count;
+			uint32_t index;
+			uint32_t (*tags)[4];
+			/* output bytes landing in bounce blocks, copied on completion */
+			struct {
+				const uint8_t *src;
+				uint8_t *dst;
+				uint32_t len;
+			} copy[2 * AESD_GCM_MAX_FRAGMENTS];
+			uint8_t copies;
+		} gcm;
+#endif
 	} xfer;
 #ifdef CONFIG_HAVE_AES_GCM
 	uint8_t* buffer;
@@ -140,4 +170,50 @@ extern bool aesd_is_busy(struct _aesd_desc* desc);
 
 extern void aesd_wait_transfer(struct _aesd_desc* desc);
 
+/**
+ * \brief Take the AES engine for a sequence of direct register accesses
+ * (aes.h). Transfers of every descriptor fail with ADES_ERROR_LOCK until
+ * aesd_engine_unlock() is called, and the engine is not handed over while
+ * one of them is in progress.
+ * \return true if the engine was free and now belongs to the caller
+ */
+extern bool aesd_engine_try_lock(void);
+
+/**
+ * \brief Give back the AES engine taken with aesd_engine_try_lock().
+ */
+extern void aesd_engine_unlock(void);
+
+#ifdef CONFIG_HAVE_AES_GCM
+/**
+ * \brief Encrypt or decrypt a batch of GCM records back to back.
+ *
+ * The key, direction and transfer mode are taken from desc->cfg and the key
+ * is loaded once for the whole batch; each record only reprograms the IV,
+ * the AAD/payload lengths and the GHASH accumulator. Record i's tag is
+ * written to tags[i] (on decryption the caller compares it with the
+ * received tag).
+ *
+ * In DMA mode the payload of each record is moved by one linked list per
+ * direction built directly on the fragments, so that fragmented network
+ * buffers do not need to be linearised. Every fragment but the last must
+ * start on a word boundary and hold a multiple of 4 bytes; blocks straddling
+ * two fragments go through internal bounce blocks. Records not meeting these
+ * constraints are processed by the CPU.
+ *
+ * \param desc  AES driver descriptor, initialized with aesd_init()
+ * \param records  Array of records
+ * \param count  Number of records
+ * \param tags  Output array of count tags
+ * \param cb  Callback invoked when the whole batch is done, may be NULL
+ * \return AESD_SUCCESS, ADES_ERROR_LOCK or AESD_ERROR_TRANSFER if a record
+ * is malformed
+ */
+extern uint32_t aesd_gcm_batch(struct _aesd_desc* desc,
+							   struct _aesd_gcm_record* records,
+							   uint32_t count,
+							   uint32_t (*tags)[4],
+							   struct _callback* cb);
+#endif
+
 #endif /* AESD_HEADER__ */
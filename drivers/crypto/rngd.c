@@ -0,0 +1,596 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Random number service: TRNG entropy pool with SP800-90B health tests
+ * feeding an AES-256 CTR_DRBG (SP800-90A 10.2, with derivation function).
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip.h"
+#include "compiler.h"
+#include "crypto/aes.h"
+#include "crypto/aesd.h"
+#include "crypto/rngd.h"
+#include "crypto/trng.h"
+#include "intmath.h"
+#include "irqflags.h"
+#include "mm/cache.h"
+#include "peripherals/pmc.h"
+#include "rand.h"
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+#define RNGD_KEY_SIZE    32
+#define RNGD_BLOCK_SIZE  16
+#define RNGD_SEED_SIZE   (RNGD_KEY_SIZE + RNGD_BLOCK_SIZE)
+
+/* Derivation function buffer: IV || L || N || entropy || nonce || input || padding */
+#define RNGD_DF_BUFFER_SIZE (RNGD_BLOCK_SIZE + 8 + \
+		(RNGD_SEED_WORDS + RNGD_NONCE_WORDS) * 4 + RNGD_MAX_INPUT + RNGD_BLOCK_SIZE)
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+static struct {
+	struct _aesd_desc* aesd;
+	bool ready;
+	bool rand_source;
+
+	/* CTR_DRBG working state */
+	ALIGNED(4) uint8_t key[RNGD_KEY_SIZE];
+	ALIGNED(4) uint8_t v[RNGD_BLOCK_SIZE];
+	uint32_t reseed_counter;
+
+	/* Entropy pool, filled by the TRNG interrupt */
+	struct {
+		uint32_t words[RNGD_POOL_SIZE];
+		volatile uint32_t head;
+		volatile uint32_t count;
+	} pool;
+
+	struct {
+		uint32_t rct_last;
+		uint32_t rct_count;
+		uint32_t apt_ref;
+		uint32_t apt_count;
+		uint32_t apt_seen;
+	} health;
+
+	uint32_t reservoir_pos;
+	struct _rngd_stats stats;
+} _rngd;
+
+CACHE_ALIGNED static uint8_t _rngd_reservoir[RNGD_RESERVOIR_SIZE];
+
+ALIGNED(4) static uint8_t _rngd_df_buffer[RNGD_DF_BUFFER_SIZE];
+
+ALIGNED(4) static const uint8_t _rngd_df_key[RNGD_KEY_SIZE] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+	0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+};
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static void _rngd_put_be32(uint8_t* p, uint32_t value)
+{
+	p[0] = value >> 24;
+	p[1] = value >> 16;
+	p[2] = value >> 8;
+	p[3] = value;
+}
+
+/* Add n to the 128-bit big-endian counter v */
+static void _rngd_inc(uint8_t* v, uint32_t n)
+{
+	int i;
+
+	for (i = RNGD_BLOCK_SIZE - 1; i >= 0 && n; i--) {
+		n += v[i];
+		v[i] = n & 0xff;
+		n >>= 8;
+	}
+}
+
+/* Repetition count and adaptive proportion tests on one TRNG word */
+static bool _rngd_health_check(uint32_t word)
+{
+	bool ok = true;
+
+	if (word == _rngd.health.rct_last) {
+		if (++_rngd.health.rct_count >= RNGD_RCT_CUTOFF) {
+			_rngd.stats.rct_failures++;
+			_rngd.health.rct_count = 1;
+			ok = false;
+		}
+	} else {
+		_rngd.health.rct_last = word;
+		_rngd.health.rct_count = 1;
+	}
+
+	if (_rngd.health.apt_seen == 0) {
+		_rngd.health.apt_ref = word;
+		_rngd.health.apt_count = 1;
+	} else if (word == _rngd.health.apt_ref) {
+		if (++_rngd.health.apt_count >= RNGD_APT_CUTOFF) {
+			_rngd.stats.apt_failures++;
+			_rngd.health.apt_seen = RNGD_APT_WINDOW - 1;
+			ok = false;
+		}
+	}
+	if (++_rngd.health.apt_seen == RNGD_APT_WINDOW)
+		_rngd.health.apt_seen = 0;
+
+	return ok;
+}
+
+static void _rngd_trng_callback(uint32_t value, void* user_arg)
+{
+	uint32_t index;
+
+	if (!_rngd_health_check(value)) {
+		/* Drop what was collected from a misbehaving source */
+		_rngd.pool.count = 0;
+		return;
+	}
+
+	index = (_rngd.pool.head + _rngd.pool.count) % RNGD_POOL_SIZE;
+	_rngd.pool.words[index] = value;
+	_rngd.stats.entropy_words++;
+	if (++_rngd.pool.count == RNGD_POOL_SIZE)
+		trng_suspend_it();
+}
+
+static bool _rngd_pool_take(uint32_t* words, uint32_t count)
+{
+	uint32_t flags, i;
+
+	flags = arch_irq_save();
+	if (_rngd.pool.count < count) {
+		arch_irq_restore(flags);
+		return false;
+	}
+	for (i = 0; i < count; i++) {
+		words[i] = _rngd.pool.words[_rngd.pool.head];
+		_rngd.pool.words[_rngd.pool.head] = 0;
+		_rngd.pool.head = (_rngd.pool.head + 1) % RNGD_POOL_SIZE;
+	}
+	_rngd.pool.count -= count;
+	arch_irq_restore(flags);
+
+	trng_resume_it();
+	return true;
+}
+
+/* Read words straight from the TRNG, before the interrupt is enabled */
+static int _rngd_poll_words(uint32_t* words, uint32_t count)
+{
+	uint32_t i, value;
+
+	for (i = 0; i < count; i++) {
+		value = trng_get_random_data();
+		if (!_rngd_health_check(value))
+			return -EIO;
+		if (words)
+			words[i] = value;
+	}
+	return 0;
+}
+
+/* The DRBG drives the engine registers directly, only when no other aesd
+ * user holds the engine */
+static bool _rngd_engine_lock(void)
+{
+	if (_rngd.aesd)
+		aesd_wait_transfer(_rngd.aesd);
+	return aesd_engine_try_lock();
+}
+
+static void _rngd_aes_set_key(const uint8_t* key)
+{
+	aes_soft_reset();
+	aes_configure(AES_MR_OPMOD_ECB | AES_MR_KEYSIZE_AES256 |
+		      AES_MR_SMOD_AUTO_START | AES_MR_CIPHER);
+	aes_write_key((const uint32_t*)key, RNGD_KEY_SIZE);
+}
+
+static void _rngd_aes_encrypt(const uint8_t* in, uint8_t* out)
+{
+	aes_set_input((void*)in, RNGD_BLOCK_SIZE);
+	while ((aes_get_status() & AES_ISR_DATRDY) != AES_ISR_DATRDY);
+	aes_get_output(out, RNGD_BLOCK_SIZE);
+}
+
+/* E(K, V + 1) || E(K, V + 2) || ..., V left on the last counter used */
+static void _rngd_keystream(uint8_t* out, uint32_t blocks)
+{
+	_rngd_aes_set_key(_rngd.key);
+	while (blocks--) {
+		_rngd_inc(_rngd.v, 1);
+		_rngd_aes_encrypt(_rngd.v, out);
+		out += RNGD_BLOCK_SIZE;
+	}
+}
+
+/* Same keystream by aesd in CTR mode. The engine counter only carries over
+ * 16 bits, so requests are split where the low 16 bits of V wrap. */
+static int _rngd_keystream_aesd(uint8_t* out, uint32_t blocks)
+{
+	struct _aesd_desc* desc = _rngd.aesd;
+	struct _buffer buf;
+	uint32_t low, n;
+	int err = 0;
+	bool encrypt = desc->cfg.encrypt;
+	enum _aesd_mode mode = desc->cfg.mode;
+	enum _aesd_key_size key_size = desc->cfg.key_size;
+	enum _aesd_cipher_size cfbs = desc->cfg.cfbs;
+	uint32_t key[8];
+	uint32_t vector[4];
+
+	memcpy(key, desc->cfg.key, sizeof(key));
+	memcpy(vector, desc->cfg.vector, sizeof(vector));
+
+	desc->cfg.encrypt = true;
+	desc->cfg.mode = AESD_MODE_CTR;
+	desc->cfg.key_size = AESD_AES256;
+	desc->cfg.cfbs = AESD_CFBS_128;
+	memcpy(desc->cfg.key, _rngd.key, RNGD_KEY_SIZE);
+
+	memset(out, 0, blocks * RNGD_BLOCK_SIZE);
+	while (blocks) {
+		_rngd_inc(_rngd.v, 1);
+		low = (_rngd.v[14] << 8) | _rngd.v[15];
+		n = min_u32(blocks, 0x10000 - low);
+		memcpy(desc->cfg.vector, _rngd.v, RNGD_BLOCK_SIZE);
+
+		buf.data = out;
+		buf.size = n * RNGD_BLOCK_SIZE;
+		buf.attr = 0;
+		if (aesd_transfer(desc, &buf, &buf, NULL, NULL) != AESD_SUCCESS) {
+			err = -EBUSY;
+			break;
+		}
+		aesd_wait_transfer(desc);
+
+		_rngd_inc(_rngd.v, n - 1);
+		out += n * RNGD_BLOCK_SIZE;
+		blocks -= n;
+	}
+
+	memcpy(desc->cfg.key, key, sizeof(key));
+	memcpy(desc->cfg.vector, vector, sizeof(vector));
+	desc->cfg.encrypt = encrypt;
+	desc->cfg.mode = mode;
+	desc->cfg.key_size = key_size;
+	desc->cfg.cfbs = cfbs;
+	memset(key, 0, sizeof(key));
+	return err;
+}
+
+/* CTR_DRBG_Update: (K, V) from the next seedlen bits of keystream, XORed
+ * with the provided data when given */
+static void _rngd_update(const uint8_t* provided)
+{
+	ALIGNED(4) uint8_t temp[RNGD_SEED_SIZE];
+	uint32_t i;
+
+	_rngd_keystream(temp, RNGD_SEED_SIZE / RNGD_BLOCK_SIZE);
+	if (provided) {
+		for (i = 0; i < RNGD_SEED_SIZE; i++)
+			temp[i] ^= provided[i];
+	}
+	memcpy(_rngd.key, temp, RNGD_KEY_SIZE);
+	memcpy(_rngd.v, temp + RNGD_KEY_SIZE, RNGD_BLOCK_SIZE);
+	memset(temp, 0, sizeof(temp));
+}
+
+/* Block_Cipher_df(entropy || input, seedlen) */
+static void _rngd_df(const uint32_t* entropy, uint32_t words,
+		const void* input, uint32_t len, uint8_t* seed)
+{
+	ALIGNED(4) uint8_t temp[RNGD_SEED_SIZE];
+	ALIGNED(4) uint8_t x[RNGD_BLOCK_SIZE];
+	uint8_t* s = _rngd_df_buffer + RNGD_BLOCK_SIZE;
+	uint32_t slen, i, j, k;
+
+	/* S = L || N || input_string || 0x80 || 0^* */
+	_rngd_put_be32(s, words * 4 + len);
+	_rngd_put_be32(s + 4, RNGD_SEED_SIZE);
+	memcpy(s + 8, entropy, words * 4);
+	if (len)
+		memcpy(s + 8 + words * 4, input, len);
+	slen = 8 + words * 4 + len;
+	s[slen++] = 0x80;
+	while (slen % RNGD_BLOCK_SIZE)
+		s[slen++] = 0;
+
+	/* temp = BCC(K, IV_i || S) for i = 0, 1, 2 */
+	_rngd_aes_set_key(_rngd_df_key);
+	for (i = 0; i < RNGD_SEED_SIZE / RNGD_BLOCK_SIZE; i++) {
+		memset(_rngd_df_buffer, 0, RNGD_BLOCK_SIZE);
+		_rngd_put_be32(_rngd_df_buffer, i);
+		memset(x, 0, sizeof(x));
+		for (j = 0; j < RNGD_BLOCK_SIZE + slen; j += RNGD_BLOCK_SIZE) {
+			for (k = 0; k < RNGD_BLOCK_SIZE; k++)
+				x[k] ^= _rngd_df_buffer[j + k];
+			_rngd_aes_encrypt(x, x);
+		}
+		memcpy(temp + i * RNGD_BLOCK_SIZE, x, RNGD_BLOCK_SIZE);
+	}
+
+	/* K = leftmost keylen bits of temp, X = next outlen bits, then
+	 * chain X = E(K, X) up to seedlen bits */
+	_rngd_aes_set_key(temp);
+	memcpy(x, temp + RNGD_KEY_SIZE, RNGD_BLOCK_SIZE);
+	for (i = 0; i < RNGD_SEED_SIZE; i += RNGD_BLOCK_SIZE) {
+		_rngd_aes_encrypt(x, x);
+		memcpy(seed + i, x, RNGD_BLOCK_SIZE);
+	}
+
+	memset(temp, 0, sizeof(temp));
+	memset(x, 0, sizeof(x));
+	memset(_rngd_df_buffer, 0, sizeof(_rngd_df_buffer));
+}
+
+static int _rngd_instantiate(const void* pers, uint32_t len)
+{
+	uint32_t entropy[RNGD_SEED_WORDS + RNGD_NONCE_WORDS];
+	ALIGNED(4) uint8_t seed[RNGD_SEED_SIZE];
+	int err;
+
+	/* Entropy input and nonce both come from the TRNG */
+	err = _rngd_poll_words(entropy, ARRAY_SIZE(entropy));
+	if (err < 0)
+		return err;
+
+	_rngd_df(entropy, ARRAY_SIZE(entropy), pers, len, seed);
+	memset(_rngd.key, 0, sizeof(_rngd.key));
+	memset(_rngd.v, 0, sizeof(_rngd.v));
+	_rngd_update(seed);
+	_rngd.reseed_counter = 1;
+
+	memset(entropy, 0, sizeof(entropy));
+	memset(seed, 0, sizeof(seed));
+	return 0;
+}
+
+static int _rngd_reseed(const void* input, uint32_t len)
+{
+	uint32_t entropy[RNGD_SEED_WORDS];
+	ALIGNED(4) uint8_t seed[RNGD_SEED_SIZE];
+
+	if (!_rngd_pool_take(entropy, ARRAY_SIZE(entropy)))
+		return -EAGAIN;
+
+	_rngd_df(entropy, ARRAY_SIZE(entropy), input, len, seed);
+	_rngd_update(seed);
+	_rngd.reseed_counter = 1;
+	_rngd.stats.reseeds++;
+
+	memset(entropy, 0, sizeof(entropy));
+	memset(seed, 0, sizeof(seed));
+	return 0;
+}
+
+/* One CTR_DRBG generate request covering the whole reservoir */
+static int _rngd_refill(void)
+{
+	int err;
+
+	if (!_rngd_engine_lock())
+		return -EBUSY;
+
+	if (_rngd.reseed_counter > RNGD_RESEED_INTERVAL) {
+		if (_rngd_reseed(NULL, 0) < 0) {
+			_rngd.stats.deferred++;
+			if (_rngd.reseed_counter > RNGD_RESEED_LIMIT) {
+				aesd_engine_unlock();
+				return -EAGAIN;
+			}
+		}
+	}
+
+	if (_rngd.aesd) {
+		/* aesd takes the engine itself for the transfers */
+		aesd_engine_unlock();
+		err = _rngd_keystream_aesd(_rngd_reservoir, RNGD_RESERVOIR_SIZE / RNGD_BLOCK_SIZE);
+		if (err == 0 && !aesd_engine_try_lock())
+			err = -EBUSY;
+		if (err < 0) {
+			/* (K, V) cannot be updated, the keystream is not served */
+			memset(_rngd_reservoir, 0, sizeof(_rngd_reservoir));
+			return err;
+		}
+		_rngd.stats.refills_aesd++;
+	} else {
+		_rngd_keystream(_rngd_reservoir, RNGD_RESERVOIR_SIZE / RNGD_BLOCK_SIZE);
+	}
+	_rngd_update(NULL);
+	aesd_engine_unlock();
+
+	_rngd.reseed_counter++;
+	_rngd.stats.refills++;
+	_rngd.reservoir_pos = 0;
+	return 0;
+}
+
+/* rand() source, rand() uses its LCG for the values that cannot be
+ * generated */
+static int _rngd_rand(uint32_t* value)
+{
+	int err;
+
+	err = rngd_get_bytes(value, sizeof(*value));
+	if (err < 0)
+		_rngd.stats.rand_fallbacks++;
+	return err;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+int rngd_init(struct _aesd_desc* aesd, const void* pers, uint32_t pers_len)
+{
+	int err;
+
+	if (pers_len > RNGD_MAX_INPUT)
+		return -EINVAL;
+
+	memset(&_rngd, 0, sizeof(_rngd));
+	_rngd.aesd = aesd;
+
+	pmc_configure_peripheral(ID_AES, NULL, true);
+	trng_enable();
+
+	err = _rngd_poll_words(NULL, RNGD_STARTUP_WORDS);
+	if (err == 0) {
+		if (_rngd_engine_lock()) {
+			err = _rngd_instantiate(pers, pers_len);
+			aesd_engine_unlock();
+		} else {
+			err = -EBUSY;
+		}
+	}
+	if (err < 0) {
+		trng_disable();
+		return err;
+	}
+
+	_rngd.reservoir_pos = RNGD_RESERVOIR_SIZE;
+	_rngd.ready = true;
+	trng_enable_it(_rngd_trng_callback, NULL);
+	return 0;
+}
+
+void rngd_deinit(void)
+{
+	rngd_set_rand_source(false);
+	trng_disable_it();
+	trng_disable();
+	memset(&_rngd, 0, sizeof(_rngd));
+	memset(_rngd_reservoir, 0, sizeof(_rngd_reservoir));
+}
+
+bool rngd_is_ready(void)
+{
+	return _rngd.ready;
+}
+
+void rngd_set_rand_source(bool enable)
+{
+	if (enable)
+		rand_set_source(_rngd_rand);
+	else if (_rngd.rand_source)
+		rand_set_source(NULL);
+	_rngd.rand_source = enable;
+}
+
+int rngd_get_bytes(void* buf, uint32_t len)
+{
+	uint8_t* out = (uint8_t*)buf;
+	uint32_t n;
+	int err;
+
+	if (!_rngd.ready)
+		return -EAGAIN;
+
+	while (len) {
+		if (_rngd.reservoir_pos == RNGD_RESERVOIR_SIZE) {
+			err = _rngd_refill();
+			if (err < 0)
+				return err;
+		}
+		n = min_u32(len, RNGD_RESERVOIR_SIZE - _rngd.reservoir_pos);
+		memcpy(out, _rngd_reservoir + _rngd.reservoir_pos, n);
+		/* Served bytes are not kept around */
+		memset(_rngd_reservoir + _rngd.reservoir_pos, 0, n);
+		_rngd.reservoir_pos += n;
+		_rngd.stats.bytes += n;
+		out += n;
+		len -= n;
+	}
+	return 0;
+}
+
+uint32_t rngd_get_u32(void)
+{
+	uint32_t value = 0;
+
+	rngd_get_bytes(&value, sizeof(value));
+	return value;
+}
+
+int rngd_reseed(const void* input, uint32_t len)
+{
+	int err;
+
+	if (!_rngd.ready)
+		return -EAGAIN;
+	if (len > RNGD_MAX_INPUT)
+		return -EINVAL;
+
+	if (!_rngd_engine_lock())
+		return -EBUSY;
+	err = _rngd_reseed(input, len);
+	aesd_engine_unlock();
+	return err;
+}
+
+uint32_t rngd_get_entropy_level(void)
+{
+	return _rngd.pool.count;
+}
+
+void rngd_get_stats(struct _rngd_stats* stats, bool reset)
+{
+	uint32_t flags;
+
+	flags = arch_irq_save();
+	*stats = _rngd.stats;
+	if (reset)
+		memset(&_rngd.stats, 0, sizeof(_rngd.stats));
+	arch_irq_restore(flags);
+}
@@ -0,0 +1,192 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef RNGD_H_
+#define RNGD_H_
+
+#if defined(CONFIG_HAVE_TRNG) && defined(CONFIG_HAVE_AES)
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "crypto/aesd.h"
+
+/*------------------------------------------------------------------------------
+ *         Definitions
+ *------------------------------------------------------------------------------*/
+
+/** Entropy pool size, in TRNG words */
+#define RNGD_POOL_SIZE          64
+
+/** Min-entropy assumed per TRNG word, in bits. The health test cutoffs and
+ * the amount of entropy input taken per seed are derived from it. */
+#define RNGD_WORD_ENTROPY       8
+
+/** Entropy words per reseed (256 bits) and per nonce (128 bits) */
+#define RNGD_SEED_WORDS         (256 / RNGD_WORD_ENTROPY)
+#define RNGD_NONCE_WORDS        (128 / RNGD_WORD_ENTROPY)
+
+/** Repetition count test cutoff: 1 + ceil(20 / H) for a 2^-20 false
+ * positive rate (SP800-90B 4.4.1) */
+#define RNGD_RCT_CUTOFF         4
+
+/** Adaptive proportion test window and cutoff for H = 8 (SP800-90B 4.4.2) */
+#define RNGD_APT_WINDOW         512
+#define RNGD_APT_CUTOFF         13
+
+/** Startup health test length, in TRNG words */
+#define RNGD_STARTUP_WORDS      1024
+
+/** Generated bytes buffered ahead of the requests */
+#define RNGD_RESERVOIR_SIZE     1024
+
+/** Reservoir refills after which a reseed is scheduled */
+#define RNGD_RESEED_INTERVAL    64
+
+/** Reservoir refills after which generation stops until a reseed succeeds */
+#define RNGD_RESEED_LIMIT       (1024 * RNGD_RESEED_INTERVAL)
+
+/** Maximum size of personalization strings and additional input */
+#define RNGD_MAX_INPUT          48
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+struct _rngd_stats {
+	uint32_t entropy_words;   /*< TRNG words accepted in the pool */
+	uint32_t rct_failures;    /*< repetition count test failures */
+	uint32_t apt_failures;    /*< adaptive proportion test failures */
+	uint32_t reseeds;         /*< completed reseeds */
+	uint32_t deferred;        /*< scheduled reseeds postponed for entropy */
+	uint32_t refills;         /*< reservoir refills */
+	uint32_t refills_aesd;    /*< reservoir refills done through aesd */
+	uint32_t bytes;           /*< bytes returned to callers */
+	uint32_t rand_fallbacks;  /*< rand() values taken from its LCG */
+};
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Start the random number service.
+ *
+ * The TRNG is enabled and its output is run through the startup health
+ * tests, then the CTR_DRBG (AES-256, derivation function, SP800-90A 10.2)
+ * is instantiated from it. Afterwards the entropy pool is refilled in
+ * the background by the TRNG interrupt. rand() keeps its own generator
+ * unless rngd_set_rand_source() is called.
+ *
+ * The DRBG drives the AES engine directly while holding it with
+ * aesd_engine_try_lock(). The service calls fail with -EBUSY when another
+ * aesd user holds the engine.
+ *
+ * \param aesd  Optional AES driver descriptor. If not NULL, reservoir refills
+ * are done by aesd_transfer() in CTR mode with its transfer mode (DMA if so
+ * configured), and the service waits for its pending transfers first.
+ * \param pers  Optional personalization string
+ * \param pers_len  Size of the personalization string, at most RNGD_MAX_INPUT
+ * \return 0 on success, -EIO if the startup health tests failed, -EINVAL if
+ * pers_len is too large, -EBUSY if the engine is held
+ */
+extern int rngd_init(struct _aesd_desc* aesd, const void* pers, uint32_t pers_len);
+
+/**
+ * \brief Stop the service: the TRNG is disabled, the DRBG state wiped and
+ * rand() is given back to its LCG if it was served by the DRBG.
+ */
+extern void rngd_deinit(void);
+
+/**
+ * \brief Check whether the DRBG is instantiated.
+ */
+extern bool rngd_is_ready(void);
+
+/**
+ * \brief Serve rand() from the DRBG, or give it back to its LCG.
+ *
+ * When the DRBG cannot generate, for example while the AES engine is
+ * held by another user or while a required reseed waits for entropy,
+ * rand() takes the value from its LCG instead. Such values are counted in
+ * the rand_fallbacks statistic.
+ *
+ * \param enable  true to serve rand() from the DRBG
+ */
+extern void rngd_set_rand_source(bool enable);
+
+/**
+ * \brief Get random bytes.
+ *
+ * Requests are served from the reservoir, which is refilled by the DRBG
+ * when empty; the call never waits for the TRNG. When a reseed is due and
+ * the pool holds enough entropy, it is done before the refill. Must not
+ * be called from interrupt context.
+ *
+ * \param buf  Output buffer
+ * \param len  Number of bytes
+ * \return 0 on success, -EAGAIN if the DRBG is not instantiated or reached
+ * RNGD_RESEED_LIMIT without enough entropy for a reseed, -EBUSY if the
+ * reservoir had to be refilled while the engine was held
+ */
+extern int rngd_get_bytes(void* buf, uint32_t len);
+
+/**
+ * \brief Get a random 32-bit value, 0 if no value could be generated.
+ */
+extern uint32_t rngd_get_u32(void);
+
+/**
+ * \brief Reseed the DRBG now from the entropy pool.
+ * \param input  Optional additional input
+ * \param len  Size of the additional input, at most RNGD_MAX_INPUT
+ * \return 0 on success, -EAGAIN if the pool does not hold RNGD_SEED_WORDS
+ * words, -EINVAL if len is too large, -EBUSY if the engine is held
+ */
+extern int rngd_reseed(const void* input, uint32_t len);
+
+/**
+ * \brief Get the number of words currently held by the entropy pool.
+ */
+extern uint32_t rngd_get_entropy_level(void);
+
+/**
+ * \brief Get the service statistics.
+ * \param stats  Output statistics
+ * \param reset  Clear the counters after reading them
+ */
+extern void rngd_get_stats(struct _rngd_stats* stats, bool reset);
+
+#endif /* CONFIG_HAVE_TRNG && CONFIG_HAVE_AES */
+
+#endif /* RNGD_H_ */
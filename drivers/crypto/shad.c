@@ -38,10 +38,12 @@
 #include "errno.h"
 #include "intmath.h"
 #include "irq/irq.h"
+#include "irqflags.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
 #include "serial/console.h"
 #include "swab.h"
+#include "timer.h"
 #include "trace.h"
 
 /*----------------------------------------------------------------------------
@@ -126,6 +128,28 @@ static uint8_t _shad_get_dma_chunk_size(enum _shad_algo algo)
 #endif
 }
 
+#ifdef CONFIG_HAVE_SHA_HMAC
+static void _shad_sched_run(struct _shad_desc* desc);
+
+/* Keep the streams off the engine from shad_start() to the end of the
+ * one-shot message, once the slice in flight, if any, is done */
+static void _shad_oneshot_claim(struct _shad_desc* desc)
+{
+	uint32_t flags;
+
+	while (true) {
+		flags = arch_irq_save();
+		if (!desc->sched.active) {
+			desc->sched.oneshot = true;
+			arch_irq_restore(flags);
+			return;
+		}
+		arch_irq_restore(flags);
+		dma_poll();
+	}
+}
+#endif
+
 static void _shad_finish(struct _shad_desc* desc)
 {
 	/* Get output data */
@@ -133,8 +157,16 @@ static void _shad_finish(struct _shad_desc* desc)
 
 	/* Release mutex and execute callback function */
 	mutex_unlock(&desc->mutex);
+#ifdef CONFIG_HAVE_SHA_HMAC
+	desc->sched.oneshot = false;
+#endif
 
 	callback_call(&desc->xfer.callback, NULL);
+
+#ifdef CONFIG_HAVE_SHA_HMAC
+	/* Resume the streams queued during the message */
+	_shad_sched_run(desc);
+#endif
 }
 
 static int _shad_dma_update_callback(void *arg, void* arg2)
@@ -376,6 +408,330 @@ static int _shad_update_polling(struct _shad_desc* desc, const uint8_t* data, ui
 	}
 }
 
+#ifdef CONFIG_HAVE_SHA_HMAC
+
+/*----------------------------------------------------------------------------
+ *        Stream contexts
+ *----------------------------------------------------------------------------*/
+
+/* Initial hash values. SHA-224 and SHA-384 run as SHA-256 and SHA-512 from
+ * their own initial value, so the whole state can be read back. */
+static const uint32_t _shad_iv_sha1[] = {
+	0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0,
+};
+
+static const uint32_t _shad_iv_sha224[] = {
+	0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939,
+	0xffc00b31, 0x68581511, 0x64f98fa7, 0xbefa4fa4,
+};
+
+static const uint32_t _shad_iv_sha256[] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static const uint32_t _shad_iv_sha384[] = {
+	0xcbbb9d5d, 0xc1059ed8, 0x629a292a, 0x367cd507,
+	0x9159015a, 0x3070dd17, 0x152fecd8, 0xf70e5939,
+	0x67332667, 0xffc00b31, 0x8eb44a87, 0x68581511,
+	0xdb0c2e0d, 0x64f98fa7, 0x47b5481d, 0xbefa4fa4,
+};
+
+static const uint32_t _shad_iv_sha512[] = {
+	0x6a09e667, 0xf3bcc908, 0xbb67ae85, 0x84caa73b,
+	0x3c6ef372, 0xfe94f82b, 0xa54ff53a, 0x5f1d36f1,
+	0x510e527f, 0xade682d1, 0x9b05688c, 0x2b3e6c1f,
+	0x1f83d9ab, 0xfb41bd6b, 0x5be0cd19, 0x137e2179,
+};
+
+static int _shad_ctx_setup(struct _shad_ctx* ctx, enum _shad_algo algo)
+{
+	const uint32_t* iv;
+	uint32_t words, value, i;
+
+	switch (algo) {
+	case ALGO_SHA_1:
+		iv = _shad_iv_sha1;
+		words = ARRAY_SIZE(_shad_iv_sha1);
+		break;
+	case ALGO_SHA_224:
+		iv = _shad_iv_sha224;
+		words = ARRAY_SIZE(_shad_iv_sha224);
+		break;
+	case ALGO_SHA_256:
+		iv = _shad_iv_sha256;
+		words = ARRAY_SIZE(_shad_iv_sha256);
+		break;
+#ifdef SHA_MR_ALGO_SHA512
+	case ALGO_SHA_384:
+		iv = _shad_iv_sha384;
+		words = ARRAY_SIZE(_shad_iv_sha384);
+		break;
+	case ALGO_SHA_512:
+		iv = _shad_iv_sha512;
+		words = ARRAY_SIZE(_shad_iv_sha512);
+		break;
+#endif
+	default:
+		return -EINVAL;
+	}
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->algo = algo;
+	for (i = 0; i < words; i++) {
+		value = swab32(iv[i]);
+		memcpy(&ctx->state[4 * i], &value, 4);
+	}
+	return 0;
+}
+
+static uint32_t _shad_ctx_state_size(enum _shad_algo algo)
+{
+	if (algo == ALGO_SHA_1)
+		return 20;
+	else if (algo == ALGO_SHA_224 || algo == ALGO_SHA_256)
+		return 32;
+	else
+		return 64;
+}
+
+static uint32_t _shad_ctx_engine_algo(enum _shad_algo algo)
+{
+	if (algo == ALGO_SHA_1)
+		return SHA_MR_ALGO_SHA1;
+	else if (algo == ALGO_SHA_224 || algo == ALGO_SHA_256)
+		return SHA_MR_ALGO_SHA256;
+#ifdef SHA_MR_ALGO_SHA512
+	else
+		return SHA_MR_ALGO_SHA512;
+#else
+	else
+		return 0;
+#endif
+}
+
+/* Restore the intermediate hash of a stream in the engine */
+static void _shad_ctx_load(struct _shad_ctx* ctx, bool dma)
+{
+	sha_soft_reset();
+	sha_configure(_shad_ctx_engine_algo(ctx->algo) | SHA_MR_UIHV |
+	              (dma ? SHA_MR_SMOD_IDATAR0_START : SHA_MR_SMOD_AUTO_START));
+	sha_set_ir0(1);
+	sha_set_input(ctx->state, _shad_ctx_state_size(ctx->algo));
+	sha_set_ir0(0);
+	sha_first_block();
+}
+
+/* Save the intermediate hash of a stream once the engine is done */
+static void _shad_ctx_save(struct _shad_ctx* ctx)
+{
+	while ((sha_get_status() & SHA_ISR_DATRDY) == 0);
+	sha_get_output(ctx->state, _shad_ctx_state_size(ctx->algo));
+}
+
+static void _shad_sched_push(struct _shad_desc* desc, struct _shad_ctx* ctx)
+{
+	uint32_t flags = arch_irq_save();
+
+	ctx->next = NULL;
+	if (desc->sched.tail)
+		desc->sched.tail->next = ctx;
+	else
+		desc->sched.head = ctx;
+	desc->sched.tail = ctx;
+
+	arch_irq_restore(flags);
+}
+
+/* Give the engine to the stream at the head of the queue, if it is free */
+static struct _shad_ctx* _shad_sched_claim(struct _shad_desc* desc)
+{
+	struct _shad_ctx* ctx = NULL;
+	uint32_t flags = arch_irq_save();
+
+	if (!desc->sched.active && !desc->sched.oneshot && desc->sched.head &&
+	    mutex_try_lock(&desc->mutex)) {
+		ctx = desc->sched.head;
+		desc->sched.head = ctx->next;
+		if (!desc->sched.head)
+			desc->sched.tail = NULL;
+		desc->sched.active = ctx;
+	}
+
+	arch_irq_restore(flags);
+	return ctx;
+}
+
+/* Pad the message and get the digest, then run the outer hash for HMAC */
+static void _shad_ctx_finalize(struct _shad_ctx* ctx)
+{
+	const uint32_t block_size = _shad_get_block_size(ctx->algo);
+	const uint32_t digest_size = shad_get_digest_size(ctx->algo);
+	uint32_t padding_len;
+
+	padding_len = _shad_fill_padding(ctx->algo, ctx->length + ctx->pending,
+	                                 &ctx->block[ctx->pending],
+	                                 sizeof(ctx->block) - ctx->pending);
+	_shad_ctx_load(ctx, false);
+	_shad_process_blocks_polling(ctx->block, ctx->pending + padding_len,
+	                             block_size, false);
+	_shad_ctx_save(ctx);
+
+	if (ctx->hmac) {
+		memcpy(ctx->block, ctx->state, digest_size);
+		memcpy(ctx->state, ctx->hmac->opad_state, sizeof(ctx->state));
+		padding_len = _shad_fill_padding(ctx->algo, block_size + digest_size,
+		                                 &ctx->block[digest_size],
+		                                 sizeof(ctx->block) - digest_size);
+		_shad_ctx_load(ctx, false);
+		_shad_process_blocks_polling(ctx->block, digest_size + padding_len,
+		                             block_size, false);
+		_shad_ctx_save(ctx);
+	}
+
+	memcpy(ctx->job.digest->data, ctx->state, digest_size);
+	ctx->pending = 0;
+	ctx->job.final = false;
+}
+
+static int _shad_ctx_dma_callback(void* arg, void* arg2);
+
+/* Run one slice of a stream. Returns true if the slice was handed to the
+ * DMA, in which case it completes from the DMA callback. */
+static bool _shad_ctx_slice(struct _shad_desc* desc, struct _shad_ctx* ctx)
+{
+	const uint32_t block_size = _shad_get_block_size(ctx->algo);
+	struct _dma_transfer_cfg cfg[2];
+	struct _dma_cfg cfg_dma;
+	struct _callback _cb;
+	uint32_t complement, run;
+	uint32_t sg_count = 0;
+	bool dma;
+
+	if (!ctx->stats.started) {
+		ctx->stats.first_tick = timer_get_tick();
+		ctx->stats.started = true;
+	}
+	ctx->stats.slices++;
+
+	if (ctx->job.size == 0 && ctx->job.final) {
+		_shad_ctx_finalize(ctx);
+		return false;
+	}
+
+	/* Complete the block left by the previous request */
+	if (ctx->pending) {
+		complement = min_u32(ctx->job.size, block_size - ctx->pending);
+		memcpy(&ctx->block[ctx->pending], ctx->job.data, complement);
+		ctx->pending += complement;
+		ctx->job.data += complement;
+		ctx->job.size -= complement;
+		ctx->stats.bytes += complement;
+	}
+
+	run = min_u32(ctx->job.size & ~(block_size - 1), SHAD_CTX_SLICE_SIZE);
+	if (ctx->pending < block_size && run == 0)
+		return false;
+
+	dma = desc->cfg.transfer_mode == SHAD_TRANS_DMA &&
+	      ((uint32_t)ctx->job.data & 3) == 0;
+	_shad_ctx_load(ctx, dma);
+
+	if (ctx->pending == block_size) {
+		if (dma)
+			_shad_prepare_dma_sg(&cfg[sg_count++], ctx->block, block_size);
+		else
+			_shad_process_blocks_polling(ctx->block, block_size, block_size, false);
+		ctx->length += block_size;
+		ctx->pending = 0;
+	}
+
+	if (run) {
+		if (dma)
+			_shad_prepare_dma_sg(&cfg[sg_count++], ctx->job.data, run);
+		else
+			_shad_process_blocks_polling(ctx->job.data, run, block_size, false);
+		ctx->length += run;
+		ctx->job.data += run;
+		ctx->job.size -= run;
+		ctx->stats.bytes += run;
+	}
+
+	if (!dma) {
+		_shad_ctx_save(ctx);
+		return false;
+	}
+
+	memset(&cfg_dma, 0, sizeof(cfg_dma));
+	cfg_dma.incr_saddr = true;
+	cfg_dma.incr_daddr = false;
+	cfg_dma.data_width = DMA_DATA_WIDTH_WORD;
+	cfg_dma.chunk_size = _shad_get_dma_chunk_size(ctx->algo);
+
+	callback_set(&_cb, _shad_ctx_dma_callback, (void*)desc);
+	dma_set_callback(desc->dma_channel, &_cb);
+	dma_configure_transfer(desc->dma_channel, &cfg_dma, cfg, sg_count);
+	dma_start_transfer(desc->dma_channel);
+	return true;
+}
+
+/* Account for a finished slice, then either requeue the stream or complete
+ * its request */
+static void _shad_ctx_slice_done(struct _shad_desc* desc, struct _shad_ctx* ctx)
+{
+	const uint32_t block_size = _shad_get_block_size(ctx->algo);
+	struct _callback cb;
+	bool done;
+
+	/* Keep the tail of the request for the next one */
+	if (ctx->job.size && ctx->job.size < block_size && ctx->pending == 0) {
+		memcpy(ctx->block, ctx->job.data, ctx->job.size);
+		ctx->pending = ctx->job.size;
+		ctx->stats.bytes += ctx->job.size;
+		ctx->job.size = 0;
+	}
+	ctx->stats.last_tick = timer_get_tick();
+
+	done = ctx->job.size == 0 && !ctx->job.final;
+	if (!done)
+		_shad_sched_push(desc, ctx);
+
+	desc->sched.active = NULL;
+	mutex_unlock(&desc->mutex);
+
+	if (done) {
+		callback_copy(&cb, &ctx->job.callback);
+		ctx->job.busy = false;
+		callback_call(&cb, NULL);
+	}
+}
+
+static void _shad_sched_run(struct _shad_desc* desc)
+{
+	struct _shad_ctx* ctx;
+
+	while ((ctx = _shad_sched_claim(desc)) != NULL) {
+		if (_shad_ctx_slice(desc, ctx))
+			return;
+		_shad_ctx_slice_done(desc, ctx);
+	}
+}
+
+static int _shad_ctx_dma_callback(void* arg, void* arg2)
+{
+	struct _shad_desc* desc = (struct _shad_desc*)arg;
+	struct _shad_ctx* ctx = desc->sched.active;
+
+	dma_reset_channel(desc->dma_channel);
+	_shad_ctx_save(ctx);
+	_shad_ctx_slice_done(desc, ctx);
+	_shad_sched_run(desc);
+
+	return 0;
+}
+
+#endif /* CONFIG_HAVE_SHA_HMAC */
+
 /*----------------------------------------------------------------------------
  *        Public functions
  *----------------------------------------------------------------------------*/
@@ -388,6 +744,10 @@ void shad_init(struct _shad_desc* desc)
 	/* Allocate one DMA channel for writing message blocks to SHA_IDATARx */
 	desc->dma_channel = dma_allocate_channel(DMA_PERIPH_MEMORY, ID_SHA);
 	assert(desc->dma_channel);
+
+#ifdef CONFIG_HAVE_SHA_HMAC
+	memset(&desc->sched, 0, sizeof(desc->sched));
+#endif
 }
 
 int shad_get_digest_size(enum _shad_algo algo)
@@ -447,6 +807,9 @@ int shad_start(struct _shad_desc* desc)
 		return -EINVAL;
 	}
 
+#ifdef CONFIG_HAVE_SHA_HMAC
+	_shad_oneshot_claim(desc);
+#endif
 	sha_soft_reset();
 	sha_configure(algo | mode | SHA_MR_PROCDLY_LONGEST);
 	memset(&desc->xfer, 0, sizeof(desc->xfer));
@@ -497,7 +860,9 @@ int shad_finish(struct _shad_desc* desc, struct _buffer* buffer,
 #ifdef CONFIG_HAVE_SHA_HMAC
 		/* Get output data */
 		sha_get_output(buffer->data, buffer->size);
+		desc->sched.oneshot = false;
 		callback_call(&desc->xfer.callback, NULL);
+		_shad_sched_run(desc);
 		return 0;
 #else
 		return -EAGAIN;
@@ -632,6 +997,9 @@ static void hmac_precompute_intermediate(struct _shad_desc* desc)
 	while ((sha_get_status() & SHA_ISR_DATRDY) == 0);
 	sha_get_output(opad, digest_size);
 	sha_configure(mr);
+
+	desc->sched.oneshot = false;
+	_shad_sched_run(desc);
 }
 
 static int hmac_computer_with_intermediate(struct _shad_desc* desc,
@@ -762,4 +1130,150 @@ int shad_compute_hmac(struct _shad_desc* desc,
 #else
 	return hmac_computer_without_intermediate(desc, text, digest);
 #endif
-}
\ No newline at end of file
+}
+
+#ifdef CONFIG_HAVE_SHA_HMAC
+int shad_ctx_start(struct _shad_desc* desc, struct _shad_ctx* ctx,
+			enum _shad_algo algo)
+{
+	int err;
+
+	err = _shad_ctx_setup(ctx, algo);
+	if (err < 0)
+		return err;
+	ctx->desc = desc;
+	return 0;
+}
+
+int shad_ctx_hmac_start(struct _shad_desc* desc, struct _shad_ctx* ctx,
+			const struct _shad_hmac_key* key)
+{
+	int err;
+
+	err = shad_ctx_start(desc, ctx, key->algo);
+	if (err < 0)
+		return err;
+
+	/* The first block, K0 xor ipad, is already in the key */
+	memcpy(ctx->state, key->ipad_state, sizeof(ctx->state));
+	ctx->length = _shad_get_block_size(key->algo);
+	ctx->hmac = key;
+	return 0;
+}
+
+int shad_ctx_update(struct _shad_ctx* ctx, const void* data, uint32_t size,
+			struct _callback* cb)
+{
+	if (ctx->job.busy)
+		return -EBUSY;
+
+	ctx->job.busy = true;
+	ctx->job.final = false;
+	ctx->job.data = (const uint8_t*)data;
+	ctx->job.size = size;
+	callback_copy(&ctx->job.callback, cb);
+
+	_shad_sched_push(ctx->desc, ctx);
+	_shad_sched_run(ctx->desc);
+	return 0;
+}
+
+int shad_ctx_finish(struct _shad_ctx* ctx, struct _buffer* digest,
+			struct _callback* cb)
+{
+	if (ctx->job.busy)
+		return -EBUSY;
+	if (digest->size < shad_get_digest_size(ctx->algo))
+		return -EINVAL;
+
+	ctx->job.busy = true;
+	ctx->job.final = true;
+	ctx->job.data = NULL;
+	ctx->job.size = 0;
+	ctx->job.digest = digest;
+	callback_copy(&ctx->job.callback, cb);
+
+	_shad_sched_push(ctx->desc, ctx);
+	_shad_sched_run(ctx->desc);
+	return 0;
+}
+
+bool shad_ctx_is_busy(struct _shad_ctx* ctx)
+{
+	return ctx->job.busy;
+}
+
+void shad_ctx_wait(struct _shad_ctx* ctx)
+{
+	while (shad_ctx_is_busy(ctx)) {
+		if (ctx->desc->cfg.transfer_mode == SHAD_TRANS_DMA)
+			dma_poll();
+		/* the engine may have been held by a one-shot request */
+		_shad_sched_run(ctx->desc);
+	}
+}
+
+void shad_ctx_get_stats(struct _shad_ctx* ctx, struct _shad_ctx_stats* stats)
+{
+	stats->bytes = ctx->stats.bytes;
+	stats->slices = ctx->stats.slices;
+	stats->elapsed = ctx->stats.started ?
+		(uint32_t)timer_get_interval(ctx->stats.first_tick, ctx->stats.last_tick) : 0;
+	stats->rate = stats->elapsed ?
+		(uint32_t)((uint64_t)stats->bytes * 1000 / stats->elapsed) : 0;
+}
+
+int shad_hmac_key_init(struct _shad_desc* desc, struct _shad_hmac_key* key,
+			enum _shad_algo algo, const uint8_t* k, uint32_t size)
+{
+	const uint32_t block_size = _shad_get_block_size(algo);
+	uint8_t k0[SHAD_MAX_BLOCK_SIZE];
+	uint8_t pad[SHAD_MAX_BLOCK_SIZE];
+	struct _buffer digest = {
+		.data = k0,
+		.size = sizeof(k0),
+	};
+	struct _shad_ctx ctx;
+	uint32_t i;
+	int err;
+
+	err = shad_ctx_start(desc, &ctx, algo);
+	if (err < 0)
+		return err;
+
+	/* K0: the key, hashed first if longer than a block, padded with
+	 * zeros to a block */
+	memset(k0, 0, sizeof(k0));
+	if (size > block_size) {
+		shad_ctx_update(&ctx, k, size, NULL);
+		shad_ctx_wait(&ctx);
+		shad_ctx_finish(&ctx, &digest, NULL);
+		shad_ctx_wait(&ctx);
+		memset(&k0[shad_get_digest_size(algo)], 0,
+		       sizeof(k0) - shad_get_digest_size(algo));
+	} else {
+		memcpy(k0, k, size);
+	}
+
+	/* H state after (K0 xor ipad) */
+	for (i = 0; i < block_size; i++)
+		pad[i] = k0[i] ^ 0x36;
+	shad_ctx_start(desc, &ctx, algo);
+	shad_ctx_update(&ctx, pad, block_size, NULL);
+	shad_ctx_wait(&ctx);
+	memcpy(key->ipad_state, ctx.state, sizeof(key->ipad_state));
+
+	/* H state after (K0 xor opad) */
+	for (i = 0; i < block_size; i++)
+		pad[i] = k0[i] ^ 0x5c;
+	shad_ctx_start(desc, &ctx, algo);
+	shad_ctx_update(&ctx, pad, block_size, NULL);
+	shad_ctx_wait(&ctx);
+	memcpy(key->opad_state, ctx.state, sizeof(key->opad_state));
+
+	key->algo = algo;
+	memset(k0, 0, sizeof(k0));
+	memset(pad, 0, sizeof(pad));
+	return 0;
+}
+#endif /* CONFIG_HAVE_SHA_HMAC */
@@ -38,6 +38,7 @@
 #include <stdint.h>
 
 #include "callback.h"
+#include "compiler.h"
 #include "crypto/sha.h"
 #include "dma/dma.h"
 #include "io.h"
@@ -61,6 +62,16 @@ enum _shad_transfer_mode
 	SHAD_TRANS_DMA
 };
 
+/* Largest block size of the supported algorithms (SHA-384/512) */
+#define SHAD_MAX_BLOCK_SIZE 128
+
+/* Bytes processed for a stream before the engine is given to the next one */
+#ifndef SHAD_CTX_SLICE_SIZE
+#define SHAD_CTX_SLICE_SIZE 2048
+#endif
+
+struct _shad_ctx;
+
 struct _shad_desc {
 	/* structure to define SHA configuration */
 	struct {
@@ -81,8 +92,69 @@ struct _shad_desc {
 		uint32_t processed; /* cumulated data processed, value is included in padding data */
 		struct _buffer* buffer;
 	} xfer;
+
+#ifdef CONFIG_HAVE_SHA_HMAC
+	/* streams waiting for the engine, served round-robin */
+	struct {
+		struct _shad_ctx* head;
+		struct _shad_ctx* tail;
+		struct _shad_ctx* active;
+		bool oneshot; /* engine held from shad_start() to shad_finish() */
+	} sched;
+#endif
+};
+
+#ifdef CONFIG_HAVE_SHA_HMAC
+/* HMAC key, reduced to the intermediate hashes of its padded blocks */
+struct _shad_hmac_key {
+	enum _shad_algo algo;
+	uint8_t ipad_state[64]; /* H state after (K0 xor ipad) */
+	uint8_t opad_state[64]; /* H state after (K0 xor opad) */
 };
 
+struct _shad_ctx_stats {
+	uint32_t bytes;   /* message bytes hashed */
+	uint32_t slices;  /* number of times the stream got the engine */
+	uint32_t elapsed; /* ms between the first and the last slice */
+	uint32_t rate;    /* bytes per second over that period */
+};
+
+/* Hash stream, its intermediate hash is kept here between slices so that
+ * any number of streams can share the engine */
+struct _shad_ctx {
+	enum _shad_algo algo;
+	struct _shad_desc* desc;
+	const struct _shad_hmac_key* hmac;
+
+	/* --- following fields are used internally --- */
+
+	uint8_t state[64];    /* intermediate hash, in digest byte order */
+	ALIGNED(4) uint8_t block[2 * SHAD_MAX_BLOCK_SIZE]; /* partial block, padding */
+	uint32_t pending;     /* bytes in block */
+	uint32_t length;      /* bytes already hashed */
+
+	/* pending request */
+	struct {
+		bool busy;
+		bool final;
+		const uint8_t* data;
+		uint32_t size;
+		struct _buffer* digest;
+		struct _callback callback;
+	} job;
+
+	struct {
+		bool started;
+		uint64_t first_tick;
+		uint64_t last_tick;
+		uint32_t bytes;
+		uint32_t slices;
+	} stats;
+
+	struct _shad_ctx* next;
+};
+#endif /* CONFIG_HAVE_SHA_HMAC */
+
 /*------------------------------------------------------------------------------
  *        Functions
  *----------------------------------------------------------------------------*/
@@ -102,6 +174,8 @@ extern int shad_get_digest_size(enum _shad_algo algo);
 
 /**
  * \brief Start a new SHA computation.
+ * The streams (shad_ctx_*) of the descriptor are held off until the
+ * computation is finished with shad_finish().
  * \param desc a SHA driver descriptor
  * \return 0 on success, <0 on error
  */
@@ -182,4 +256,87 @@ extern int shad_compute_hmac(struct _shad_desc* desc,
 					  struct _buffer* text,
 					  struct _buffer* digest,
 					  struct _callback* cb);
+
+#ifdef CONFIG_HAVE_SHA_HMAC
+
+/**
+ * \brief Start a new hash stream.
+ * \param desc a SHA driver descriptor, initialized with shad_init()
+ * \param ctx stream context
+ * \param algo SHA algorithm: ALGO_SHA_1..ALGO_SHA_512
+ * \return 0 on success, <0 on error
+ * \note The context must not have a pending request.
+ */
+extern int shad_ctx_start(struct _shad_desc* desc, struct _shad_ctx* ctx,
+			enum _shad_algo algo);
+
+/**
+ * \brief Start a new HMAC stream with a precomputed key.
+ * \param desc a SHA driver descriptor, initialized with shad_init()
+ * \param ctx stream context
+ * \param key key prepared by shad_hmac_key_init()
+ * \return 0 on success, <0 on error
+ */
+extern int shad_ctx_hmac_start(struct _shad_desc* desc, struct _shad_ctx* ctx,
+			const struct _shad_hmac_key* key);
+
+/**
+ * \brief Queue some data for a stream.
+ * \param ctx stream context
+ * \param data data to hash, must stay valid until the callback is called
+ * \param size data size in bytes
+ * \param cb callback called once the data has been consumed
+ * \return 0 on success, -EBUSY if the stream has a pending request
+ * \note With a DMA descriptor, word-aligned data is moved by DMA, other
+ * data is written by the CPU.
+ */
+extern int shad_ctx_update(struct _shad_ctx* ctx, const void* data,
+			uint32_t size, struct _callback* cb);
+
+/**
+ * \brief Pad the stream and get its digest (or HMAC).
+ * \param ctx stream context
+ * \param digest buffer receiving the digest
+ * \param cb callback called when the digest is available
+ * \return 0 on success, <0 on error
+ */
+extern int shad_ctx_finish(struct _shad_ctx* ctx, struct _buffer* digest,
+			struct _callback* cb);
+
+/**
+ * \brief Checks if a stream has a pending request.
+ * \param ctx stream context
+ * \return true if the stream is busy.
+ */
+extern bool shad_ctx_is_busy(struct _shad_ctx* ctx);
+
+/**
+ * \brief Wait for the pending request of a stream to complete.
+ * \param ctx stream context
+ */
+extern void shad_ctx_wait(struct _shad_ctx* ctx);
+
+/**
+ * \brief Get the statistics of a stream.
+ * \param ctx stream context
+ * \param stats structure to fill
+ */
+extern void shad_ctx_get_stats(struct _shad_ctx* ctx,
+			struct _shad_ctx_stats* stats);
+
+/**
+ * \brief Precompute an HMAC key for use by any number of streams.
+ * \param desc a SHA driver descriptor, initialized with shad_init()
+ * \param key key structure to fill
+ * \param algo SHA algorithm: ALGO_SHA_1..ALGO_SHA_512
+ * \param k secret key
+ * \param size secret key size in bytes
+ * \return 0 on success, <0 on error
+ */
+extern int shad_hmac_key_init(struct _shad_desc* desc,
+			struct _shad_hmac_key* key, enum _shad_algo algo,
+			const uint8_t* k, uint32_t size);
+
+#endif /* CONFIG_HAVE_SHA_HMAC */
+
 #endif /* SHAD_H */
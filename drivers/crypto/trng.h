@@ -73,6 +73,17 @@ extern void trng_enable_it(trng_callback_t cb, void* user_arg);
  */
 extern void trng_disable_it(void);
 
+/**
+ * \brief Stop the TRNG interrupt without removing its callback, e.g. while
+ * the consumer has no room for new values.
+ */
+extern void trng_suspend_it(void);
+
+/**
+ * \brief Restart the TRNG interrupt stopped by trng_suspend_it().
+ */
+extern void trng_resume_it(void);
+
 /**
  * \brief Get the next random value generated by the TRNG. This function will
  * block until a value is available.
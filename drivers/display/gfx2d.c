@@ -0,0 +1,613 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "chip.h"
+#include "compiler.h"
+#include "display/gfx2d.h"
+#include "display/lcdc.h"
+#include "dma/dma.h"
+#include "errno.h"
+#include "mm/cache.h"
+
+/** \addtogroup gfx2d_module
+ *@{*/
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+/** DMA used for rectangle copies and fills */
+static struct {
+	struct _dma_channel *channel;
+	uint32_t threshold;
+} _dma;
+
+static struct _gfx2d_stats _stats;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static inline uint8_t *_pixel(const struct _gfx2d_surface *surface,
+		uint16_t x, uint16_t y)
+{
+	return surface->buffer + y * surface->stride + x * (surface->bpp / 8);
+}
+
+/**
+ * \brief Clip a rectangle to a surface.
+ * \return false if nothing is left to draw.
+ */
+static bool _clip(const struct _gfx2d_surface *surface,
+		uint16_t x, uint16_t y, uint16_t *w, uint16_t *h)
+{
+	if (x >= surface->width || y >= surface->height || !*w || !*h)
+		return false;
+	if (*w > surface->width - x)
+		*w = surface->width - x;
+	if (*h > surface->height - y)
+		*h = surface->height - y;
+	return true;
+}
+
+/**
+ * \brief Clip a blit to its source and destination surfaces.
+ * \return false if nothing is left to draw.
+ */
+static bool _clip_blit(const struct _gfx2d_surface *dst, uint16_t dx, uint16_t dy,
+		const struct _gfx2d_surface *src, uint16_t sx, uint16_t sy,
+		uint16_t *w, uint16_t *h)
+{
+	return _clip(src, sx, sy, w, h) && _clip(dst, dx, dy, w, h);
+}
+
+static uint32_t _area(const struct _gfx2d_rect *r)
+{
+	return (uint32_t)r->w * r->h;
+}
+
+static void _union(struct _gfx2d_rect *out, const struct _gfx2d_rect *a,
+		const struct _gfx2d_rect *b)
+{
+	uint16_t ax2 = a->x + a->w, ay2 = a->y + a->h;
+	uint16_t bx2 = b->x + b->w, by2 = b->y + b->h;
+
+	out->x = a->x < b->x ? a->x : b->x;
+	out->y = a->y < b->y ? a->y : b->y;
+	out->w = (ax2 > bx2 ? ax2 : bx2) - out->x;
+	out->h = (ay2 > by2 ? ay2 : by2) - out->y;
+}
+
+/**
+ * \brief Add a clipped rectangle to the dirty list. When the list is full
+ * the rectangle is merged with the entry whose area grows the least.
+ */
+static void _add_dirty(struct _gfx2d_surface *surface, uint16_t x, uint16_t y,
+		uint16_t w, uint16_t h)
+{
+	struct _gfx2d_rect rect = { x, y, w, h };
+	struct _gfx2d_rect merged;
+	uint32_t cost, best_cost = UINT32_MAX;
+	uint8_t i, best = 0;
+
+	for (i = 0; i < surface->dirty_count; i++) {
+		_union(&merged, &surface->dirty[i], &rect);
+		cost = _area(&merged) - _area(&surface->dirty[i]);
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = i;
+		}
+	}
+
+	/* Already covered */
+	if (best_cost == 0)
+		return;
+
+	if (surface->dirty_count < GFX2D_MAX_DIRTY) {
+		surface->dirty[surface->dirty_count++] = rect;
+	} else {
+		_union(&merged, &surface->dirty[best], &rect);
+		surface->dirty[best] = merged;
+	}
+}
+
+static void _fill_words(uint32_t *p, uint32_t value, uint32_t count)
+{
+	for (; count >= 8; count -= 8) {
+		p[0] = value;
+		p[1] = value;
+		p[2] = value;
+		p[3] = value;
+		p[4] = value;
+		p[5] = value;
+		p[6] = value;
+		p[7] = value;
+		p += 8;
+	}
+	while (count--)
+		*p++ = value;
+}
+
+static inline void _put_pixel(uint8_t *p, uint32_t color, uint8_t bpp)
+{
+	switch (bpp) {
+	case 16:
+		*(uint16_t *)p = color;
+		break;
+	case 24:
+		p[0] = color;
+		p[1] = color >> 8;
+		p[2] = color >> 16;
+		break;
+	case 32:
+		*(uint32_t *)p = color;
+		break;
+	}
+}
+
+static inline uint32_t _get_pixel(const uint8_t *p, uint8_t bpp)
+{
+	switch (bpp) {
+	case 16:
+		return *(const uint16_t *)p;
+	case 24:
+		return p[0] | (p[1] << 8) | (p[2] << 16);
+	default:
+		return *(const uint32_t *)p;
+	}
+}
+
+/**
+ * \brief Fill count pixels with word stores.
+ * 16 and 24 bpp colors are replicated in a 1 or 3 words pattern once
+ * the pointer is word aligned.
+ */
+static void _fill_row(uint8_t *p, uint32_t count, uint32_t color, uint8_t bpp)
+{
+	uint32_t *p32;
+
+	switch (bpp) {
+	case 16:
+		color &= 0xffff;
+		if (((uint32_t)p & 2) && count) {
+			*(uint16_t *)p = color;
+			p += 2;
+			count--;
+		}
+		_fill_words((uint32_t *)p, color | (color << 16), count / 2);
+		if (count & 1)
+			*(uint16_t *)(p + 2 * (count - 1)) = color;
+		break;
+	case 24:
+		color &= 0xffffff;
+		while (((uint32_t)p & 3) && count) {
+			_put_pixel(p, color, 24);
+			p += 3;
+			count--;
+		}
+		p32 = (uint32_t *)p;
+		for (; count >= 4; count -= 4) {
+			p32[0] = color | (color << 24);
+			p32[1] = (color >> 8) | (color << 16);
+			p32[2] = (color >> 16) | (color << 8);
+			p32 += 3;
+		}
+		p = (uint8_t *)p32;
+		while (count--) {
+			_put_pixel(p, color, 24);
+			p += 3;
+		}
+		break;
+	case 32:
+		_fill_words((uint32_t *)p, color, count);
+		break;
+	}
+}
+
+static bool _use_dma(uint32_t row_bytes, uint16_t rows)
+{
+	return _dma.channel && row_bytes * rows >= _dma.threshold;
+}
+
+/**
+ * \brief Run a scatter-gather transfer on the gfx2d DMA channel and wait
+ * for its completion.
+ * \return 0 on success, or the DMA driver error code.
+ */
+static int _dma_run(struct _dma_cfg *cfg, struct _dma_transfer_cfg *list,
+		uint8_t count)
+{
+	int err;
+
+	err = dma_configure_transfer(_dma.channel, cfg, list, count);
+	if (err < 0)
+		return err;
+	err = dma_start_transfer(_dma.channel);
+	if (err < 0)
+		return err;
+	while (!dma_is_transfer_done(_dma.channel))
+		dma_poll();
+	dma_reset_channel(_dma.channel);
+	return 0;
+}
+
+/**
+ * \brief Copy rows with the DMA, GFX2D_DMA_ROWS descriptors per
+ * scatter-gather transfer. Rows longer than the DMA maximum block size are
+ * split over several descriptors. A src_stride of 0 replicates the same
+ * source row.
+ * \return 0 on success, or the DMA driver error code.
+ */
+static int _dma_copy_rows(uint8_t *dst, uint32_t dst_stride,
+		const uint8_t *src, uint32_t src_stride,
+		uint32_t row_bytes, uint16_t rows)
+{
+	struct _dma_transfer_cfg list[GFX2D_DMA_ROWS];
+	struct _dma_cfg cfg_dma = {
+		.incr_saddr = true,
+		.incr_daddr = true,
+		.chunk_size = DMA_CHUNK_SIZE_1,
+		.loop = false,
+	};
+	uint32_t src_len = src_stride * (rows - 1) + row_bytes;
+	uint32_t dst_len = dst_stride * (rows - 1) + row_bytes;
+	uint8_t *dst_start = dst;
+	uint32_t width, max_bytes, offset, chunk;
+	uint8_t count = 0;
+	int err = 0;
+
+	/* Contiguous rows are copied as one block */
+	if (dst_stride == row_bytes && src_stride == row_bytes) {
+		row_bytes *= rows;
+		rows = 1;
+	}
+
+	if ((((uint32_t)dst | (uint32_t)src | dst_stride | src_stride | row_bytes) & 3) == 0)
+		width = DMA_DATA_WIDTH_WORD;
+	else
+		width = DMA_DATA_WIDTH_BYTE;
+	cfg_dma.data_width = width;
+	max_bytes = DMA_MAX_BT_SIZE << width;
+
+	cache_clean_region(src, src_len);
+	cache_clean_region(dst, dst_len);
+
+	while (rows--) {
+		for (offset = 0; offset < row_bytes; offset += chunk) {
+			chunk = row_bytes - offset;
+			if (chunk > max_bytes)
+				chunk = max_bytes;
+			list[count].saddr = src + offset;
+			list[count].daddr = dst + offset;
+			list[count].len = chunk >> width;
+			if (++count == GFX2D_DMA_ROWS) {
+				err = _dma_run(&cfg_dma, list, count);
+				if (err < 0)
+					goto exit;
+				count = 0;
+			}
+		}
+		src += src_stride;
+		dst += dst_stride;
+	}
+	if (count)
+		err = _dma_run(&cfg_dma, list, count);
+
+exit:
+	/* Drop the stale lines of the destination */
+	cache_invalidate_region(dst_start, dst_len);
+	return err;
+}
+
+static uint8_t _blend(uint8_t s, uint8_t d, uint32_t a)
+{
+	uint32_t t = s * a + d * (255 - a) + 128;
+	return (t + (t >> 8)) >> 8;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+int gfx2d_init_surface(struct _gfx2d_surface *surface, void *buffer,
+		uint16_t width, uint16_t height, uint8_t bpp)
+{
+	if (!buffer || (bpp != 16 && bpp != 24 && bpp != 32))
+		return -EINVAL;
+
+	surface->buffer = buffer;
+	surface->width = width;
+	surface->height = height;
+	surface->bpp = bpp;
+	/* 4-byte aligned rows */
+	surface->stride = ((uint32_t)width * (bpp / 8) + 3) & ~3u;
+	surface->dirty_count = 0;
+
+	return 0;
+}
+
+int gfx2d_init_canvas_surface(struct _gfx2d_surface *surface)
+{
+	struct _lcdc_layer *canvas = lcdc_get_canvas();
+
+	return gfx2d_init_surface(surface, canvas->buffer,
+			canvas->width, canvas->height, canvas->bpp);
+}
+
+void gfx2d_fill_rect(struct _gfx2d_surface *surface,
+		uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint32_t color)
+{
+	uint32_t row_bytes;
+	uint8_t *p;
+	uint16_t i;
+
+	if (!_clip(surface, x, y, &w, &h))
+		return;
+
+	p = _pixel(surface, x, y);
+	row_bytes = w * (surface->bpp / 8);
+
+	_fill_row(p, w, color, surface->bpp);
+	if (h > 1 && _use_dma(row_bytes, h - 1) &&
+	    _dma_copy_rows(p + surface->stride, surface->stride,
+			   p, 0, row_bytes, h - 1) == 0) {
+		_stats.dma_ops++;
+	} else {
+		for (i = 1; i < h; i++)
+			_fill_row(p + i * surface->stride, w, color, surface->bpp);
+		_stats.cpu_ops++;
+	}
+
+	_add_dirty(surface, x, y, w, h);
+}
+
+int gfx2d_blit(struct _gfx2d_surface *dst, uint16_t dx, uint16_t dy,
+		const struct _gfx2d_surface *src, uint16_t sx, uint16_t sy,
+		uint16_t w, uint16_t h)
+{
+	const uint8_t *s;
+	uint8_t *d;
+	uint32_t row_bytes;
+	uint16_t i;
+
+	if (dst->bpp != src->bpp)
+		return -EINVAL;
+	if (!_clip_blit(dst, dx, dy, src, sx, sy, &w, &h))
+		return 0;
+
+	s = _pixel(src, sx, sy);
+	d = _pixel(dst, dx, dy);
+	row_bytes = w * (dst->bpp / 8);
+
+	if (src->buffer == dst->buffer) {
+		/* Same surface: walk rows so that overlapping areas are
+		 * read before being overwritten */
+		if (dy > sy) {
+			for (i = h; i > 0; i--)
+				memmove(d + (i - 1) * dst->stride,
+					s + (i - 1) * src->stride, row_bytes);
+		} else {
+			for (i = 0; i < h; i++)
+				memmove(d + i * dst->stride,
+					s + i * src->stride, row_bytes);
+		}
+		_stats.cpu_ops++;
+	} else if (_use_dma(row_bytes, h) &&
+		   _dma_copy_rows(d, dst->stride, s, src->stride,
+				  row_bytes, h) == 0) {
+		_stats.dma_ops++;
+	} else {
+		for (i = 0; i < h; i++)
+			memcpy(d + i * dst->stride, s + i * src->stride, row_bytes);
+		_stats.cpu_ops++;
+	}
+
+	_add_dirty(dst, dx, dy, w, h);
+	return 0;
+}
+
+int gfx2d_blit_colorkey(struct _gfx2d_surface *dst, uint16_t dx, uint16_t dy,
+		const struct _gfx2d_surface *src, uint16_t sx, uint16_t sy,
+		uint16_t w, uint16_t h, uint32_t key)
+{
+	uint8_t cw = dst->bpp / 8;
+	uint32_t mask = dst->bpp == 32 ? 0xffffffff : (1u << dst->bpp) - 1;
+	uint16_t i, j;
+
+	if (dst->bpp != src->bpp)
+		return -EINVAL;
+	if (!_clip_blit(dst, dx, dy, src, sx, sy, &w, &h))
+		return 0;
+
+	key &= mask;
+	for (j = 0; j < h; j++) {
+		const uint8_t *s = _pixel(src, sx, sy + j);
+		uint8_t *d = _pixel(dst, dx, dy + j);
+		for (i = 0; i < w; i++, s += cw, d += cw) {
+			uint32_t color = _get_pixel(s, dst->bpp);
+			if (color != key)
+				_put_pixel(d, color, dst->bpp);
+		}
+	}
+	_stats.cpu_ops++;
+
+	_add_dirty(dst, dx, dy, w, h);
+	return 0;
+}
+
+int gfx2d_blit_alpha(struct _gfx2d_surface *dst, uint16_t dx, uint16_t dy,
+		const struct _gfx2d_surface *src, uint16_t sx, uint16_t sy,
+		uint16_t w, uint16_t h, uint8_t alpha)
+{
+	uint8_t cw = dst->bpp / 8;
+	uint16_t i, j;
+
+	if (src->bpp != 32 || (dst->bpp != 24 && dst->bpp != 32))
+		return -ENOTSUP;
+	if (!_clip_blit(dst, dx, dy, src, sx, sy, &w, &h))
+		return 0;
+
+	for (j = 0; j < h; j++) {
+		const uint32_t *s = (const uint32_t *)_pixel(src, sx, sy + j);
+		uint8_t *d = _pixel(dst, dx, dy + j);
+		for (i = 0; i < w; i++, d += cw) {
+			uint32_t color = *s++;
+			uint32_t a = (color >> 24) * alpha;
+
+			/* a / 255, exact for 0 and 255 * 255 */
+			a = (a + 1 + (a >> 8)) >> 8;
+			if (a == 0)
+				continue;
+			if (a == 255) {
+				_put_pixel(d, color, dst->bpp);
+				continue;
+			}
+			d[0] = _blend(color, d[0], a);
+			d[1] = _blend(color >> 8, d[1], a);
+			d[2] = _blend(color >> 16, d[2], a);
+			if (cw == 4)
+				d[3] = a + (d[3] * (255 - a) + 127) / 255;
+		}
+	}
+	_stats.cpu_ops++;
+
+	_add_dirty(dst, dx, dy, w, h);
+	return 0;
+}
+
+void gfx2d_draw_glyph(struct _gfx2d_surface *surface, uint16_t x, uint16_t y,
+		const uint8_t *bitmap, uint16_t w, uint16_t h,
+		uint32_t fg, uint32_t bg, bool transparent)
+{
+	uint16_t pitch = (w + 7) / 8;
+	uint8_t cw = surface->bpp / 8;
+	uint16_t i, j, run;
+	bool bit, run_bit;
+
+	if (!_clip(surface, x, y, &w, &h))
+		return;
+
+	for (j = 0; j < h; j++) {
+		const uint8_t *row = &bitmap[j * pitch];
+		uint8_t *p = _pixel(surface, x, y + j);
+
+		/* Draw runs of identical bits with word fills */
+		run = 0;
+		run_bit = row[0] & 0x80;
+		for (i = 0; i <= w; i++) {
+			bit = i < w ? (row[i / 8] >> (7 - (i & 7))) & 1 : !run_bit;
+			if (bit == run_bit) {
+				run++;
+				continue;
+			}
+			if (run_bit)
+				_fill_row(p, run, fg, surface->bpp);
+			else if (!transparent)
+				_fill_row(p, run, bg, surface->bpp);
+			p += run * cw;
+			run = 1;
+			run_bit = bit;
+		}
+	}
+	_stats.cpu_ops++;
+
+	_add_dirty(surface, x, y, w, h);
+}
+
+void gfx2d_mark_dirty(struct _gfx2d_surface *surface,
+		uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+	if (_clip(surface, x, y, &w, &h))
+		_add_dirty(surface, x, y, w, h);
+}
+
+void gfx2d_flush(struct _gfx2d_surface *surface)
+{
+	const struct _gfx2d_rect *r;
+	uint32_t row_bytes;
+	uint8_t i;
+	uint16_t j;
+
+	if (!surface->dirty_count)
+		return;
+
+	for (i = 0; i < surface->dirty_count; i++) {
+		r = &surface->dirty[i];
+		row_bytes = r->w * (surface->bpp / 8);
+		if (row_bytes * 2 < surface->stride) {
+			/* Narrow rectangle: skip the untouched part of rows */
+			for (j = 0; j < r->h; j++)
+				cache_clean_region(_pixel(surface, r->x, r->y + j),
+						   row_bytes);
+			_stats.flushed_bytes += row_bytes * r->h;
+		} else {
+			cache_clean_region(_pixel(surface, r->x, r->y),
+				surface->stride * (r->h - 1) + row_bytes);
+			_stats.flushed_bytes += surface->stride * (r->h - 1) + row_bytes;
+		}
+	}
+	surface->dirty_count = 0;
+	_stats.flushes++;
+}
+
+int gfx2d_enable_dma(bool enable, uint32_t threshold)
+{
+	if (!enable) {
+		if (_dma.channel) {
+			dma_free_channel(_dma.channel);
+			_dma.channel = NULL;
+		}
+		return 0;
+	}
+
+	if (!_dma.channel) {
+		_dma.channel = dma_allocate_channel(DMA_PERIPH_MEMORY,
+						    DMA_PERIPH_MEMORY);
+		if (!_dma.channel)
+			return -EBUSY;
+	}
+	_dma.threshold = threshold ? threshold : GFX2D_DMA_THRESHOLD;
+
+	return 0;
+}
+
+void gfx2d_get_stats(struct _gfx2d_stats *stats)
+{
+	*stats = _stats;
+}
+
+/**@}*/
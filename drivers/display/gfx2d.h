@@ -0,0 +1,212 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file */
+
+/**
+ * \ingroup drivers/display
+ * \addtogroup gfx2d_module 2D Graphics
+ *
+ * \section Purpose
+ *
+ * Rectangle fill, blit and glyph rendering on a memory surface (a LCDC
+ * layer or any software framebuffer).
+ *
+ * \section Usage
+ *
+ * -# Wrap a buffer with gfx2d_init_surface() or the current LCDC canvas
+ *    with gfx2d_init_canvas_surface().
+ * -# Draw with gfx2d_fill_rect(), gfx2d_blit(), gfx2d_blit_colorkey(),
+ *    gfx2d_blit_alpha() and gfx2d_draw_glyph(). Each operation is clipped
+ *    to the surface and records the touched rectangle.
+ * -# Call gfx2d_flush() to clean from the data cache only the rectangles
+ *    modified since the previous flush.
+ * -# Optionally call gfx2d_enable_dma() so that large copies and fills are
+ *    done by the DMA controller, one descriptor per row (rows longer
+ *    than the DMA maximum block size use several descriptors).
+ */
+
+#ifndef GFX2D_H_
+#define GFX2D_H_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Number of dirty rectangles tracked per surface before they get merged */
+#ifndef GFX2D_MAX_DIRTY
+#define GFX2D_MAX_DIRTY (8)
+#endif
+
+/** Default minimum rectangle size (bytes) handled by the DMA */
+#define GFX2D_DMA_THRESHOLD (8192)
+
+/** Descriptors (rows or row chunks) programmed per DMA scatter-gather transfer */
+#define GFX2D_DMA_ROWS (16)
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** \brief Rectangle, in pixels */
+struct _gfx2d_rect {
+	uint16_t x;
+	uint16_t y;
+	uint16_t w;
+	uint16_t h;
+};
+
+/** \brief Drawing surface */
+struct _gfx2d_surface {
+	uint8_t *buffer;    /**< First pixel of the surface */
+	uint16_t width;     /**< Width in pixels */
+	uint16_t height;    /**< Height in pixels */
+	uint32_t stride;    /**< Bytes between two rows */
+	uint8_t  bpp;       /**< Bits per pixel (16, 24 or 32) */
+	uint8_t  dirty_count;
+	struct _gfx2d_rect dirty[GFX2D_MAX_DIRTY];
+};
+
+/** \brief Operation counters */
+struct _gfx2d_stats {
+	uint32_t cpu_ops;       /**< Operations done by the CPU */
+	uint32_t dma_ops;       /**< Operations done by the DMA */
+	uint32_t flushes;       /**< Calls to gfx2d_flush() with dirty areas */
+	uint32_t flushed_bytes; /**< Bytes cleaned from the data cache */
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize a surface on a memory buffer.
+ * Rows are 4-byte aligned, as for the LCDC layers.
+ * \param surface Surface to initialize.
+ * \param buffer  Pixel buffer.
+ * \param width   Width in pixels.
+ * \param height  Height in pixels.
+ * \param bpp     Bits per pixel (16, 24 or 32).
+ * \return 0 on success, -EINVAL for unsupported parameters.
+ */
+extern int gfx2d_init_surface(struct _gfx2d_surface *surface, void *buffer,
+		uint16_t width, uint16_t height, uint8_t bpp);
+
+/**
+ * \brief Initialize a surface on the current LCDC canvas.
+ * \param surface Surface to initialize.
+ * \return 0 on success, -EINVAL if no canvas is selected.
+ */
+extern int gfx2d_init_canvas_surface(struct _gfx2d_surface *surface);
+
+/**
+ * \brief Fill a rectangle with a color.
+ * \param surface Target surface.
+ * \param x, y    Top left corner.
+ * \param w, h    Size of the rectangle.
+ * \param color   Color, in the surface pixel format.
+ */
+extern void gfx2d_fill_rect(struct _gfx2d_surface *surface,
+		uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint32_t color);
+
+/**
+ * \brief Copy a rectangle between surfaces of the same pixel format.
+ * Source and destination may be the same surface and overlap.
+ * \return 0 on success, -EINVAL if the formats differ.
+ */
+extern int gfx2d_blit(struct _gfx2d_surface *dst, uint16_t dx, uint16_t dy,
+		const struct _gfx2d_surface *src, uint16_t sx, uint16_t sy,
+		uint16_t w, uint16_t h);
+
+/**
+ * \brief Copy a rectangle, skipping the source pixels equal to key.
+ * \return 0 on success, -EINVAL if the formats differ.
+ */
+extern int gfx2d_blit_colorkey(struct _gfx2d_surface *dst, uint16_t dx, uint16_t dy,
+		const struct _gfx2d_surface *src, uint16_t sx, uint16_t sy,
+		uint16_t w, uint16_t h, uint32_t key);
+
+/**
+ * \brief Blend an ARGB8888 source rectangle onto a RGB888/ARGB8888 surface.
+ * The per-pixel alpha of the source is scaled by the global alpha.
+ * \param alpha Global alpha (0: transparent, 255: source alpha only).
+ * \return 0 on success, -ENOTSUP for unsupported formats.
+ */
+extern int gfx2d_blit_alpha(struct _gfx2d_surface *dst, uint16_t dx, uint16_t dy,
+		const struct _gfx2d_surface *src, uint16_t sx, uint16_t sy,
+		uint16_t w, uint16_t h, uint8_t alpha);
+
+/**
+ * \brief Draw a 1 bpp glyph.
+ * Glyph rows are (width + 7) / 8 bytes long, most significant bit first.
+ * \param surface     Target surface.
+ * \param x, y        Top left corner.
+ * \param bitmap      Glyph bitmap.
+ * \param w, h        Glyph size in pixels.
+ * \param fg          Color of the set bits.
+ * \param bg          Color of the cleared bits.
+ * \param transparent If true, cleared bits are not drawn.
+ */
+extern void gfx2d_draw_glyph(struct _gfx2d_surface *surface, uint16_t x, uint16_t y,
+		const uint8_t *bitmap, uint16_t w, uint16_t h,
+		uint32_t fg, uint32_t bg, bool transparent);
+
+/**
+ * \brief Record a modified rectangle, for drawing done outside gfx2d.
+ */
+extern void gfx2d_mark_dirty(struct _gfx2d_surface *surface,
+		uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+/**
+ * \brief Clean the dirty rectangles of a surface from the data cache
+ * and clear the dirty list.
+ */
+extern void gfx2d_flush(struct _gfx2d_surface *surface);
+
+/**
+ * \brief Use the DMA for copies and fills of at least threshold bytes.
+ * \param enable    Allocate (true) or release (false) the DMA channel.
+ * \param threshold Minimum rectangle size in bytes, 0 for default.
+ * \return 0 on success, -EBUSY if no DMA channel is available.
+ */
+extern int gfx2d_enable_dma(bool enable, uint32_t threshold);
+
+/**
+ * \brief Get the operation counters.
+ */
+extern void gfx2d_get_stats(struct _gfx2d_stats *stats);
+
+#endif /* GFX2D_H_ */
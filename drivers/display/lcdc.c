@@ -40,7 +40,9 @@
 #include "chip.h"
 #include "compiler.h"
 #include "display/lcdc.h"
+#include "errno.h"
 #include "gpio/pio.h"
+#include "irq/irq.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
 #include "trace.h"
@@ -90,6 +92,27 @@ struct _layer_data {
 	uint8_t                bpp;
 };
 
+/** Swap chain buffer states */
+enum _swap_state {
+	SWAP_BUFFER_FREE = 0, /**< Available to lcdc_swap_chain_acquire() */
+	SWAP_BUFFER_ACQUIRED, /**< Being rendered */
+	SWAP_BUFFER_QUEUED,   /**< Presented, waiting for a frame boundary */
+	SWAP_BUFFER_FRONT,    /**< Scanned out */
+};
+
+/** Swap chain attached to a layer */
+struct _swap_chain {
+	void                  *buffers[LCDC_SWAP_CHAIN_MAX_BUFFERS];
+	volatile uint8_t       state[LCDC_SWAP_CHAIN_MAX_BUFFERS];
+	uint8_t                count;
+	volatile int8_t        front;    /**< Scanned out buffer */
+	volatile int8_t        flipping; /**< Added to the DMA queue, not loaded */
+	volatile int8_t        pending;  /**< Presented during a flip */
+	uint32_t               offset;   /**< Start offset of the DMA in buffers */
+	struct _callback       callback;
+	struct _lcdc_swap_stats stats;
+};
+
 /*----------------------------------------------------------------------------
  *        Local variables
  *----------------------------------------------------------------------------*/
@@ -232,6 +255,12 @@ static const struct _layer_info lcdc_layers[] = {
 #endif
 };
 
+/** Swap chains, indexed by layer ID */
+static struct _swap_chain swap_chains[ARRAY_SIZE(lcdc_layers)];
+
+CACHE_ALIGNED_DDR
+static struct _lcdc_dma_desc swap_dma_desc[ARRAY_SIZE(lcdc_layers)][LCDC_SWAP_CHAIN_MAX_BUFFERS];
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -1881,4 +1910,286 @@ uint32_t lcdc_configure_get_mode(uint8_t layer_id)
 	return layer->reg_cfg[1];
 }
 
+/**
+ * Get the LCDC_LCDIER bit of a layer, 0 if swap chains are not supported
+ */
+static uint32_t _swap_chain_irq_mask(uint8_t layer_id)
+{
+	switch (layer_id) {
+	case LCDC_BASE:
+		return LCDC_LCDIER_BASEIE;
+#ifdef CONFIG_HAVE_LCDC_OVR1
+	case LCDC_OVR1:
+		return LCDC_LCDIER_OVR1IE;
+#endif
+	case LCDC_HEO:
+		return LCDC_LCDIER_HEOIE;
+#ifdef CONFIG_HAVE_LCDC_OVR2
+	case LCDC_OVR2:
+		return LCDC_LCDIER_OVR2IE;
+#endif
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Add the descriptor of a swap chain buffer to the layer DMA queue.
+ * The LCDC loads it at the end of the current frame and raises the ADD
+ * interrupt.
+ */
+static void _swap_chain_flip(uint8_t layer_id, uint8_t index)
+{
+	const struct _layer_info *layer = &lcdc_layers[layer_id];
+	struct _swap_chain *chain = &swap_chains[layer_id];
+	struct _lcdc_dma_desc *desc = &swap_dma_desc[layer_id][index];
+
+	desc->addr = (uint32_t)chain->buffers[index] + chain->offset;
+	desc->ctrl = LCDC_BASECTRL_DFETCH | LCDC_BASECTRL_ADDIEN;
+	desc->next = (uint32_t)desc;
+	cache_clean_region(desc, sizeof(*desc));
+
+	chain->state[index] = SWAP_BUFFER_QUEUED;
+	chain->flipping = index;
+	layer->reg_dma_head[0] = (uint32_t)desc;
+	layer->reg_enable[0] = LCDC_BASECHER_A2QEN;
+}
+
+/**
+ * Release a swap chain buffer and notify the renderer
+ */
+static void _swap_chain_release(struct _swap_chain *chain, uint8_t index)
+{
+	chain->state[index] = SWAP_BUFFER_FREE;
+	callback_call(&chain->callback, (void *)(uint32_t)index);
+}
+
+static void _lcdc_irq_handler(uint32_t source, void *user_arg)
+{
+	uint32_t status = LCDC->LCDC_LCDISR & LCDC->LCDC_LCDIMR;
+	struct _swap_chain *chain;
+	uint8_t layer_id, i;
+	bool rendering;
+
+	for (layer_id = 0; layer_id < ARRAY_SIZE(swap_chains); layer_id++) {
+		chain = &swap_chains[layer_id];
+		if (!chain->count)
+			continue;
+
+		if (status & _swap_chain_irq_mask(layer_id)) {
+			/* Reading the layer status clears it */
+			if ((lcdc_layers[layer_id].reg_enable[6] & LCDC_BASEISR_ADD) &&
+			    chain->flipping >= 0) {
+				int8_t old = chain->front;
+
+				chain->front = chain->flipping;
+				chain->flipping = -1;
+				chain->state[chain->front] = SWAP_BUFFER_FRONT;
+				lcdc_layers[layer_id].data->buffer = chain->buffers[chain->front];
+				chain->stats.flips++;
+
+				if (chain->pending >= 0) {
+					_swap_chain_flip(layer_id, chain->pending);
+					chain->pending = -1;
+				}
+				if (old >= 0)
+					_swap_chain_release(chain, old);
+			}
+		}
+
+		if (status & LCDC_LCDISR_SOF) {
+			chain->stats.frames++;
+			if (chain->flipping < 0) {
+				rendering = false;
+				for (i = 0; i < chain->count; i++)
+					if (chain->state[i] == SWAP_BUFFER_ACQUIRED)
+						rendering = true;
+				/* The renderer did not deliver in time, the
+				 * front buffer is shown once more */
+				if (rendering)
+					chain->stats.missed++;
+			}
+		}
+	}
+}
+
+/**
+ * \brief Attach a swap chain to a displayed layer.
+ * The layer must already show buffers[0] (through lcdc_put_image() or
+ * lcdc_create_canvas() for instance). All buffers must have the same
+ * format, the DMA start offset used for buffers[0] (mirroring, rotation)
+ * is applied to the other buffers.
+ * \param layer_id Layer ID (base, overlays or HEO with a RGB format).
+ * \param buffers  Frame buffers, buffers[0] being the front buffer.
+ * \param count    Number of buffers (2 to LCDC_SWAP_CHAIN_MAX_BUFFERS).
+ * \param cb       Callback called from the LCDC interrupt when a buffer
+ *                 is released, with the buffer index as second argument.
+ *                 May be NULL.
+ * \return 0 on success, -EINVAL for invalid parameters or if the layer is
+ * not displaying buffers[0].
+ */
+int lcdc_swap_chain_create(uint8_t layer_id, void **buffers, uint8_t count,
+		struct _callback *cb)
+{
+	const struct _layer_info *layer;
+	struct _swap_chain *chain;
+	uint32_t irq_mask;
+	uint8_t i;
+
+	irq_mask = _swap_chain_irq_mask(layer_id);
+	if (!irq_mask || count < 2 || count > LCDC_SWAP_CHAIN_MAX_BUFFERS)
+		return -EINVAL;
+
+	layer = &lcdc_layers[layer_id];
+	if (!lcdc_is_layer_on(layer_id) || layer->data->buffer != buffers[0])
+		return -EINVAL;
+#ifdef LCDC_HEOCFG1_YUVEN
+	if (layer->reg_cfg[1] & LCDC_HEOCFG1_YUVEN)
+		return -EINVAL;
+#endif
+
+	irq_disable(ID_LCDC);
+
+	chain = &swap_chains[layer_id];
+	memset(chain, 0, sizeof(*chain));
+	for (i = 0; i < count; i++) {
+		chain->buffers[i] = buffers[i];
+		chain->state[i] = SWAP_BUFFER_FREE;
+	}
+	chain->state[0] = SWAP_BUFFER_FRONT;
+	chain->front = 0;
+	chain->flipping = -1;
+	chain->pending = -1;
+	chain->offset = layer->data->dma_desc->addr - (uint32_t)buffers[0];
+	if (cb)
+		callback_copy(&chain->callback, cb);
+	chain->count = count;
+
+	layer->reg_enable[3] = LCDC_BASEIER_ADD;
+	LCDC->LCDC_LCDIER = irq_mask | LCDC_LCDIER_SOFIE;
+
+	irq_add_handler(ID_LCDC, _lcdc_irq_handler, NULL);
+	irq_enable(ID_LCDC);
+
+	return 0;
+}
+
+/**
+ * \brief Detach the swap chain of a layer.
+ * The front buffer stays displayed. A flip in progress completes without
+ * notification.
+ * \param layer_id Layer ID.
+ */
+void lcdc_swap_chain_destroy(uint8_t layer_id)
+{
+	uint32_t irq_mask = _swap_chain_irq_mask(layer_id);
+	bool active = false;
+	uint8_t i;
+
+	if (!irq_mask || !swap_chains[layer_id].count)
+		return;
+
+	irq_disable(ID_LCDC);
+
+	lcdc_layers[layer_id].reg_enable[4] = LCDC_BASEIDR_ADD;
+	LCDC->LCDC_LCDIDR = irq_mask;
+	swap_chains[layer_id].count = 0;
+
+	for (i = 0; i < ARRAY_SIZE(swap_chains); i++)
+		if (swap_chains[i].count)
+			active = true;
+	if (active) {
+		irq_enable(ID_LCDC);
+	} else {
+		LCDC->LCDC_LCDIDR = LCDC_LCDIDR_SOFID;
+		irq_remove_handler(ID_LCDC, _lcdc_irq_handler);
+	}
+}
+
+/**
+ * \brief Get a buffer to render into.
+ * \param layer_id Layer ID.
+ * \return Buffer index, or -EBUSY if all buffers are in use.
+ */
+int lcdc_swap_chain_acquire(uint8_t layer_id)
+{
+	struct _swap_chain *chain = &swap_chains[layer_id];
+	int index = -EBUSY;
+	uint8_t i;
+
+	if (!_swap_chain_irq_mask(layer_id) || !chain->count)
+		return -EINVAL;
+
+	irq_disable(ID_LCDC);
+	for (i = 0; i < chain->count; i++) {
+		if (chain->state[i] == SWAP_BUFFER_FREE) {
+			chain->state[i] = SWAP_BUFFER_ACQUIRED;
+			index = i;
+			break;
+		}
+	}
+	irq_enable(ID_LCDC);
+
+	return index;
+}
+
+/**
+ * \brief Queue a rendered buffer for display.
+ * The buffer is shown from the next frame boundary. If another buffer is
+ * already waiting for a flip, the older one is dropped and released.
+ * \note The rendered area must have been cleaned from the data cache
+ * (see gfx2d_flush()).
+ * \param layer_id Layer ID.
+ * \param index    Buffer index returned by lcdc_swap_chain_acquire().
+ * \return 0 on success, -EINVAL if the buffer was not acquired.
+ */
+int lcdc_swap_chain_present(uint8_t layer_id, uint8_t index)
+{
+	struct _swap_chain *chain = &swap_chains[layer_id];
+	int8_t dropped = -1;
+
+	if (!_swap_chain_irq_mask(layer_id) || index >= chain->count)
+		return -EINVAL;
+
+	irq_disable(ID_LCDC);
+
+	if (chain->state[index] != SWAP_BUFFER_ACQUIRED) {
+		irq_enable(ID_LCDC);
+		return -EINVAL;
+	}
+	chain->stats.presents++;
+
+	if (chain->flipping < 0) {
+		_swap_chain_flip(layer_id, index);
+	} else {
+		/* A flip is in progress, apply this one on its completion */
+		if (chain->pending >= 0) {
+			dropped = chain->pending;
+			chain->state[dropped] = SWAP_BUFFER_FREE;
+			chain->stats.dropped++;
+		}
+		chain->state[index] = SWAP_BUFFER_QUEUED;
+		chain->pending = index;
+	}
+
+	irq_enable(ID_LCDC);
+
+	if (dropped >= 0)
+		callback_call(&chain->callback, (void *)(uint32_t)dropped);
+
+	return 0;
+}
+
+/**
+ * \brief Get the swap chain counters of a layer.
+ * \param layer_id Layer ID.
+ * \param stats    Filled with the counters.
+ */
+void lcdc_swap_chain_get_stats(uint8_t layer_id, struct _lcdc_swap_stats *stats)
+{
+	irq_disable(ID_LCDC);
+	*stats = swap_chains[layer_id].stats;
+	irq_enable(ID_LCDC);
+}
+
 /**@}*/
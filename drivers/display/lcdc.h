@@ -63,6 +63,12 @@
  *                            drawing on
  *    -# lcdc_select_canvas(): Select a displayer as canvas to drawing on
  *    -# lcdc_get_canvas():    Get current selected canvas layer
+ * -# Tear-free page flipping on a displayed layer:
+ *    -# lcdc_swap_chain_create(): Attach N buffers to the layer
+ *    -# lcdc_swap_chain_acquire(): Get a buffer that is not scanned out
+ *    -# lcdc_swap_chain_present(): Queue it, it is shown at the next frame
+ *       boundary and the previous front buffer is released through the
+ *       callback
  *
  * For LCD drawing functions, refer to \ref lcdc_draw.
  *
@@ -118,6 +124,11 @@ enum {
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "callback.h"
+
+/** Maximum number of buffers in a layer swap chain */
+#define LCDC_SWAP_CHAIN_MAX_BUFFERS (3)
+
 /*----------------------------------------------------------------------------
  *        Types
  *----------------------------------------------------------------------------*/
@@ -145,6 +156,15 @@ struct _lcdc_desc {
 	uint8_t timing_hpw; /**< Horizontal pulse width in LCDDOTCLK cycles */
 };
 
+/** Swap chain counters */
+struct _lcdc_swap_stats {
+	uint32_t frames;   /**< Start of frame events */
+	uint32_t presents; /**< Buffers presented */
+	uint32_t flips;    /**< Buffers put on screen */
+	uint32_t dropped;  /**< Presented buffers replaced before being shown */
+	uint32_t missed;   /**< Frames repeated while a buffer was rendered */
+};
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -231,6 +251,19 @@ extern void *lcdc_create_canvas_yuv_planar(uint8_t layer,
 extern void *lcdc_create_canvas_yuv_semiplanar(uint8_t layer,
 		void *buffer_y, void *buffer_uv, uint8_t bpp,
 		uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+extern int lcdc_swap_chain_create(uint8_t layer, void **buffers, uint8_t count,
+		struct _callback *cb);
+
+extern void lcdc_swap_chain_destroy(uint8_t layer);
+
+extern int lcdc_swap_chain_acquire(uint8_t layer);
+
+extern int lcdc_swap_chain_present(uint8_t layer, uint8_t index);
+
+extern void lcdc_swap_chain_get_stats(uint8_t layer,
+		struct _lcdc_swap_stats *stats);
+
 #ifdef CONFIG_HAVE_LCDC_PP
 extern void lcdc_configure_pp(void *buffer, uint32_t output_mode);
 #endif
@@ -46,9 +46,9 @@
 #include "compiler.h"
 #include "dma/dma.h"
 #include "irq/irq.h"
+#include "irqflags.h"
 #include "errno.h"
 #include "mm/cache.h"
-#include "mutex.h"
 #include "peripherals/pmc.h"
 
 /*----------------------------------------------------------------------------
@@ -103,30 +103,18 @@ static uint32_t controllers[] = {
  *        Local definitions
  *----------------------------------------------------------------------------*/
 
-/** Types for specifying a transfer of scattered data, or a transfer of
- * contiguous data that may be reconfigured on a block-by-block basis. */
-
-/** Elementary transfer descriptor, AKA linked list item.
- * Allocate the items, but do not access their members. Please use the dedicated
- * functions defined below. */
-struct _dma_sg_desc {
-#ifdef CONFIG_HAVE_XDMAC
-	struct _xdmac_desc_view1 desc;
-#elif defined(CONFIG_HAVE_DMAC)
-	struct _dmac_desc desc;
+#if DMA_SG_ITEM_POOL_SIZE > 64
+#error "DMA_SG_ITEM_POOL_SIZE must not exceed 64"
 #endif
-};
 
+/** Descriptors shared by the channels without a private pool. Lists are
+ * carved as contiguous runs, tracked by one bit per free descriptor. */
 struct _dma_sg_pool {
 	struct _dma_sg_desc desc[DMA_SG_ITEM_POOL_SIZE];
-	struct _dma_sg_desc* head;
-	struct _dma_sg_desc* tail;
-
-	uint16_t count; /* Count elements in list  */
-	mutex_t mutex;
+	uint64_t free;
+	struct _dma_sg_stats stats;
 };
 
-
 /** DMA driver instance */
 struct _dma_ctrl {
 	struct _dma_controller controllers[DMA_CONTROLLERS];
@@ -156,88 +144,113 @@ static inline bool is_dest_periph(struct _dma_channel* channel)
 	return ((channel->dest_txif != 0xff) | (channel->dest_rxif != 0xff));
 }
 
+static inline uint64_t _dma_sg_mask(uint8_t count)
+{
+	return count >= 64 ? ~0ull : ((1ull << count) - 1);
+}
+
 /**
- * \brief Preinitialize all descriptors and pool and link them together
+ * \brief Mark all descriptors of the shared pool as free
  */
 static void _dma_sg_init(void)
 {
-	uint32_t i;
-
 	memset(&_dma_sg_pool, 0, sizeof(_dma_sg_pool));
+	_dma_sg_pool.free = _dma_sg_mask(DMA_SG_ITEM_POOL_SIZE);
+}
 
-	mutex_lock(&_dma_sg_pool.mutex);
+/**
+ * \brief Find the first run of count free descriptors in the pool bitmap.
+ * Each step ANDs the bitmap with a shifted copy of itself, doubling the
+ * length of the runs it describes, so the search takes log2(count) steps.
+ * \return index of the first descriptor of the run, or -1
+ */
+static int _dma_sg_find_run(uint64_t free, uint8_t count)
+{
+	uint8_t len = 1;
+	uint32_t word;
 
-	for (i = 0; i < ARRAY_SIZE(_dma_sg_pool.desc); i++)
-		DMA_SG_DESC_SET_NEXT(&_dma_sg_pool.desc[i], &_dma_sg_pool.desc[i + 1]);
-	DMA_SG_DESC_SET_NEXT(&_dma_sg_pool.desc[i - 1], 0);
+	while (len < count && free) {
+		uint8_t shift = (count - len) < len ? (count - len) : len;
+		free &= free >> shift;
+		len += shift;
+	}
 
-	_dma_sg_pool.head = _dma_sg_pool.desc;
-	_dma_sg_pool.tail = &_dma_sg_pool.desc[i - 1];
-	_dma_sg_pool.count = ARRAY_SIZE(_dma_sg_pool.desc);
+	word = (uint32_t)free;
+	if (word)
+		return 31 - CLZ(word & -word);
+	word = (uint32_t)(free >> 32);
+	if (word)
+		return 63 - CLZ(word & -word);
+	return -1;
+}
 
-	mutex_unlock(&_dma_sg_pool.mutex);
+static void _dma_sg_stats_alloc(struct _dma_sg_stats* stats, uint8_t count)
+{
+	stats->allocs++;
+	stats->in_use += count;
+	if (stats->in_use > stats->high_water)
+		stats->high_water = stats->in_use;
 }
 
-static struct _dma_sg_desc* _dma_sg_desc_alloc(uint8_t count)
+/**
+ * \brief Get count contiguous descriptors for a channel list.
+ * A channel with a private pool owns it, so no synchronization is needed.
+ * The shared pool is updated with interrupts masked for a few
+ * instructions, which keeps it usable from completion callbacks.
+ */
+static struct _dma_sg_desc* _dma_sg_desc_alloc(struct _dma_channel* channel, uint8_t count)
 {
-	struct _dma_sg_desc* list_head;
-	struct _dma_sg_desc* curr;
-	struct _dma_sg_desc* next;
-	uint8_t i;
+	struct _dma_sg_desc* list_head = NULL;
+	uint32_t flags;
+	int first;
 
 	if (count == 0)
 		return NULL;
-	if (count > _dma_sg_pool.count)
-		return NULL;
-
-	mutex_lock(&_dma_sg_pool.mutex);
 
-	list_head = _dma_sg_pool.head;
-	curr = list_head;
-	for (i = 0; i < (count - 1); i++) {
-		curr = DMA_SG_DESC_GET_NEXT(curr);
+	if (channel->sg_pool) {
+		if (count > channel->sg_pool_size) {
+			channel->sg_stats.exhausted++;
+			return NULL;
+		}
+		_dma_sg_stats_alloc(&channel->sg_stats, count);
+		return channel->sg_pool;
 	}
-		next = DMA_SG_DESC_GET_NEXT(curr);
-	DMA_SG_DESC_SET_NEXT(curr, 0);
-
-	_dma_sg_pool.count -= count;
-	_dma_sg_pool.head = next;
 
-	if (_dma_sg_pool.count == 0) {
-		_dma_sg_pool.head = NULL;
-		_dma_sg_pool.tail = NULL;
+	flags = arch_irq_save();
+	first = count <= DMA_SG_ITEM_POOL_SIZE ? _dma_sg_find_run(_dma_sg_pool.free, count) : -1;
+	if (first >= 0) {
+		_dma_sg_pool.free &= ~(_dma_sg_mask(count) << first);
+		_dma_sg_stats_alloc(&_dma_sg_pool.stats, count);
+		list_head = &_dma_sg_pool.desc[first];
+	} else {
+		_dma_sg_pool.stats.exhausted++;
 	}
-
-	mutex_unlock(&_dma_sg_pool.mutex);
+	arch_irq_restore(flags);
 
 	return list_head;
 }
 
-static void _dma_sg_desc_free(struct _dma_sg_desc* list_head)
+static void _dma_sg_desc_free(struct _dma_channel* channel)
 {
-	struct _dma_sg_desc* curr = list_head;
-	struct _dma_sg_desc* tail;
+	struct _dma_sg_desc* list_head = channel->sg_list;
+	uint8_t count = channel->sg_count;
+	uint32_t flags;
 
 	if (list_head == NULL)
 		return;
 
-	do {
-		tail = curr;
-		curr = DMA_SG_DESC_GET_NEXT(curr);
-	} while ((curr != NULL) && (curr != list_head));
-	curr = list_head;
-
-	mutex_lock(&_dma_sg_pool.mutex);
-
-	if (_dma_sg_pool.head == NULL)
-		_dma_sg_pool.head = list_head;
+	channel->sg_list = NULL;
+	channel->sg_count = 0;
 
-	if (_dma_sg_pool.tail != NULL)
-		DMA_SG_DESC_SET_NEXT(_dma_sg_pool.tail, list_head);
-	_dma_sg_pool.tail = tail;
-	DMA_SG_DESC_SET_NEXT(_dma_sg_pool.tail, 0);
+	if (list_head == channel->sg_pool) {
+		channel->sg_stats.in_use -= count;
+		return;
+	}
 
-	mutex_unlock(&_dma_sg_pool.mutex);
+	flags = arch_irq_save();
+	_dma_sg_pool.free |= _dma_sg_mask(count) << (list_head - _dma_sg_pool.desc);
+	_dma_sg_pool.stats.in_use -= count;
+	arch_irq_restore(flags);
 }
 
 static int _dma_configure_transfer(struct _dma_channel* channel,
@@ -367,17 +380,33 @@ static int _dma_sg_configure_transfer(struct _dma_channel* channel,
 	src_is_periph = is_source_periph(channel);
 	dst_is_periph = is_dest_periph(channel);
 
-	_sg_head = _dma_sg_desc_alloc(sg_list_size);
-	if (_sg_head == NULL)
-		return -ENOMEM;
-	curr = _sg_head;
-
-	src_is_periph = is_source_periph(channel);
-	dst_is_periph = is_dest_periph(channel);
+	if (channel->sg_list && channel->sg_count >= sg_list_size) {
+		/* Rewrite the current list in place */
+		_sg_head = channel->sg_list;
+		if (channel->sg_pool)
+			channel->sg_stats.reuses++;
+		else
+			_dma_sg_pool.stats.reuses++;
+	} else {
+		_dma_sg_desc_free(channel);
+		_sg_head = _dma_sg_desc_alloc(channel, sg_list_size);
+		if (_sg_head == NULL)
+			return -ENOMEM;
+		channel->sg_list = _sg_head;
+		channel->sg_count = sg_list_size;
+	}
 
 	/* Update linked list */
 	for (idx = 0; idx < sg_list_size; idx++) {
 		cfg = &sg_list[idx];
+		curr = &_sg_head[idx];
+
+		if (idx + 1 < sg_list_size)
+			DMA_SG_DESC_SET_NEXT(curr, curr + 1);
+		else if (cfg_dma->loop)
+			DMA_SG_DESC_SET_NEXT(curr, _sg_head);
+		else
+			DMA_SG_DESC_SET_NEXT(curr, 0);
 
 		DMA_SG_DESC_SET_SADDR(curr, cfg->saddr);
 		DMA_SG_DESC_SET_DADDR(curr, cfg->daddr);
@@ -421,19 +450,15 @@ static int _dma_sg_configure_transfer(struct _dma_channel* channel,
 		curr->desc.ctrlb |= DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM | DMAC_CTRLB_DST_DSCR_FETCH_FROM_MEM;
 
 #endif
-		if (DMA_SG_DESC_GET_NEXT(curr) == 0)
-			if (cfg_dma->loop)
-				DMA_SG_DESC_SET_NEXT(curr, _sg_head);
-		curr = DMA_SG_DESC_GET_NEXT(curr);
 	}
-	channel->sg_list = _sg_head;
 
-	cache_clean_region(_dma_sg_pool.desc, sizeof(_dma_sg_pool.desc));
+	cache_clean_region(_sg_head, sg_list_size * sizeof(*_sg_head));
 
 	/* Update configuration */
 #if defined(CONFIG_HAVE_XDMAC)
 	struct _xdmacd_cfg xdmacd_cfg;
 	uint32_t desc_ctrl;
+	int err;
 
 	xdmacd_cfg.cfg = (src_is_periph | dst_is_periph) ? XDMAC_CC_TYPE_PER_TRAN : XDMAC_CC_TYPE_MEM_TRAN;
 	xdmacd_cfg.cfg |= src_is_periph ? XDMAC_CC_DSYNC_PER2MEM : XDMAC_CC_DSYNC_MEM2PER;
@@ -454,7 +479,14 @@ static int _dma_sg_configure_transfer(struct _dma_channel* channel,
 	           | XDMAC_CNDC_NDSUP_SRC_PARAMS_UPDATED
 	           | XDMAC_CNDC_NDDUP_DST_PARAMS_UPDATED;
 
-	return xdmacd_configure_transfer(channel, &xdmacd_cfg, desc_ctrl, (void *)_sg_head);
+	err = xdmacd_configure_transfer(channel, &xdmacd_cfg, desc_ctrl, (void *)_sg_head);
+	if (err < 0)
+		return err;
+
+	/* A circular list never reaches its end: report each block instead */
+	if (cfg_dma->loop)
+		xdmac_enable_channel_it(channel->hw, channel->id, XDMAC_CIE_BIE);
+	return 0;
 #elif defined(CONFIG_HAVE_DMAC)
 	struct _dmacd_cfg dmacd_cfg;
 
@@ -506,6 +538,7 @@ void dma_initialize(bool polling)
 			channel->dest_txif = 0;
 			channel->dest_rxif = 0;
 			channel->state = DMA_STATE_FREE;
+			channel->loop = false;
 		}
 
 		if (!polling) {
@@ -559,6 +592,10 @@ struct _dma_channel* dma_allocate_channel(uint8_t src, uint8_t dest)
 				dma_prepare_channel(channel);
 
 				channel->sg_list = NULL;
+				channel->sg_count = 0;
+				channel->sg_pool = NULL;
+				channel->sg_pool_size = 0;
+				memset(&channel->sg_stats, 0, sizeof(channel->sg_stats));
 
 				return channel;
 			}
@@ -589,8 +626,7 @@ int dma_reset_channel(struct _dma_channel* channel)
 	dmac_disable_channel(channel->hw, channel->id);
 #endif
 
-	_dma_sg_desc_free(channel->sg_list);
-	channel->sg_list = NULL;
+	_dma_sg_desc_free(channel);
 
 	/* Change state to 'allocated' */
 	channel->state = DMA_STATE_ALLOCATED;
@@ -606,8 +642,9 @@ int dma_free_channel(struct _dma_channel* channel)
 	case DMA_STATE_ALLOCATED:
 	case DMA_STATE_DONE:
 		channel->state = DMA_STATE_FREE;
-		_dma_sg_desc_free(channel->sg_list);
-		channel->sg_list = NULL;
+		_dma_sg_desc_free(channel);
+		channel->sg_pool = NULL;
+		channel->sg_pool_size = 0;
 		break;
 	}
 	return 0;
@@ -703,13 +740,56 @@ int dma_configure_transfer(struct _dma_channel* channel,
 			   struct _dma_cfg* cfg_dma,
 			   struct _dma_transfer_cfg* list, uint8_t list_size)
 {
+	int err;
+
 	if (list_size == 0)
 		return -EINVAL;
 
+	/* Descriptors of a running list may be rewritten in place */
+	if (channel->state == DMA_STATE_STARTED)
+		return -EBUSY;
+
 	if ((list_size == 1) && (!cfg_dma->loop))
-		return _dma_configure_transfer(channel, cfg_dma, list);
+		err = _dma_configure_transfer(channel, cfg_dma, list);
 	else
-		return _dma_sg_configure_transfer(channel, cfg_dma, list, list_size);
+		err = _dma_sg_configure_transfer(channel, cfg_dma, list, list_size);
+	if (err < 0)
+		return err;
+
+	channel->loop = cfg_dma->loop;
+	return 0;
+}
+
+int dma_set_sg_pool(struct _dma_channel* channel, struct _dma_sg_desc* pool, uint8_t size)
+{
+	if (channel->state == DMA_STATE_FREE)
+		return -EPERM;
+	else if (channel->state == DMA_STATE_STARTED)
+		return -EBUSY;
+
+	if (pool && size == 0)
+		return -EINVAL;
+
+	_dma_sg_desc_free(channel);
+	channel->sg_pool = pool;
+	channel->sg_pool_size = pool ? size : 0;
+	memset(&channel->sg_stats, 0, sizeof(channel->sg_stats));
+
+	return 0;
+}
+
+void dma_get_sg_stats(struct _dma_channel* channel, struct _dma_sg_stats* stats)
+{
+	uint32_t flags;
+
+	if (channel) {
+		*stats = channel->sg_stats;
+		return;
+	}
+
+	flags = arch_irq_save();
+	*stats = _dma_sg_pool.stats;
+	arch_irq_restore(flags);
 }
 
 uint32_t dma_get_transferred_data_len(struct _dma_channel* channel, uint8_t chunk_size, uint32_t len)
@@ -113,6 +113,26 @@ enum {
 /** \addtogroup dma_structs DMA Driver Structs
 		@{*/
 
+/** Linked list item of a scatter-gather transfer.
+ * Drivers may provide storage for them (see dma_set_sg_pool) but should not
+ * access their members. */
+struct _dma_sg_desc {
+#ifdef CONFIG_HAVE_XDMAC
+	struct _xdmac_desc_view1 desc;
+#elif defined(CONFIG_HAVE_DMAC)
+	struct _dmac_desc desc;
+#endif
+};
+
+/** Scatter-gather descriptor usage statistics */
+struct _dma_sg_stats {
+	uint32_t allocs;     /* Lists taken from the pool */
+	uint32_t reuses;     /* Lists rewritten in place */
+	uint32_t exhausted;  /* Allocations refused for lack of descriptors */
+	uint16_t in_use;     /* Descriptors currently allocated */
+	uint16_t high_water; /* Largest in_use seen */
+};
+
 /** DMA driver channel */
 struct _dma_channel {
 #if defined(CONFIG_HAVE_DMAC)
@@ -132,8 +152,14 @@ struct _dma_channel {
 	volatile uint32_t rep_count;/* repeat count in auto mode */
 #endif
 	volatile uint8_t state;		/* Channel State */
+	bool loop;			/* Circular list, callback per block */
+
+	struct _dma_sg_desc* sg_list;	/* Current linked list */
+	uint8_t sg_count;		/* Descriptors held by sg_list */
 
-	struct _dma_sg_desc* sg_list;
+	struct _dma_sg_desc* sg_pool;	/* Private descriptors, NULL for shared pool */
+	uint8_t sg_pool_size;
+	struct _dma_sg_stats sg_stats;	/* Private pool statistics */
 };
 
 struct _dma_transfer_cfg {
@@ -147,7 +173,7 @@ struct _dma_cfg {
 	uint32_t chunk_size;
 	bool incr_saddr;
 	bool incr_daddr;
-	bool loop; /* Used by scatter/gather only */
+	bool loop; /* Used by scatter/gather only, callback on each item */
 };
 
 struct _dma_controller {
@@ -267,6 +293,22 @@ extern bool dma_is_transfer_done(struct _dma_channel* channel);
  */
 extern void dma_fifo_flush(struct _dma_channel* channel);
 
+/**
+ * \brief Give a channel its own scatter-gather descriptors.
+ * Lists for this channel are then built in \a pool, which avoids any
+ * contention with other channels. Pass NULL to return to the shared pool.
+ * \param channel Channel pointer
+ * \param pool Descriptor storage, cache aligned, or NULL
+ * \param size Number of descriptors in \a pool
+ */
+extern int dma_set_sg_pool(struct _dma_channel* channel, struct _dma_sg_desc* pool, uint8_t size);
+
+/**
+ * \brief Get the descriptor statistics of a channel private pool, or of
+ * the shared pool when \a channel is NULL.
+ */
+extern void dma_get_sg_stats(struct _dma_channel* channel, struct _dma_sg_stats* stats);
+
 /**
  * \brief Transferred data by DMA
  * \param channel Channel pointer
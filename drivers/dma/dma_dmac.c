@@ -187,6 +187,10 @@ void dma_irq_handler(uint32_t source, void* user_arg)
 				channel->state = DMA_STATE_DONE;
 				exec = 1;
 			}
+		} else if (gis & (DMAC_EBCISR_BTC0 << chan)) {
+			/* Circular lists never complete, report each buffer */
+			if (channel->loop)
+				exec = 1;
 		}
 		/* Execute callback */
 		if (exec)
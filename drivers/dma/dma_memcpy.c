@@ -0,0 +1,434 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file
+ *
+ * Memory copy and fill service on top of the generic DMA layer.
+ *
+ * A few channels are reserved for memory to memory transfers. Requests wait
+ * in a queue for a free channel and are programmed as linked lists of at
+ * most DMA_MEMCPY_SG_ITEMS items, each item being bounded by
+ * DMA_MAX_BT_SIZE data units; longer requests take several runs. Requests
+ * smaller than a threshold are done by the CPU, which is faster than
+ * programming a channel and maintaining the cache for a few lines.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "compiler.h"
+#include "dma/dma.h"
+#include "dma/dma_memcpy.h"
+#include "errno.h"
+#include "irqflags.h"
+#include "mm/cache.h"
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+enum {
+	DMA_MEMCPY_OP_COPY,
+	DMA_MEMCPY_OP_SET,
+};
+
+struct _dma_memcpy_req {
+	uint8_t op;
+	uint8_t value;
+	uint8_t* dst;
+	const uint8_t* src;
+	uint32_t len;        /* bytes per line */
+	uint32_t lines;
+	uint32_t dst_stride;
+	uint32_t src_stride;
+	struct _callback callback;
+};
+
+struct _dma_memcpy_chan {
+	struct _dma_sg_desc desc[DMA_MEMCPY_SG_ITEMS];
+	uint32_t pattern;    /* source of fill requests */
+	struct _dma_channel* channel;
+	struct _dma_memcpy_req req;
+	uint32_t line;       /* next line to program */
+	uint32_t offset;     /* next byte to program in that line */
+	volatile bool busy;
+};
+
+struct _dma_memcpy {
+	struct _dma_memcpy_chan chan[DMA_MEMCPY_CHANNELS];
+	uint8_t nchan;
+
+	struct _dma_memcpy_req queue[DMA_MEMCPY_QUEUE_SIZE];
+	uint16_t head;
+	uint16_t count;
+
+	uint32_t threshold;
+	struct _dma_memcpy_stats stats;
+};
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+CACHE_ALIGNED static struct _dma_memcpy _dma_memcpy = {
+	.threshold = DMA_MEMCPY_CPU_THRESHOLD,
+};
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static uint32_t _dma_memcpy_span(const struct _dma_memcpy_req* req, uint32_t stride)
+{
+	return (req->lines - 1) * stride + req->len;
+}
+
+/**
+ * \brief Widest data unit allowed by the alignment of the request
+ */
+static uint8_t _dma_memcpy_width(const struct _dma_memcpy_req* req)
+{
+	uint32_t bits = (uint32_t)req->dst | req->len;
+
+	if (req->lines > 1)
+		bits |= req->dst_stride;
+	if (req->op == DMA_MEMCPY_OP_COPY) {
+		bits |= (uint32_t)req->src;
+		if (req->lines > 1)
+			bits |= req->src_stride;
+	}
+
+	if ((bits & 3) == 0)
+		return DMA_DATA_WIDTH_WORD;
+	else if ((bits & 1) == 0)
+		return DMA_DATA_WIDTH_HALF_WORD;
+	else
+		return DMA_DATA_WIDTH_BYTE;
+}
+
+/**
+ * \brief Copy a request with the CPU, from the given line and offset on
+ */
+static void _dma_memcpy_cpu(const struct _dma_memcpy_req* req,
+		uint32_t line, uint32_t offset)
+{
+	for (; line < req->lines; line++, offset = 0) {
+		uint8_t* dst = req->dst + line * req->dst_stride + offset;
+		if (req->op == DMA_MEMCPY_OP_SET)
+			memset(dst, req->value, req->len - offset);
+		else
+			memcpy(dst, req->src + line * req->src_stride + offset,
+			       req->len - offset);
+	}
+}
+
+static int _dma_memcpy_callback(void* arg, void* arg2);
+
+/**
+ * \brief Program and start the next run of the current request
+ */
+static int _dma_memcpy_run(struct _dma_memcpy_chan* ch)
+{
+	struct _dma_memcpy_req* req = &ch->req;
+	struct _dma_transfer_cfg list[DMA_MEMCPY_SG_ITEMS];
+	struct _dma_cfg cfg;
+	struct _callback _cb;
+	uint32_t max_bytes;
+	uint8_t count = 0;
+	int err;
+
+	cfg.data_width = _dma_memcpy_width(req);
+	cfg.chunk_size = DMA_CHUNK_SIZE_1;
+	cfg.incr_saddr = req->op == DMA_MEMCPY_OP_COPY;
+	cfg.incr_daddr = true;
+	cfg.loop = false;
+
+	max_bytes = DMA_MAX_BT_SIZE << cfg.data_width;
+	while (count < DMA_MEMCPY_SG_ITEMS && ch->line < req->lines) {
+		uint32_t left = req->len - ch->offset;
+		uint32_t chunk = left < max_bytes ? left : max_bytes;
+
+		if (req->op == DMA_MEMCPY_OP_SET)
+			list[count].saddr = &ch->pattern;
+		else
+			list[count].saddr = req->src + ch->line * req->src_stride + ch->offset;
+		list[count].daddr = req->dst + ch->line * req->dst_stride + ch->offset;
+		list[count].len = chunk >> cfg.data_width;
+		count++;
+
+		ch->offset += chunk;
+		if (ch->offset == req->len) {
+			ch->offset = 0;
+			ch->line++;
+		}
+	}
+
+	err = dma_configure_transfer(ch->channel, &cfg, list, count);
+	if (err < 0)
+		return err;
+	callback_set(&_cb, _dma_memcpy_callback, ch);
+	dma_set_callback(ch->channel, &_cb);
+	return dma_start_transfer(ch->channel);
+}
+
+/**
+ * \brief Give queued requests to the idle channels
+ */
+static void _dma_memcpy_dispatch(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < _dma_memcpy.nchan; i++) {
+		struct _dma_memcpy_chan* ch = &_dma_memcpy.chan[i];
+		bool take = false;
+		uint32_t flags;
+
+		flags = arch_irq_save();
+		if (!ch->busy && _dma_memcpy.count) {
+			ch->req = _dma_memcpy.queue[_dma_memcpy.head];
+			_dma_memcpy.head = (_dma_memcpy.head + 1) % DMA_MEMCPY_QUEUE_SIZE;
+			_dma_memcpy.count--;
+			ch->busy = true;
+			take = true;
+		}
+		arch_irq_restore(flags);
+
+		if (!take)
+			continue;
+
+		ch->line = 0;
+		ch->offset = 0;
+		if (ch->req.op == DMA_MEMCPY_OP_SET)
+			ch->pattern = ch->req.value * 0x01010101u;
+		cache_clean_region(&ch->pattern, sizeof(ch->pattern));
+		if (_dma_memcpy_run(ch) < 0) {
+			/* The channel could not be programmed, finish with the CPU */
+			_dma_memcpy_cpu(&ch->req, 0, 0);
+			ch->busy = false;
+			callback_call(&ch->req.callback, NULL);
+		}
+	}
+}
+
+static int _dma_memcpy_callback(void* arg, void* arg2)
+{
+	struct _dma_memcpy_chan* ch = (struct _dma_memcpy_chan*)arg;
+	struct _callback callback;
+	uint32_t line = ch->line;
+	uint32_t offset = ch->offset;
+	bool failed = false;
+
+	if (ch->line < ch->req.lines) {
+		if (_dma_memcpy_run(ch) == 0)
+			return 0;
+		failed = true;
+	}
+
+	cache_invalidate_region(ch->req.dst, _dma_memcpy_span(&ch->req, ch->req.dst_stride));
+
+	/* The channel could not be programmed for the next run, finish the
+	 * remaining lines with the CPU once the cache no longer holds stale
+	 * destination lines */
+	if (failed)
+		_dma_memcpy_cpu(&ch->req, line, offset);
+
+	callback_copy(&callback, &ch->req.callback);
+	ch->busy = false;
+	_dma_memcpy_dispatch();
+
+	callback_call(&callback, NULL);
+	return 0;
+}
+
+static int _dma_memcpy_submit(struct _dma_memcpy_req* req, struct _callback* cb)
+{
+	uint32_t bytes = req->len * req->lines;
+	uint32_t flags;
+	bool idle = true;
+	uint8_t i;
+
+	callback_copy(&req->callback, cb);
+
+	flags = arch_irq_save();
+	if (_dma_memcpy.count)
+		idle = false;
+	for (i = 0; i < _dma_memcpy.nchan; i++)
+		if (_dma_memcpy.chan[i].busy)
+			idle = false;
+	if ((idle && bytes < _dma_memcpy.threshold) || _dma_memcpy.nchan == 0) {
+		_dma_memcpy.stats.cpu_requests++;
+		_dma_memcpy.stats.cpu_bytes += bytes;
+		arch_irq_restore(flags);
+
+		_dma_memcpy_cpu(req, 0, 0);
+		callback_call(&req->callback, NULL);
+		return 0;
+	}
+	arch_irq_restore(flags);
+
+	if (req->op == DMA_MEMCPY_OP_COPY)
+		cache_clean_region(req->src, _dma_memcpy_span(req, req->src_stride));
+	cache_clean_region(req->dst, _dma_memcpy_span(req, req->dst_stride));
+
+	flags = arch_irq_save();
+	if (_dma_memcpy.count == DMA_MEMCPY_QUEUE_SIZE) {
+		_dma_memcpy.stats.queue_full++;
+		arch_irq_restore(flags);
+		return -EBUSY;
+	}
+	_dma_memcpy.queue[(_dma_memcpy.head + _dma_memcpy.count) % DMA_MEMCPY_QUEUE_SIZE] = *req;
+	_dma_memcpy.count++;
+	if (_dma_memcpy.count > _dma_memcpy.stats.queue_max)
+		_dma_memcpy.stats.queue_max = _dma_memcpy.count;
+	_dma_memcpy.stats.dma_requests++;
+	_dma_memcpy.stats.dma_bytes += bytes;
+	arch_irq_restore(flags);
+
+	_dma_memcpy_dispatch();
+	return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+int dma_memcpy_initialize(void)
+{
+	uint8_t i;
+
+	for (i = _dma_memcpy.nchan; i < DMA_MEMCPY_CHANNELS; i++) {
+		struct _dma_memcpy_chan* ch = &_dma_memcpy.chan[i];
+
+		ch->channel = dma_allocate_channel(DMA_PERIPH_MEMORY, DMA_PERIPH_MEMORY);
+		if (!ch->channel)
+			break;
+		dma_set_sg_pool(ch->channel, ch->desc, DMA_MEMCPY_SG_ITEMS);
+		ch->busy = false;
+		_dma_memcpy.nchan++;
+	}
+
+	return _dma_memcpy.nchan ? 0 : -ENODEV;
+}
+
+int dma_memcpy_async(void* dst, const void* src, size_t len, struct _callback* cb)
+{
+	struct _dma_memcpy_req req;
+
+	if (!dst || !src || len == 0)
+		return -EINVAL;
+
+	req.op = DMA_MEMCPY_OP_COPY;
+	req.value = 0;
+	req.dst = dst;
+	req.src = src;
+	req.len = len;
+	req.lines = 1;
+	req.dst_stride = 0;
+	req.src_stride = 0;
+
+	return _dma_memcpy_submit(&req, cb);
+}
+
+int dma_memset_async(void* dst, uint8_t value, size_t len, struct _callback* cb)
+{
+	struct _dma_memcpy_req req;
+
+	if (!dst || len == 0)
+		return -EINVAL;
+
+	req.op = DMA_MEMCPY_OP_SET;
+	req.value = value;
+	req.dst = dst;
+	req.src = NULL;
+	req.len = len;
+	req.lines = 1;
+	req.dst_stride = 0;
+	req.src_stride = 0;
+
+	return _dma_memcpy_submit(&req, cb);
+}
+
+int dma_memcpy_2d_async(void* dst, uint32_t dst_stride,
+			const void* src, uint32_t src_stride,
+			uint32_t width, uint32_t height, struct _callback* cb)
+{
+	struct _dma_memcpy_req req;
+
+	if (!dst || !src || width == 0 || height == 0)
+		return -EINVAL;
+	if (height > 1 && (dst_stride < width || src_stride < width))
+		return -EINVAL;
+
+	req.op = DMA_MEMCPY_OP_COPY;
+	req.value = 0;
+	req.dst = dst;
+	req.src = src;
+	req.len = width;
+	req.lines = height;
+	req.dst_stride = dst_stride;
+	req.src_stride = src_stride;
+
+	return _dma_memcpy_submit(&req, cb);
+}
+
+bool dma_memcpy_is_busy(void)
+{
+	uint8_t i;
+
+	if (_dma_memcpy.count)
+		return true;
+	for (i = 0; i < _dma_memcpy.nchan; i++)
+		if (_dma_memcpy.chan[i].busy)
+			return true;
+	return false;
+}
+
+void dma_memcpy_wait(void)
+{
+	while (dma_memcpy_is_busy())
+		dma_poll();
+}
+
+void dma_memcpy_set_threshold(uint32_t bytes)
+{
+	_dma_memcpy.threshold = bytes;
+}
+
+void dma_memcpy_get_stats(struct _dma_memcpy_stats* stats, bool reset)
+{
+	uint32_t flags = arch_irq_save();
+
+	*stats = _dma_memcpy.stats;
+	if (reset)
+		memset(&_dma_memcpy.stats, 0, sizeof(_dma_memcpy.stats));
+	arch_irq_restore(flags);
+}
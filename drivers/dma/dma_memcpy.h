@@ -0,0 +1,141 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _DMA_MEMCPY_H_
+#define _DMA_MEMCPY_H_
+
+/*----------------------------------------------------------------------------
+ *        Includes
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "callback.h"
+
+/*------------------------------------------------------------------------------
+ *         Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Number of DMA channels reserved for memory operations */
+#ifndef DMA_MEMCPY_CHANNELS
+#define DMA_MEMCPY_CHANNELS 2
+#endif
+
+/** Number of requests that can wait for a channel */
+#ifndef DMA_MEMCPY_QUEUE_SIZE
+#define DMA_MEMCPY_QUEUE_SIZE 16
+#endif
+
+/** Linked list items programmed per channel run */
+#ifndef DMA_MEMCPY_SG_ITEMS
+#define DMA_MEMCPY_SG_ITEMS 8
+#endif
+
+/** Requests below this size (in bytes) are done by the CPU */
+#ifndef DMA_MEMCPY_CPU_THRESHOLD
+#define DMA_MEMCPY_CPU_THRESHOLD 512
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+struct _dma_memcpy_stats {
+	uint32_t dma_requests; /* Requests done by DMA */
+	uint32_t cpu_requests; /* Requests done by the CPU */
+	uint32_t dma_bytes;
+	uint32_t cpu_bytes;
+	uint32_t queue_full;   /* Requests refused with -EBUSY */
+	uint16_t queue_max;    /* Deepest queue seen */
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Reserve the DMA channels used by the memory operations.
+ * dma_initialize() must have been called before.
+ * \return 0 on success, -ENODEV if no channel could be allocated
+ */
+extern int dma_memcpy_initialize(void);
+
+/**
+ * \brief Copy \a len bytes from \a src to \a dst.
+ * Small requests are done by the CPU before returning, larger ones are
+ * queued for the reserved DMA channels. Requests are started in submission
+ * order and a request done by the CPU never overtakes queued ones.
+ * The callback, if any, is called once the data is in \a dst, possibly
+ * from interrupt context. Both regions are cleaned from the cache on
+ * submission and \a dst is invalidated on completion, so \a dst should not
+ * share cache lines with data the CPU modifies during the transfer.
+ * \return 0 on success, -EINVAL on bad arguments, -EBUSY if the queue is full
+ */
+extern int dma_memcpy_async(void* dst, const void* src, size_t len, struct _callback* cb);
+
+/**
+ * \brief Fill \a len bytes at \a dst with \a value.
+ * Same completion and cache rules as dma_memcpy_async().
+ */
+extern int dma_memset_async(void* dst, uint8_t value, size_t len, struct _callback* cb);
+
+/**
+ * \brief Copy a rectangle of \a height lines of \a width bytes.
+ * \param dst_stride distance in bytes between two lines of \a dst
+ * \param src_stride distance in bytes between two lines of \a src
+ * Same completion and cache rules as dma_memcpy_async().
+ */
+extern int dma_memcpy_2d_async(void* dst, uint32_t dst_stride,
+			       const void* src, uint32_t src_stride,
+			       uint32_t width, uint32_t height, struct _callback* cb);
+
+/**
+ * \brief Check whether requests are queued or in progress.
+ */
+extern bool dma_memcpy_is_busy(void);
+
+/**
+ * \brief Wait until all submitted requests are completed.
+ */
+extern void dma_memcpy_wait(void);
+
+/**
+ * \brief Set the size below which requests are done by the CPU.
+ * 0 sends every request to the DMA.
+ */
+extern void dma_memcpy_set_threshold(uint32_t bytes);
+
+/**
+ * \brief Copy the usage statistics, optionally clearing them.
+ */
+extern void dma_memcpy_get_stats(struct _dma_memcpy_stats* stats, bool reset);
+
+#endif /* _DMA_MEMCPY_H_ */
@@ -768,6 +768,32 @@ static int _twid_transfer(struct _twi_desc* desc, struct _buffer* buf,  struct _
  *        External functions
  *----------------------------------------------------------------------------*/
 
+/* Hold transfers while MCK changes, then recompute the TWI clock */
+static int _twid_clock_notifier(void* arg, void* arg2)
+{
+	struct _twi_desc* desc = (struct _twi_desc*)arg;
+	struct _pmc_clock_change* change = (struct _pmc_clock_change*)arg2;
+
+	switch (change->event) {
+	case PMC_CLOCK_PRE_CHANGE:
+		if (!mutex_try_lock(&desc->mutex))
+			return -EBUSY;
+		break;
+	case PMC_CLOCK_POST_CHANGE:
+		twi_configure_master(desc->addr, desc->freq);
+#ifdef CONFIG_HAVE_TWI_FIFO
+		if (desc->use_fifo)
+			twi_fifo_enable(desc->addr, true);
+#endif
+		mutex_unlock(&desc->mutex);
+		break;
+	case PMC_CLOCK_ABORT_CHANGE:
+		mutex_unlock(&desc->mutex);
+		break;
+	}
+	return 0;
+}
+
 int twid_configure(struct _twi_desc* desc)
 {
 	uint32_t id = get_twi_id_from_addr(desc->addr);
@@ -812,6 +838,9 @@ int twid_configure(struct _twi_desc* desc)
 
 	desc->mutex = 0;
 
+	callback_set(&desc->clock_notifier.callback, _twid_clock_notifier, desc);
+	pmc_register_clock_notifier(&desc->clock_notifier);
+
 	return 0;
 }
 
@@ -39,6 +39,7 @@
 #include "i2c/twi.h"
 #include "io.h"
 #include "mutex.h"
+#include "peripherals/pmc.h"
 
 /*------------------------------------------------------------------------------
  *        Types
@@ -54,6 +55,7 @@ struct _twi_desc
 	uint32_t timeout; /**< timeout (if 0, a default timeout is used) */
 	mutex_t mutex;
 	struct _callback callback;
+	struct _pmc_clock_notifier clock_notifier;
 
 #ifdef CONFIG_HAVE_TWI_FIFO
 	bool use_fifo;
@@ -41,7 +41,21 @@
 #include "irq/nvic.h"
 #endif
 
+#include "irqflags.h"
+
+#ifdef CONFIG_IRQ_PROFILING
+#include "cycles.h"
+#include "peripherals/pmc.h"
+#ifndef ARCH_HAVE_CYCLE_COUNTER
+#include "timer.h"
+#endif
+#endif
+
 #include <assert.h>
+#include <string.h>
+#ifdef CONFIG_IRQ_PROFILING
+#include <stdio.h>
+#endif
 
 /*------------------------------------------------------------------------------
  *         Local types
@@ -53,13 +67,41 @@ struct handler_entry {
 	struct handler_entry* next;
 };
 
+/* Dispatch state of a source. The first handler is called directly, the
+ * chain only holds the other handlers of shared sources. */
+struct irq_vector {
+	irq_handler_t handler;
+	void* user_arg;
+	struct handler_entry* shared;
+	uint32_t flags;
+};
+
+/* irq_vector flags */
+#define IRQ_VECTOR_MASKED (1u << 0)
+
+#ifdef CONFIG_IRQ_PROFILING
+struct _irq_profile_state {
+	struct _irq_profile stats;
+	uint32_t mark;
+	bool marked;
+};
+#endif
+
 /*------------------------------------------------------------------------------
  *         Local variables
  *------------------------------------------------------------------------------*/
 
-static struct handler_entry  handlers_pool[ID_PERIPH_COUNT * 2];
+static struct handler_entry  handlers_pool[ID_PERIPH_COUNT];
 static struct handler_entry* next_free_handler;
-static struct handler_entry* handlers[ID_PERIPH_COUNT];
+
+/* Kept in internal SRAM so that a dispatch does not depend on external
+ * memory latency. Not zeroed at startup, see irq_initialize(). */
+SECTION(".region_sram") ALIGNED(16)
+static struct irq_vector vectors[ID_PERIPH_COUNT];
+
+#ifdef CONFIG_IRQ_PROFILING
+static struct _irq_profile_state profiles[ID_PERIPH_COUNT];
+#endif
 
 /*------------------------------------------------------------------------------
  *         Local functions
@@ -99,10 +141,77 @@ static void _free_handler(struct handler_entry* entry)
 	next_free_handler = entry;
 }
 
+#ifdef CONFIG_IRQ_PROFILING
+static inline bool _profile_timed(void)
+{
+#ifdef ARCH_HAVE_CYCLE_COUNTER
+	return true;
+#else
+	return timer_get_cycles_freq() != 0;
+#endif
+}
+
+static inline uint32_t _profile_cycles(void)
+{
+#ifdef ARCH_HAVE_CYCLE_COUNTER
+	return arch_cycles_read();
+#else
+	return _profile_timed() ? (uint32_t)timer_get_cycles() : 0;
+#endif
+}
+
+static void _profile_account(uint32_t value, uint32_t* min, uint32_t* max,
+		uint64_t* total)
+{
+	if (value < *min)
+		*min = value;
+	if (value > *max)
+		*max = value;
+	*total += value;
+}
+
+static void _profile_record(uint32_t source, uint32_t start, uint32_t call)
+{
+	struct _irq_profile_state* state = &profiles[source];
+	struct _irq_profile* stats = &state->stats;
+	uint32_t delta;
+	bool marked = state->marked;
+
+	state->marked = false;
+	stats->count++;
+	if (!_profile_timed())
+		return;
+
+	/* negative intervals come from a TC count read while its upper part
+	 * was not updated yet, drop them */
+	delta = _profile_cycles() - call;
+	if ((int32_t)delta >= 0 && (int32_t)(call - start) >= 0) {
+		stats->timed++;
+		_profile_account(delta, &stats->min, &stats->max, &stats->total);
+		_profile_account(call - start, &stats->dispatch_min,
+				&stats->dispatch_max, &stats->dispatch_total);
+	}
+
+	if (marked) {
+		delta = start - state->mark;
+		if ((int32_t)delta >= 0) {
+			stats->latency_count++;
+			_profile_account(delta, &stats->latency_min,
+					&stats->latency_max, &stats->latency_total);
+		}
+	}
+}
+#endif /* CONFIG_IRQ_PROFILING */
+
 static void _default_irq_handler(void)
 {
 	uint32_t source;
-	struct handler_entry *entry;
+	struct irq_vector* vector;
+	struct handler_entry* entry;
+#ifdef CONFIG_IRQ_PROFILING
+	uint32_t start = _profile_cycles();
+	uint32_t call;
+#endif
 
 #if defined(CONFIG_HAVE_AIC2) || defined(CONFIG_HAVE_AIC5)
 	source = aic_get_current_interrupt_source();
@@ -112,17 +221,35 @@ static void _default_irq_handler(void)
 #error Unknown IRQ controller!
 #endif
 
-	entry = handlers[source];
-	if (!entry) {
+	vector = &vectors[source];
+	if (!vector->handler) {
 		// no handler for interrupt, block
 		while (1);
 	}
 
-	while (entry) {
-		if (entry->handler)
-			entry->handler(source, entry->user_arg);
-		entry = entry->next;
-	}
+#if defined(CONFIG_HAVE_AIC2) || defined(CONFIG_HAVE_AIC5)
+	/* the IRQ entry code unmasks IRQ before calling the dispatcher, mask
+	 * it again for the sources whose handlers must not be preempted */
+	if (vector->flags & IRQ_VECTOR_MASKED)
+		arch_irq_disable();
+#endif
+
+#ifdef CONFIG_IRQ_PROFILING
+	call = _profile_cycles();
+#endif
+
+	vector->handler(source, vector->user_arg);
+	for (entry = vector->shared; entry; entry = entry->next)
+		entry->handler(source, entry->user_arg);
+
+#if defined(CONFIG_HAVE_AIC2) || defined(CONFIG_HAVE_AIC5)
+	if (vector->flags & IRQ_VECTOR_MASKED)
+		arch_irq_enable();
+#endif
+
+#ifdef CONFIG_IRQ_PROFILING
+	_profile_record(source, start, call);
+#endif
 }
 
 /*----------------------------------------------------------------------------
@@ -132,6 +259,14 @@ static void _default_irq_handler(void)
 void irq_initialize(void)
 {
 	_initialize_handlers_pool();
+	memset(vectors, 0, sizeof(vectors));
+
+#ifdef CONFIG_IRQ_PROFILING
+	irq_profile_reset();
+#ifdef ARCH_HAVE_CYCLE_COUNTER
+	arch_cycles_enable();
+#endif
+#endif
 
 #if defined(CONFIG_HAVE_AIC2) || defined(CONFIG_HAVE_AIC5)
 	aic_initialize(_default_irq_handler);
@@ -164,45 +299,103 @@ void irq_configure_priority(uint32_t source, uint8_t priority)
 #endif
 }
 
+void irq_configure_masking(uint32_t source, bool masked)
+{
+#if defined(CONFIG_HAVE_AIC2) || defined(CONFIG_HAVE_AIC5)
+	uint32_t flags;
+
+	assert(source < ID_PERIPH_COUNT);
+
+	flags = arch_irq_save();
+	if (masked)
+		vectors[source].flags |= IRQ_VECTOR_MASKED;
+	else
+		vectors[source].flags &= ~IRQ_VECTOR_MASKED;
+	arch_irq_restore(flags);
+#elif defined(CONFIG_HAVE_NVIC)
+	// ignored, not implemented on NVIC
+#else
+#error Unknown IRQ controller!
+#endif
+}
+
 void irq_add_handler(uint32_t source, irq_handler_t handler, void* user_arg)
 {
+	struct irq_vector* vector;
 	struct handler_entry* entry;
+	struct handler_entry** link;
+	uint32_t flags;
+
+	assert(source < ID_PERIPH_COUNT);
+	assert(handler);
+
+	vector = &vectors[source];
+	flags = arch_irq_save();
 
 	/* check if handler is already registered */
-	entry = handlers[source];
-	while (entry) {
-		if (entry->handler == handler) {
-			entry->user_arg = user_arg;
-			return;
+	if (vector->handler == handler) {
+		vector->user_arg = user_arg;
+		goto exit;
+	}
+	for (link = &vector->shared; *link; link = &(*link)->next) {
+		if ((*link)->handler == handler) {
+			(*link)->user_arg = user_arg;
+			goto exit;
 		}
-		entry = entry->next;
 	}
 
-	/* add handler to linked list */
-	entry = _alloc_handler();
-	entry->handler = handler;
-	entry->user_arg = user_arg;
-	entry->next = handlers[source];
-	handlers[source] = entry;
+	if (!vector->handler) {
+		/* first handler, called directly */
+		vector->user_arg = user_arg;
+		vector->handler = handler;
+	} else {
+		/* shared source, add handler at the end of the chain */
+		entry = _alloc_handler();
+		entry->handler = handler;
+		entry->user_arg = user_arg;
+		*link = entry;
+	}
+
+exit:
+	arch_irq_restore(flags);
 }
 
 void irq_remove_handler(uint32_t source, irq_handler_t handler)
 {
-	struct handler_entry* prev;
-	struct handler_entry* cur;
-
-	/* remove handler from linked list */
-	prev = NULL;
-	cur = handlers[source];
-	while (cur) {
-		if (cur->handler == handler) {
-			if (prev)
-				prev->next = cur->next;
-			_free_handler(cur);
-			return;
+	struct irq_vector* vector;
+	struct handler_entry* entry;
+	struct handler_entry** link;
+	uint32_t flags;
+
+	assert(source < ID_PERIPH_COUNT);
+
+	vector = &vectors[source];
+	flags = arch_irq_save();
+
+	if (vector->handler == handler) {
+		/* promote the first chained handler, if any */
+		entry = vector->shared;
+		if (entry) {
+			vector->handler = entry->handler;
+			vector->user_arg = entry->user_arg;
+			vector->shared = entry->next;
+			_free_handler(entry);
+		} else {
+			vector->handler = NULL;
+			vector->user_arg = NULL;
+		}
+	} else {
+		for (link = &vector->shared; *link; link = &(*link)->next) {
+			if ((*link)->handler == handler) {
+				entry = *link;
+				*link = entry->next;
+				_free_handler(entry);
+				break;
+			}
 		}
-		cur = cur->next;
 	}
+
+	arch_irq_restore(flags);
 }
 
 void irq_enable(uint32_t source)
@@ -226,3 +419,89 @@ void irq_disable(uint32_t source)
 #error Unknown IRQ controller!
 #endif
 }
+
+#ifdef CONFIG_IRQ_PROFILING
+
+void irq_profile_reset(void)
+{
+	int i;
+	uint32_t flags = arch_irq_save();
+
+	memset(profiles, 0, sizeof(profiles));
+	for (i = 0; i < ARRAY_SIZE(profiles); i++) {
+		profiles[i].stats.min = UINT32_MAX;
+		profiles[i].stats.dispatch_min = UINT32_MAX;
+		profiles[i].stats.latency_min = UINT32_MAX;
+	}
+
+	arch_irq_restore(flags);
+}
+
+bool irq_profile_get(uint32_t source, struct _irq_profile* profile)
+{
+	uint32_t flags;
+
+	if (source >= ID_PERIPH_COUNT)
+		return false;
+
+	flags = arch_irq_save();
+	*profile = profiles[source].stats;
+	arch_irq_restore(flags);
+
+	return true;
+}
+
+uint32_t irq_profile_get_freq(void)
+{
+#ifdef ARCH_HAVE_CYCLE_COUNTER
+	return pmc_get_processor_clock();
+#else
+	return timer_get_cycles_freq();
+#endif
+}
+
+void irq_profile_mark(uint32_t source)
+{
+	uint32_t flags;
+
+	assert(source < ID_PERIPH_COUNT);
+
+	flags = arch_irq_save();
+	profiles[source].mark = _profile_cycles();
+	profiles[source].marked = true;
+	arch_irq_restore(flags);
+}
+
+void irq_profile_dump(void)
+{
+	struct _irq_profile p;
+	uint32_t source;
+
+	printf("IRQ profile, in cycles at %uHz\r\n",
+			(unsigned)irq_profile_get_freq());
+	printf(" src      count      min      avg      max"
+	       " disp.min disp.avg disp.max  lat.min  lat.avg  lat.max\r\n");
+
+	for (source = 0; source < ID_PERIPH_COUNT; source++) {
+		irq_profile_get(source, &p);
+		if (p.count == 0)
+			continue;
+
+		printf(" %3u %10u", (unsigned)source, (unsigned)p.count);
+		if (p.timed)
+			printf(" %8u %8u %8u %8u %8u %8u", (unsigned)p.min,
+					(unsigned)(p.total / p.timed),
+					(unsigned)p.max, (unsigned)p.dispatch_min,
+					(unsigned)(p.dispatch_total / p.timed),
+					(unsigned)p.dispatch_max);
+		else
+			printf("        -        -        -        -        -        -");
+		if (p.latency_count)
+			printf(" %8u %8u %8u", (unsigned)p.latency_min,
+					(unsigned)(p.latency_total / p.latency_count),
+					(unsigned)p.latency_max);
+		printf("\r\n");
+	}
+}
+
+#endif /* CONFIG_IRQ_PROFILING */
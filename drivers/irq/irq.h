@@ -34,6 +34,7 @@
  *         Headers
  *------------------------------------------------------------------------------*/
 
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef void (*irq_handler_t)(uint32_t source, void* user_arg);
@@ -45,6 +46,36 @@ enum _irq_mode {
 	IRQ_MODE_NEGATIVE_EDGE,
 };
 
+#ifdef CONFIG_IRQ_PROFILING
+/**
+ * \brief Profiling statistics of an interrupt source.
+ *
+ * Durations are in profiling cycles, see irq_profile_get_freq().
+ */
+struct _irq_profile {
+	/** Number of dispatches */
+	uint32_t count;
+	/** Number of dispatches with a handler time measurement */
+	uint32_t timed;
+	/** Shortest, longest and cumulated time spent in the handlers,
+	 * including the handlers of higher priority sources preempting them */
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+	/** Shortest, longest and cumulated time from the dispatcher entry to
+	 * the first handler call */
+	uint32_t dispatch_min;
+	uint32_t dispatch_max;
+	uint64_t dispatch_total;
+	/** Number of dispatches following an irq_profile_mark() */
+	uint32_t latency_count;
+	/** Shortest, longest and cumulated time from the mark to the dispatch */
+	uint32_t latency_min;
+	uint32_t latency_max;
+	uint64_t latency_total;
+};
+#endif
+
 /*------------------------------------------------------------------------------
  *         Global functions
  *------------------------------------------------------------------------------*/
@@ -79,11 +110,30 @@ extern void irq_configure_mode(uint32_t source, enum _irq_mode mode);
  */
 extern void irq_configure_priority(uint32_t source, uint8_t priority);
 
+/**
+ * \brief Configure whether the handlers of a given source run with IRQ masked.
+ *
+ * By default, handlers run with IRQ unmasked, so that sources of higher
+ * priority (see irq_configure_priority()) preempt them. Handlers of masked
+ * sources cannot be preempted, except during the short window between the
+ * IRQ entry code and the dispatcher.
+ *
+ * \note Only implemented on AIC.
+ *
+ * \param source   Interrupt source to configure
+ * \param masked   true to run the source handlers with IRQ masked
+ */
+extern void irq_configure_masking(uint32_t source, bool masked);
+
 /**
  * \brief Add a handler for a given interrupt source (ID_xxx).
  *
  * If the handler is already configured for the interrupt source, this function
- * does nothing.
+ * only updates its user argument.
+ *
+ * The first handler of a source is called directly from a per-source table.
+ * The other handlers of a shared source are chained after it and called in
+ * the order they were added.
  *
  * \param source   Interrupt source to configure
  * \param handler  Handler for the interrupt
@@ -116,6 +166,55 @@ extern void irq_enable(uint32_t source);
  */
 extern void irq_disable(uint32_t source);
 
+#ifdef CONFIG_IRQ_PROFILING
+
+/**
+ * \brief Clear the profiling statistics of all interrupt sources.
+ */
+extern void irq_profile_reset(void);
+
+/**
+ * \brief Get a snapshot of the profiling statistics of a source (ID_xxx).
+ *
+ * \param source  Interrupt source
+ * \param profile Filled with the statistics
+ * \return false if source is out of range, true otherwise
+ */
+extern bool irq_profile_get(uint32_t source, struct _irq_profile* profile);
+
+/**
+ * \brief Returns the profiling cycle frequency, in Hz.
+ *
+ * Profiling uses the core cycle counter (PMU PMCCNTR on Cortex-A, DWT
+ * CYCCNT on Cortex-M). Cores without one (ARM926) use the TC cycle count of
+ * the timer service, and this returns 0 until timer_configure() is called,
+ * in which case only the dispatch counts are recorded.
+ */
+extern uint32_t irq_profile_get_freq(void);
+
+/**
+ * \brief Record the time an interrupt is raised, to measure the latency
+ * until its dispatch.
+ *
+ * The interrupt controllers do not timestamp pending interrupts, so this is
+ * to be called by code that knows when the interrupt is raised, for example
+ * when it triggers it or when it is raised by a timer compare.
+ *
+ * \param source  Interrupt source
+ */
+extern void irq_profile_mark(uint32_t source);
+
+/**
+ * \brief Print the statistics of the sources dispatched at least once.
+ */
+extern void irq_profile_dump(void);
+
+#else
+
+static inline void irq_profile_mark(uint32_t source) {}
+
+#endif /* CONFIG_IRQ_PROFILING */
+
 #ifdef __cplusplus
 }
 #endif
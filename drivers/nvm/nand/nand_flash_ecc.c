@@ -46,6 +46,7 @@
 #include "trace.h"
 
 #include <assert.h>
+#include <stdbool.h>
 #include <string.h>
 
 
@@ -120,15 +121,19 @@ static uint8_t ecc_read_page_with_pmecc(const struct _nand_flash *nand,
  * \param block  Number of the block to write in.
  * \param page  Number of the page to write inside the given block.
  * \param data  Data area buffer, can be 0.
+ * \param wait  Wait for the end of the page program.
  * \return 0 if successful; otherwise returns an error code.
  */
 static uint8_t ecc_write_page_with_pmecc(const struct _nand_flash *nand,
-		uint16_t block, uint16_t page, void *data)
+		uint16_t block, uint16_t page, void *data, bool wait)
 {
 	uint8_t error;
 
 	/* Perform write operation */
-	error = nand_raw_write_page(nand, block, page, data, NULL);
+	if (wait)
+		error = nand_raw_write_page(nand, block, page, data, NULL);
+	else
+		error = nand_raw_write_page_start(nand, block, page, data, NULL);
 	if (error) {
 		trace_error("ecc_write_page_with_pmecc: Failed to write page\r\n");
 		return error;
@@ -137,6 +142,27 @@ static uint8_t ecc_write_page_with_pmecc(const struct _nand_flash *nand,
 	return 0;
 }
 
+static uint8_t _ecc_write_page(const struct _nand_flash *nand,
+	uint16_t block, uint16_t page, void *data, void *spare, bool wait)
+{
+	assert(data || spare);
+
+	if (nand_is_using_pmecc()) {
+		if (spare)
+			return NAND_ERROR_ECC_NOT_COMPATIBLE;
+		return ecc_write_page_with_pmecc(nand, block, page, data, wait);
+	}
+
+	if (nand_is_using_no_ecc()) {
+		if (wait)
+			return nand_raw_write_page(nand, block, page, data, spare);
+		else
+			return nand_raw_write_page_start(nand, block, page, data, spare);
+	}
+
+	return NAND_ERROR_ECC_NOT_COMPATIBLE;
+}
+
 /*------------------------------------------------------------------------------ */
 /*         Exported functions */
 /*------------------------------------------------------------------------------ */
@@ -188,16 +214,25 @@ uint8_t nand_ecc_write_page(const struct _nand_flash *nand,
 	uint16_t block, uint16_t page, void *data, void *spare)
 {
 	NAND_TRACE("nand_ecc_write_page(B#%d:P#%d)\r\n", block, page);
-	assert(data || spare);
 
-	if (nand_is_using_pmecc()) {
-		if (spare)
-			return NAND_ERROR_ECC_NOT_COMPATIBLE;
-		return ecc_write_page_with_pmecc(nand, block, page, data);
-	}
+	return _ecc_write_page(nand, block, page, data, spare, true);
+}
 
-	if (nand_is_using_no_ecc())
-		return nand_raw_write_page(nand, block, page, data, spare);
+/**
+ * \brief Same as nand_ecc_write_page() but returns once the page program has
+ * started. nand_raw_write_page_wait() must be called before the next
+ * operation on the device.
+ * \param nand Pointer to an EccNandFlash instance.
+ * \param block  Number of the block to write in.
+ * \param page  Number of the page to write inside the given block.
+ * \param data  Data area buffer, can be 0.
+ * \param spare  Spare area buffer, can be 0.
+ * \return 0 if the program has started; otherwise returns an error code.
+ */
+uint8_t nand_ecc_write_page_start(const struct _nand_flash *nand,
+	uint16_t block, uint16_t page, void *data, void *spare)
+{
+	NAND_TRACE("nand_ecc_write_page_start(B#%d:P#%d)\r\n", block, page);
 
-	return NAND_ERROR_ECC_NOT_COMPATIBLE;
+	return _ecc_write_page(nand, block, page, data, spare, false);
 }
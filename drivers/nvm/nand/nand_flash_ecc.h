@@ -70,4 +70,8 @@ extern uint8_t nand_ecc_write_page(const struct _nand_flash *nand,
 		uint16_t block, uint16_t page,
 		void *data, void *spare);
 
+extern uint8_t nand_ecc_write_page_start(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page,
+		void *data, void *spare);
+
 #endif /* NAND_FLASH_ECC_H */
@@ -373,6 +373,26 @@ static uint8_t _nand_wait_ready(const struct _nand_flash *nand)
 	return _status_ready_pass(nand);
 }
 
+/**
+ * \brief Wait for the end of a page program and check its status.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \return 0 if the page was programmed, NAND_ERROR_CANNOTWRITE otherwise.
+ */
+static uint8_t _write_page_status(const struct _nand_flash *nand)
+{
+#ifdef CONFIG_HAVE_NFC
+	if (nand_is_nfc_enabled()) {
+		if (!nand_is_nfc_sram_enabled())
+			nfc_wait_rb_busy();
+	}
+#endif
+
+	if (_nand_wait_ready(nand))
+		return NAND_ERROR_CANNOTWRITE;
+
+	return 0;
+}
+
 /**
  * \brief Erases the specified block of the device. Returns 0 if the operation was
  * successful; otherwise returns an error code.
@@ -562,10 +582,11 @@ static uint8_t _read_page_with_pmecc(const struct _nand_flash *nand,
  * \param block  Number of the block where the page to write resides.
  * \param page  Number of the page to write inside the given block.
  * \param data  Buffer containing the data area.
+ * \param wait  Wait for the end of the program, else return once it started.
  * \return 0 if the write operation is successful; otherwise returns 1.
 */
 static uint8_t _write_page(const struct _nand_flash *nand,
-	uint16_t block, uint16_t page, uint8_t *data, uint8_t *spare)
+	uint16_t block, uint16_t page, uint8_t *data, uint8_t *spare, bool wait)
 {
 	uint8_t error = 0;
 	uint32_t data_size = nand_model_get_page_data_size(&nand->model);
@@ -617,14 +638,7 @@ static uint8_t _write_page(const struct _nand_flash *nand,
 
 	_send_cle_ale(nand, CLE_WRITE_EN, NAND_CMD_WRITE_2, 0, 0, 0);
 
-#ifdef CONFIG_HAVE_NFC
-	if (nand_is_nfc_enabled()) {
-		if (!nand_is_nfc_sram_enabled())
-			nfc_wait_rb_busy();
-	}
-#endif
-
-	if (_status_ready_pass(nand)) {
+	if (wait && _write_page_status(nand)) {
 			trace_error("write_page_no_ecc: Failed writing data area.\r\n");
 			error = NAND_ERROR_CANNOTWRITE;
 	}
@@ -639,10 +653,11 @@ static uint8_t _write_page(const struct _nand_flash *nand,
  * \param block  Number of the block where the page to write resides.
  * \param page  Number of the page to write inside the given block.
  * \param data  Buffer containing the data area.
+ * \param wait  Wait for the end of the program, else return once it started.
  * \return 0 if the write operation is successful; otherwise returns 1.
 */
 static uint8_t _write_page_with_pmecc(const struct _nand_flash *nand,
-	uint16_t block, uint16_t page, uint8_t *data)
+	uint16_t block, uint16_t page, uint8_t *data, bool wait)
 {
 	uint8_t error = 0;
 	uint32_t data_size = nand_model_get_page_data_size(&nand->model);
@@ -708,14 +723,7 @@ static uint8_t _write_page_with_pmecc(const struct _nand_flash *nand,
 	_data_array_out(nand, false, ecc_table, pmecc_get_ecc_bytes_per_page(), 0);
 	_send_cle_ale(nand, CLE_WRITE_EN, NAND_CMD_WRITE_2, 0, 0, 0);
 
-#ifdef CONFIG_HAVE_NFC
-	if (nand_is_nfc_enabled()) {
-		if (!nand_is_nfc_sram_enabled())
-			nfc_wait_rb_busy();
-	}
-#endif
-
-	if (_nand_wait_ready(nand)) {
+	if (wait && _write_page_status(nand)) {
 		trace_error("write_page_pmecc: Failed writing.\r\n");
 		error = NAND_ERROR_CANNOTWRITE;
 	}
@@ -874,10 +882,52 @@ uint8_t nand_raw_write_page(const struct _nand_flash *nand,
 	NAND_TRACE("nand_raw_write_page(B#%d:P#%d)\r\n", block, page);
 
 	if (!nand_is_using_pmecc() || spare)
-		return _write_page(nand, block, page, data, spare);
+		return _write_page(nand, block, page, data, spare, true);
 
 	if (nand_is_using_pmecc())
-		return _write_page_with_pmecc(nand, block, page, data);
+		return _write_page_with_pmecc(nand, block, page, data, true);
 
 	return NAND_ERROR_ECC_NOT_COMPATIBLE;
 }
+
+/**
+ * \brief Same as nand_raw_write_page() but returns once the page program
+ * has started. nand_raw_write_page_wait() must be called before the next
+ * operation on the device.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param block  Number of the block where the page to write resides.
+ * \param page  Number of the page to write inside the given block.
+ * \param data  Buffer containing the data area.
+ * \param spare  Buffer containing the spare area.
+ * \return 0 if the program has started; otherwise returns an error code.
+ */
+uint8_t nand_raw_write_page_start(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, void *data, void *spare)
+{
+	NAND_TRACE("nand_raw_write_page_start(B#%d:P#%d)\r\n", block, page);
+
+	if (!nand_is_using_pmecc() || spare)
+		return _write_page(nand, block, page, data, spare, false);
+
+	if (nand_is_using_pmecc())
+		return _write_page_with_pmecc(nand, block, page, data, false);
+
+	return NAND_ERROR_ECC_NOT_COMPATIBLE;
+}
+
+/**
+ * \brief Waits for the end of a page program started by
+ * nand_raw_write_page_start().
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \return 0 if the page was programmed; otherwise returns
+ * NAND_ERROR_CANNOTWRITE.
+ */
+uint8_t nand_raw_write_page_wait(const struct _nand_flash *nand)
+{
+	if (_write_page_status(nand)) {
+		trace_error("nand_raw_write_page_wait: Failed writing.\r\n");
+		return NAND_ERROR_CANNOTWRITE;
+	}
+
+	return 0;
+}
@@ -305,6 +305,31 @@ uint8_t nand_skipblock_write_page(const struct _nand_flash *nand,
 	return nand_ecc_write_page(nand, block, page, data, spare);
 }
 
+/**
+ * \brief Same as nand_skipblock_write_page() but returns once the page
+ * program has started. nand_raw_write_page_wait() must be called before the
+ * next operation on the device.
+ * \param nand  Pointer to a _raw_nand_flash instance.
+ * \param block  Number of the block to write.
+ * \param page  Number of the page to write inside the given block.
+ * \param data  Data area buffer.
+ * \param spare  Spare area buffer.
+ * \return NAND_ERROR_BADBLOCK if the page is BAD; otherwise,
+ * returns nand_ecc_write_page_start().
+ */
+uint8_t nand_skipblock_write_page_start(const struct _nand_flash *nand,
+	uint16_t block, uint16_t page, void *data, void *spare)
+{
+	/* Check that the block is LIVE */
+	if (nand_skipblock_check_block(nand, block) != GOODBLOCK) {
+		trace_error("nand_skipblock_write_page_start: Block is BAD.\r\n");
+		return NAND_ERROR_BADBLOCK;
+	}
+
+	/* Start writing data with ECC calculation */
+	return nand_ecc_write_page_start(nand, block, page, data, spare);
+}
+
 /**
  * \brief Writes the data of a whole block on a SkipBlock NANDFLASH.
  * \param nand  Pointer to a _raw_nand_flash instance.
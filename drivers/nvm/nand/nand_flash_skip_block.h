@@ -105,6 +105,10 @@ extern uint8_t nand_skipblock_write_page(const struct _nand_flash *nand,
 		uint16_t block, uint16_t page,
 		void *data, void *spare);
 
+extern uint8_t nand_skipblock_write_page_start(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page,
+		void *data, void *spare);
+
 uint8_t nand_skipblock_write_block(const struct _nand_flash *nand,
 		uint16_t block, void *data);
 
@@ -752,7 +752,7 @@ int spi_nor_read(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len)
 	return spi_flash_exec(flash, &cmd);
 }
 
-int spi_nor_write(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len)
+static int _spi_nor_write(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len, bool wait_last)
 {
 	struct spi_flash_command cmd;
 	int rc = 0;
@@ -784,9 +784,11 @@ int spi_nor_write(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t
 		if (rc < 0)
 			break;
 
-		rc = spi_flash_wait_till_ready(flash);
-		if (rc < 0)
-			break;
+		if (wait_last || len > page_remain) {
+			rc = spi_flash_wait_till_ready(flash);
+			if (rc < 0)
+				break;
+		}
 
 		buf += page_remain;
 		to += page_remain;
@@ -796,6 +798,16 @@ int spi_nor_write(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t
 	return rc;
 }
 
+int spi_nor_write(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len)
+{
+	return _spi_nor_write(flash, to, buf, len, true);
+}
+
+int spi_nor_write_start(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len)
+{
+	return _spi_nor_write(flash, to, buf, len, false);
+}
+
 int spi_nor_erase(struct spi_flash *flash, size_t offset, size_t len)
 {
 	const struct spi_flash_erase_map *map = &flash->erase_map;
@@ -117,6 +117,10 @@ int spi_nor_read(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len)
 int spi_nor_write(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len);
 int spi_nor_erase(struct spi_flash *flash, size_t offset, size_t len);
 
+/* Same as spi_nor_write() but returns while the last page is programmed:
+ * spi_flash_wait_till_ready() must be called before the next operation */
+int spi_nor_write_start(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len);
+
 int spansion_new_quad_enable(struct spi_flash *flash);
 int spansion_quad_enable(struct spi_flash *flash);
 int macronix_quad_enable(struct spi_flash *flash);
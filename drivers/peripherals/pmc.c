@@ -71,7 +71,9 @@
 #include <errno.h>
 #include <string.h>
 
+#include "callback.h"
 #include "chip.h"
+#include "irqflags.h"
 #include "timer.h"
 #include "peripherals/pmc.h"
 #include "peripherals/slowclock.h"
@@ -96,6 +98,7 @@ struct _pmc_main_osc {
  *----------------------------------------------------------------------------*/
 
 RAMDATA static uint32_t _pmc_mck = 0;
+static struct _pmc_clock_notifier* _pmc_clock_notifiers = NULL;
 static struct _pmc_main_osc _pmc_main_oscillators = {
 	.rc_freq = MAIN_CLOCK_INT_OSC,
 };
@@ -1247,6 +1250,71 @@ RAMCODE void pmc_set_custom_pck_mck(const struct pck_mck_cfg *cfg)
 	}
 }
 
+/*----------------------------------------------------------------------------
+ *        Exported functions (Clock change notifiers)
+ *----------------------------------------------------------------------------*/
+
+void pmc_register_clock_notifier(struct _pmc_clock_notifier* notifier)
+{
+	struct _pmc_clock_notifier* n;
+	uint32_t flags = arch_irq_save();
+
+	for (n = _pmc_clock_notifiers; n; n = n->next)
+		if (n == notifier)
+			break;
+	if (!n) {
+		notifier->next = _pmc_clock_notifiers;
+		_pmc_clock_notifiers = notifier;
+	}
+	arch_irq_restore(flags);
+}
+
+void pmc_unregister_clock_notifier(struct _pmc_clock_notifier* notifier)
+{
+	struct _pmc_clock_notifier** n;
+	uint32_t flags = arch_irq_save();
+
+	for (n = &_pmc_clock_notifiers; *n; n = &(*n)->next) {
+		if (*n == notifier) {
+			*n = notifier->next;
+			notifier->next = NULL;
+			break;
+		}
+	}
+	arch_irq_restore(flags);
+}
+
+int pmc_change_pck_mck(const struct pck_mck_cfg *cfg)
+{
+	struct _pmc_clock_notifier *n, *failed;
+	struct _pmc_clock_change change = {
+		.event = PMC_CLOCK_PRE_CHANGE,
+		.old_mck = pmc_get_master_clock(),
+		.new_mck = 0,
+	};
+	int err;
+
+	for (n = _pmc_clock_notifiers; n; n = n->next) {
+		err = callback_call(&n->callback, &change);
+		if (err < 0) {
+			failed = n;
+			change.event = PMC_CLOCK_ABORT_CHANGE;
+			for (n = _pmc_clock_notifiers; n != failed; n = n->next)
+				callback_call(&n->callback, &change);
+			return err;
+		}
+	}
+
+	pmc_set_custom_pck_mck(cfg);
+
+	change.event = PMC_CLOCK_POST_CHANGE;
+	change.new_mck = pmc_get_master_clock();
+	for (n = _pmc_clock_notifiers; n; n = n->next)
+		callback_call(&n->callback, &change);
+
+	return 0;
+}
+
 /*----------------------------------------------------------------------------
  *        Exported functions (Peripherals)
  *----------------------------------------------------------------------------*/
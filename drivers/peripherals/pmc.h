@@ -38,6 +38,8 @@
 
 #include <stdint.h>
 
+#include "callback.h"
+
 /*----------------------------------------------------------------------------
  *        Types
  *----------------------------------------------------------------------------*/
@@ -107,6 +109,32 @@ struct pck_mck_cfg {
 #endif
 };
 
+/**
+ * \brief Master clock change events, see pmc_register_clock_notifier()
+ */
+enum _pmc_clock_event {
+	PMC_CLOCK_PRE_CHANGE,   /**< MCK is about to change, quiesce */
+	PMC_CLOCK_POST_CHANGE,  /**< MCK changed, recompute dividers */
+	PMC_CLOCK_ABORT_CHANGE, /**< MCK change vetoed, resume */
+};
+
+/**
+ * \brief Master clock change, passed as second argument to the notifiers
+ */
+struct _pmc_clock_change {
+	enum _pmc_clock_event event;
+	uint32_t old_mck; /**< MCK before the change, in Hz */
+	uint32_t new_mck; /**< MCK after the change (0 before it is applied) */
+};
+
+/**
+ * \brief Master clock change notifier
+ */
+struct _pmc_clock_notifier {
+	struct _pmc_clock_notifier* next;
+	struct _callback callback;
+};
+
 struct	_pmc_periph_cfg{
 #ifdef CONFIG_HAVE_PMC_PERIPH_DIV
 	/** Peripheral clock divisor (0 means use lowest divider possible) */
@@ -190,6 +218,35 @@ extern uint32_t pmc_get_main_oscillator_freq(void);
  */
 extern void pmc_set_custom_pck_mck(const struct pck_mck_cfg *cfg);
 
+/**
+ * \brief Register a master clock change notifier.
+ *
+ * The notifier callback is called with a struct _pmc_clock_change as second
+ * argument by pmc_change_pck_mck(). On PMC_CLOCK_PRE_CHANGE it may return a
+ * negative error to veto the change, the notifiers already called then get
+ * PMC_CLOCK_ABORT_CHANGE. Registering a registered notifier does nothing.
+ *
+ * \param notifier Notifier, must stay valid until unregistered
+ */
+extern void pmc_register_clock_notifier(struct _pmc_clock_notifier* notifier);
+
+/**
+ * \brief Unregister a master clock change notifier
+ */
+extern void pmc_unregister_clock_notifier(struct _pmc_clock_notifier* notifier);
+
+/**
+ * \brief Configure PCK and MCK with custom setting, notifying the
+ * registered clock change notifiers before and after the change.
+ *
+ * pmc_set_custom_pck_mck() and the pmc_switch_mck_to_*() functions do not
+ * notify, they are meant for low-level code that runs while DDR or drivers
+ * are unavailable.
+ *
+ * \return 0 on success, the notifier error if the change was vetoed
+ */
+extern int pmc_change_pck_mck(const struct pck_mck_cfg *cfg);
+
 /**
  * \brief Get the configured frequency of the master clock
  * \return master clock frequency in Hz
@@ -0,0 +1,272 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "callback.h"
+#include "chip.h"
+#include "cpuidle.h"
+#include "irqflags.h"
+#include "peripherals/pmc.h"
+#include "peripherals/tc.h"
+#include "power/dvfs.h"
+#include "timer.h"
+
+/*------------------------------------------------------------------------------
+ *         Local definitions
+ *------------------------------------------------------------------------------*/
+
+/** No OPP switch pending */
+#define DVFS_NO_OPP 0xff
+
+/** The latency TC counter is read on 16 bits, enough for 2 seconds */
+#define DVFS_LATENCY_MASK 0xffff
+
+/*------------------------------------------------------------------------------
+ *         Local variables
+ *------------------------------------------------------------------------------*/
+
+static struct {
+	const struct _dvfs_cfg* cfg;
+	struct _timer_event sample;
+	volatile uint8_t pending;
+	uint8_t opp;
+	uint64_t window_start_us;
+	uint64_t idle_us;
+	uint64_t opp_start_ms;
+	struct _dvfs_stats stats;
+} _dvfs;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/* Called with interrupts disabled */
+static void _dvfs_account_residency(void)
+{
+	uint64_t now = timer_get_tick();
+
+	_dvfs.stats.residency_ms[_dvfs.opp] += (uint32_t)(now - _dvfs.opp_start_ms);
+	_dvfs.opp_start_ms = now;
+}
+
+/* Called with interrupts disabled */
+static void _dvfs_restart_window(void)
+{
+	_dvfs.window_start_us = timer_get_us();
+	_dvfs.idle_us = 0;
+}
+
+static int _dvfs_switch(uint8_t opp)
+{
+	const struct _dvfs_cfg* cfg = _dvfs.cfg;
+	uint32_t start = 0, flags;
+	int err;
+
+	if (cfg->tc)
+		start = tc_get_cv(cfg->tc, cfg->channel);
+
+	err = pmc_change_pck_mck(&cfg->opps[opp]);
+
+	flags = arch_irq_save();
+	if (err < 0) {
+		_dvfs.stats.vetoed++;
+	} else {
+		if (cfg->tc) {
+			uint32_t ticks = (tc_get_cv(cfg->tc, cfg->channel) - start) & DVFS_LATENCY_MASK;
+			uint32_t latency = (uint32_t)(((uint64_t)ticks * 1000000) / pmc_get_slow_clock());
+			_dvfs.stats.last_latency_us = latency;
+			if (latency > _dvfs.stats.max_latency_us)
+				_dvfs.stats.max_latency_us = latency;
+		}
+		_dvfs_account_residency();
+		_dvfs.opp = opp;
+		_dvfs.stats.opp = opp;
+		_dvfs.stats.switches++;
+		/* the load measured at the previous OPP is meaningless now */
+		_dvfs_restart_window();
+	}
+	if (_dvfs.pending == opp)
+		_dvfs.pending = DVFS_NO_OPP;
+	arch_irq_restore(flags);
+
+	return err;
+}
+
+/* Runs from the timer interrupt: only pick the next OPP, the switch itself
+ * is left to dvfs_update() since the notifiers may wait for the
+ * peripherals to drain. */
+static int _dvfs_sample(void* arg, void* arg2)
+{
+	const struct _dvfs_cfg* cfg = _dvfs.cfg;
+	uint64_t now = timer_get_us();
+	uint64_t window = now - _dvfs.window_start_us;
+	uint32_t load = 0;
+	uint8_t target = _dvfs.opp;
+
+	if (window > 0 && _dvfs.idle_us < window)
+		load = (uint32_t)(100 - (_dvfs.idle_us * 100) / window);
+	_dvfs.stats.load = load;
+	_dvfs_restart_window();
+	_dvfs_account_residency();
+
+	if (load > cfg->up_threshold)
+		target = cfg->opp_count - 1;
+	else if (load < cfg->down_threshold && target > 0)
+		target--;
+
+	_dvfs.pending = (target != _dvfs.opp) ? target : DVFS_NO_OPP;
+
+	return 0;
+}
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+int dvfs_start(const struct _dvfs_cfg* cfg)
+{
+	struct _callback cb;
+	uint32_t flags;
+	int err;
+
+	if (!cfg || !cfg->opps || cfg->opp_count == 0 ||
+	    cfg->opp_count > DVFS_MAX_OPPS || cfg->sample_ms == 0 ||
+	    cfg->down_threshold > cfg->up_threshold ||
+	    cfg->up_threshold > 100)
+		return -EINVAL;
+
+	dvfs_stop();
+
+	if (cfg->tc) {
+		uint32_t tc_id = get_tc_id_from_addr(cfg->tc, cfg->channel);
+
+		if (!pmc_is_peripheral_enabled(tc_id))
+			pmc_configure_peripheral(tc_id, NULL, true);
+		tc_configure(cfg->tc, cfg->channel, TC_CMR_TCCLKS_TIMER_CLOCK5);
+		tc_start(cfg->tc, cfg->channel);
+	}
+
+	memset(&_dvfs.stats, 0, sizeof(_dvfs.stats));
+	_dvfs.cfg = cfg;
+	_dvfs.pending = DVFS_NO_OPP;
+	_dvfs.opp = cfg->opp_count - 1;
+	_dvfs.stats.opp = _dvfs.opp;
+
+	err = _dvfs_switch(_dvfs.opp);
+	if (err < 0) {
+		_dvfs.cfg = NULL;
+		return err;
+	}
+
+	flags = arch_irq_save();
+	_dvfs.opp_start_ms = timer_get_tick();
+	memset(_dvfs.stats.residency_ms, 0, sizeof(_dvfs.stats.residency_ms));
+	_dvfs.stats.switches = 0;
+	_dvfs_restart_window();
+	arch_irq_restore(flags);
+
+	timer_event_init(&_dvfs.sample);
+	callback_set(&cb, _dvfs_sample, NULL);
+	timer_event_start(&_dvfs.sample, cfg->sample_ms, cfg->sample_ms, &cb);
+
+	return 0;
+}
+
+void dvfs_stop(void)
+{
+	if (!_dvfs.cfg)
+		return;
+
+	timer_event_cancel(&_dvfs.sample);
+	if (_dvfs.cfg->tc)
+		tc_stop(_dvfs.cfg->tc, _dvfs.cfg->channel);
+	_dvfs.pending = DVFS_NO_OPP;
+	_dvfs.cfg = NULL;
+}
+
+void dvfs_update(void)
+{
+	uint8_t opp = _dvfs.pending;
+
+	if (_dvfs.cfg && opp != DVFS_NO_OPP)
+		_dvfs_switch(opp);
+}
+
+void dvfs_idle(void)
+{
+	uint64_t start;
+	uint32_t flags;
+
+	dvfs_update();
+
+	/* WFI wakes up on a pending interrupt even when masked: keep them
+	 * masked so that the idle time is accounted before the sample
+	 * handler runs */
+	flags = arch_irq_save();
+	start = timer_get_us();
+	cpu_idle();
+	if (_dvfs.cfg)
+		_dvfs.idle_us += timer_get_us() - start;
+	arch_irq_restore(flags);
+}
+
+int dvfs_set_opp(uint8_t opp)
+{
+	if (!_dvfs.cfg || opp >= _dvfs.cfg->opp_count)
+		return -EINVAL;
+
+	if (opp == _dvfs.opp)
+		return 0;
+
+	return _dvfs_switch(opp);
+}
+
+void dvfs_get_stats(struct _dvfs_stats* stats, bool reset)
+{
+	uint32_t flags = arch_irq_save();
+
+	if (_dvfs.cfg)
+		_dvfs_account_residency();
+	memcpy(stats, &_dvfs.stats, sizeof(*stats));
+	if (reset) {
+		_dvfs.stats.switches = 0;
+		_dvfs.stats.vetoed = 0;
+		_dvfs.stats.max_latency_us = 0;
+		memset(_dvfs.stats.residency_ms, 0, sizeof(_dvfs.stats.residency_ms));
+	}
+
+	arch_irq_restore(flags);
+}
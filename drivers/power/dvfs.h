@@ -0,0 +1,143 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef DVFS_H_
+#define DVFS_H_
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip.h"
+#include "peripherals/pmc.h"
+
+/*------------------------------------------------------------------------------
+ *         Definitions
+ *------------------------------------------------------------------------------*/
+
+/** Maximum number of operating points */
+#define DVFS_MAX_OPPS 8
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief DVFS governor configuration
+ */
+struct _dvfs_cfg {
+	/** Operating points, sorted by increasing MCK */
+	const struct pck_mck_cfg* opps;
+	uint8_t opp_count;
+
+	/** Load sampling period, in timer ticks (ms) */
+	uint32_t sample_ms;
+
+	/** Jump to the highest OPP above this load, in percent */
+	uint8_t up_threshold;
+
+	/** Step down one OPP below this load, in percent */
+	uint8_t down_threshold;
+
+	/** Optional TC channel clocked by the slow clock to time the clock
+	 * switches, NULL to disable latency measurement */
+	Tc* tc;
+	uint8_t channel;
+};
+
+/**
+ * \brief DVFS governor statistics
+ */
+struct _dvfs_stats {
+	uint32_t switches;        /**< completed OPP switches */
+	uint32_t vetoed;          /**< switches vetoed by a clock notifier */
+	uint8_t load;             /**< load of the last sample, in percent */
+	uint8_t opp;              /**< current OPP */
+	uint32_t last_latency_us; /**< duration of the last switch */
+	uint32_t max_latency_us;  /**< longest switch */
+	uint32_t residency_ms[DVFS_MAX_OPPS]; /**< time spent in each OPP */
+};
+
+/*------------------------------------------------------------------------------
+ *         Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ * \brief Start the ondemand DVFS governor.
+ *
+ * The load is sampled every cfg->sample_ms from the idle time accounted by
+ * dvfs_idle(), using a software timer event. The clock is switched with
+ * pmc_change_pck_mck(), so that drivers registered as clock notifiers
+ * follow. Switches are applied in thread context, by dvfs_idle() or
+ * dvfs_update(); a vetoed switch is retried at the next sample. Starts at
+ * the highest OPP.
+ *
+ * \param cfg Governor configuration, must stay valid until dvfs_stop()
+ * \return 0 on success, -EINVAL if the configuration is invalid, or the
+ * notifier error if the initial switch was vetoed
+ */
+extern int dvfs_start(const struct _dvfs_cfg* cfg);
+
+/**
+ * \brief Stop the DVFS governor. The clock stays at the current OPP.
+ */
+extern void dvfs_stop(void);
+
+/**
+ * \brief Apply a pending OPP switch, then wait for an interrupt, accounting
+ * the time spent as idle. Meant to be called from the idle loop.
+ */
+extern void dvfs_idle(void);
+
+/**
+ * \brief Apply a pending OPP switch. For busy loops that seldom reach
+ * dvfs_idle().
+ */
+extern void dvfs_update(void);
+
+/**
+ * \brief Switch to an OPP. The governor may leave it at the next sample.
+ *
+ * \return 0 on success, -EINVAL if opp is out of range, or the notifier
+ * error if the switch was vetoed
+ */
+extern int dvfs_set_opp(uint8_t opp);
+
+/**
+ * \brief Get the governor statistics
+ *
+ * \param stats Filled with the statistics
+ * \param reset Clear the counters and residencies after reading them
+ */
+extern void dvfs_get_stats(struct _dvfs_stats* stats, bool reset);
+
+#endif /* DVFS_H_ */
@@ -35,6 +35,7 @@
 #include <string.h>
 
 #include "board.h"
+#include "callback.h"
 #include "chip.h"
 #include "console.h"
 #ifdef CONFIG_HAVE_L1CACHE
@@ -51,6 +52,40 @@
 
 static struct _seriald console;
 
+static struct {
+	void* addr;
+	uint32_t baudrate;
+	bool rx_interrupt;
+	struct _pmc_clock_notifier clock_notifier;
+} console_state;
+
+/*------------------------------------------------------------------------------
+ *         Local functions
+ *------------------------------------------------------------------------------*/
+
+/* Drain the transmitter before MCK changes, then recompute the baudrate */
+static int _console_clock_notifier(void* arg, void* arg2)
+{
+	struct _pmc_clock_change* change = (struct _pmc_clock_change*)arg2;
+	seriald_rx_handler_t handler;
+
+	switch (change->event) {
+	case PMC_CLOCK_PRE_CHANGE:
+		while (!seriald_is_tx_empty(&console));
+		break;
+	case PMC_CLOCK_POST_CHANGE:
+		handler = console.rx_handler;
+		seriald_configure(&console, console_state.addr, console_state.baudrate);
+		console.rx_handler = handler;
+		if (console_state.rx_interrupt)
+			seriald_enable_rx_interrupt(&console);
+		break;
+	default:
+		break;
+	}
+	return 0;
+}
+
 /*------------------------------------------------------------------------------
  *         Exported functions
  *------------------------------------------------------------------------------*/
@@ -64,7 +99,14 @@ void console_configure(const struct _console_cfg* config)
 		if (config->rx_pin.mask)
 			pio_configure(&config->rx_pin, 1);
 		seriald_configure(&console, config->addr, config->baudrate);
+		console_state.addr = config->addr;
+		console_state.baudrate = config->baudrate;
+		console_state.rx_interrupt = false;
+		callback_set(&console_state.clock_notifier.callback,
+		             _console_clock_notifier, NULL);
+		pmc_register_clock_notifier(&console_state.clock_notifier);
 	} else {
+		pmc_unregister_clock_notifier(&console_state.clock_notifier);
 		memset(&console, 0, sizeof(console));
 	}
 }
@@ -102,11 +144,13 @@ void console_set_rx_handler(console_rx_handler_t handler)
 
 void console_enable_rx_interrupt(void)
 {
+	console_state.rx_interrupt = true;
 	seriald_enable_rx_interrupt(&console);
 }
 
 void console_disable_rx_interrupt(void)
 {
+	console_state.rx_interrupt = false;
 	seriald_disable_rx_interrupt(&console);
 }
 
@@ -341,6 +341,31 @@ int spid_transfer(struct _spi_desc* desc,
 	return 0;
 }
 
+/* Hold transfers while MCK changes and keep the chip select bitrates */
+static int _spid_clock_notifier(void* arg, void* arg2)
+{
+	struct _spi_desc* desc = (struct _spi_desc*)arg;
+	struct _pmc_clock_change* change = (struct _pmc_clock_change*)arg2;
+	uint8_t cs;
+
+	switch (change->event) {
+	case PMC_CLOCK_PRE_CHANGE:
+		if (!mutex_try_lock(&desc->mutex))
+			return -EBUSY;
+		break;
+	case PMC_CLOCK_POST_CHANGE:
+		for (cs = 0; cs < SPID_CS_COUNT; cs++)
+			if (desc->cs_bitrate[cs])
+				spi_set_cs_bitrate(desc->addr, cs, desc->cs_bitrate[cs]);
+		mutex_unlock(&desc->mutex);
+		break;
+	case PMC_CLOCK_ABORT_CHANGE:
+		mutex_unlock(&desc->mutex);
+		break;
+	}
+	return 0;
+}
+
 bool spid_is_busy(struct _spi_desc* desc)
 {
 	return mutex_is_locked(&desc->mutex);
@@ -375,6 +400,10 @@ int spid_configure(struct _spi_desc* desc)
 	spi_disable_it(desc->addr, ~0u);
 	desc->xfer.dma.tx_channel = 0;
 	desc->xfer.dma.rx_channel = 0;
+	memset(desc->cs_bitrate, 0, sizeof(desc->cs_bitrate));
+
+	callback_set(&desc->clock_notifier.callback, _spid_clock_notifier, desc);
+	pmc_register_clock_notifier(&desc->clock_notifier);
 
 	spi_enable(desc->addr);
 
@@ -403,11 +432,13 @@ void spid_configure_cs(struct _spi_desc* desc, uint8_t cs,
 	}
 
 	spi_configure_cs(desc->addr, cs, bitrate, delay_dlybs, delay_dlybct, csr);
+	desc->cs_bitrate[cs] = bitrate;
 }
 
 void spid_set_cs_bitrate(struct _spi_desc* desc, uint8_t cs, uint32_t bitrate)
 {
 	spi_set_cs_bitrate(desc->addr, cs, bitrate);
+	desc->cs_bitrate[cs] = bitrate;
 }
 
 int spid_configure_master(struct _spi_desc* desc, bool master)
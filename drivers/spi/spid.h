@@ -41,11 +41,14 @@
 #include "dma/dma.h"
 #include "io.h"
 #include "mutex.h"
+#include "peripherals/pmc.h"
 
 /*------------------------------------------------------------------------------
  *        Types
  *----------------------------------------------------------------------------*/
 
+#define SPID_CS_COUNT 4
+
 enum _spid_mode {
 	SPID_MODE_0 = 0x00, // POL=0, CPHA=0
 	SPID_MODE_1 = 0x01, // POL=0, CPHA=1
@@ -60,6 +63,11 @@ struct _spi_desc {
 	/* following fields are used internally */
 	mutex_t mutex;
 
+	/* requested chip select bitrates (kHz), reapplied after master clock
+	 * changes */
+	uint32_t cs_bitrate[SPID_CS_COUNT];
+	struct _pmc_clock_notifier clock_notifier;
+
 #ifdef CONFIG_HAVE_SPI_FIFO
 	bool use_fifo;
 	struct {
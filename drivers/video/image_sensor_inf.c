@@ -327,3 +327,105 @@ uint32_t sensor_get_output(struct sensor_profile *sensor,
 	}
 	return SENSOR_RESOLUTION_NOT_SUPPORTED;
 }
+
+uint32_t sensor_set_manual_exposure(uint8_t twi_bus,
+									struct sensor_profile* sensor)
+{
+	const struct sensor_exposure_ctrl* ctrl = sensor->exposure;
+	uint32_t val = 0;
+
+	if (!ctrl)
+		return SENSOR_NOT_SUPPORTED;
+
+	if (sensor_twi_read_reg(sensor->twi_inf_mode, twi_bus, sensor->addr,
+							ctrl->manual_reg, (uint8_t*)&val) < 0)
+		return SENSOR_TWI_ERROR;
+	val = (val & ~ctrl->manual_mask) | (ctrl->manual_val & ctrl->manual_mask);
+	if (sensor_twi_write_reg(sensor->twi_inf_mode, twi_bus, sensor->addr,
+							 ctrl->manual_reg, (uint8_t*)&val) < 0)
+		return SENSOR_TWI_ERROR;
+
+	return SENSOR_OK;
+}
+
+uint32_t sensor_get_exposure(uint8_t twi_bus,
+							 struct sensor_profile* sensor,
+							 uint32_t* exposure,
+							 uint16_t* gain)
+{
+	const struct sensor_exposure_ctrl* ctrl = sensor->exposure;
+	uint32_t raw, val;
+	uint8_t i;
+
+	if (!ctrl)
+		return SENSOR_NOT_SUPPORTED;
+
+	raw = 0;
+	for (i = 0; i < ARRAY_SIZE(ctrl->exposure_regs); i++) {
+		if (ctrl->exposure_regs[i] == SENSOR_REG_TERM)
+			break;
+		val = 0;
+		if (sensor_twi_read_reg(sensor->twi_inf_mode, twi_bus, sensor->addr,
+								ctrl->exposure_regs[i], (uint8_t*)&val) < 0)
+			return SENSOR_TWI_ERROR;
+		raw = (raw << 8) | (val & 0xff);
+	}
+	*exposure = raw >> ctrl->exposure_shift;
+
+	raw = 0;
+	for (i = 0; i < ARRAY_SIZE(ctrl->gain_regs); i++) {
+		if (ctrl->gain_regs[i] == SENSOR_REG_TERM)
+			break;
+		val = 0;
+		if (sensor_twi_read_reg(sensor->twi_inf_mode, twi_bus, sensor->addr,
+								ctrl->gain_regs[i], (uint8_t*)&val) < 0)
+			return SENSOR_TWI_ERROR;
+		raw = (raw << 8) | (val & 0xff);
+	}
+	*gain = raw << ctrl->gain_shift;
+
+	return SENSOR_OK;
+}
+
+uint32_t sensor_set_exposure(uint8_t twi_bus,
+							 struct sensor_profile* sensor,
+							 uint32_t exposure,
+							 uint16_t gain)
+{
+	const struct sensor_exposure_ctrl* ctrl = sensor->exposure;
+	uint32_t raw, val;
+	uint8_t i, count;
+
+	if (!ctrl)
+		return SENSOR_NOT_SUPPORTED;
+
+	if (exposure > ctrl->exposure_max)
+		exposure = ctrl->exposure_max;
+	if (gain > ctrl->gain_max)
+		gain = ctrl->gain_max;
+
+	/* Registers are listed MSB first, write them LSB last */
+	for (count = 0; count < ARRAY_SIZE(ctrl->exposure_regs); count++)
+		if (ctrl->exposure_regs[count] == SENSOR_REG_TERM)
+			break;
+	raw = exposure << ctrl->exposure_shift;
+	for (i = 0; i < count; i++) {
+		val = (raw >> (8 * (count - 1 - i))) & 0xff;
+		if (sensor_twi_write_reg(sensor->twi_inf_mode, twi_bus, sensor->addr,
+								 ctrl->exposure_regs[i], (uint8_t*)&val) < 0)
+			return SENSOR_TWI_ERROR;
+	}
+
+	for (count = 0; count < ARRAY_SIZE(ctrl->gain_regs); count++)
+		if (ctrl->gain_regs[count] == SENSOR_REG_TERM)
+			break;
+	raw = gain >> ctrl->gain_shift;
+	for (i = 0; i < count; i++) {
+		val = (raw >> (8 * (count - 1 - i))) & 0xff;
+		if (sensor_twi_write_reg(sensor->twi_inf_mode, twi_bus, sensor->addr,
+								 ctrl->gain_regs[i], (uint8_t*)&val) < 0)
+			return SENSOR_TWI_ERROR;
+	}
+
+	return SENSOR_OK;
+}
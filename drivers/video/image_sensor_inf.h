@@ -66,7 +66,8 @@ enum {
 	SENSOR_OK = 0,        /**< Operation is successful */
 	SENSOR_TWI_ERROR,
 	SENSOR_ID_ERROR,
-	SENSOR_RESOLUTION_NOT_SUPPORTED
+	SENSOR_RESOLUTION_NOT_SUPPORTED,
+	SENSOR_NOT_SUPPORTED  /**< Feature not available on this sensor */
 };
 
 /** Sensor type */
@@ -127,6 +128,19 @@ struct sensor_output {
 	const struct sensor_reg* output_setting;    /** sensor registers setting */
 };
 
+/** define a structure describing the manual exposure and gain registers */
+struct sensor_exposure_ctrl {
+	uint16_t exposure_regs[3];    /** exposure registers, MSB first, SENSOR_REG_TERM if unused */
+	uint8_t exposure_shift;       /** position of the exposure line count in the registers */
+	uint16_t gain_regs[2];        /** gain registers, MSB first, SENSOR_REG_TERM if unused */
+	uint8_t gain_shift;           /** conversion from 1/16 gain units to register units */
+	uint16_t manual_reg;          /** register selecting manual exposure and gain */
+	uint8_t manual_mask;          /** bits of manual_reg to update */
+	uint8_t manual_val;           /** value of the bits for manual mode */
+	uint32_t exposure_max;        /** maximum exposure, in lines */
+	uint16_t gain_max;            /** maximum gain, in 1/16 units */
+};
+
 /** define a structure for sensor profile */
 struct sensor_profile {
 	const char* name;             /** Sensor name */
@@ -139,6 +153,7 @@ struct sensor_profile {
 	uint16_t pid_low;             /** product ID low byte */
 	uint16_t version_mask;        /** version mask */
 	const struct sensor_output* output_conf[SENSOR_SUPPORTED_OUTPUTS]; /** sensor settings */
+	const struct sensor_exposure_ctrl* exposure; /** manual exposure control, NULL if not supported */
 };
 
 /*----------------------------------------------------------------------------
@@ -195,6 +210,41 @@ extern uint32_t sensor_get_output(struct sensor_profile* sensor,
 								  uint32_t *width,
 								  uint32_t *height);
 
+/**
+ * \brief Disable the sensor automatic exposure and gain control.
+ * \param twi_bus TWI bus
+ * \param sensor pointer to a sensor profile instance.
+ * \return SENSOR_OK if no error; otherwise return SENSOR_XXX_ERROR
+ */
+extern uint32_t sensor_set_manual_exposure(uint8_t twi_bus,
+										   struct sensor_profile* sensor);
+
+/**
+ * \brief Read the current sensor exposure and gain.
+ * \param twi_bus TWI bus
+ * \param sensor pointer to a sensor profile instance.
+ * \param exposure pointer to the exposure, in lines, to be read.
+ * \param gain pointer to the analog gain, in 1/16 units, to be read.
+ * \return SENSOR_OK if no error; otherwise return SENSOR_XXX_ERROR
+ */
+extern uint32_t sensor_get_exposure(uint8_t twi_bus,
+									struct sensor_profile* sensor,
+									uint32_t* exposure,
+									uint16_t* gain);
+
+/**
+ * \brief Program the sensor exposure and gain.
+ * \param twi_bus TWI bus
+ * \param sensor pointer to a sensor profile instance.
+ * \param exposure exposure, in lines
+ * \param gain analog gain, in 1/16 units
+ * \return SENSOR_OK if no error; otherwise return SENSOR_XXX_ERROR
+ */
+extern uint32_t sensor_set_exposure(uint8_t twi_bus,
+									struct sensor_profile* sensor,
+									uint32_t exposure,
+									uint16_t gain);
+
 #endif /* CONFIG_HAVE_IMAGE_SENSOR */
 
 #endif /* ! IMAGE_SENSOR_INF_H */
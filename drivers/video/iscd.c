@@ -27,6 +27,9 @@
  * ----------------------------------------------------------------------------
  */
 
+#include <string.h>
+
+#include "irqflags.h"
 #include "irq/irq.h"
 
 #include "mm/cache.h"
@@ -35,6 +38,7 @@
 #include "video/isc.h"
 #include "video/iscd.h"
 
+#include "timer.h"
 #include "trace.h"
 
 /*----------------------------------------------------------------------------
@@ -49,9 +53,56 @@ CACHE_ALIGNED static union {
 
 static struct _iscd_awb awb;
 
+/** 3A engine state, updated from interrupt context */
+static struct {
+	struct _iscd_3a engine;
+	struct _iscd_desc* desc;
+	volatile bool enabled;
+	uint8_t channel;
+	volatile bool exposure_pending;
+} _3a;
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
+static void _iscd_dma_read_histogram(uint32_t buf);
+
+/**
+ * \brief Request the histogram of the current 3A channel.
+ */
+static void _iscd_3a_request_histogram(void)
+{
+	isc_histogram_configure(_3a.channel,
+			ISC_HIS_CFG_BAYSEL(_3a.desc->pipe.bayer_pattern), 1);
+	isc_update_profile();
+	isc_update_histogram_table();
+}
+
+/**
+ * \brief Process a histogram read for the 3A engine and request the next
+ * one. Called from the histogram DMA callback.
+ */
+static void _iscd_3a_histogram_done(struct _iscd_desc* iscd)
+{
+	const struct _iscd_3a_result* res;
+
+	if (iscd_3a_add_histogram(&_3a.engine, _3a.channel, iscd->pipe.histo_buf)) {
+		res = iscd_3a_update(&_3a.engine);
+		if (res->wb_changed) {
+			isc_wb_adjust_bayer_color(0, 0, 0, 0,
+				res->wb[ISCD_3A_R], res->wb[ISCD_3A_GR],
+				res->wb[ISCD_3A_B], res->wb[ISCD_3A_GB]);
+			isc_update_profile();
+		}
+		if (res->exposure_changed)
+			_3a.exposure_pending = true;
+	}
+
+	_3a.channel = (_3a.channel + 1) % ISCD_3A_CHANNELS;
+	if (_3a.enabled)
+		_iscd_3a_request_histogram();
+}
+
 /**
  * \brief Callback entry for histogram DMA transfer done.
  */
@@ -63,7 +114,11 @@ static int _dma_histo_callback(void *arg, void* arg2)
 
 	cache_invalidate_region((uint32_t*)iscd->pipe.histo_buf,
 			HIST_ENTRIES * sizeof(uint32_t));
-	awb.dma.dma_histo_done = true;
+
+	if (_3a.enabled)
+		_iscd_3a_histogram_done(iscd);
+	else
+		awb.dma.dma_histo_done = true;
 
 	return 0;
 }
@@ -168,6 +223,121 @@ static void _awb_count_up(uint32_t* buf)
 		awb.count[awb.op_mode] += (*buf++) * i;
 }
 
+/**
+ * \brief Update the transfer addresses of a capture DMA descriptor.
+ */
+static void _iscd_dma_set_frame(struct _iscd_desc* desc, uint8_t d, uint8_t frame)
+{
+	struct _iscd_frame* f = &desc->pool.frames[frame];
+
+	desc->pool.desc_frame[d] = frame;
+
+	switch (desc->cfg.layout) {
+	case ISCD_LAYOUT_PACKED8:
+	case ISCD_LAYOUT_PACKED16:
+	case ISCD_LAYOUT_PACKED32:
+		_isc_dma_view_pool.view0[d].addr = f->addr[0];
+		cache_clean_region(&_isc_dma_view_pool.view0[d],
+				sizeof(struct _isc_dma_view0));
+		break;
+	case ISCD_LAYOUT_YC420SP:
+	case ISCD_LAYOUT_YC422SP:
+		_isc_dma_view_pool.view1[d].addr0 = f->addr[0];
+		_isc_dma_view_pool.view1[d].addr1 = f->addr[1];
+		cache_clean_region(&_isc_dma_view_pool.view1[d],
+				sizeof(struct _isc_dma_view1));
+		break;
+	case ISCD_LAYOUT_YC422P:
+	case ISCD_LAYOUT_YC420P:
+		_isc_dma_view_pool.view2[d].addr0 = f->addr[0];
+		_isc_dma_view_pool.view2[d].addr1 = f->addr[1];
+		_isc_dma_view_pool.view2[d].addr2 = f->addr[2];
+		cache_clean_region(&_isc_dma_view_pool.view2[d],
+				sizeof(struct _isc_dma_view2));
+		break;
+	}
+}
+
+/**
+ * \brief Find a frame buffer that can be used for the next capture.
+ * \return frame index or -1 if every buffer is in use
+ */
+static int _iscd_frame_find_free(struct _iscd_desc* desc)
+{
+	uint8_t i;
+
+	for (i = 0; i < desc->cfg.multi_bufs; i++) {
+		if (desc->pool.frames[i].state == ISCD_FRAME_FREE)
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * \brief Make a completed frame the most recent frame.
+ */
+static void _iscd_frame_publish(struct _iscd_desc* desc, uint8_t frame)
+{
+	struct _iscd_frame* f = &desc->pool.frames[frame];
+
+	if (desc->pool.latest >= 0 && desc->pool.latest != frame) {
+		struct _iscd_frame* prev = &desc->pool.frames[desc->pool.latest];
+		if (!prev->consumed)
+			desc->pool.stats.skipped++;
+		if (prev->refcount == 0)
+			prev->state = ISCD_FRAME_FREE;
+	}
+
+	f->state = ISCD_FRAME_READY;
+	f->consumed = false;
+	f->sequence = desc->pool.sequence;
+	f->timestamp = desc->pool.start_tick;
+	desc->pool.latest = frame;
+	desc->pool.stats.delivered++;
+
+	desc->pipe.frame_idx = frame;
+	if (desc->dma.callback)
+		desc->dma.callback(frame);
+}
+
+/**
+ * \brief Handle the completion of a capture DMA descriptor.
+ *
+ * The ISC has already loaded the next descriptor when the DMA done interrupt
+ * is raised, so the descriptor that just completed is the one that will be
+ * loaded for the frame after it. It is relinked to a free buffer. If no
+ * buffer is free (all held by consumers), it is pointed at the buffer being
+ * captured, and that frame is dropped instead of being published while it
+ * is overwritten.
+ */
+static void _iscd_frame_done(struct _iscd_desc* desc)
+{
+	uint8_t done_desc = desc->pool.hw_desc;
+	uint8_t done = desc->pool.desc_frame[done_desc];
+	uint8_t cur = desc->pool.desc_frame[done_desc ^ 1];
+	int next;
+
+	desc->pool.hw_desc ^= 1;
+	desc->pool.sequence++;
+	desc->pool.stats.captured++;
+
+	if (done == cur && desc->cfg.multi_bufs > 1)
+		desc->pool.stats.dropped++;
+	else
+		_iscd_frame_publish(desc, done);
+
+	if (desc->cfg.multi_bufs == 1)
+		return;
+
+	next = _iscd_frame_find_free(desc);
+	if (next < 0) {
+		next = cur;
+	} else {
+		desc->pool.frames[next].state = ISCD_FRAME_CAPTURE;
+	}
+	_iscd_dma_set_frame(desc, done_desc, next);
+}
+
 /**
  * \brief ISC interrupt handler.
  */
@@ -177,95 +347,116 @@ static void _isc_handler(uint32_t source, void* arg)
 	uint32_t status;
 
 	status = isc_interrupt_status();
-	if ((status & ISC_INTSR_VD) == ISC_INTSR_VD) {
-		if (iscd->pipe.frame_idx == (iscd->cfg.multi_bufs - 1))
-			iscd->pipe.frame_idx = 0;
+	if ((status & ISC_INTSR_VD) == ISC_INTSR_VD)
+		iscd->pool.start_tick = timer_get_tick();
+	if ((status & ISC_INTSR_DDONE) == ISC_INTSR_DDONE)
+		_iscd_frame_done(iscd);
+	if ((status & ISC_INTSR_HISDONE) == ISC_INTSR_HISDONE) {
+		if (_3a.enabled)
+			_iscd_dma_read_histogram((uint32_t)iscd->pipe.histo_buf);
 		else
-			iscd->pipe.frame_idx++;
-		if (iscd->dma.callback)
-			iscd->dma.callback(iscd->pipe.frame_idx);
+			awb.dma.dma_histo_ready = true;
 	}
-	if ((status & ISC_INTSR_HISDONE) == ISC_INTSR_HISDONE)
-		awb.dma.dma_histo_ready = true;
 }
 
 /**
- * \brief Setup DMA Descriptors.
+ * \brief Initialize the frame pool and the capture DMA descriptors.
  */
 static uint8_t _iscd_configure_dma(struct _iscd_desc* desc)
 {
 	uint32_t i;
-	struct _isc_dma_view0* dma_view0;
-	struct _isc_dma_view1* dma_view1;
-	struct _isc_dma_view2* dma_view2;
+	uint32_t ctrl;
+	uint8_t d;
+
+	if (desc->cfg.multi_bufs == 0 || desc->cfg.multi_bufs > ISCD_MAX_FRAMES)
+		return ISCD_ERROR_CONFIG;
+
+	/* With two buffers, one is always being captured and the other holds
+	 * the published frame, so no buffer is ever free for the descriptor
+	 * relinked at DDONE and every frame after the first would be dropped.
+	 * The published frame cannot be recycled either: a consumer may acquire
+	 * it after the relink, while the ISC is about to overwrite it. */
+	if (desc->cfg.multi_bufs == 2)
+		return ISCD_ERROR_CONFIG;
+
+	memset(&desc->pool, 0, sizeof(desc->pool));
+	desc->pool.latest = -1;
+	for (i = 0; i < desc->cfg.multi_bufs; i++) {
+		desc->pool.frames[i].index = i;
+		desc->pool.frames[i].state = ISCD_FRAME_FREE;
+		desc->pool.frames[i].addr[0] = desc->dma.address0 + i * desc->dma.size;
+		desc->pool.frames[i].addr[1] = desc->dma.address1 + i * desc->dma.size;
+		desc->pool.frames[i].addr[2] = desc->dma.address2 + i * desc->dma.size;
+	}
 
 	switch (desc->cfg.layout) {
 	case ISCD_LAYOUT_PACKED8:
 	case ISCD_LAYOUT_PACKED16:
 	case ISCD_LAYOUT_PACKED32:
-		dma_view0 = _isc_dma_view_pool.view0;
-		for (i = 0; i < desc->cfg.multi_bufs; i++) {
-			dma_view0[i].ctrl = ISC_DCTRL_DVIEW_PACKED | ISC_DCTRL_DE;
-			dma_view0[i].next_desc = (uint32_t)&dma_view0[i + 1];
-			dma_view0[i].addr = (uint32_t)desc->dma.address0 + i * desc->dma.size;
-			dma_view0[i].stride = 0;
+		ctrl = ISC_DCTRL_DVIEW_PACKED;
+		for (d = 0; d < ISCD_CAPTURE_DESC; d++) {
+			_isc_dma_view_pool.view0[d].ctrl = ctrl | ISC_DCTRL_IE | ISC_DCTRL_DE;
+			_isc_dma_view_pool.view0[d].next_desc =
+				(uint32_t)&_isc_dma_view_pool.view0[d ^ 1];
+			_isc_dma_view_pool.view0[d].stride = 0;
 		}
-		dma_view0[i - 1].next_desc = (uint32_t)&dma_view0[0];
-		cache_clean_region(dma_view0, sizeof(struct _isc_dma_view0) * desc->cfg.multi_bufs);
-		isc_dma_configure_desc_entry((uint32_t)&dma_view0[0]);
 		isc_dma_configure_input_mode(ISC_DCFG_IMODE(desc->cfg.layout) |
 		                             ISC_DCFG_YMBSIZE_BEATS8);
-		isc_dma_enable(ISC_DCTRL_DVIEW_PACKED | ISC_DCTRL_DE);
 		break;
 
 	case ISCD_LAYOUT_YC420SP:
 	case ISCD_LAYOUT_YC422SP:
 		/* Set DAM for 16-bit YC422SP/YC420SP with stream descriptor view 1
 			for YCbCr planar pixel stream */
-		dma_view1 = _isc_dma_view_pool.view1;
-		for(i = 0; i < desc->cfg.multi_bufs; i++) {
-			dma_view1[i].ctrl = ISC_DCTRL_DVIEW_SEMIPLANAR | ISC_DCTRL_DE;
-			dma_view1[i].next_desc = (uint32_t)&dma_view1[i + 1];
-			dma_view1[i].addr0 = (uint32_t)desc->dma.address0 + i * desc->dma.size;
-			dma_view1[i].stride0 = 0;
-			dma_view1[i].addr1 = (uint32_t)desc->dma.address1 + i * desc->dma.size;;
-			dma_view1[i].stride1 = 0;
+		ctrl = ISC_DCTRL_DVIEW_SEMIPLANAR;
+		for (d = 0; d < ISCD_CAPTURE_DESC; d++) {
+			_isc_dma_view_pool.view1[d].ctrl = ctrl | ISC_DCTRL_IE | ISC_DCTRL_DE;
+			_isc_dma_view_pool.view1[d].next_desc =
+				(uint32_t)&_isc_dma_view_pool.view1[d ^ 1];
+			_isc_dma_view_pool.view1[d].stride0 = 0;
+			_isc_dma_view_pool.view1[d].stride1 = 0;
 		}
-		dma_view1[i - 1].next_desc = (uint32_t)&dma_view1[0];
-		cache_clean_region(dma_view1, sizeof(struct _isc_dma_view1) * desc->cfg.multi_bufs);
-		isc_dma_configure_desc_entry((uint32_t)&dma_view1[0]);
 		isc_dma_configure_input_mode(ISC_DCFG_IMODE(desc->cfg.layout) |
 		                             ISC_DCFG_YMBSIZE_BEATS8 | ISC_DCFG_CMBSIZE_BEATS8);
-		isc_dma_enable(ISC_DCTRL_DVIEW_SEMIPLANAR | ISC_DCTRL_DE);
 		break;
 
 	case ISCD_LAYOUT_YC422P:
 	case ISCD_LAYOUT_YC420P:
 		/* Set DAM for 16-bit YC422P/YC420P with stream descriptor view 2
 			for YCbCr planar pixel stream */
-		dma_view2 = _isc_dma_view_pool.view2;
-		for(i = 0; i < desc->cfg.multi_bufs; i++) {
-			dma_view2[i].ctrl = ISC_DCTRL_DVIEW_PLANAR | ISC_DCTRL_DE;
-			dma_view2[i].next_desc = (uint32_t)&dma_view2[i + 1];
-			dma_view2[i].addr0 = (uint32_t)desc->dma.address0 + i * desc->dma.size;;
-			dma_view2[i].stride0 = 0;
-			dma_view2[i].addr1 = (uint32_t)desc->dma.address1 + i * desc->dma.size;;
-			dma_view2[i].stride1 = 0;
-			dma_view2[i].addr2 = (uint32_t)desc->dma.address2 + i * desc->dma.size;;
-			dma_view2[i].stride2 = 0;
+		ctrl = ISC_DCTRL_DVIEW_PLANAR;
+		for (d = 0; d < ISCD_CAPTURE_DESC; d++) {
+			_isc_dma_view_pool.view2[d].ctrl = ctrl | ISC_DCTRL_IE | ISC_DCTRL_DE;
+			_isc_dma_view_pool.view2[d].next_desc =
+				(uint32_t)&_isc_dma_view_pool.view2[d ^ 1];
+			_isc_dma_view_pool.view2[d].stride0 = 0;
+			_isc_dma_view_pool.view2[d].stride1 = 0;
+			_isc_dma_view_pool.view2[d].stride2 = 0;
 		}
-		dma_view2[i - 1].next_desc = (uint32_t)&dma_view2[0];
-		cache_clean_region(dma_view2, sizeof(struct _isc_dma_view2) * desc->cfg.multi_bufs);
-		isc_dma_configure_desc_entry((uint32_t)&dma_view2[0]);
 		isc_dma_configure_input_mode(ISC_DCFG_IMODE(desc->cfg.layout) |
 		                             ISC_DCFG_YMBSIZE_BEATS8 | ISC_DCFG_CMBSIZE_BEATS8);
-		isc_dma_enable(ISC_DCTRL_DVIEW_PLANAR | ISC_DCTRL_DE);
 		break;
 
 	default:
 		return ISCD_ERROR_CONFIG;
 	}
 
+	/* First frame is captured in buffer 0, next one in buffer 1 (or in
+	 * buffer 0 again when a single buffer is configured) */
+	desc->pool.frames[0].state = ISCD_FRAME_CAPTURE;
+	_iscd_dma_set_frame(desc, 0, 0);
+	if (desc->cfg.multi_bufs > 1) {
+		desc->pool.frames[1].state = ISCD_FRAME_CAPTURE;
+		_iscd_dma_set_frame(desc, 1, 1);
+	} else {
+		_iscd_dma_set_frame(desc, 1, 0);
+	}
+	desc->pool.hw_desc = 0;
+
+	/* All descriptor views start at the same address */
+	isc_dma_configure_desc_entry((uint32_t)&_isc_dma_view_pool);
+	isc_dma_enable(ctrl | ISC_DCTRL_IE | ISC_DCTRL_DE);
+
 	return ISCD_OK;
 }
 
@@ -408,7 +599,8 @@ uint8_t iscd_pipe_start(struct _iscd_desc* desc)
 	}
 	isc_rlp_configure(desc->pipe.rlp_mode, 0);
 
-	_iscd_configure_dma(desc);
+	if (_iscd_configure_dma(desc) != ISCD_OK)
+		return ISCD_ERROR_CONFIG;
 
 	awb.state = AWB_INIT;
 	awb.op_mode = 0;
@@ -416,7 +608,7 @@ uint8_t iscd_pipe_start(struct _iscd_desc* desc)
 
 	isc_update_profile();
 	irq_add_handler(ID_ISC, _isc_handler, desc);
-	isc_enable_interrupt(ISC_INTEN_VD | ISC_INTEN_HISDONE);
+	isc_enable_interrupt(ISC_INTEN_VD | ISC_INTEN_DDONE | ISC_INTEN_HISDONE);
 	isc_interrupt_status();
 
 	irq_enable(ID_ISC);
@@ -425,6 +617,97 @@ uint8_t iscd_pipe_start(struct _iscd_desc* desc)
 	return ISCD_OK;
 }
 
+struct _iscd_frame* iscd_frame_acquire(struct _iscd_desc* desc)
+{
+	struct _iscd_frame* frame = NULL;
+
+	irq_disable(ID_ISC);
+	if (desc->pool.latest >= 0) {
+		frame = &desc->pool.frames[desc->pool.latest];
+		frame->refcount++;
+		frame->consumed = true;
+	}
+	irq_enable(ID_ISC);
+
+	return frame;
+}
+
+void iscd_frame_get(struct _iscd_desc* desc, struct _iscd_frame* frame)
+{
+	irq_disable(ID_ISC);
+	frame->refcount++;
+	irq_enable(ID_ISC);
+}
+
+void iscd_frame_release(struct _iscd_desc* desc, struct _iscd_frame* frame)
+{
+	irq_disable(ID_ISC);
+	if (frame->refcount > 0)
+		frame->refcount--;
+	if (frame->refcount == 0 && frame->index != desc->pool.latest)
+		frame->state = ISCD_FRAME_FREE;
+	irq_enable(ID_ISC);
+}
+
+void iscd_frame_get_stats(struct _iscd_desc* desc, struct _iscd_frame_stats* stats)
+{
+	irq_disable(ID_ISC);
+	*stats = desc->pool.stats;
+	irq_enable(ID_ISC);
+}
+
+uint8_t iscd_3a_start(struct _iscd_desc* desc, const struct _iscd_3a_cfg* cfg,
+		uint32_t exposure, uint16_t gain)
+{
+	struct _iscd_3a_cfg default_cfg;
+
+	if (!desc->pipe.histo_enable || !desc->pipe.histo_buf ||
+	    desc->cfg.input_format != RAW_BAYER)
+		return ISCD_ERROR_CONFIG;
+
+	if (!cfg) {
+		iscd_3a_get_default_cfg(&default_cfg);
+		cfg = &default_cfg;
+	}
+
+	irq_disable(ID_ISC);
+	iscd_3a_init(&_3a.engine, cfg, exposure, gain);
+	_3a.desc = desc;
+	_3a.channel = ISCD_3A_GR;
+	_3a.exposure_pending = false;
+	_3a.enabled = true;
+	_iscd_3a_request_histogram();
+	irq_enable(ID_ISC);
+
+	return ISCD_OK;
+}
+
+void iscd_3a_stop(void)
+{
+	_3a.enabled = false;
+}
+
+bool iscd_3a_get_exposure(uint32_t* exposure, uint16_t* gain)
+{
+	bool pending;
+	uint32_t flags;
+
+	/* Results are updated from the DMA callback */
+	flags = arch_irq_save();
+	pending = _3a.exposure_pending;
+	*exposure = _3a.engine.result.exposure;
+	*gain = _3a.engine.result.gain;
+	_3a.exposure_pending = false;
+	arch_irq_restore(flags);
+
+	return pending;
+}
+
+bool iscd_3a_is_converged(void)
+{
+	return _3a.engine.result.converged;
+}
+
 /**
  * \brief Image tuning for AWB, this is a reference algrothm only.
  */
@@ -35,10 +35,12 @@
  *        Header
  *----------------------------------------------------------------------------*/
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "callback.h"
 #include "dma/dma.h"
+#include "video/iscd_3a.h"
 
 /*------------------------------------------------------------------------------
  *        Definition
@@ -47,6 +49,12 @@
 #define MAX_DMA_VIEW_SIZE (sizeof(struct _isc_dma_view2) / sizeof(uint32_t))
 #define ISCD_MAX_DMA_DESC (10)
 
+/** Maximum number of frame buffers managed by the frame pool */
+#define ISCD_MAX_FRAMES ISCD_MAX_DMA_DESC
+
+/** Number of DMA descriptors used for capture (current and next frame) */
+#define ISCD_CAPTURE_DESC (2)
+
 /* GAMMA and HISTOGRAM definitions */
 #define GAMMA_ENTRIES (64)
 
@@ -102,6 +110,31 @@ enum _iscd_bayer_pattern {
 	ISCD_BGBG,
 };
 
+enum _iscd_frame_state {
+	ISCD_FRAME_FREE = 0,     /**< frame buffer available for capture */
+	ISCD_FRAME_CAPTURE,      /**< frame buffer owned by the ISC DMA */
+	ISCD_FRAME_READY,        /**< frame buffer holds a complete image */
+};
+
+/** \brief Frame buffer of the ISCD frame pool */
+struct _iscd_frame {
+	uint8_t index;                  /**< frame buffer index in the pool */
+	enum _iscd_frame_state state;   /**< frame buffer state */
+	volatile uint8_t refcount;      /**< number of consumer references */
+	bool consumed;                  /**< acquired at least once */
+	uint32_t sequence;              /**< capture sequence number */
+	uint64_t timestamp;             /**< capture start tick */
+	uint32_t addr[3];               /**< plane addresses */
+};
+
+/** \brief Frame pool statistics */
+struct _iscd_frame_stats {
+	uint32_t captured;  /**< frames completed by the ISC */
+	uint32_t delivered; /**< frames published to consumers */
+	uint32_t dropped;   /**< frames discarded because no buffer was free */
+	uint32_t skipped;   /**< published frames replaced before any acquire */
+};
+
 enum _iscd_awb_state {
 	AWB_INIT = 0,
 	AWB_WAIT_HIS_READY,
@@ -115,6 +148,8 @@ struct _iscd_desc {
 		uint8_t input_format;
 		uint8_t input_bits;
 		enum _iscd_layout layout;
+		/* number of frame buffers: 1 (capture in place) or 3 to
+		 * ISCD_MAX_FRAMES (frame pool), 2 is rejected */
 		uint8_t multi_bufs;
 	} cfg;
 	struct {
@@ -147,6 +182,16 @@ struct _iscd_desc {
 		uint32_t size;
 		iscd_callback_t callback;
 	} dma;
+	/* frame pool state, managed by the driver */
+	struct {
+		struct _iscd_frame frames[ISCD_MAX_FRAMES];
+		uint8_t desc_frame[ISCD_CAPTURE_DESC];
+		uint8_t hw_desc;
+		int8_t latest;
+		uint32_t sequence;
+		uint64_t start_tick;
+		struct _iscd_frame_stats stats;
+	} pool;
 };
 
 struct _iscd_awb {
@@ -167,6 +212,79 @@ struct _iscd_awb {
 
 extern uint8_t iscd_pipe_start(struct _iscd_desc* desc);
 
+/**
+ * \brief Acquire a reference on the most recent complete frame.
+ *
+ * The frame buffer will not be used for capture until every reference taken
+ * with iscd_frame_acquire() or iscd_frame_get() has been released.
+ *
+ * \param desc  Pointer to the ISCD descriptor
+ * \return Pointer to the frame, or NULL if no frame has been captured yet
+ */
+extern struct _iscd_frame* iscd_frame_acquire(struct _iscd_desc* desc);
+
+/**
+ * \brief Take an additional reference on an already acquired frame, so that
+ * several consumers (USB, LCD, encoder) can share it.
+ *
+ * \param desc  Pointer to the ISCD descriptor
+ * \param frame Pointer to a frame previously returned by iscd_frame_acquire()
+ */
+extern void iscd_frame_get(struct _iscd_desc* desc, struct _iscd_frame* frame);
+
+/**
+ * \brief Release a reference on a frame.
+ *
+ * \param desc  Pointer to the ISCD descriptor
+ * \param frame Pointer to the frame to release
+ */
+extern void iscd_frame_release(struct _iscd_desc* desc, struct _iscd_frame* frame);
+
+/**
+ * \brief Get the frame pool statistics.
+ *
+ * \param desc  Pointer to the ISCD descriptor
+ * \param stats Pointer to the structure receiving the statistics
+ */
+extern void iscd_frame_get_stats(struct _iscd_desc* desc, struct _iscd_frame_stats* stats);
+
 extern void iscd_auto_white_balance_ref_algo(uint32_t* histo_buf);
 
+/**
+ * \brief Start the interrupt driven 3A (AE/AGC/AWB) engine.
+ *
+ * Histograms of the four bayer channels are read in turn from the ISC
+ * histogram interrupt and the DMA callback, white balance gains are applied
+ * to the ISC directly. Sensor exposure and gain updates are retrieved with
+ * iscd_3a_get_exposure() and written to the sensor from thread context.
+ * This must not be used together with iscd_auto_white_balance_ref_algo().
+ *
+ * \param desc     Pointer to a started ISCD descriptor (RAW_BAYER input,
+ *                 histogram enabled)
+ * \param cfg      3A tuning, NULL for iscd_3a_get_default_cfg() values
+ * \param exposure Current sensor exposure, in lines
+ * \param gain     Current sensor analog gain, in 1/16 units
+ * \return ISCD_OK if successful, ISCD_ERROR_CONFIG otherwise
+ */
+extern uint8_t iscd_3a_start(struct _iscd_desc* desc, const struct _iscd_3a_cfg* cfg,
+		uint32_t exposure, uint16_t gain);
+
+/**
+ * \brief Stop the 3A engine after the current histogram.
+ */
+extern void iscd_3a_stop(void);
+
+/**
+ * \brief Get pending sensor exposure and gain computed by the 3A engine.
+ * \param exposure Pointer receiving the exposure, in lines
+ * \param gain     Pointer receiving the analog gain, in 1/16 units
+ * \return true if new values are available since the last call
+ */
+extern bool iscd_3a_get_exposure(uint32_t* exposure, uint16_t* gain);
+
+/**
+ * \brief Tell if auto exposure has converged.
+ */
+extern bool iscd_3a_is_converged(void);
+
 #endif /* ISCD_H_ */
@@ -0,0 +1,238 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file
+ *
+ * Auto exposure, auto gain and auto white balance engine working on the
+ * statistics of the ISC histograms.
+ *
+ * This file does not access any hardware so that the algorithms can be run
+ * on recorded histograms.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "video/iscd_3a.h"
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static uint32_t _clamp(uint32_t value, uint32_t min, uint32_t max)
+{
+	if (value < min)
+		return min;
+	if (value > max)
+		return max;
+	return value;
+}
+
+/**
+ * \brief Move current value toward target by rate/256 of the error, moving
+ * by at least one unit so that the loop always converges.
+ */
+static uint32_t _approach(uint32_t current, uint32_t target, uint8_t rate)
+{
+	uint32_t step;
+
+	if (target > current) {
+		step = (uint32_t)(((uint64_t)(target - current) * rate) >> 8);
+		return current + (step ? step : 1);
+	} else if (target < current) {
+		step = (uint32_t)(((uint64_t)(current - target) * rate) >> 8);
+		return current - (step ? step : 1);
+	}
+	return current;
+}
+
+static void _iscd_3a_auto_exposure(struct _iscd_3a* ctx)
+{
+	struct _iscd_3a_cfg* cfg = &ctx->cfg;
+	struct _iscd_3a_result* res = &ctx->result;
+	uint32_t pixels, saturated, mean, target, tolerance;
+	uint32_t exposure, gain;
+	uint64_t total, desired, lower, upper;
+
+	pixels = ctx->pixels[ISCD_3A_GR] + ctx->pixels[ISCD_3A_GB];
+	if (pixels == 0)
+		return;
+	saturated = ctx->saturated[ISCD_3A_GR] + ctx->saturated[ISCD_3A_GB];
+	mean = (ctx->mean[ISCD_3A_GR] + ctx->mean[ISCD_3A_GB]) / 2;
+
+	/* Lower the target when too many pixels are clipped */
+	target = (uint32_t)cfg->target << 4;
+	if ((uint32_t)(((uint64_t)saturated << 8) / pixels) > cfg->saturation_limit)
+		target = (target * 3) / 4;
+	tolerance = (uint32_t)cfg->tolerance << 4;
+
+	if (mean + tolerance >= target && mean <= target + tolerance) {
+		res->converged = true;
+		return;
+	}
+	res->converged = false;
+
+	/* Exposure/gain product needed to reach the target, limited to
+	 * max_step per iteration to avoid oscillations */
+	total = (uint64_t)res->exposure * res->gain;
+	desired = (total * target) / (mean ? mean : 1);
+	lower = (total << 8) / cfg->max_step;
+	upper = (total * cfg->max_step) >> 8;
+	if (desired < lower)
+		desired = lower;
+	if (desired > upper)
+		desired = upper;
+	if (total < 0xffffffffu && desired < 0xffffffffu)
+		desired = _approach((uint32_t)total, (uint32_t)desired, cfg->ae_rate);
+
+	/* Prefer exposure time over gain to keep noise low */
+	exposure = (uint32_t)_clamp((uint32_t)(desired / cfg->gain_min),
+			cfg->exposure_min, cfg->exposure_max);
+	gain = _clamp((uint32_t)(desired / exposure), cfg->gain_min, cfg->gain_max);
+
+	if (exposure != res->exposure || gain != res->gain) {
+		res->exposure = exposure;
+		res->gain = gain;
+		res->exposure_changed = true;
+	}
+}
+
+static void _iscd_3a_auto_white_balance(struct _iscd_3a* ctx)
+{
+	struct _iscd_3a_cfg* cfg = &ctx->cfg;
+	struct _iscd_3a_result* res = &ctx->result;
+	uint32_t green, target, wb;
+	uint8_t i;
+
+	/* Grey world: every channel is scaled to the average green level */
+	green = (ctx->mean_unsat[ISCD_3A_GR] + ctx->mean_unsat[ISCD_3A_GB]) / 2;
+	if (green == 0)
+		return;
+
+	for (i = 0; i < ISCD_3A_CHANNELS; i++) {
+		if (ctx->mean_unsat[i] == 0)
+			continue;
+		target = (green * ISCD_3A_WB_UNITY) / ctx->mean_unsat[i];
+		target = _clamp(target, cfg->wb_min, cfg->wb_max);
+		wb = _approach(res->wb[i], target, cfg->awb_rate);
+		if (wb != res->wb[i]) {
+			res->wb[i] = wb;
+			res->wb_changed = true;
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------
+ *        Public functions
+ *----------------------------------------------------------------------------*/
+
+void iscd_3a_get_default_cfg(struct _iscd_3a_cfg* cfg)
+{
+	cfg->target = 100;
+	cfg->tolerance = 6;
+	cfg->saturation_bin = 500;
+	cfg->saturation_limit = 8;
+	cfg->ae_rate = 128;
+	cfg->awb_rate = 64;
+	cfg->max_step = 512;
+	cfg->exposure_min = 1;
+	cfg->exposure_max = 1000;
+	cfg->gain_min = ISCD_3A_GAIN_UNITY;
+	cfg->gain_max = 8 * ISCD_3A_GAIN_UNITY;
+	cfg->wb_min = ISCD_3A_WB_UNITY / 4;
+	cfg->wb_max = 8 * ISCD_3A_WB_UNITY - 1;
+}
+
+void iscd_3a_init(struct _iscd_3a* ctx, const struct _iscd_3a_cfg* cfg,
+		uint32_t exposure, uint16_t gain)
+{
+	uint8_t i;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->cfg = *cfg;
+	if (ctx->cfg.gain_min == 0)
+		ctx->cfg.gain_min = ISCD_3A_GAIN_UNITY;
+	if (ctx->cfg.exposure_min == 0)
+		ctx->cfg.exposure_min = 1;
+	if (ctx->cfg.max_step <= 256)
+		ctx->cfg.max_step = 257;
+
+	ctx->result.exposure = _clamp(exposure, ctx->cfg.exposure_min,
+			ctx->cfg.exposure_max);
+	ctx->result.gain = _clamp(gain, ctx->cfg.gain_min, ctx->cfg.gain_max);
+	for (i = 0; i < ISCD_3A_CHANNELS; i++)
+		ctx->result.wb[i] = ISCD_3A_WB_UNITY;
+}
+
+bool iscd_3a_add_histogram(struct _iscd_3a* ctx, uint8_t channel,
+		const uint32_t* histo)
+{
+	uint32_t i;
+	uint32_t pixels = 0, unsat = 0, saturated = 0;
+	uint64_t sum = 0, sum_unsat = 0;
+
+	if (channel >= ISCD_3A_CHANNELS)
+		return false;
+
+	for (i = 0; i < ISCD_3A_HIST_ENTRIES; i++) {
+		pixels += histo[i];
+		sum += (uint64_t)histo[i] * i;
+		if (i < ctx->cfg.saturation_bin) {
+			unsat += histo[i];
+			sum_unsat += (uint64_t)histo[i] * i;
+		} else {
+			saturated += histo[i];
+		}
+	}
+
+	ctx->pixels[channel] = pixels;
+	ctx->saturated[channel] = saturated;
+	ctx->mean[channel] = pixels ? (uint32_t)((sum << 4) / pixels) : 0;
+	ctx->mean_unsat[channel] = unsat ? (uint32_t)((sum_unsat << 4) / unsat) : 0;
+	ctx->channels |= 1 << channel;
+
+	return ctx->channels == ((1 << ISCD_3A_CHANNELS) - 1);
+}
+
+const struct _iscd_3a_result* iscd_3a_update(struct _iscd_3a* ctx)
+{
+	ctx->result.exposure_changed = false;
+	ctx->result.wb_changed = false;
+
+	_iscd_3a_auto_exposure(ctx);
+	_iscd_3a_auto_white_balance(ctx);
+
+	ctx->channels = 0;
+	ctx->iterations++;
+
+	return &ctx->result;
+}
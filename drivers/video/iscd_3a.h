@@ -0,0 +1,159 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef ISCD_3A_H_
+#define ISCD_3A_H_
+
+/*------------------------------------------------------------------------------
+ *        Header
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *        Definition
+ *----------------------------------------------------------------------------*/
+
+/** Number of histogram bins delivered by the ISC */
+#define ISCD_3A_HIST_ENTRIES (512)
+
+/** Histogram channels, same order as the ISC_HIS_CFG.MODE bayer values */
+#define ISCD_3A_GR (0)
+#define ISCD_3A_R  (1)
+#define ISCD_3A_GB (2)
+#define ISCD_3A_B  (3)
+#define ISCD_3A_CHANNELS (4)
+
+/** Unity gain for sensor analog gain (4 fractional bits) */
+#define ISCD_3A_GAIN_UNITY (16)
+
+/** Unity gain for ISC white balance gains (unsigned 0:4:9) */
+#define ISCD_3A_WB_UNITY (512)
+
+/*------------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** \brief 3A engine tuning */
+struct _iscd_3a_cfg {
+	/** Target mean level of the green channels (0..511) */
+	uint16_t target;
+	/** Half width of the dead band around target in which AE is idle */
+	uint16_t tolerance;
+	/** First bin considered saturated */
+	uint16_t saturation_bin;
+	/** Maximum saturated pixels ratio (per 256) before target is lowered */
+	uint8_t saturation_limit;
+	/** Fraction of the error corrected per iteration (per 256) for AE */
+	uint8_t ae_rate;
+	/** Fraction of the error corrected per iteration (per 256) for AWB */
+	uint8_t awb_rate;
+	/** Maximum exposure*gain change factor per iteration (per 256, > 256) */
+	uint16_t max_step;
+	/** Exposure limits, in sensor lines */
+	uint32_t exposure_min;
+	uint32_t exposure_max;
+	/** Analog gain limits (ISCD_3A_GAIN_UNITY is 1x) */
+	uint16_t gain_min;
+	uint16_t gain_max;
+	/** White balance gain limits (ISCD_3A_WB_UNITY is 1x) */
+	uint16_t wb_min;
+	uint16_t wb_max;
+};
+
+/** \brief 3A engine output */
+struct _iscd_3a_result {
+	uint32_t exposure;               /**< sensor exposure, in lines */
+	uint16_t gain;                   /**< sensor analog gain */
+	uint16_t wb[ISCD_3A_CHANNELS];   /**< ISC white balance gains */
+	bool exposure_changed;           /**< exposure or gain updated */
+	bool wb_changed;                 /**< white balance gains updated */
+	bool converged;                  /**< AE is within tolerance */
+};
+
+/** \brief 3A engine state */
+struct _iscd_3a {
+	struct _iscd_3a_cfg cfg;
+	struct _iscd_3a_result result;
+	/** statistics of the last histograms, per channel */
+	uint32_t mean[ISCD_3A_CHANNELS];     /**< mean level, 4 fractional bits */
+	uint32_t mean_unsat[ISCD_3A_CHANNELS]; /**< mean of unsaturated bins */
+	uint32_t pixels[ISCD_3A_CHANNELS];
+	uint32_t saturated[ISCD_3A_CHANNELS];
+	uint8_t channels;                    /**< bitmask of channels received */
+	uint32_t iterations;
+};
+
+/*------------------------------------------------------------------------------
+ *        Functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Fill a configuration with default tuning values.
+ * \param cfg  Pointer to the configuration to fill
+ */
+extern void iscd_3a_get_default_cfg(struct _iscd_3a_cfg* cfg);
+
+/**
+ * \brief Initialize the 3A engine.
+ * \param ctx       Pointer to the 3A engine state
+ * \param cfg       Tuning parameters
+ * \param exposure  Initial sensor exposure, in lines
+ * \param gain      Initial sensor analog gain
+ */
+extern void iscd_3a_init(struct _iscd_3a* ctx, const struct _iscd_3a_cfg* cfg,
+		uint32_t exposure, uint16_t gain);
+
+/**
+ * \brief Feed a histogram of one bayer channel.
+ *
+ * Only the statistics are computed here, the histogram buffer can be reused
+ * as soon as this function returns.
+ *
+ * \param ctx      Pointer to the 3A engine state
+ * \param channel  ISCD_3A_GR, ISCD_3A_R, ISCD_3A_GB or ISCD_3A_B
+ * \param histo    ISCD_3A_HIST_ENTRIES histogram bins
+ * \return true when all channels have been received since the last update
+ */
+extern bool iscd_3a_add_histogram(struct _iscd_3a* ctx, uint8_t channel,
+		const uint32_t* histo);
+
+/**
+ * \brief Run one AE/AGC/AWB iteration from the collected statistics.
+ *
+ * The computation uses integer arithmetic only so that results are
+ * bit-exact between the target and a host build.
+ *
+ * \param ctx  Pointer to the 3A engine state
+ * \return Pointer to the updated result
+ */
+extern const struct _iscd_3a_result* iscd_3a_update(struct _iscd_3a* ctx);
+
+#endif /* ISCD_3A_H_ */
@@ -5254,6 +5254,17 @@ static const struct sensor_output ov5640_output_wxga =
 static const struct sensor_output ov5640_output_af =
 { 1, 0, 0, 0, 1, 0, 0, ov5640_afc };
 
+static const struct sensor_exposure_ctrl ov5640_exposure =
+{
+	{ 0x3500, 0x3501, 0x3502 },      /* AEC PK EXPOSURE[19:0], 1/16 line units */
+	4,
+	{ 0x350a, 0x350b },              /* AEC PK REAL GAIN[9:0], 1/16 units */
+	0,
+	0x3503, 0x03, 0x03,              /* AEC/AGC manual */
+	984,
+	0x3ff
+};
+
 const struct sensor_profile ov5640_profile =
 {
 	"OV5640",
@@ -5273,5 +5284,6 @@ const struct sensor_profile ov5640_profile =
 		&ov5640_output_af,
 		0,
 		0
-	}
+	},
+	&ov5640_exposure
 };
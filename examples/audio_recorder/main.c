@@ -108,6 +108,7 @@
 #include "chip.h"
 #include "board.h"
 #include "compiler.h"
+#include "cycles.h"
 #include "trace.h"
 #include "timer.h"
 #include "wav.h"
@@ -116,6 +117,7 @@
 #include "peripherals/pmc.h"
 #include "peripherals/wdt.h"
 #include "dma/dma.h"
+#include "audio/audio_dsp.h"
 
 #include "compiler.h"
 
@@ -155,6 +157,9 @@
 /* record 10 seconds */
 #define SAMPLE_COUNT (10 * SAMPLE_RATE)
 
+/* samples processed by the capture chain benchmark */
+#define BENCH_SAMPLES (4096)
+
 
 /*----------------------------------------------------------------------------
  *         Internal variables
@@ -168,6 +173,14 @@ static volatile bool _sound_recorded = false;
 /** audio playing volume */
 static uint8_t play_vol = AUDIO_PLAY_MAX_VOLUME/2;
 
+/** capture processing: high-pass (DC removal) then AGC */
+static struct _audio_dsp _record_dsp;
+static struct _audio_dsp_stage _record_hpf;
+static struct _audio_dsp_stage _record_agc;
+static bool _record_dsp_on = false;
+
+static int16_t _bench_buffer[BENCH_SAMPLES];
+
 struct {
 	mutex_t rx;
 	mutex_t tx;
@@ -227,6 +240,9 @@ static void _display_menu(void)
 	printf("P -> Playback the record sound \n\r");
 	printf("+ -> Increase the volume of playback sound \n\r");
 	printf("- -> Decrease the volume of playback sound \n\r");
+	printf("D -> Enable/disable the capture processing (%s) \n\r",
+	       _record_dsp_on ? "on" : "off");
+	printf("B -> Benchmark the capture processing \n\r");
 	printf("=>");
 }
 
@@ -245,6 +261,71 @@ static void _play_start(void)
 	audio_enable(&audio_play_device, true);
 }
 
+/**
+ * \brief Build the capture processing chain: 80Hz high-pass filter to
+ * remove DC and rumble, then AGC to -6dBFS with up to 24dB of gain.
+ */
+static void _configure_record_dsp(void)
+{
+	struct _audio_dsp_biquad hpf;
+	const struct _audio_dsp_agc_cfg agc = {
+		.target_dbfs = -6,
+		.max_gain_db = 24,
+		.attack_ms = 5,
+		.release_ms = 500,
+	};
+	uint32_t rate = audio_record_device.sample_rate;
+
+	audio_dsp_init(&_record_dsp, rate, audio_record_device.num_channels,
+		       audio_record_device.bits_per_sample);
+	audio_dsp_design_biquad(&hpf, AUDIO_DSP_HIGHPASS, rate, 80,
+				AUDIO_DSP_FIXED(0.707), 0);
+	audio_dsp_biquad_init(&_record_hpf, &hpf, 1);
+	audio_dsp_add_stage(&_record_dsp, &_record_hpf);
+	audio_dsp_agc_init(&_record_agc, &agc, rate);
+	audio_dsp_add_stage(&_record_dsp, &_record_agc);
+}
+
+/**
+ * \brief Attach or detach the capture processing chain. The whole record
+ * is processed at the end of the capture, before the completion callback.
+ */
+static void _toggle_record_dsp(void)
+{
+	_record_dsp_on = !_record_dsp_on;
+	audio_set_dsp(&audio_record_device, _record_dsp_on ? &_record_dsp : NULL);
+	printf("Capture processing %s\r\n", _record_dsp_on ? "enabled" : "disabled");
+}
+
+/**
+ * \brief Measure the cost of the capture processing chain, in CPU cycles
+ * per sample.
+ */
+static void _benchmark_record_dsp(void)
+{
+#ifdef ARCH_HAVE_CYCLE_COUNTER
+	uint32_t frames = BENCH_SAMPLES / audio_record_device.num_channels;
+	uint32_t samples = frames * audio_record_device.num_channels;
+	uint32_t i, start, cycles;
+
+	/* 375Hz square wave at -12dBFS */
+	for (i = 0; i < BENCH_SAMPLES; i++)
+		_bench_buffer[i] = (i & 64) ? 8192 : -8192;
+
+	audio_dsp_reset(&_record_dsp);
+	arch_cycles_enable();
+	start = arch_cycles_read();
+	audio_dsp_process(&_record_dsp, _bench_buffer, frames);
+	cycles = arch_cycles_read() - start;
+	audio_dsp_reset(&_record_dsp);
+
+	printf("Capture processing: %u cycles for %u samples, %u cycles/sample\r\n",
+	       (unsigned)cycles, (unsigned)samples, (unsigned)(cycles / samples));
+#else
+	printf("No cycle counter on this core\r\n");
+#endif
+}
+
 /**
  * \brief Record sound.
  */
@@ -312,6 +393,9 @@ extern int main(void)
 	/* Configure audio play volume */
 	audio_set_volume(&audio_play_device, play_vol);
 
+	/* Build the capture processing chain, detached by default */
+	_configure_record_dsp();
+
 	/* Infinite loop */
 	while (1) {
 		_display_menu();
@@ -322,6 +406,10 @@ extern int main(void)
 			_record_sound();
 		else if (key == 'p' || key == 'P')
 			_playback_sound();
+		else if (key == 'd' || key == 'D')
+			_toggle_record_dsp();
+		else if (key == 'b' || key == 'B')
+			_benchmark_record_dsp();
 		else if (key == '+') {
 			if (play_vol < AUDIO_PLAY_MAX_VOLUME) {
 				play_vol += 10;
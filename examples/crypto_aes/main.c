@@ -111,6 +111,7 @@
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
 #include "serial/console.h"
+#include "timer.h"
 #include "trace.h"
 
 /*----------------------------------------------------------------------------
@@ -184,6 +185,17 @@ CACHE_ALIGNED static uint32_t msg_aad[DATA_LEN_INWORD];
 
 #ifdef CONFIG_HAVE_AES_GCM
 CACHE_ALIGNED static uint32_t buffer[8];
+
+/* GCM batch benchmark: records per batch, batches per size, and maximum
+ * record size rounded up to a cache line */
+#define AES_BATCH_RECORDS	8
+#define AES_BATCH_LOOPS		32
+#define AES_BATCH_MAX_SIZE	1504
+#define AES_BATCH_FRAGMENTS	3
+
+CACHE_ALIGNED static uint8_t batch_clear[AES_BATCH_RECORDS][AES_BATCH_MAX_SIZE];
+CACHE_ALIGNED static uint8_t batch_encrypted[AES_BATCH_RECORDS][AES_BATCH_MAX_SIZE];
+CACHE_ALIGNED static uint8_t batch_decrypted[AES_BATCH_RECORDS][AES_BATCH_MAX_SIZE];
 #endif
 
 static volatile bool dma_rd_complete = false;
@@ -436,6 +448,109 @@ static void full_aes_test(void)
 	printf("TEST SUCCESS !\r\n");
 }
 
+#ifdef CONFIG_HAVE_AES_GCM
+/**
+ * \brief Split a record payload in AES_BATCH_FRAGMENTS word-sized fragments,
+ * the way a network stack would hand over a chained packet.
+ */
+static void fragment_record(uint8_t* data, uint32_t size, struct _buffer* frags)
+{
+	uint32_t chunk = (size / AES_BATCH_FRAGMENTS) & ~3;
+	uint8_t i;
+
+	for (i = 0; i < AES_BATCH_FRAGMENTS; i++) {
+		frags[i].data = data;
+		frags[i].size = (i == AES_BATCH_FRAGMENTS - 1) ? size : chunk;
+		data += frags[i].size;
+		size -= frags[i].size;
+	}
+}
+
+/**
+ * \brief Run batched GCM on fragmented 64/512/1500-byte records, check the
+ * round trip and report packets per second.
+ */
+static void gcm_batch_test(void)
+{
+	static const uint32_t sizes[] = { 64, 512, 1500 };
+	static struct _buffer frags_clear[AES_BATCH_RECORDS][AES_BATCH_FRAGMENTS];
+	static struct _buffer frags_enc[AES_BATCH_RECORDS][AES_BATCH_FRAGMENTS];
+	static struct _buffer frags_dec[AES_BATCH_RECORDS][AES_BATCH_FRAGMENTS];
+	static struct _aesd_gcm_record records[AES_BATCH_RECORDS];
+	static uint32_t enc_tags[AES_BATCH_RECORDS][4];
+	static uint32_t dec_tags[AES_BATCH_RECORDS][4];
+	struct _buffer aad = {
+		.data = (uint8_t*)aes_aad,
+		.size = sizeof(aes_aad),
+	};
+	uint32_t i, j, size, elapsed;
+	uint64_t start;
+	bool ok;
+
+	aesd.cfg.key[0] = AES_KEY_0;
+	aesd.cfg.key[1] = AES_KEY_1;
+	aesd.cfg.key[2] = AES_KEY_2;
+	aesd.cfg.key[3] = AES_KEY_3;
+	aesd.cfg.key[4] = AES_KEY_4;
+	aesd.cfg.key[5] = AES_KEY_5;
+	aesd.cfg.key[6] = AES_KEY_6;
+	aesd.cfg.key[7] = AES_KEY_7;
+
+	for (i = 0; i < AES_BATCH_RECORDS; i++)
+		for (j = 0; j < AES_BATCH_MAX_SIZE; j++)
+			batch_clear[i][j] = example_text[(i + j) % DATA_LEN_INBYTE];
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		size = sizes[i];
+		for (j = 0; j < AES_BATCH_RECORDS; j++) {
+			fragment_record(batch_clear[j], size, frags_clear[j]);
+			fragment_record(batch_encrypted[j], size, frags_enc[j]);
+			fragment_record(batch_decrypted[j], size, frags_dec[j]);
+			records[j].aad = &aad;
+			records[j].iv[0] = AES_VECTOR_0;
+			records[j].iv[1] = AES_VECTOR_1;
+			records[j].iv[2] = j;
+			records[j].in = frags_clear[j];
+			records[j].in_count = AES_BATCH_FRAGMENTS;
+			records[j].out = frags_enc[j];
+			records[j].out_count = AES_BATCH_FRAGMENTS;
+		}
+
+		aesd.cfg.encrypt = true;
+		start = timer_get_tick();
+		for (j = 0; j < AES_BATCH_LOOPS; j++) {
+			aesd_gcm_batch(&aesd, records, AES_BATCH_RECORDS, enc_tags, NULL);
+			aesd_wait_transfer(&aesd);
+		}
+		elapsed = (uint32_t)timer_get_interval(start, timer_get_tick());
+
+		for (j = 0; j < AES_BATCH_RECORDS; j++) {
+			records[j].in = frags_enc[j];
+			records[j].out = frags_dec[j];
+		}
+		aesd.cfg.encrypt = false;
+		memset(batch_decrypted, 0, sizeof(batch_decrypted));
+		aesd_gcm_batch(&aesd, records, AES_BATCH_RECORDS, dec_tags, NULL);
+		aesd_wait_transfer(&aesd);
+
+		ok = true;
+		for (j = 0; j < AES_BATCH_RECORDS; j++) {
+			if (memcmp(batch_clear[j], batch_decrypted[j], size) != 0 ||
+			    memcmp(enc_tags[j], dec_tags[j], sizeof(enc_tags[j])) != 0)
+				ok = false;
+		}
+
+		if (elapsed == 0)
+			elapsed = 1;
+		printf("-I- GCM batch %4u bytes: %u packets/s, %u KB/s %s\r\n",
+		       (unsigned)size,
+		       (unsigned)(AES_BATCH_LOOPS * AES_BATCH_RECORDS * 1000 / elapsed),
+		       (unsigned)(AES_BATCH_LOOPS * AES_BATCH_RECORDS * size / elapsed),
+		       ok ? "passed" : "failed");
+	}
+}
+#endif
+
 /**
  * \brief Display main menu.
  */
@@ -488,6 +603,9 @@ static void display_menu(void)
 		chk_box[0], chk_box[1], chk_box[2]);
 	printf("   p: Begin the encryption/decryption process\n\r");
 	printf("   f: Full test for all AES mode\n\r");
+#ifdef CONFIG_HAVE_AES_GCM
+	printf("   b: GCM batch benchmark (fragmented records)\n\r");
+#endif
 	printf("   h: Display this menu\n\r");
 	printf("\n\r");
 }
@@ -623,6 +741,11 @@ int main(void)
 		case 'p':
 			start_aes(false);
 			break;
+#ifdef CONFIG_HAVE_AES_GCM
+		case 'b':
+			gcm_batch_test();
+			break;
+#endif
 		case 'f':
 			full_aes_test();
 			aesd.cfg.transfer_mode = AESD_TRANS_POLLING_MANUAL;
@@ -311,12 +311,33 @@ static void generate_test_key(void)
 	}
 }
 
+/**
+ * \brief Get a word of the FIPS reference digest.
+ */
+static uint32_t get_ref_digest(enum _shad_algo algo, uint32_t mode, uint32_t i)
+{
+	switch (algo) {
+	case ALGO_SHA_1:
+		return ref_digests_one[mode][i];
+	case ALGO_SHA_224:
+		return ref_digests_224[mode][i];
+	case ALGO_SHA_256:
+		return ref_digests_256[mode][i];
+	case ALGO_SHA_384:
+		return ref_digests_384[mode][i];
+	case ALGO_SHA_512:
+		return ref_digests_512[mode][i];
+	default:
+		return 0;
+	}
+}
+
 /**
  * \brief Start SHA process.
  */
 static bool start_sha(bool full_test)
 {
-	uint32_t rc = 0, i, val, ref = 0;
+	uint32_t rc = 0, i, val, ref;
 	uint32_t len;
 	int output_size = shad_get_digest_size(shad.cfg.algo);
 
@@ -422,23 +443,7 @@ static bool start_sha(bool full_test)
 	}
 	for (rc = 0, i = 0; i < output_size / 4; i++) {
 		val = swab32(digest[i]);
-		switch (shad.cfg.algo) {
-		case ALGO_SHA_1:
-			ref = ref_digests_one[block_mode][i];
-			break;
-		case ALGO_SHA_224:
-			ref = ref_digests_224[block_mode][i];
-			break;
-		case ALGO_SHA_256:
-			ref = ref_digests_256[block_mode][i];
-			break;
-		case ALGO_SHA_384:
-			ref = ref_digests_384[block_mode][i];
-			break;
-		case ALGO_SHA_512:
-			ref = ref_digests_512[block_mode][i];
-			break;
-		}
+		ref = get_ref_digest(shad.cfg.algo, block_mode, i);
 		if (!shad.cfg._shad_generate_hmac) {
 			if (val != ref) {
 				if (!full_test)
@@ -464,6 +469,69 @@ static bool start_sha(bool full_test)
 	return (rc == 0 ? true : false);
 }
 
+#ifdef CONFIG_HAVE_SHA_HMAC
+/**
+ * \brief Hash the three FIPS messages as interleaved streams.
+ */
+static void interleaved_sha_test(void)
+{
+	static struct _shad_ctx ctx[3];
+	static uint32_t digests[3][MAX_DIGEST_SIZE_INWORD];
+	struct _buffer buf_digest;
+	struct _shad_ctx_stats stats;
+	int output_size = shad_get_digest_size(shad.cfg.algo);
+	uint32_t i, j, rc = 0;
+	uint32_t offset;
+
+	if (output_size < 0) {
+		printf("-F- Unsupported SHA algorithm\r\n");
+		return;
+	}
+
+	memset((uint8_t*)message, msg_long_pattern, LEN_MSG_LONG);
+	for (i = 0; i < 3; i++)
+		shad_ctx_start(&shad, &ctx[i], shad.cfg.algo);
+
+	/* The long message is fed in chunks, the short ones are queued in
+	 * between and get the engine at the next slice */
+	for (offset = 0; offset < LEN_MSG_LONG; offset += LEN_MSG_LONG / 10) {
+		shad_ctx_update(&ctx[2], &message[offset], LEN_MSG_LONG / 10, NULL);
+		if (offset == 0) {
+			shad_ctx_update(&ctx[0], msg0, LEN_MSG_0, NULL);
+			if (shad.cfg.algo == ALGO_SHA_384 ||
+			    shad.cfg.algo == ALGO_SHA_512)
+				shad_ctx_update(&ctx[1], msg2, LEN_MSG_2, NULL);
+			else
+				shad_ctx_update(&ctx[1], msg1, LEN_MSG_1, NULL);
+		}
+		shad_ctx_wait(&ctx[2]);
+	}
+
+	for (i = 0; i < 3; i++) {
+		shad_ctx_wait(&ctx[i]);
+		buf_digest.data = (uint8_t*)digests[i];
+		buf_digest.size = output_size;
+		shad_ctx_finish(&ctx[i], &buf_digest, NULL);
+	}
+
+	for (i = 0; i < 3; i++) {
+		shad_ctx_wait(&ctx[i]);
+		for (j = 0; j < output_size / 4; j++)
+			if (swab32(digests[i][j]) != get_ref_digest(shad.cfg.algo, i, j))
+				rc++;
+		shad_ctx_get_stats(&ctx[i], &stats);
+		printf("-I- Stream %u: %u bytes, %u slices, %u ms, %u bytes/s\r\n",
+		       (unsigned)i, (unsigned)stats.bytes, (unsigned)stats.slices,
+		       (unsigned)stats.elapsed, (unsigned)stats.rate);
+	}
+
+	if (rc)
+		printf("-I- Failed to verify message digests (%u errors)\r\n", (unsigned)rc);
+	else
+		printf("-I- Message digests matched with the results in FIPS examples\r\n");
+}
+#endif /* CONFIG_HAVE_SHA_HMAC */
+
 /**
  * \brief Display main menu.
  */
@@ -506,6 +574,9 @@ static void display_menu(void)
 	else
 		printf("   s: Start hash algorithm process \r\n");
 	printf("   f: Full SHA test\r\n");
+#ifdef CONFIG_HAVE_SHA_HMAC
+	printf("   i: Interleaved streams test\r\n");
+#endif
 	printf("   h: Display this menu\r\n");
 	printf("\r\n");
 }
@@ -639,6 +710,11 @@ int main(void)
 		case 's':
 			start_sha(false);
 			break;
+#ifdef CONFIG_HAVE_SHA_HMAC
+		case 'i':
+			interleaved_sha_test();
+			break;
+#endif
 		case 'f':
 			full_sha_test();
 			shad.cfg.transfer_mode = SHAD_TRANS_POLLING;
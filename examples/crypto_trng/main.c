@@ -41,6 +41,8 @@
  *
  * The demonstration program configure TRNG peripheral. As soon as the TRNG is enabled
  * the generator provides one 32-bit value every 84 clock cycles.
+ * When the AES is available, the TRNG feeds the random number service (rngd),
+ * a CTR_DRBG the example also sets as the source of rand(), and benchmarks both.
  * TRNG interrupt status DATRDY is set when a new random value is ready, it can be read
  * out on the 32-bit output data register (TRNG_ODATA)in TRNG interrupt routine.
  *
@@ -92,36 +94,190 @@
 
 #include "serial/console.h"
 
+#include "crypto/aesd.h"
+#include "crypto/rngd.h"
 #include "crypto/trng.h"
 
+#include "rand.h"
+#include "timer.h"
+
+#include <ctype.h>
 #include <stdio.h>
 
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/* Words read from the raw TRNG by the benchmark */
+#define RAW_BENCH_WORDS    16384
+
+/* Bytes requested from the DRBG per benchmarked request size */
+#define DRBG_BENCH_BYTES   (256 * 1024)
+
+/* rand() calls done by the benchmark */
+#define RAND_BENCH_CALLS   16384
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+static const char _pers[] = "crypto_trng example";
+
+#ifdef CONFIG_HAVE_AES
+static struct _aesd_desc aesd;
+
+static uint8_t bench_buffer[1024];
+#endif
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
 
-static void trng_callback(uint32_t random_value, void* user_arg)
+static void display_menu(void)
+{
+	printf("\n\rTRNG Menu:\n\r");
+	printf("   r: Print raw TRNG and DRBG values\n\r");
+#ifdef CONFIG_HAVE_AES
+	printf("   b: Benchmark TRNG, DRBG (polled and aesd) and rand()\n\r");
+	printf("   s: Display random service statistics\n\r");
+#endif
+	printf("   h: Display this menu\n\r");
+	printf("\n\r");
+}
+
+static void print_values(void)
+{
+	int i;
+
+	/* Raw values are read while the service interrupt is stopped */
+	trng_suspend_it();
+	for (i = 0; i < 8; i++)
+		printf("TRNG 0x%08x\n\r", (unsigned int)trng_get_random_data());
+	trng_resume_it();
+#ifdef CONFIG_HAVE_AES
+	for (i = 0; i < 8; i++)
+		printf("DRBG 0x%08x\n\r", (unsigned int)rngd_get_u32());
+#endif
+}
+
+#ifdef CONFIG_HAVE_AES
+static uint32_t rate(uint32_t count, uint64_t start)
+{
+	uint32_t elapsed = (uint32_t)timer_get_interval(start, timer_get_tick());
+
+	if (elapsed == 0)
+		elapsed = 1;
+	return (uint32_t)(((uint64_t)count * 1000) / elapsed);
+}
+
+static void bench_drbg(const char* name)
 {
-	printf("0x%08x\n\r", (unsigned int)random_value);
+	static const uint32_t sizes[] = { 4, 64, 1024 };
+	uint64_t start;
+	uint32_t i, j;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		start = timer_get_tick();
+		for (j = 0; j < DRBG_BENCH_BYTES; j += sizes[i])
+			rngd_get_bytes(bench_buffer, sizes[i]);
+		printf("-I- DRBG %s, %4u-byte requests: %u bytes/s\n\r", name,
+		       (unsigned)sizes[i], (unsigned)rate(DRBG_BENCH_BYTES, start));
+	}
 }
 
+static void benchmark(void)
+{
+	uint64_t start;
+	uint32_t i;
+	volatile uint32_t sink;
+
+	trng_suspend_it();
+	start = timer_get_tick();
+	for (i = 0; i < RAW_BENCH_WORDS; i++)
+		sink = trng_get_random_data();
+	printf("-I- TRNG polled: %u bytes/s\n\r",
+	       (unsigned)rate(RAW_BENCH_WORDS * 4, start));
+	trng_resume_it();
+
+	rngd_deinit();
+	if (rngd_init(NULL, _pers, sizeof(_pers)) == 0)
+		bench_drbg("polled");
+
+	rngd_deinit();
+	if (rngd_init(&aesd, _pers, sizeof(_pers)) == 0) {
+		rngd_set_rand_source(true);
+		bench_drbg("aesd dma");
+	}
+
+	start = timer_get_tick();
+	for (i = 0; i < RAND_BENCH_CALLS; i++)
+		sink = rand();
+	printf("-I- rand(): %u calls/s\n\r", (unsigned)rate(RAND_BENCH_CALLS, start));
+	(void)sink;
+}
+
+static void print_stats(void)
+{
+	struct _rngd_stats stats;
+
+	rngd_get_stats(&stats, false);
+	printf("-I- Entropy pool: %u words, %u accepted\n\r",
+	       (unsigned)rngd_get_entropy_level(), (unsigned)stats.entropy_words);
+	printf("-I- Health test failures: %u RCT, %u APT\n\r",
+	       (unsigned)stats.rct_failures, (unsigned)stats.apt_failures);
+	printf("-I- Refills: %u (%u by aesd), reseeds: %u, deferred: %u\n\r",
+	       (unsigned)stats.refills, (unsigned)stats.refills_aesd,
+	       (unsigned)stats.reseeds, (unsigned)stats.deferred);
+	printf("-I- Bytes served: %u, rand() fallbacks: %u\n\r",
+	       (unsigned)stats.bytes, (unsigned)stats.rand_fallbacks);
+}
+#endif
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
 
 /**
  *  \brief $page_name$ Application entry point.
- *
  *  \return Unused (ANSI-C compatibility).
  *  \callgraph
  */
 int main(void)
 {
+	uint8_t key;
+
 	/* Output example information */
 	console_example_info("TRNG Example");
 
+#ifdef CONFIG_HAVE_AES
+	aesd_init(&aesd);
+	aesd.cfg.transfer_mode = AESD_TRANS_DMA;
+	if (rngd_init(&aesd, _pers, sizeof(_pers)) < 0)
+		printf("-E- TRNG startup health tests failed\n\r");
+	else
+		rngd_set_rand_source(true);
+#else
 	trng_enable();
-	trng_enable_it(&trng_callback, NULL);
+#endif
+	display_menu();
 
-	while (1) ;
+	while (1) {
+		key = tolower(console_get_char());
+		switch (key) {
+		case 'r':
+			print_values();
+			break;
+#ifdef CONFIG_HAVE_AES
+		case 'b':
+			benchmark();
+			break;
+		case 's':
+			print_stats();
+			break;
+#endif
+		case 'h':
+			display_menu();
+			break;
+		}
+	}
 }
@@ -98,9 +98,11 @@
 #include "chip.h"
 #include "compiler.h"
 #include "dma/dma.h"
+#include "dma/dma_memcpy.h"
 #include "mm/cache.h"
 #include "mutex.h"
 #include "serial/console.h"
+#include "timer.h"
 #include "trace.h"
 
 /*----------------------------------------------------------------------------
@@ -119,6 +121,12 @@
 /** Buffer length */
 #define BUFFER_LEN 128
 
+/** Largest copy size measured by the benchmark */
+#define BENCH_MAX_LEN (16 * 1024)
+
+/** Minimum duration of one benchmark measurement (ms) */
+#define BENCH_DURATION 50
+
 /** Polling or interrupt mode */
 #undef USE_POLLING
 
@@ -136,6 +144,10 @@ CACHE_ALIGNED static uint8_t test_buf[BUFFER_LEN];
 /** Destination buffer */
 CACHE_ALIGNED static uint8_t dest_buf[BUFFER_LEN];
 
+/** Benchmark buffers */
+CACHE_ALIGNED static uint8_t bench_src[BENCH_MAX_LEN];
+CACHE_ALIGNED static uint8_t bench_dst[BENCH_MAX_LEN];
+
 /* Current Programming DMA mode for Multiple Buffer Transfers */
 static uint8_t dma_mode = DMA_SINGLE;
 static uint8_t dma_data_width = 0;
@@ -199,6 +211,7 @@ static void _display_menu(void)
 	printf("- DMA transfer type\n\r");
 	printf("    S: Single Block transfer\n\r");
 	printf("    L: Linked List transfer\n\r");
+	printf("- B: Benchmark CPU memcpy against dma_memcpy_async\n\r");
 	printf("- H: Display this menu\n\r");
 	printf("\n\r");
 }
@@ -296,6 +309,55 @@ static uint8_t _start_dma_transfer(void)
 	return 0;
 }
 
+/**
+ * \brief Measure the throughput of one copy method for a given size.
+ * \return throughput in KB/s
+ */
+static uint32_t _bench_copy(uint32_t len, bool use_dma)
+{
+	uint64_t start = timer_get_tick();
+	uint64_t elapsed;
+	uint32_t count = 0;
+
+	do {
+		if (use_dma) {
+			dma_memcpy_async(bench_dst, bench_src, len, NULL);
+			dma_memcpy_wait();
+		} else {
+			memcpy(bench_dst, bench_src, len);
+		}
+		count++;
+		elapsed = timer_get_interval(start, timer_get_tick());
+	} while (elapsed < BENCH_DURATION);
+
+	return (uint32_t)(((uint64_t)len * count * 1000) / (elapsed * 1024));
+}
+
+/**
+ * \brief Compare CPU and DMA copies from small to large sizes, cache
+ * maintenance included, to help choosing DMA_MEMCPY_CPU_THRESHOLD.
+ */
+static void _benchmark(void)
+{
+	uint32_t len;
+
+	for (len = 0; len < BENCH_MAX_LEN; len++)
+		bench_src[len] = len;
+
+	/* Force every request to the DMA */
+	dma_memcpy_set_threshold(0);
+
+	printf("\n\r   size |  CPU KB/s |  DMA KB/s\n\r");
+	for (len = 16; len <= BENCH_MAX_LEN; len <<= 1) {
+		uint32_t cpu = _bench_copy(len, false);
+		uint32_t dma = _bench_copy(len, true);
+		printf(" %6u | %9u | %9u %s\n\r", (unsigned)len,
+		       (unsigned)cpu, (unsigned)dma, dma > cpu ? "DMA" : "CPU");
+	}
+
+	dma_memcpy_set_threshold(DMA_MEMCPY_CPU_THRESHOLD);
+}
+
 /*----------------------------------------------------------------------------
  *         Global functions
  *----------------------------------------------------------------------------*/
@@ -321,6 +383,10 @@ extern int main(void)
 		return 0;
 	}
 
+	/* Reserve channels for the memory copy service */
+	if (dma_memcpy_initialize() < 0)
+		trace_warning("No channel left for dma_memcpy_async, CPU copies only\n\r");
+
 	/* Display menu */
 	_display_menu();
 	while (1) {
@@ -348,6 +414,8 @@ extern int main(void)
 			dma_mode = DMA_SG;
 			_configure_transfer();
 			configured = true;
+		} else if (key == 'B') {
+			_benchmark();
 		} else if (key == 'H') {
 			_display_menu();
 		} else if (configured && (key == 'T' || key == 't')) {
@@ -15,7 +15,7 @@
 
 #define configCPU_CLOCK_HZ						/* Not used in this port as the value comes from the Atmel libraries. */
 #define configUSE_PORT_OPTIMISED_TASK_SELECTION	1
-#define configUSE_TICKLESS_IDLE					0
+#define configUSE_TICKLESS_IDLE					1
 #define configTICK_RATE_HZ						( ( TickType_t ) 1000 )
 #define configUSE_PREEMPTION					1
 #define configUSE_IDLE_HOOK						1
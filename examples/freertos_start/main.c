@@ -135,6 +135,11 @@ static void vLedTask(void *pvParameters);
 
 static void vLedTask(void *pvParameters)
 {
+#if (configUSE_TICKLESS_IDLE != 0)
+	TicklessIdleStats_t stats;
+	uint32_t count = 0;
+#endif
+
 	while (1) {
 
 		printf("LED task running\n\r");
@@ -150,6 +155,19 @@ static void vLedTask(void *pvParameters)
 		/* Simply toggle the LED every 500ms, blocking between each toggle. */
 		vTaskDelay(500/portTICK_RATE_MS);
 
+#if (configUSE_TICKLESS_IDLE != 0)
+		/* Report the tickless idle statistics every 10 toggles */
+		if (++count == 10) {
+			count = 0;
+			vPortGetTicklessIdleStats(&stats, pdTRUE);
+			printf("\n\rIdle: %u sleeps (%u aborted, %u early), residency %u.%u%%, wake latency avg %uus max %uus\n\r",
+			       (unsigned)stats.ulSleepCount, (unsigned)stats.ulAbortCount,
+			       (unsigned)stats.ulEarlyWakeCount,
+			       (unsigned)(stats.ulResidency / 10), (unsigned)(stats.ulResidency % 10),
+			       (unsigned)stats.ulAvgWakeLatencyUs, (unsigned)stats.ulMaxWakeLatencyUs);
+		}
+#endif
+
 	}
 }
 
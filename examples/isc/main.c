@@ -150,6 +150,9 @@ static uint8_t sensor_mode;
 /* LCD mode */
 static uint32_t lcd_mode;
 static bool awb;
+
+/* 3A engine running, otherwise the reference AWB algorithm is used */
+static bool auto_exposure;
 static struct _iscd_desc iscd;
 /* Color space matrix setting */
 static struct _color_space ref_cs = {
@@ -252,6 +255,34 @@ static void configure_isc(void)
 	iscd_pipe_start(&iscd);
 }
 
+/**
+ * \brief Start auto exposure and white balance.
+ *
+ * Sensors providing manual exposure control run the interrupt driven 3A
+ * engine, others fall back to the reference white balance algorithm.
+ *
+ * \return true if the 3A engine was started
+ */
+static bool start_3a(void)
+{
+	uint32_t exposure;
+	uint16_t gain;
+
+	if (!sensor->exposure)
+		return false;
+
+	if (sensor_set_manual_exposure(SENSOR_TWI_BUS, sensor) != SENSOR_OK ||
+	    sensor_get_exposure(SENSOR_TWI_BUS, sensor, &exposure, &gain) != SENSOR_OK) {
+		printf("-E- Sensor exposure control failed.\n\r");
+		return false;
+	}
+	if (iscd_3a_start(&iscd, NULL, exposure, gain) != ISCD_OK) {
+		printf("-E- 3A start failed.\n\r");
+		return false;
+	}
+	return true;
+}
+
 /*----------------------------------------------------------------------------
  *        Global functions
  *----------------------------------------------------------------------------*/
@@ -263,6 +294,8 @@ static void configure_isc(void)
 extern int main(void)
 {
 	uint8_t key;
+	uint32_t exposure;
+	uint16_t gain;
 
 	/* Output example information */
 	console_example_info("ISC Example");
@@ -350,23 +383,33 @@ restart_sensor:
 		printf("-I- press 'A' or 'a' to start auto white balance & AE. \n\r");
 
 	awb = false;
+	auto_exposure = false;
 	while (1) {
 		if (console_is_rx_ready()) {
 			key = console_get_char();
 			switch (key) {
 			case 'S':
 			case 's':
+				iscd_3a_stop();
 				isc_stop_capture();
 				goto restart_sensor;
 			case 'A':
 			case 'a':
-				if (sensor_mode == RAW_BAYER)
+				if (sensor_mode == RAW_BAYER && !awb) {
 					awb = true;
+					auto_exposure = start_3a();
+				}
 				break;
 			}
 		}
-		if (awb)
-			iscd_auto_white_balance_ref_algo(iscd.pipe.histo_buf);
+		if (awb) {
+			if (auto_exposure) {
+				if (iscd_3a_get_exposure(&exposure, &gain))
+					sensor_set_exposure(SENSOR_TWI_BUS, sensor, exposure, gain);
+			} else {
+				iscd_auto_white_balance_ref_algo(iscd.pipe.histo_buf);
+			}
+		}
 	}
 
 }
@@ -43,6 +43,7 @@
 #include "board.h"
 #include "compiler.h"
 
+#include "display/gfx2d.h"
 #include "display/lcdc.h"
 
 #include "lcd_draw.h"
@@ -60,10 +61,42 @@
 /** Front color cache */
 static uint32_t front_color;
 
+/** Surface on the current canvas, kept across calls so that the drawn
+ * areas accumulate until lcd_flush() */
+static struct _gfx2d_surface canvas_surface;
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
 
+/**
+ * \brief Get the drawing surface of the current canvas.
+ * When the canvas changed, the areas drawn on the previous one are cleaned
+ * from the data cache and the surface is bound to the new canvas.
+ * \return the surface, or NULL if no canvas can be drawn on.
+ */
+static struct _gfx2d_surface *_get_canvas_surface(void)
+{
+	struct _lcdc_layer *canvas = lcdc_get_canvas();
+
+	if (canvas->buffer == NULL)
+		return NULL;
+
+	if (canvas_surface.buffer != canvas->buffer ||
+	    canvas_surface.width != canvas->width ||
+	    canvas_surface.height != canvas->height ||
+	    canvas_surface.bpp != canvas->bpp) {
+		if (canvas_surface.buffer)
+			gfx2d_flush(&canvas_surface);
+		if (gfx2d_init_canvas_surface(&canvas_surface) < 0) {
+			canvas_surface.buffer = NULL;
+			return NULL;
+		}
+	}
+
+	return &canvas_surface;
+}
+
 /**
  * Hide canvas layer
  */
@@ -97,6 +130,7 @@ static void _set_front_color(uint32_t color)
  */
 static void _draw_pixel(uint32_t dwX, uint32_t dwY)
 {
+	struct _gfx2d_surface *surface = _get_canvas_surface();
 	struct _lcdc_layer *pDisp = lcdc_get_canvas();
 	uint8_t *buffer = pDisp->buffer;
 	uint16_t w = pDisp->width;
@@ -130,6 +164,9 @@ static void _draw_pixel(uint32_t dwX, uint32_t dwY)
 		pPix[3] = (front_color >> 24) & 0xFF;
 		break;
 	}
+
+	if (surface)
+		gfx2d_mark_dirty(surface, dwX, dwY, 1, 1);
 }
 
 /**
@@ -141,56 +178,13 @@ static void _draw_pixel(uint32_t dwX, uint32_t dwY)
  */
 static void _fill_rect(uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2)
 {
-	struct _lcdc_layer *pDisp = lcdc_get_canvas();
-	uint16_t w = pDisp->width;
-	uint16_t cw = pDisp->bpp / 8;	/* color width */
-	uint32_t rw = w * cw;	/* row width in bytes */
-	uint8_t *base;
-	uint8_t *buffer = pDisp->buffer;
-	uint32_t fillStart, fillEnd;
-	uint32_t i;
-	if (buffer == NULL)
-		return;
-
-	/* 4-byte aligned rows */
-	if (rw & 0x3)
-		rw = (rw | 0x3) + 1;
-	/* Buffer address for the starting row */
-	base = &buffer[dwY1 * rw];
-
-	fillStart = dwX1 * cw;
-	fillEnd = dwX2 * cw;
-
-#if 1				/* Memcopy pixel */
-	buffer = base;
-	for (; dwY1 <= dwY2; dwY1++) {
-		for (i = fillStart; i <= fillEnd; i += cw) {
-			memcpy(&buffer[i], &front_color, cw);
-		}
-		buffer = &buffer[rw];
-	}
-#endif
+	struct _gfx2d_surface *surface = _get_canvas_surface();
 
-#if 0				/* Pixel by pixel */
-	for (; dwY1 <= dwY2; dwY1++) {
-		for (i = dwX1; i <= dwX2; i++) {
-			_draw_pixel(i, dwY1);
-		}
-	}
-#endif
+	if (surface == NULL)
+		return;
 
-#if 0				/* Optimized */
-	/* First row */
-	for (i = fillStart; i <= fillEnd; i += cw) {
-		memcpy(&base[i], &front_color, cw);
-	}
-	/* Next rows, copy first */
-	buffer = &base[rw + fillStart];
-	for (i = dwY1 + 1; i <= dwY2; i++) {
-		memcpy(buffer, &base[fillStart], fillEnd - fillStart + cw);
-		buffer = &buffer[rw];
-	}
-#endif
+	gfx2d_fill_rect(surface, dwX1, dwY1, dwX2 - dwX1 + 1, dwY2 - dwY1 + 1,
+			front_color);
 }
 
 /**
@@ -373,6 +367,18 @@ void lcd_fill_yuv422(void)
 	}
 }
 
+/**
+ * \brief Clean from the data cache the areas of the current canvas drawn
+ * since the previous flush.
+ */
+void lcd_flush(void)
+{
+	struct _gfx2d_surface *surface = _get_canvas_surface();
+
+	if (surface)
+		gfx2d_flush(surface);
+}
+
 /**
  * \brief Draw a pixel on LCD of given color.
  *
@@ -76,6 +76,8 @@
 /** @{*/
 extern void lcd_fill_white(void);
 
+extern void lcd_flush(void);
+
 extern void lcd_fill(uint32_t color);
 
 extern void lcd_fill_yuv422(void);
@@ -79,6 +79,7 @@
  *      2 -> Switch to UPLL
  *      3 -> Switch to main clock
  *      4 -> Switch to slow clock
+ *      5 -> Run the DVFS governor
  *      -------------------------------
  *      =>
  *     \endcode
@@ -101,6 +102,7 @@
 #include "peripherals/pmc.h"
 #include "peripherals/wdt.h"
 #include "gpio/pio.h"
+#include "power/dvfs.h"
 #include "serial/console.h"
 
 #include <stdbool.h>
@@ -110,6 +112,18 @@
 
 #include "trace.h"
 #include "compiler.h"
+#include "timer.h"
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** Slow clock TC channel timing the DVFS clock switches */
+#define DVFS_TC          BOARD_TIMER_TC
+#define DVFS_TC_CHANNEL  1
+
+/** Duration of each phase of the DVFS demo, in ms */
+#define DVFS_PHASE_MS    2000
 
 /*----------------------------------------------------------------------------
  *        Local variables
@@ -117,6 +131,9 @@
 
 volatile uint8_t MenuChoice;
 
+/** DVFS operating points: main clock and PLLA */
+static struct pck_mck_cfg dvfs_opps[2];
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -138,9 +155,8 @@ static void _configure_console(void)
 
 static void _set_clock_setting(int index)
 {
-	while (!console_is_tx_empty());
-	pmc_set_custom_pck_mck(&clock_test_setting[index]);
-	_configure_console();
+	/* the console follows through its clock change notifier */
+	pmc_change_pck_mck(&clock_test_setting[index]);
 }
 
 static void _print_clocks(void)
@@ -158,6 +174,7 @@ static void _print_menu(void)
 	       "2 -> Switch to UPLL\n\r"
 	       "3 -> Switch to main clock\n\r"
 	       "4 -> Switch to slow clock\n\r"
+	       "5 -> Run the DVFS governor\n\r"
 	       "-------------------------------\n\r"
 	       "=>");
 }
@@ -168,6 +185,60 @@ static void _wait_busyloop(int loops)
 	for (delay = 0; delay < loops; delay++);
 }
 
+static void _print_dvfs_stats(const char* phase)
+{
+	struct _dvfs_stats stats;
+	unsigned i;
+
+	dvfs_get_stats(&stats, true);
+	printf("%s: load %u%%, OPP %u, %u switches, %u vetoed, "
+	       "latency %uus (max %uus)\r\n", phase,
+	       (unsigned)stats.load, (unsigned)stats.opp,
+	       (unsigned)stats.switches, (unsigned)stats.vetoed,
+	       (unsigned)stats.last_latency_us, (unsigned)stats.max_latency_us);
+	for (i = 0; i < ARRAY_SIZE(dvfs_opps); i++)
+		printf("  OPP %u: %ums\r\n", i, (unsigned)stats.residency_ms[i]);
+}
+
+static void _run_dvfs(void)
+{
+	struct _dvfs_cfg cfg = {
+		.opps = dvfs_opps,
+		.opp_count = ARRAY_SIZE(dvfs_opps),
+		.sample_ms = 50,
+		.up_threshold = 80,
+		.down_threshold = 30,
+		.tc = DVFS_TC,
+		.channel = DVFS_TC_CHANNEL,
+	};
+	uint64_t end;
+
+	dvfs_opps[0] = clock_test_setting[2];
+	dvfs_opps[1] = clock_test_setting[0];
+
+	if (dvfs_start(&cfg) < 0) {
+		printf("Cannot start the DVFS governor\r\n");
+		return;
+	}
+
+	/* idle: the governor steps down to the main clock */
+	end = timer_get_tick() + DVFS_PHASE_MS;
+	while (timer_get_tick() < end)
+		dvfs_idle();
+	_print_dvfs_stats("Idle");
+
+	/* busy: the governor jumps back to PLLA */
+	end = timer_get_tick() + DVFS_PHASE_MS;
+	while (timer_get_tick() < end) {
+		_wait_busyloop(1000);
+		dvfs_update();
+	}
+	_print_dvfs_stats("Busy");
+
+	dvfs_stop();
+	_set_clock_setting(0);
+}
+
 /*----------------------------------------------------------------------------
  *        Global functions
  *----------------------------------------------------------------------------
@@ -249,6 +320,16 @@ int main(void)
 			_print_clocks();
 			_print_menu();
 			break;
+		case '5':
+			printf(" %c\r\n", MenuChoice);
+			MenuChoice = 0;
+
+			printf("Run the DVFS governor\r\n");
+
+			_run_dvfs();
+			_print_clocks();
+			_print_menu();
+			break;
 		default:
 			break;
 		}
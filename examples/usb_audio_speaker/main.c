@@ -111,6 +111,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "audio/asrc.h"
 #include "audio/audio_device.h"
 #include "board.h"
 #include "chip.h"
@@ -155,8 +156,15 @@
 /**  Number of available audio buffers. */
 #define BUFFERS (32)
 
-/**  Size of one buffer in bytes. */
-#define BUFFER_SIZE ROUND_UP_MULT(AUDDSpeakerDriver_BYTESPERFRAME, L1_CACHE_BYTES)
+/**  Number of audio frames (one sample per channel) in one USB packet. */
+#define PACKET_FRAMES (AUDDSpeakerDriver_SAMPLESPERFRAME / AUDDSpeakerDriver_NUMCHANNELS)
+
+/**  Highest DAC / USB sample rate ratio the buffer pool can hold. */
+#define MAX_RATE_RATIO (2)
+
+/**  Size of the buffer pool in bytes. Buffers are carved at startup with
+     the frame count given by asrc_get_max_output() for one USB packet. */
+#define POOL_SIZE (BUFFERS * ROUND_UP_MULT((MAX_RATE_RATIO * PACKET_FRAMES + 2) * AUDDSpeakerDriver_BYTESPERSUBFRAME, L1_CACHE_BYTES))
 
 /**  Delay (in number of buffers) before starting the DAC transmission
      after data has been received. */
@@ -173,8 +181,18 @@ extern const USBDDriverDescriptors audd_speaker_driver_descriptors;
  *         Internal variables
  *----------------------------------------------------------------------------*/
 
-/**  Data buffers for receiving audio frames from the USB host. */
-CACHE_ALIGNED static uint8_t _buffer[BUFFERS][BUFFER_SIZE];
+/**  Buffer for receiving audio frames from the USB host. */
+CACHE_ALIGNED static uint8_t _usb_buffer[ROUND_UP_MULT(AUDDSpeakerDriver_BYTESPERFRAME, L1_CACHE_BYTES)];
+
+/**  Data buffers of rate converted audio frames, queued to the DAC. */
+CACHE_ALIGNED static uint8_t _buffer_pool[POOL_SIZE];
+
+/**  Capacity of one data buffer, in frames and in bytes. */
+static uint32_t _buffer_frames;
+static uint32_t _buffer_size;
+
+/**  Sample rate converter absorbing the USB / DAC clocks drift. */
+static struct _asrc _asrc;
 
 /**  Number of samples stored in each data buffer. */
 static uint32_t _samples[BUFFERS];
@@ -211,6 +229,14 @@ static const struct _pin button_pins[] = PINS_PUSHBUTTONS;
  *         Internal functions
  *----------------------------------------------------------------------------*/
 
+/**
+ *  \brief Get a data buffer of the pool.
+ */
+static uint8_t* _get_buffer(uint16_t index)
+{
+	return &_buffer_pool[index * _buffer_size];
+}
+
 /**
  *  \brief Audio TX callback
  */
@@ -225,7 +251,7 @@ static int _audio_transfer_callback(void* arg, void* arg2)
 		/* Load next buffer */
 		callback_set(&_cb, _audio_transfer_callback, desc);
 		audio_transfer(desc,
-			       _buffer[_audio_ctx.circ.tx],
+			       _get_buffer(_audio_ctx.circ.tx),
 			       _audio_ctx.samples[_audio_ctx.circ.tx],
 			       &_cb);
 	} else {
@@ -244,12 +270,19 @@ static void _usb_frame_recv_callback(void* arg, uint8_t status, uint32_t transfe
 	struct _audio_desc* desc = (struct _audio_desc*)arg;
 
 	if (status == USBD_STATUS_SUCCESS) {
+		uint32_t frames = transferred / AUDDSpeakerDriver_BYTESPERSUBFRAME;
+
 		if (_audio_ctx.circ.count >= (BUFFERS - 1)) {
 			_audio_ctx.circ.tx = (_audio_ctx.circ.tx + 1) % BUFFERS;
 			_audio_ctx.circ.count--;
 		}
 
-		_audio_ctx.samples[_audio_ctx.circ.rx] = transferred;
+		/* Convert the packet, the ratio follows the queue level */
+		asrc_track_fill(&_asrc, _audio_ctx.circ.count * PACKET_FRAMES);
+		frames = asrc_process(&_asrc, _usb_buffer, &frames,
+				      _get_buffer(_audio_ctx.circ.rx), _buffer_frames);
+
+		_audio_ctx.samples[_audio_ctx.circ.rx] = frames * AUDDSpeakerDriver_BYTESPERSUBFRAME;
 		_audio_ctx.circ.rx = (_audio_ctx.circ.rx + 1) % BUFFERS;
 		_audio_ctx.circ.count++;
 
@@ -264,7 +297,7 @@ static void _usb_frame_recv_callback(void* arg, uint8_t status, uint32_t transfe
 				/* Start DAC transmission if necessary */
 				callback_set(&_cb, _audio_transfer_callback, desc);
 				audio_transfer(desc,
-					       _buffer[_audio_ctx.circ.tx],
+					       _get_buffer(_audio_ctx.circ.tx),
 					       _audio_ctx.samples[_audio_ctx.circ.tx],
 					       &_cb);
 				_audio_ctx.circ.tx = (_audio_ctx.circ.tx + 1) % BUFFERS;
@@ -279,7 +312,7 @@ static void _usb_frame_recv_callback(void* arg, uint8_t status, uint32_t transfe
 	}
 
 	/* Receive next packet */
-	audd_speaker_driver_read(_buffer[_audio_ctx.circ.rx],
+	audd_speaker_driver_read(_usb_buffer,
 				 AUDDSpeakerDriver_BYTESPERFRAME,
 				 _usb_frame_recv_callback, desc);
 }
@@ -430,6 +463,7 @@ void audd_speaker_driver_stream_setting_changed(uint8_t new_setting)
 		_audio_ctx.circ.count = 0;
 		_audio_ctx.circ.tx = 0;
 		_audio_ctx.circ.rx = 0;
+		asrc_reset(&_asrc);
 	}
 }
 
@@ -445,9 +479,7 @@ void audd_speaker_driver_stream_setting_changed(uint8_t new_setting)
 int main(void)
 {
 	bool usb_conn = false;
-
-	int32_t jitter = 0, _jitter_curr;
-	int8_t clock_adjust = 0;
+	struct _asrc_cfg asrc_cfg;
 
 	console_set_rx_handler(console_handler);
 	console_enable_rx_interrupt();
@@ -464,6 +496,25 @@ int main(void)
 	/* Configure audio play volume */
 	audio_set_volume(&audio_device, _audio_ctx.volume);
 
+	/* Configure the sample rate converter, keeping the queue level
+	 * around the playback start threshold */
+	asrc_get_default_cfg(&asrc_cfg, AUDDSpeakerDriver_SAMPLERATE,
+			     audio_device.sample_rate,
+			     AUDDSpeakerDriver_NUMCHANNELS,
+			     AUDDSpeakerDriver_BITSPERSAMPLE,
+			     BUFFERS * PACKET_FRAMES);
+	asrc_cfg.target_fill = BUFFER_THRESHOLD * PACKET_FRAMES;
+	asrc_init(&_asrc, &asrc_cfg);
+
+	/* Size the buffers for the worst case ASRC output of one packet */
+	_buffer_frames = asrc_get_max_output(&_asrc, PACKET_FRAMES);
+	_buffer_size = ROUND_UP_MULT(_buffer_frames * AUDDSpeakerDriver_BYTESPERSUBFRAME, L1_CACHE_BYTES);
+	if (BUFFERS * _buffer_size > sizeof(_buffer_pool)) {
+		printf("-E- DAC rate %u Hz too high for the buffer pool\r\n",
+		       (unsigned)audio_device.sample_rate);
+		while (1);
+	}
+
 #ifdef PINS_PUSHBUTTONS
 	configure_buttons();
 #endif
@@ -487,26 +538,10 @@ int main(void)
 			continue;
 		}
 
-		_jitter_curr = (_audio_ctx.circ.count - _audio_ctx.threshold);
-
-		if (jitter != _jitter_curr) {
-			jitter = _jitter_curr;
-			if (jitter > 0 && clock_adjust != 1) {
-				/* USB too fast or SSC too slow: faster clock */
-				clock_adjust = 1;
-				audio_sync_adjust(&audio_device, clock_adjust);
-			}
-			if (jitter < 0 && clock_adjust != -1) {
-				/* USB too slow or SSC too fast: slower clock */
-				clock_adjust = -1;
-				audio_sync_adjust(&audio_device, clock_adjust);
-			}
-		}
-
 		if (!usb_conn) {
 			trace_info("USB connected\r\n");
 			/* Start Reading the incoming audio stream */
-			audd_speaker_driver_read(_buffer[_audio_ctx.circ.rx],
+			audd_speaker_driver_read(_usb_buffer,
 					AUDDSpeakerDriver_BYTESPERFRAME,
 					_usb_frame_recv_callback, &audio_device);
 
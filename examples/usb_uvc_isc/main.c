@@ -190,9 +190,27 @@ static void isc_vd_callback(uint8_t frame_idx)
 #ifdef FRAME_DEBUG_ENABLED
 	_isc_frame_count++;
 #endif
-	uvc_function_update_frame_idx(frame_idx);
 }
 
+/* The UVC function holds the frame it is sending, so that the ISC does not
+ * capture into it until the whole frame has been sent */
+static int uvc_frame_acquire(void)
+{
+	struct _iscd_frame* frame = iscd_frame_acquire(&iscd);
+
+	return frame ? frame->index : -1;
+}
+
+static void uvc_frame_release(int index)
+{
+	iscd_frame_release(&iscd, &iscd.pool.frames[index]);
+}
+
+static const struct _uvc_frame_ops uvc_frame_ops = {
+	.acquire = uvc_frame_acquire,
+	.release = uvc_frame_release,
+};
+
 /**
  * \brief ISC initialization.
  */
@@ -215,6 +233,9 @@ static void configure_isc(void)
 	iscd.dma.size = FRAME_BUFFER_SIZEC(image_width, image_height);
 	iscd.dma.callback = isc_vd_callback;
 	iscd_pipe_start(&iscd);
+
+	/* iscd_pipe_start() resets the frame pool */
+	uvc_function_set_frame_ops(&uvc_frame_ops);
 }
 
 static void start_preview(void)
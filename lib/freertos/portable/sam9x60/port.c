@@ -30,6 +30,8 @@
 #include "FreeRTOS.h"
 #include "task.h"
 
+#include <string.h>
+
 #include "chip.h"
 #include "trace.h"
 #include "irqflags.h"
@@ -37,7 +39,9 @@
 #include "compiler.h"
 #include "irq/irq.h"
 #include "irq/aic.h"
+#include "cpuidle.h"
 #include "peripherals/pit.h"
+#include "peripherals/pmc.h"
 
 #if configUSE_PORT_OPTIMISED_TASK_SELECTION == 1
 	/* Check the configuration. */
@@ -89,6 +93,11 @@ static void prvSetupTimerInterrupt( void );
 /* The PIT interrupt handler - the RTOS tick. */
 static void vPortTickISR( void );
 
+#if( configUSE_TICKLESS_IDLE != 0 )
+	/* Restore the tick period after a tickless idle sleep. */
+	static void prvTicklessRestorePeriod( void );
+#endif
+
 
 /*
  * Used to catch tasks that attempt to return from their implementing function.
@@ -247,6 +256,10 @@ static __arm void vPortTickISR( void )
 static void vPortTickISR( void )
 #endif
 {	
+#if( configUSE_TICKLESS_IDLE != 0 )
+	prvTicklessRestorePeriod();
+#endif
+
 	/* Increment the tick count - which may wake some tasks but as the
 	preemptive scheduler is not being used any woken task is not given
 	processor time no matter what its priority. */
@@ -320,8 +333,182 @@ void configCLEAR_TICK_INTERRUPT(void)
 
 /*-----------------------------------------------------------*/
 
+#if( configUSE_TICKLESS_IDLE != 0 )
+
+/* Room left between the PIT counter and the PIV restored from the tick
+interrupt, so that PIT_MR is written before the counter reaches it. */
+#define portTICKLESS_RESTORE_MARGIN		( 16UL )
+
+/* PIV of one tick.  The PIT counts from 0 to PIV so a tick lasts PIV + 1
+counts of MCK/16. */
+static uint32_t ulTickPIV = 0;
+
+/* Set when the PIT period was left longer than one tick on wake, the next
+tick interrupt restores it. */
+static volatile uint32_t ulTicklessRestorePIV = pdFALSE;
+
+static TicklessIdleStats_t xTicklessStats;
+static TickType_t xTicklessStatsStart = 0;
+static uint32_t ulWakeLatencyMax = 0;
+static uint64_t ullWakeLatencySum = 0;
+static uint32_t ulWakeLatencyCount = 0;
+
+/*-----------------------------------------------------------*/
+
+static void prvTicklessRestorePeriod( void )
+{
+uint32_t ulCPIV;
+
+	if( ulTicklessRestorePIV != pdFALSE )
+	{
+		/* Only shorten the period while the counter is below the new PIV,
+		otherwise it would run up to its 20-bit limit. */
+		ulCPIV = ( pit_get_piir() & PIT_PIIR_CPIV_Msk ) >> PIT_PIIR_CPIV_Pos;
+		if( ( ulCPIV + portTICKLESS_RESTORE_MARGIN ) < ulTickPIV )
+		{
+			pit_set_piv( ulTickPIV );
+			ulTicklessRestorePIV = pdFALSE;
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime )
+{
+uint32_t ulPeriod, ulPIIR, ulCheck, ulCPIV, ulPIV, ulCompleteTickPeriods;
+TickType_t xModifiableIdleTime;
+BaseType_t xTickPending;
+
+	if( ulTickPIV == 0 )
+	{
+		ulTickPIV = ( pit_get_mode() & PIT_MR_PIV_Msk ) >> PIT_MR_PIV_Pos;
+	}
+	ulPeriod = ulTickPIV + 1;
+
+	/* The 20-bit PIT counter bounds the sleep duration. */
+	if( xExpectedIdleTime > ( ( PIT_MR_PIV_Msk >> PIT_MR_PIV_Pos ) + 1 ) / ulPeriod )
+	{
+		xExpectedIdleTime = ( ( PIT_MR_PIV_Msk >> PIT_MR_PIV_Pos ) + 1 ) / ulPeriod;
+	}
+	if( xExpectedIdleTime < 2 )
+	{
+		return;
+	}
+
+	/* Interrupts stay masked up to the tick count update, a pending interrupt
+	still ends the WFI. */
+	portDISABLE_INTERRUPTS();
+
+	if( ( eTaskConfirmSleepModeStatus() == eAbortSleep ) || ( ( pit_get_piir() & PIT_PIIR_PICNT_Msk ) != 0 ) )
+	{
+		xTicklessStats.ulAbortCount++;
+		portENABLE_INTERRUPTS();
+		return;
+	}
+
+	/* Stretch the current tick period up to the expected wake time.  The
+	counter keeps its phase, it restarts at the last tick boundary. */
+	pit_set_piv( xExpectedIdleTime * ulPeriod - 1 );
+	if( ( pit_get_piir() & PIT_PIIR_PICNT_Msk ) != 0 )
+	{
+		/* The tick period ended before the write, its interrupt is pending. */
+		pit_set_piv( ulTickPIV );
+		xTicklessStats.ulAbortCount++;
+		portENABLE_INTERRUPTS();
+		return;
+	}
+
+	xModifiableIdleTime = xExpectedIdleTime;
+	configPRE_SLEEP_PROCESSING( xModifiableIdleTime );
+	if( xModifiableIdleTime > 0 )
+	{
+		cpu_idle();
+	}
+	configPOST_SLEEP_PROCESSING( xExpectedIdleTime );
+
+	ulPIIR = pit_get_piir();
+	xTickPending = ( ulPIIR & PIT_PIIR_PICNT_Msk ) != 0;
+	for( ;; )
+	{
+		/* Stop the period at the next tick boundary: the counter is either
+		past the stretched period (tick interrupt pending) or still in it. */
+		ulCPIV = ( ulPIIR & PIT_PIIR_CPIV_Msk ) >> PIT_PIIR_CPIV_Pos;
+		ulPIV = ( ulCPIV / ulPeriod + 1 ) * ulPeriod - 1;
+		pit_set_piv( ulPIV );
+
+		/* Retry if the counter went past the new PIV while writing it. */
+		ulCheck = pit_get_piir();
+		if( ( ( ulCheck & PIT_PIIR_PICNT_Msk ) != ( ulPIIR & PIT_PIIR_PICNT_Msk ) ) ||
+			( ( ( ulCheck & PIT_PIIR_CPIV_Msk ) >> PIT_PIIR_CPIV_Pos ) <= ulPIV ) )
+		{
+			break;
+		}
+		ulPIIR = ulCheck;
+	}
+	ulTicklessRestorePIV = ( ulPIV != ulTickPIV ) ? pdTRUE : pdFALSE;
+
+	if( xTickPending != pdFALSE )
+	{
+		/* Woken by the stretched period.  The pending tick interrupt counts
+		the last tick, ticks lost to a late wake are not recovered. */
+		ulCompleteTickPeriods = xExpectedIdleTime - 1;
+		xTicklessStats.ulSleptTicks += xExpectedIdleTime;
+		if( ulCPIV > ulWakeLatencyMax )
+		{
+			ulWakeLatencyMax = ulCPIV;
+		}
+		ullWakeLatencySum += ulCPIV;
+		ulWakeLatencyCount++;
+	}
+	else
+	{
+		/* Woken early by another interrupt. */
+		ulCompleteTickPeriods = ulCPIV / ulPeriod;
+		xTicklessStats.ulSleptTicks += ulCompleteTickPeriods;
+		xTicklessStats.ulEarlyWakeCount++;
+	}
+	xTicklessStats.ulSleepCount++;
+
+	vTaskStepTick( ulCompleteTickPeriods );
+	portENABLE_INTERRUPTS();
+}
+/*-----------------------------------------------------------*/
+
+void vPortGetTicklessIdleStats( TicklessIdleStats_t *pxStats, BaseType_t xReset )
+{
+uint32_t ulCountFreq;
+
+	portENTER_CRITICAL();
+	*pxStats = xTicklessStats;
+	pxStats->ulElapsedTicks = xTaskGetTickCount() - xTicklessStatsStart;
+	pxStats->ulResidency = pxStats->ulElapsedTicks ?
+		( uint32_t )( ( ( uint64_t )pxStats->ulSleptTicks * 1000 ) / pxStats->ulElapsedTicks ) : 0;
+
+	/* The PIT counts at MCK/16. */
+	ulCountFreq = pmc_get_peripheral_clock( ID_PIT ) / 16;
+	pxStats->ulMaxWakeLatencyUs = ( uint32_t )( ( ( uint64_t )ulWakeLatencyMax * 1000000 ) / ulCountFreq );
+	pxStats->ulAvgWakeLatencyUs = ulWakeLatencyCount ?
+		( uint32_t )( ( ullWakeLatencySum * 1000000 ) / ulCountFreq / ulWakeLatencyCount ) : 0;
+
+	if( xReset != pdFALSE )
+	{
+		memset( &xTicklessStats, 0, sizeof( xTicklessStats ) );
+		xTicklessStatsStart = xTaskGetTickCount();
+		ulWakeLatencyMax = 0;
+		ullWakeLatencySum = 0;
+		ulWakeLatencyCount = 0;
+	}
+	portEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+#endif /* configUSE_TICKLESS_IDLE */
+
 void FreeRTOS_Tick_Handler( void )
 {
+#if( configUSE_TICKLESS_IDLE != 0 )
+	prvTicklessRestorePeriod();
+#endif
 
 	portDISABLE_INTERRUPTS();
 	/* Increment the RTOS tick. */
@@ -184,5 +184,33 @@
 	#define portNOP() __asm volatile( "NOP" )
 	#define portINLINE __inline
 
+	#if( configUSE_TICKLESS_IDLE != 0 )
+
+		/* Tickless idle statistics, see vPortGetTicklessIdleStats(). */
+		typedef struct xTICKLESS_IDLE_STATS
+		{
+			uint32_t ulSleepCount;			/* Sleeps entered. */
+			uint32_t ulAbortCount;			/* Sleeps abandoned before entering WFI. */
+			uint32_t ulEarlyWakeCount;		/* Sleeps ended by an interrupt other than the tick. */
+			uint32_t ulSleptTicks;			/* Ticks elapsed while sleeping. */
+			uint32_t ulElapsedTicks;		/* Ticks elapsed since the statistics were reset. */
+			uint32_t ulResidency;			/* ulSleptTicks / ulElapsedTicks, per mille. */
+			uint32_t ulMaxWakeLatencyUs;	/* Delay from the wake deadline to the tick count update. */
+			uint32_t ulAvgWakeLatencyUs;
+		} TicklessIdleStats_t;
+
+		/* Stop the tick for xExpectedIdleTime ticks and sleep.  The PIT period
+		is stretched up to the next task deadline and the tick count is
+		compensated on wake.  configPRE_SLEEP_PROCESSING() may enter a deeper
+		PMC mode itself and set its parameter to 0 to skip the WFI. */
+		void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime );
+		#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) vPortSuppressTicksAndSleep( xExpectedIdleTime )
+
+		/* Copy the tickless idle statistics, and restart them if xReset is
+		pdTRUE. */
+		void vPortGetTicklessIdleStats( TicklessIdleStats_t *pxStats, BaseType_t xReset );
+
+	#endif /* configUSE_TICKLESS_IDLE */
+
 #endif /* PORTMACRO_H */
 
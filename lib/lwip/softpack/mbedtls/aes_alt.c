@@ -0,0 +1,507 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * MBEDTLS_AES_ALT implementation on the AES engine.
+ *
+ * Single blocks (ECB, and the CFB/OFB modes built on it) are fed to the
+ * engine by the CPU; within one request the key stays loaded as long as the
+ * same context keeps using it. CBC and CTR requests are handed to the engine
+ * chaining logic:
+ * below the DMA threshold the CPU moves the blocks, from the threshold on
+ * they go through aesd in DMA mode. Contexts only hold the raw key, the
+ * chaining value stays with the caller as mbedTLS expects, so sessions can
+ * be interleaved freely.
+ *
+ * The engine is shared with the other aesd users: the direct register
+ * sequences run with the engine taken through aesd_engine_try_lock(), and
+ * DMA requests go through aesd_transfer().
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#ifdef MBEDTLS_AES_ALT
+
+#include <string.h>
+
+#include "chip.h"
+#include "crypto/aes.h"
+#include "crypto/aesd.h"
+#include "dma/dma.h"
+#include "mm/cache.h"
+#include "peripherals/pmc.h"
+
+#include "mbedtls/aes.h"
+#include "mbedtls/platform_util.h"
+
+#include "mbedtls_alt.h"
+
+#ifdef MBEDTLS_CIPHER_MODE_XTS
+#error "MBEDTLS_CIPHER_MODE_XTS is not supported by the AES alternate"
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+static struct {
+	bool clocked;
+	bool aesd_ready;
+	const mbedtls_aes_context* owner; /* context whose key is loaded */
+	uint32_t mr;                      /* mode register of that key */
+	uint32_t threshold;
+	struct _aesd_desc aesd;
+} _aes_alt = {
+	.threshold = MBEDTLS_ALT_AES_DMA_THRESHOLD,
+};
+
+CACHE_ALIGNED static uint8_t _aes_alt_buffer[MBEDTLS_ALT_AES_DMA_BUFFER_SIZE];
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static uint32_t _aes_alt_mr(const mbedtls_aes_context* ctx,
+		enum _aesd_mode mode, bool encrypt)
+{
+	return AES_MR_OPMOD(mode) |
+	       AES_MR_KEYSIZE((ctx->keybits - 128) / 64) |
+	       AES_MR_SMOD_AUTO_START |
+	       (encrypt ? AES_MR_CIPHER : 0);
+}
+
+static void _aes_alt_forget(const mbedtls_aes_context* ctx)
+{
+	if (_aes_alt.owner == ctx)
+		_aes_alt.owner = NULL;
+}
+
+/* Program the engine for a context, which must be locked. A chained mode
+ * restarts from its IV, which needs the key to be written again; single ECB
+ * blocks reuse the key as long as the same context keeps the engine. */
+static void _aes_alt_load(const mbedtls_aes_context* ctx, uint32_t mr,
+		const uint8_t* iv)
+{
+	uint32_t vector[4];
+
+	if (!iv && _aes_alt.owner == ctx && _aes_alt.mr == mr) {
+		mbedtls_alt_stats.aes_key_hits++;
+		return;
+	}
+
+	aes_soft_reset();
+	aes_configure(mr);
+	aes_write_key(ctx->key, ctx->keybits / 8);
+	if (iv) {
+		memcpy(vector, iv, sizeof(vector));
+		aes_set_vector(vector);
+	}
+	_aes_alt.owner = iv ? NULL : ctx;
+	_aes_alt.mr = mr;
+	mbedtls_alt_stats.aes_key_loads++;
+}
+
+static void _aes_alt_run(const uint8_t* input, uint8_t* output, size_t blocks)
+{
+	uint32_t data[4];
+
+	while (blocks--) {
+		memcpy(data, input, sizeof(data));
+		aes_set_input(data, sizeof(data));
+		while (!(aes_get_status() & AES_ISR_DATRDY));
+		aes_get_output(data, sizeof(data));
+		memcpy(output, data, sizeof(data));
+		input += sizeof(data);
+		output += sizeof(data);
+	}
+}
+
+/* Encrypt or decrypt one block, the engine must be locked */
+static void _aes_alt_ecb(const mbedtls_aes_context* ctx, bool encrypt,
+		const uint8_t* input, uint8_t* output)
+{
+	_aes_alt_load(ctx, _aes_alt_mr(ctx, AESD_MODE_ECB, encrypt), NULL);
+	_aes_alt_run(input, output, 1);
+	mbedtls_alt_stats.aes_polled += 16;
+}
+
+static int _aes_alt_run_dma(const mbedtls_aes_context* ctx,
+		enum _aesd_mode mode, bool encrypt, const uint8_t* iv,
+		const uint8_t* input, uint8_t* output, size_t length)
+{
+	struct _buffer buf = {
+		.data = _aes_alt_buffer,
+		.size = length,
+	};
+
+	if (!_aes_alt.aesd_ready) {
+		aesd_init(&_aes_alt.aesd);
+		_aes_alt.aesd_ready = true;
+	}
+
+	_aes_alt.aesd.cfg.encrypt = encrypt;
+	_aes_alt.aesd.cfg.transfer_mode = AESD_TRANS_DMA;
+	_aes_alt.aesd.cfg.mode = mode;
+	_aes_alt.aesd.cfg.key_size = (enum _aesd_key_size)((ctx->keybits - 128) / 64);
+	_aes_alt.aesd.cfg.cfbs = AESD_CFBS_128;
+	_aes_alt.aesd.cfg.entag = false;
+	memcpy(_aes_alt.aesd.cfg.key, ctx->key, sizeof(ctx->key));
+	memcpy(_aes_alt.aesd.cfg.vector, iv, sizeof(_aes_alt.aesd.cfg.vector));
+
+	/* The transfer is done in place: each block is read by the TX channel
+	 * before its result is written back by the RX channel */
+	memcpy(_aes_alt_buffer, input, length);
+	/* aesd takes the engine for the transfer, wait until it is free */
+	mbedtls_alt_aes_lock();
+	mbedtls_alt_aes_unlock();
+	if (aesd_transfer(&_aes_alt.aesd, &buf, &buf, NULL, NULL) != AESD_SUCCESS)
+		return MBEDTLS_ERR_AES_HW_ACCEL_FAILED;
+	aesd_wait_transfer(&_aes_alt.aesd);
+	memcpy(output, _aes_alt_buffer, length);
+
+	mbedtls_alt_stats.aes_dma += length;
+	return 0;
+}
+
+/* Add to a 128-bit big-endian counter */
+static void _aes_alt_ctr_add(uint8_t* counter, uint32_t blocks)
+{
+	int i;
+
+	for (i = 15; i >= 0 && blocks; i--) {
+		blocks += counter[i];
+		counter[i] = (uint8_t)blocks;
+		blocks >>= 8;
+	}
+}
+
+/* Run whole blocks in CBC or CTR mode and update the chaining value. The
+ * engine counter is only 16 bits wide, CTR requests are split where it
+ * would wrap. */
+static int _aes_alt_bulk(const mbedtls_aes_context* ctx, enum _aesd_mode mode,
+		bool encrypt, uint8_t* iv, const uint8_t* input, uint8_t* output,
+		size_t length)
+{
+	bool dma = length >= _aes_alt.threshold;
+	uint8_t last[16];
+	size_t len;
+	int ret;
+
+	while (length) {
+		len = length;
+		if (mode == AESD_MODE_CTR) {
+			size_t room = (0x10000 - ((iv[14] << 8) | iv[15])) * 16;
+			if (len > room)
+				len = room;
+		}
+		if (dma && len > sizeof(_aes_alt_buffer))
+			len = sizeof(_aes_alt_buffer);
+
+		/* in-place decryption overwrites the next IV */
+		if (mode == AESD_MODE_CBC && !encrypt)
+			memcpy(last, input + len - 16, 16);
+
+		if (dma) {
+			ret = _aes_alt_run_dma(ctx, mode, encrypt, iv, input, output, len);
+			if (ret)
+				return ret;
+		} else {
+			mbedtls_alt_aes_lock();
+			_aes_alt_load(ctx, _aes_alt_mr(ctx, mode, encrypt), iv);
+			_aes_alt_run(input, output, len / 16);
+			mbedtls_alt_aes_unlock();
+			mbedtls_alt_stats.aes_polled += len;
+		}
+
+		if (mode == AESD_MODE_CBC)
+			memcpy(iv, encrypt ? output + len - 16 : last, 16);
+		else
+			_aes_alt_ctr_add(iv, len / 16);
+
+		input += len;
+		output += len;
+		length -= len;
+	}
+
+	return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+void mbedtls_alt_set_aes_dma_threshold(uint32_t threshold)
+{
+	_aes_alt.threshold = threshold;
+}
+
+uint32_t mbedtls_alt_get_aes_dma_threshold(void)
+{
+	return _aes_alt.threshold;
+}
+
+void mbedtls_alt_aes_lock(void)
+{
+	/* the holder may be a DMA transfer completed by polling */
+	while (!aesd_engine_try_lock())
+		dma_poll();
+
+	if (!_aes_alt.clocked) {
+		pmc_configure_peripheral(ID_AES, NULL, true);
+		_aes_alt.clocked = true;
+	}
+	/* someone else may have used the engine since the last request */
+	_aes_alt.owner = NULL;
+}
+
+void mbedtls_alt_aes_unlock(void)
+{
+	aesd_engine_unlock();
+}
+
+void mbedtls_aes_init(mbedtls_aes_context* ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_aes_free(mbedtls_aes_context* ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	_aes_alt_forget(ctx);
+	mbedtls_platform_zeroize(ctx, sizeof(*ctx));
+}
+
+int mbedtls_aes_setkey_enc(mbedtls_aes_context* ctx, const unsigned char* key,
+		unsigned int keybits)
+{
+	if (keybits != 128 && keybits != 192 && keybits != 256)
+		return MBEDTLS_ERR_AES_INVALID_KEY_LENGTH;
+
+	_aes_alt_forget(ctx);
+	memset(ctx->key, 0, sizeof(ctx->key));
+	memcpy(ctx->key, key, keybits / 8);
+	ctx->keybits = keybits;
+	return 0;
+}
+
+int mbedtls_aes_setkey_dec(mbedtls_aes_context* ctx, const unsigned char* key,
+		unsigned int keybits)
+{
+	/* the engine derives the decryption key schedule itself */
+	return mbedtls_aes_setkey_enc(ctx, key, keybits);
+}
+
+int mbedtls_internal_aes_encrypt(mbedtls_aes_context* ctx,
+		const unsigned char input[16], unsigned char output[16])
+{
+	mbedtls_alt_aes_lock();
+	_aes_alt_ecb(ctx, true, input, output);
+	mbedtls_alt_aes_unlock();
+	return 0;
+}
+
+int mbedtls_internal_aes_decrypt(mbedtls_aes_context* ctx,
+		const unsigned char input[16], unsigned char output[16])
+{
+	mbedtls_alt_aes_lock();
+	_aes_alt_ecb(ctx, false, input, output);
+	mbedtls_alt_aes_unlock();
+	return 0;
+}
+
+#if !defined(MBEDTLS_DEPRECATED_REMOVED)
+void mbedtls_aes_encrypt(mbedtls_aes_context* ctx,
+		const unsigned char input[16], unsigned char output[16])
+{
+	mbedtls_internal_aes_encrypt(ctx, input, output);
+}
+
+void mbedtls_aes_decrypt(mbedtls_aes_context* ctx,
+		const unsigned char input[16], unsigned char output[16])
+{
+	mbedtls_internal_aes_decrypt(ctx, input, output);
+}
+#endif
+
+int mbedtls_aes_crypt_ecb(mbedtls_aes_context* ctx, int mode,
+		const unsigned char input[16], unsigned char output[16])
+{
+	if (mode == MBEDTLS_AES_ENCRYPT)
+		return mbedtls_internal_aes_encrypt(ctx, input, output);
+	else
+		return mbedtls_internal_aes_decrypt(ctx, input, output);
+}
+
+#ifdef MBEDTLS_CIPHER_MODE_CBC
+int mbedtls_aes_crypt_cbc(mbedtls_aes_context* ctx, int mode, size_t length,
+		unsigned char iv[16], const unsigned char* input,
+		unsigned char* output)
+{
+	if (length % 16)
+		return MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH;
+
+	return _aes_alt_bulk(ctx, AESD_MODE_CBC, mode == MBEDTLS_AES_ENCRYPT,
+			iv, input, output, length);
+}
+#endif /* MBEDTLS_CIPHER_MODE_CBC */
+
+#ifdef MBEDTLS_CIPHER_MODE_CFB
+int mbedtls_aes_crypt_cfb128(mbedtls_aes_context* ctx, int mode,
+		size_t length, size_t* iv_off, unsigned char iv[16],
+		const unsigned char* input, unsigned char* output)
+{
+	size_t n = *iv_off;
+	unsigned char c;
+
+	if (n > 15)
+		return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+
+	mbedtls_alt_aes_lock();
+	while (length--) {
+		if (n == 0)
+			_aes_alt_ecb(ctx, true, iv, iv);
+		if (mode == MBEDTLS_AES_DECRYPT) {
+			c = *input++;
+			*output++ = c ^ iv[n];
+			iv[n] = c;
+		} else {
+			iv[n] = *output++ = iv[n] ^ *input++;
+		}
+		n = (n + 1) & 0x0f;
+	}
+	mbedtls_alt_aes_unlock();
+
+	*iv_off = n;
+	return 0;
+}
+
+int mbedtls_aes_crypt_cfb8(mbedtls_aes_context* ctx, int mode, size_t length,
+		unsigned char iv[16], const unsigned char* input,
+		unsigned char* output)
+{
+	unsigned char c;
+	unsigned char ov[17];
+
+	mbedtls_alt_aes_lock();
+	while (length--) {
+		memcpy(ov, iv, 16);
+		_aes_alt_ecb(ctx, true, iv, iv);
+		if (mode == MBEDTLS_AES_DECRYPT)
+			ov[16] = *input;
+		c = *output++ = iv[0] ^ *input++;
+		if (mode == MBEDTLS_AES_ENCRYPT)
+			ov[16] = c;
+		memcpy(iv, ov + 1, 16);
+	}
+	mbedtls_alt_aes_unlock();
+
+	return 0;
+}
+#endif /* MBEDTLS_CIPHER_MODE_CFB */
+
+#ifdef MBEDTLS_CIPHER_MODE_OFB
+int mbedtls_aes_crypt_ofb(mbedtls_aes_context* ctx, size_t length,
+		size_t* iv_off, unsigned char iv[16], const unsigned char* input,
+		unsigned char* output)
+{
+	size_t n = *iv_off;
+
+	if (n > 15)
+		return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+
+	mbedtls_alt_aes_lock();
+	while (length--) {
+		if (n == 0)
+			_aes_alt_ecb(ctx, true, iv, iv);
+		*output++ = *input++ ^ iv[n];
+		n = (n + 1) & 0x0f;
+	}
+	mbedtls_alt_aes_unlock();
+
+	*iv_off = n;
+	return 0;
+}
+#endif /* MBEDTLS_CIPHER_MODE_OFB */
+
+#ifdef MBEDTLS_CIPHER_MODE_CTR
+int mbedtls_aes_crypt_ctr(mbedtls_aes_context* ctx, size_t length,
+		size_t* nc_off, unsigned char nonce_counter[16],
+		unsigned char stream_block[16], const unsigned char* input,
+		unsigned char* output)
+{
+	size_t n = *nc_off;
+	size_t blocks;
+	int ret;
+
+	if (n > 15)
+		return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+
+	/* finish the key stream block left by the previous call */
+	while (n && length) {
+		*output++ = *input++ ^ stream_block[n];
+		n = (n + 1) & 0x0f;
+		length--;
+	}
+
+	blocks = length & ~(size_t)0x0f;
+	if (blocks) {
+		ret = _aes_alt_bulk(ctx, AESD_MODE_CTR, true, nonce_counter,
+				input, output, blocks);
+		if (ret)
+			return ret;
+		input += blocks;
+		output += blocks;
+		length -= blocks;
+	}
+
+	if (length) {
+		mbedtls_internal_aes_encrypt(ctx, nonce_counter, stream_block);
+		_aes_alt_ctr_add(nonce_counter, 1);
+		for (n = 0; n < length; n++)
+			output[n] = input[n] ^ stream_block[n];
+	}
+
+	*nc_off = n;
+	return 0;
+}
+#endif /* MBEDTLS_CIPHER_MODE_CTR */
+
+#endif /* MBEDTLS_AES_ALT */
@@ -0,0 +1,349 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * MBEDTLS_GCM_ALT implementation on the AES engine.
+ *
+ * mbedtls_gcm_crypt_and_tag() and mbedtls_gcm_auth_decrypt(), which are the
+ * calls made by the TLS record layer, run the whole message through the
+ * engine GCM mode with automatic tag generation. The streaming interface
+ * gets its key stream from the AES alternate and computes GHASH on the CPU.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#ifdef MBEDTLS_GCM_ALT
+
+#include <string.h>
+
+#include "chip.h"
+#include "crypto/aes.h"
+
+#include "mbedtls/gcm.h"
+#include "mbedtls/platform_util.h"
+
+#include "mbedtls_alt.h"
+
+#ifndef MBEDTLS_AES_ALT
+#error "MBEDTLS_GCM_ALT requires MBEDTLS_AES_ALT"
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/* X = X * H in GF(2^128), bit-serial as in the GCM specification */
+static void _gcm_alt_mult(const uint8_t* h, uint8_t* x)
+{
+	uint8_t z[16], v[16];
+	uint8_t lsb;
+	int i, j;
+
+	memset(z, 0, sizeof(z));
+	memcpy(v, h, sizeof(v));
+	for (i = 0; i < 128; i++) {
+		if (x[i >> 3] & (0x80 >> (i & 7))) {
+			for (j = 0; j < 16; j++)
+				z[j] ^= v[j];
+		}
+		lsb = v[15] & 1;
+		for (j = 15; j > 0; j--)
+			v[j] = (v[j] >> 1) | (v[j - 1] << 7);
+		v[0] >>= 1;
+		if (lsb)
+			v[0] ^= 0xe1;
+	}
+	memcpy(x, z, sizeof(z));
+}
+
+static void _gcm_alt_ghash(const uint8_t* h, uint8_t* x, const uint8_t* data,
+		size_t length)
+{
+	size_t i, n;
+
+	while (length) {
+		n = length < 16 ? length : 16;
+		for (i = 0; i < n; i++)
+			x[i] ^= data[i];
+		_gcm_alt_mult(h, x);
+		data += n;
+		length -= n;
+	}
+}
+
+static void _gcm_alt_put_bits(uint8_t* out, uint64_t bytes)
+{
+	uint64_t bits = bytes << 3;
+	int i;
+
+	for (i = 7; i >= 0; i--) {
+		out[i] = (uint8_t)bits;
+		bits >>= 8;
+	}
+}
+
+static void _gcm_alt_inc32(uint8_t* counter)
+{
+	int i;
+
+	for (i = 15; i >= 12; i--)
+		if (++counter[i])
+			break;
+}
+
+static void _gcm_alt_j0(const mbedtls_gcm_context* ctx, const uint8_t* iv,
+		size_t iv_len, uint8_t* j0)
+{
+	uint8_t len[16];
+
+	memset(j0, 0, 16);
+	if (iv_len == 12) {
+		memcpy(j0, iv, 12);
+		j0[15] = 1;
+	} else {
+		_gcm_alt_ghash(ctx->h, j0, iv, iv_len);
+		memset(len, 0, sizeof(len));
+		_gcm_alt_put_bits(len + 8, iv_len);
+		_gcm_alt_ghash(ctx->h, j0, len, sizeof(len));
+	}
+}
+
+/* Process a complete message in the engine GCM mode */
+static void _gcm_alt_hw(mbedtls_gcm_context* ctx, int mode, size_t length,
+		const uint8_t* iv, size_t iv_len, const uint8_t* add, size_t add_len,
+		const uint8_t* input, uint8_t* output, uint8_t* tag)
+{
+	uint32_t data[4];
+	uint8_t j0[16];
+	size_t i, n;
+
+	_gcm_alt_j0(ctx, iv, iv_len, j0);
+	_gcm_alt_inc32(j0);
+
+	mbedtls_alt_aes_lock();
+	aes_soft_reset();
+	aes_configure(AES_MR_OPMOD_GCM | AES_MR_GTAGEN |
+	              AES_MR_KEYSIZE((ctx->aes.keybits - 128) / 64) |
+	              AES_MR_SMOD_AUTO_START |
+	              (mode == MBEDTLS_GCM_ENCRYPT ? AES_MR_CIPHER : 0));
+	aes_write_key(ctx->aes.key, ctx->aes.keybits / 8);
+	/* wait for the hash subkey to be computed */
+	while (!(aes_get_status() & AES_ISR_DATRDY));
+
+	memcpy(data, j0, sizeof(data));
+	aes_set_vector(data);
+	aes_set_aad_len(add_len);
+	aes_set_data_len(length);
+
+	for (i = 0; i < add_len; i += n) {
+		n = add_len - i < 16 ? add_len - i : 16;
+		memset(data, 0, sizeof(data));
+		memcpy(data, add + i, n);
+		aes_set_input(data, sizeof(data));
+		while (!(aes_get_status() & AES_ISR_DATRDY));
+	}
+
+	for (i = 0; i < length; i += n) {
+		n = length - i < 16 ? length - i : 16;
+		memset(data, 0, sizeof(data));
+		memcpy(data, input + i, n);
+		aes_set_input(data, sizeof(data));
+		while (!(aes_get_status() & AES_ISR_DATRDY));
+		aes_get_output(data, sizeof(data));
+		memcpy(output + i, data, n);
+	}
+
+	while (!(aes_get_status() & AES_ISR_TAGRDY));
+	aes_get_gcm_tag(data);
+	mbedtls_alt_aes_unlock();
+	memcpy(tag, data, sizeof(data));
+
+	mbedtls_alt_stats.gcm_bytes += length;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+void mbedtls_gcm_init(mbedtls_gcm_context* ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	mbedtls_aes_init(&ctx->aes);
+}
+
+int mbedtls_gcm_setkey(mbedtls_gcm_context* ctx, mbedtls_cipher_id_t cipher,
+		const unsigned char* key, unsigned int keybits)
+{
+	int ret;
+
+	if (cipher != MBEDTLS_CIPHER_ID_AES)
+		return MBEDTLS_ERR_GCM_BAD_INPUT;
+
+	ret = mbedtls_aes_setkey_enc(&ctx->aes, key, keybits);
+	if (ret)
+		return ret;
+
+	memset(ctx->h, 0, sizeof(ctx->h));
+	return mbedtls_internal_aes_encrypt(&ctx->aes, ctx->h, ctx->h);
+}
+
+int mbedtls_gcm_starts(mbedtls_gcm_context* ctx, int mode,
+		const unsigned char* iv, size_t iv_len,
+		const unsigned char* add, size_t add_len)
+{
+	if (iv_len == 0 || (uint64_t)add_len >> 61)
+		return MBEDTLS_ERR_GCM_BAD_INPUT;
+
+	ctx->mode = mode;
+	ctx->len = 0;
+	ctx->add_len = add_len;
+	_gcm_alt_j0(ctx, iv, iv_len, ctx->j0);
+	memcpy(ctx->y, ctx->j0, sizeof(ctx->y));
+	memset(ctx->ghash, 0, sizeof(ctx->ghash));
+	_gcm_alt_ghash(ctx->h, ctx->ghash, add, add_len);
+	return 0;
+}
+
+int mbedtls_gcm_update(mbedtls_gcm_context* ctx, size_t length,
+		const unsigned char* input, unsigned char* output)
+{
+	size_t i, n;
+
+	if (output > input && (size_t)(output - input) < length)
+		return MBEDTLS_ERR_GCM_BAD_INPUT;
+	if (ctx->len + length < ctx->len ||
+	    ctx->len + length > 0xFFFFFFFE0ull)
+		return MBEDTLS_ERR_GCM_BAD_INPUT;
+
+	ctx->len += length;
+	mbedtls_alt_stats.gcm_bytes += length;
+	while (length) {
+		n = length < 16 ? length : 16;
+		_gcm_alt_inc32(ctx->y);
+		mbedtls_internal_aes_encrypt(&ctx->aes, ctx->y, ctx->buf);
+		if (ctx->mode == MBEDTLS_GCM_DECRYPT)
+			_gcm_alt_ghash(ctx->h, ctx->ghash, input, n);
+		for (i = 0; i < n; i++)
+			output[i] = input[i] ^ ctx->buf[i];
+		if (ctx->mode == MBEDTLS_GCM_ENCRYPT)
+			_gcm_alt_ghash(ctx->h, ctx->ghash, output, n);
+		input += n;
+		output += n;
+		length -= n;
+	}
+
+	return 0;
+}
+
+int mbedtls_gcm_finish(mbedtls_gcm_context* ctx, unsigned char* tag,
+		size_t tag_len)
+{
+	uint8_t len[16];
+	size_t i;
+
+	if (tag_len > 16 || tag_len < 4)
+		return MBEDTLS_ERR_GCM_BAD_INPUT;
+
+	_gcm_alt_put_bits(len, ctx->add_len);
+	_gcm_alt_put_bits(len + 8, ctx->len);
+	_gcm_alt_ghash(ctx->h, ctx->ghash, len, sizeof(len));
+
+	mbedtls_internal_aes_encrypt(&ctx->aes, ctx->j0, ctx->buf);
+	for (i = 0; i < tag_len; i++)
+		tag[i] = ctx->buf[i] ^ ctx->ghash[i];
+	return 0;
+}
+
+int mbedtls_gcm_crypt_and_tag(mbedtls_gcm_context* ctx, int mode,
+		size_t length, const unsigned char* iv, size_t iv_len,
+		const unsigned char* add, size_t add_len,
+		const unsigned char* input, unsigned char* output,
+		size_t tag_len, unsigned char* tag)
+{
+	uint8_t full_tag[16];
+
+	if (iv_len == 0 || tag_len > 16 || tag_len < 4)
+		return MBEDTLS_ERR_GCM_BAD_INPUT;
+	/* the engine length registers are 32-bit */
+	if ((uint64_t)length > 0xFFFFFFFFu || (uint64_t)add_len > 0xFFFFFFFFu)
+		return MBEDTLS_ERR_GCM_BAD_INPUT;
+
+	_gcm_alt_hw(ctx, mode, length, iv, iv_len, add, add_len,
+			input, output, full_tag);
+	memcpy(tag, full_tag, tag_len);
+	return 0;
+}
+
+int mbedtls_gcm_auth_decrypt(mbedtls_gcm_context* ctx, size_t length,
+		const unsigned char* iv, size_t iv_len,
+		const unsigned char* add, size_t add_len,
+		const unsigned char* tag, size_t tag_len,
+		const unsigned char* input, unsigned char* output)
+{
+	uint8_t check_tag[16];
+	uint8_t diff = 0;
+	size_t i;
+	int ret;
+
+	ret = mbedtls_gcm_crypt_and_tag(ctx, MBEDTLS_GCM_DECRYPT, length,
+			iv, iv_len, add, add_len, input, output, tag_len, check_tag);
+	if (ret)
+		return ret;
+
+	/* constant-time comparison */
+	for (i = 0; i < tag_len; i++)
+		diff |= tag[i] ^ check_tag[i];
+
+	if (diff) {
+		mbedtls_platform_zeroize(output, length);
+		return MBEDTLS_ERR_GCM_AUTH_FAILED;
+	}
+	return 0;
+}
+
+void mbedtls_gcm_free(mbedtls_gcm_context* ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	mbedtls_aes_free(&ctx->aes);
+	mbedtls_platform_zeroize(ctx, sizeof(*ctx));
+}
+
+#endif /* MBEDTLS_GCM_ALT */
@@ -0,0 +1,71 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * GCM context used by the MBEDTLS_GCM_ALT implementation (gcm_alt.c).
+ */
+
+#ifndef GCM_ALT_H
+#define GCM_ALT_H
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+#include "mbedtls/aes.h"
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief GCM context
+ *
+ * One-shot operations run completely in the AES engine GCM mode. The
+ * streaming interface (starts/update/finish) keeps its state here so that
+ * several messages can be interleaved: the keystream comes from the engine
+ * in CTR mode and GHASH is computed by the CPU.
+ */
+typedef struct mbedtls_gcm_context {
+	mbedtls_aes_context aes; /**< key, shared with the AES alternate */
+	uint8_t h[16];           /**< hash subkey E(K, 0^128) */
+	uint8_t j0[16];          /**< pre-counter block */
+	uint8_t y[16];           /**< current counter block */
+	uint8_t ghash[16];       /**< running GHASH value */
+	uint8_t buf[16];         /**< last keystream block */
+	uint64_t len;            /**< processed data length */
+	uint64_t add_len;        /**< additional data length */
+	int mode;                /**< MBEDTLS_GCM_ENCRYPT or MBEDTLS_GCM_DECRYPT */
+} mbedtls_gcm_context;
+
+#endif /* GCM_ALT_H */
@@ -0,0 +1,210 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Statistics and throughput measurement of the mbedTLS hardware alternates.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "compiler.h"
+#include "timer.h"
+
+#include "mbedtls/aes.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/sha256.h"
+
+#include "mbedtls_alt.h"
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Duration of each throughput measurement (ms) */
+#define BENCHMARK_DURATION 250
+
+/*----------------------------------------------------------------------------
+ *        Exported variables
+ *----------------------------------------------------------------------------*/
+
+struct _mbedtls_alt_stats mbedtls_alt_stats;
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+static const uint32_t _benchmark_sizes[] = { 64, 512, 1500, 16384 };
+
+static uint8_t _benchmark_buffer[16384];
+
+static const unsigned char _benchmark_key[16] = {
+	0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+	0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+typedef int (*_benchmark_op_t)(void* ctx, uint32_t size);
+
+static void _benchmark_run(const char* name, _benchmark_op_t op, void* ctx)
+{
+	uint64_t start, elapsed;
+	uint32_t i, count;
+
+	for (i = 0; i < ARRAY_SIZE(_benchmark_sizes); i++) {
+		count = 0;
+		start = timer_get_tick();
+		do {
+			if (op(ctx, _benchmark_sizes[i])) {
+				printf("%-20s %5u B: failed\r\n", name,
+						(unsigned)_benchmark_sizes[i]);
+				return;
+			}
+			count++;
+			elapsed = timer_get_interval(start, timer_get_tick());
+		} while (elapsed < BENCHMARK_DURATION);
+
+		printf("%-20s %5u B: %6u KiB/s, %6u op/s\r\n", name,
+				(unsigned)_benchmark_sizes[i],
+				(unsigned)((uint64_t)count * _benchmark_sizes[i] * 1000 / 1024 / elapsed),
+				(unsigned)((uint64_t)count * 1000 / elapsed));
+	}
+}
+
+#ifdef MBEDTLS_AES_ALT
+static int _benchmark_cbc(void* ctx, uint32_t size)
+{
+	unsigned char iv[16] = { 0 };
+
+	return mbedtls_aes_crypt_cbc((mbedtls_aes_context*)ctx, MBEDTLS_AES_ENCRYPT,
+			size, iv, _benchmark_buffer, _benchmark_buffer);
+}
+
+static int _benchmark_ctr(void* ctx, uint32_t size)
+{
+	unsigned char nonce[16] = { 0 };
+	unsigned char stream[16];
+	size_t off = 0;
+
+	return mbedtls_aes_crypt_ctr((mbedtls_aes_context*)ctx, size, &off,
+			nonce, stream, _benchmark_buffer, _benchmark_buffer);
+}
+
+static void _benchmark_aes(void)
+{
+	mbedtls_aes_context aes;
+	uint32_t threshold = mbedtls_alt_get_aes_dma_threshold();
+
+	mbedtls_aes_init(&aes);
+	mbedtls_aes_setkey_enc(&aes, _benchmark_key, 128);
+
+	mbedtls_alt_set_aes_dma_threshold(UINT32_MAX);
+	_benchmark_run("AES-128-CBC polled", _benchmark_cbc, &aes);
+	_benchmark_run("AES-128-CTR polled", _benchmark_ctr, &aes);
+	mbedtls_alt_set_aes_dma_threshold(0);
+	_benchmark_run("AES-128-CBC DMA", _benchmark_cbc, &aes);
+	_benchmark_run("AES-128-CTR DMA", _benchmark_ctr, &aes);
+	mbedtls_alt_set_aes_dma_threshold(threshold);
+
+	mbedtls_aes_free(&aes);
+}
+#endif /* MBEDTLS_AES_ALT */
+
+#ifdef MBEDTLS_GCM_ALT
+static int _benchmark_gcm(void* ctx, uint32_t size)
+{
+	unsigned char iv[12] = { 0 };
+	unsigned char tag[16];
+
+	return mbedtls_gcm_crypt_and_tag((mbedtls_gcm_context*)ctx,
+			MBEDTLS_GCM_ENCRYPT, size, iv, sizeof(iv), iv, 13,
+			_benchmark_buffer, _benchmark_buffer, sizeof(tag), tag);
+}
+
+static void _benchmark_gcm_all(void)
+{
+	mbedtls_gcm_context gcm;
+
+	mbedtls_gcm_init(&gcm);
+	mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, _benchmark_key, 128);
+	_benchmark_run("AES-128-GCM", _benchmark_gcm, &gcm);
+	mbedtls_gcm_free(&gcm);
+}
+#endif /* MBEDTLS_GCM_ALT */
+
+#ifdef MBEDTLS_SHA256_ALT
+static int _benchmark_sha256(void* ctx, uint32_t size)
+{
+	unsigned char digest[32];
+
+	(void)ctx;
+	return mbedtls_sha256_ret(_benchmark_buffer, size, digest, 0);
+}
+#endif /* MBEDTLS_SHA256_ALT */
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+void mbedtls_alt_get_stats(struct _mbedtls_alt_stats* stats, bool reset)
+{
+	*stats = mbedtls_alt_stats;
+	if (reset)
+		memset(&mbedtls_alt_stats, 0, sizeof(mbedtls_alt_stats));
+}
+
+void mbedtls_alt_benchmark(void)
+{
+	memset(_benchmark_buffer, 0x5a, sizeof(_benchmark_buffer));
+
+#ifdef MBEDTLS_AES_ALT
+	_benchmark_aes();
+#endif
+#ifdef MBEDTLS_GCM_ALT
+	_benchmark_gcm_all();
+#endif
+#ifdef MBEDTLS_SHA256_ALT
+	_benchmark_run("SHA-256", _benchmark_sha256, NULL);
+#endif
+}
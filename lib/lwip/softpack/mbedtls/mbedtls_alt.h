@@ -0,0 +1,134 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Runtime control and statistics of the mbedTLS hardware alternates.
+ */
+
+#ifndef MBEDTLS_ALT_H
+#define MBEDTLS_ALT_H
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Default size from which bulk AES requests are moved by DMA (bytes) */
+#ifndef MBEDTLS_ALT_AES_DMA_THRESHOLD
+#define MBEDTLS_ALT_AES_DMA_THRESHOLD 512
+#endif
+
+/** Size of the cache-aligned buffer used for DMA transfers (bytes) */
+#ifndef MBEDTLS_ALT_AES_DMA_BUFFER_SIZE
+#define MBEDTLS_ALT_AES_DMA_BUFFER_SIZE 2048
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+struct _shad_desc;
+
+struct _mbedtls_alt_stats {
+	uint32_t aes_polled;    /**< AES bytes fed to the engine by the CPU */
+	uint32_t aes_dma;       /**< AES bytes moved by DMA */
+	uint32_t aes_key_loads; /**< engine (re)programming */
+	uint32_t aes_key_hits;  /**< ECB blocks that reused the loaded key */
+	uint32_t gcm_bytes;     /**< GCM bytes (AAD excluded) */
+	uint32_t sha256_bytes;  /**< bytes hashed by the SHA engine */
+	uint32_t entropy_bytes; /**< bytes returned by the TRNG poll */
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported variables
+ *----------------------------------------------------------------------------*/
+
+/** Statistics, updated by the alternates */
+extern struct _mbedtls_alt_stats mbedtls_alt_stats;
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Set the size from which CBC and CTR requests are moved by DMA.
+ * Smaller requests are fed to the engine by the CPU.
+ * \param threshold  Request size in bytes, 0 to always use DMA
+ */
+extern void mbedtls_alt_set_aes_dma_threshold(uint32_t threshold);
+
+/**
+ * \brief Get the size from which CBC and CTR requests are moved by DMA.
+ */
+extern uint32_t mbedtls_alt_get_aes_dma_threshold(void);
+
+/**
+ * \brief Take the AES engine for a direct register sequence, waiting for
+ * the other aesd users to release it. The engine is clocked and the key
+ * cached for ECB blocks is dropped.
+ */
+extern void mbedtls_alt_aes_lock(void);
+
+/**
+ * \brief Give back the AES engine taken with mbedtls_alt_aes_lock().
+ */
+extern void mbedtls_alt_aes_unlock(void);
+
+#ifdef CONFIG_HAVE_SHA_HMAC
+/**
+ * \brief Set the SHA driver descriptor the SHA-256 contexts run on, shared
+ * with the other users of the SHA engine. Must be called before any SHA-256
+ * operation, which fails with MBEDTLS_ERR_SHA256_HW_ACCEL_FAILED otherwise.
+ * \param shad  SHA driver descriptor, initialized with shad_init()
+ */
+extern void mbedtls_alt_set_shad(struct _shad_desc* shad);
+#endif
+
+/**
+ * \brief Get the statistics of the alternates.
+ * \param stats  Pointer to the structure to fill
+ * \param reset  Clear the counters after reading them
+ */
+extern void mbedtls_alt_get_stats(struct _mbedtls_alt_stats* stats, bool reset);
+
+/**
+ * \brief Print the throughput of the accelerated primitives for a few
+ * request sizes, polled and DMA for AES.
+ */
+extern void mbedtls_alt_benchmark(void);
+
+#endif /* MBEDTLS_ALT_H */
@@ -0,0 +1,67 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * mbedTLS build options for the SAMA5/SAM9/SAMV crypto engines.
+ *
+ * Include this file at the end of the mbedTLS configuration used by the
+ * application (for example through MBEDTLS_USER_CONFIG_FILE). It selects the
+ * hardware alternates that the current SoC can back with its AES, SHA and
+ * TRNG peripherals; every other primitive keeps the mbedTLS implementation.
+ */
+
+#ifndef MBEDTLS_ALT_CONFIG_H
+#define MBEDTLS_ALT_CONFIG_H
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+#ifdef CONFIG_HAVE_AES
+#define MBEDTLS_AES_ALT
+/* XTS is not offered by the alternate, mbedTLS has no hook for it */
+#undef MBEDTLS_CIPHER_MODE_XTS
+#ifdef CONFIG_HAVE_AES_GCM
+#define MBEDTLS_GCM_ALT
+#endif
+#endif
+
+/* The intermediate hash of a context is reloaded through the user initial
+ * hash value registers, which only the HMAC-capable SHA engines have. */
+#ifdef CONFIG_HAVE_SHA_HMAC
+#define MBEDTLS_SHA256_ALT
+#endif
+
+#ifdef CONFIG_HAVE_TRNG
+#define MBEDTLS_ENTROPY_HARDWARE_ALT
+#endif
+
+#endif /* MBEDTLS_ALT_CONFIG_H */
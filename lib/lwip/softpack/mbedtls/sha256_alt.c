@@ -0,0 +1,171 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * MBEDTLS_SHA256_ALT implementation on the SHA engine.
+ *
+ * Contexts are shad hash streams: shad owns the engine, saves the
+ * intermediate hash of a stream between runs and serializes the streams
+ * with the other requests on the same descriptor. Requests are waited for,
+ * as mbedTLS expects the digest state to be up to date on return.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#ifdef MBEDTLS_SHA256_ALT
+
+#include <string.h>
+
+#include "chip.h"
+#include "crypto/shad.h"
+
+#include "mbedtls/sha256.h"
+#include "mbedtls/platform_util.h"
+
+#include "mbedtls_alt.h"
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+static struct _shad_desc* _sha256_alt_shad;
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+void mbedtls_alt_set_shad(struct _shad_desc* shad)
+{
+	_sha256_alt_shad = shad;
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	mbedtls_platform_zeroize(ctx, sizeof(*ctx));
+}
+
+void mbedtls_sha256_clone(mbedtls_sha256_context* dst,
+		const mbedtls_sha256_context* src)
+{
+	/* requests are waited for, the stream is never queued here */
+	*dst = *src;
+}
+
+int mbedtls_sha256_starts_ret(mbedtls_sha256_context* ctx, int is224)
+{
+	if (!_sha256_alt_shad)
+		return MBEDTLS_ERR_SHA256_HW_ACCEL_FAILED;
+
+	ctx->is224 = is224;
+	if (shad_ctx_start(_sha256_alt_shad, &ctx->stream,
+			is224 ? ALGO_SHA_224 : ALGO_SHA_256) < 0)
+		return MBEDTLS_ERR_SHA256_HW_ACCEL_FAILED;
+	return 0;
+}
+
+/* mbedTLS only calls it on whole blocks of the message, which is what the
+ * stream does with data given to an update */
+int mbedtls_internal_sha256_process(mbedtls_sha256_context* ctx,
+		const unsigned char data[64])
+{
+	return mbedtls_sha256_update_ret(ctx, data, 64);
+}
+
+int mbedtls_sha256_update_ret(mbedtls_sha256_context* ctx,
+		const unsigned char* input, size_t ilen)
+{
+	if (ilen == 0)
+		return 0;
+
+	if (shad_ctx_update(&ctx->stream, input, ilen, NULL) < 0)
+		return MBEDTLS_ERR_SHA256_HW_ACCEL_FAILED;
+	shad_ctx_wait(&ctx->stream);
+
+	mbedtls_alt_stats.sha256_bytes += ilen;
+	return 0;
+}
+
+int mbedtls_sha256_finish_ret(mbedtls_sha256_context* ctx,
+		unsigned char output[32])
+{
+	struct _buffer digest = {
+		.data = output,
+		.size = ctx->is224 ? 28 : 32,
+	};
+
+	if (shad_ctx_finish(&ctx->stream, &digest, NULL) < 0)
+		return MBEDTLS_ERR_SHA256_HW_ACCEL_FAILED;
+	shad_ctx_wait(&ctx->stream);
+	return 0;
+}
+
+#if !defined(MBEDTLS_DEPRECATED_REMOVED)
+void mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224)
+{
+	mbedtls_sha256_starts_ret(ctx, is224);
+}
+
+void mbedtls_sha256_update(mbedtls_sha256_context* ctx,
+		const unsigned char* input, size_t ilen)
+{
+	mbedtls_sha256_update_ret(ctx, input, ilen);
+}
+
+void mbedtls_sha256_finish(mbedtls_sha256_context* ctx,
+		unsigned char output[32])
+{
+	mbedtls_sha256_finish_ret(ctx, output);
+}
+
+void mbedtls_sha256_process(mbedtls_sha256_context* ctx,
+		const unsigned char data[64])
+{
+	mbedtls_internal_sha256_process(ctx, data);
+}
+#endif
+
+#endif /* MBEDTLS_SHA256_ALT */
@@ -87,6 +87,10 @@ static struct _uvc_driver *uvc_driver;
 static volatile uint32_t frame_buffer_addr;
 
 static uint32_t uvc_frame_count = 0;
+
+static const struct _uvc_frame_ops* frame_ops;
+
+static int frame_held = -1;
 /*-----------------------------------------------------------------------------
  *      Exported functions
  *-----------------------------------------------------------------------------*/
@@ -288,14 +292,28 @@ void uvc_function_payload_sent(void *arg, uint8_t state,
 {
 	uint32_t dma_transfer_size;
 	uint32_t frame_size = FRAME_BUFFER_SIZEC(frm_width, frm_height);
-	uint8_t *uncompressed_stream = (uint8_t*)(uvc_driver->buf_start_addr +
-									frame_buffer_addr * FRAME_BUFFER_SIZEC(frm_width, frm_height));
+	uint8_t *uncompressed_stream;
 	USBVideoPayloadHeader *header = (USBVideoPayloadHeader*)stream_header;
 	uint32_t max_pkt_size = usbd_is_high_speed() ? frm_max_pkt_size : FRAME_PACKET_SIZE_FS;
+	int frame;
+
 	if (remaining){
 
 		return;
 	}
+	if (frame_ops && uvc_driver->frm_offset == 0) {
+		/* Hold the most recent frame while it is sent, resend the
+		 * previous one if none is available */
+		frame = frame_ops->acquire();
+		if (frame >= 0) {
+			if (frame_held >= 0)
+				frame_ops->release(frame_held);
+			frame_held = frame;
+			frame_buffer_addr = frame;
+		}
+	}
+	uncompressed_stream = (uint8_t*)(uvc_driver->buf_start_addr +
+			frame_buffer_addr * FRAME_BUFFER_SIZEC(frm_width, frm_height));
 	dma_transfer_size = frame_size - uvc_driver->frm_offset;
 	header->bHeaderLength = FRAME_PAYLOAD_HDR_SIZE;
 	header->bmHeaderInfo.B = 0;
@@ -309,9 +327,11 @@ void uvc_function_payload_sent(void *arg, uint8_t state,
 		uvc_driver->frm_offset = 0;
 		header->bmHeaderInfo.bm.EoF = 1;
 		uvc_frame_count++;
-		frame_buffer_addr = uvc_driver ->stream_frm_index;
-		frame_buffer_addr = (frame_buffer_addr == 0) ?
-							(uvc_driver->multi_buffers - 1): (frame_buffer_addr -1);
+		if (!frame_ops) {
+			frame_buffer_addr = uvc_driver ->stream_frm_index;
+			frame_buffer_addr = (frame_buffer_addr == 0) ?
+								(uvc_driver->multi_buffers - 1): (frame_buffer_addr -1);
+		}
 		if (uvc_driver->is_frame_xfring)
 			uvc_driver->is_frame_xfring = 0;
 	} else {
@@ -344,5 +364,17 @@ void uvc_function_update_frame_idx(uint32_t idx)
 	uvc_driver->stream_frm_index = idx;
 }
 
+/**
+ * Select the frame buffers to send with a frame source instead of the index
+ * given by uvc_function_update_frame_idx(). Any frame held from a previous
+ * source is forgotten without being released.
+ */
+void uvc_function_set_frame_ops(const struct _uvc_frame_ops* ops)
+{
+	frame_ops = ops;
+	frame_held = -1;
+	frame_buffer_addr = 0;
+}
+
 /**@}*/
 
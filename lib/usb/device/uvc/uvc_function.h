@@ -45,6 +45,21 @@
 #include <stdint.h>
 #include "usb/device/uvc/uvc_driver.h"
 
+/*------------------------------------------------------------------------------
+ *         Types
+ *------------------------------------------------------------------------------*/
+
+/**
+ * Frame source used to select the frame buffer sent to the host.
+ * acquire() returns the index of the frame buffer to send next and keeps it
+ * from being captured into until release() is called, or returns -1 if no
+ * frame is available.
+ */
+struct _uvc_frame_ops {
+	int (*acquire)(void);
+	void (*release)(int index);
+};
+
 /*------------------------------------------------------------------------------
  *      Global functions
  *------------------------------------------------------------------------------*/
@@ -61,6 +76,7 @@ extern void uvc_function_set_cur(const USBGenericRequest *request);
 extern uint8_t uvc_function_is_video_on(void);
 extern uint8_t uvc_function_get_frame_format(void);
 extern void uvc_function_update_frame_idx(uint32_t idx);
+extern void uvc_function_set_frame_ops(const struct _uvc_frame_ops* ops);
 extern void uvc_reset_frame_count(void);
 extern uint32_t uvc_get_frame_count(void);
 /**@}*/
@@ -48,6 +48,9 @@
 #define APPLET_CMD_WRITE_BOOTCFG     0x35 /* Write Boot Config */
 #define APPLET_CMD_TAG_BLOCK         0x36 /* Tag / untag block as bad */
 #define APPLET_CMD_ENABLE_BOOT_PART  0x37 /* Enable / disable eMMC boot partition */
+#define APPLET_CMD_WRITE_PAGES_PP    0x38 /* Write pages from a ping-pong buffer */
+#define APPLET_CMD_WRITE_COMPRESSED  0x39 /* Decompress and write pages */
+#define APPLET_CMD_VERIFY            0x3A /* Compute the digest of pages */
 
 #define APPLET_SUCCESS               0x00 /* Operation was successful */
 #define APPLET_DEV_UNKNOWN           0x01 /* Device unknown */
@@ -62,6 +65,13 @@
 #define APPLET_PMECC_CONFIG          0x0A /* ECC configure failure */
 #define APPLET_FAIL                  0x0F /* Generic/Unknown failure */
 
+/* Compression formats for the 'write compressed' command */
+#define APPLET_COMPRESSION_LZ4       0x00 /* LZ4 block format */
+
+/* Digest algorithms for the 'verify' command */
+#define APPLET_VERIFY_CRC32          0x00 /* CRC-32 (as zlib crc32) */
+#define APPLET_VERIFY_SHA256         0x01 /* SHA-256, on devices with SHA */
+
 /* Communication link identification */
 #define COMM_TYPE_USB                0x00
 #define COMM_TYPE_DBGU               0x01
@@ -178,6 +188,97 @@ union boot_partition_mailbox {
 	} out;
 };
 
+/**
+ * \brief Mailbox content for the 'write pages ping-pong' command.
+ *
+ * The applet buffer is split in two ping-pong buffers: buffer n starts at
+ * buf_addr + n * size, where size is buf_size / 2 rounded down to a whole
+ * number of pages. The command first waits for the end of the previous
+ * ping-pong write, then starts writing the given buffer and returns while
+ * the memory may still be busy, so that the host can fill the other buffer
+ * meanwhile. The buffer being written must not be modified until the next
+ * command returns.
+ *
+ * If the previous write failed, its error is returned and nothing is
+ * written: the host must write the previous buffer again.
+ */
+union write_pages_pp_mailbox {
+	struct {
+		/** Write offset (in pages) */
+		uint32_t offset;
+		/** Write length (in pages), 0 to only wait for the previous write */
+		uint32_t length;
+		/** Ping-pong buffer index (0 or 1) */
+		uint32_t buffer;
+	} in;
+
+	struct {
+		/** Pages written */
+		uint32_t pages;
+		/** Time since the previous ping-pong command returned (in us) */
+		uint32_t host_time;
+		/** Time waiting for the previous write (in us) */
+		uint32_t wait_time;
+		/** Time starting this write (in us) */
+		uint32_t write_time;
+	} out;
+};
+
+/**
+ * \brief Mailbox content for the 'write compressed' command.
+ *
+ * The compressed data is read from ping-pong buffer 0 and decompressed in
+ * ping-pong buffer 1, see union write_pages_pp_mailbox, so each command
+ * must decompress to at most one ping-pong buffer. The last page is padded
+ * with 0xFF. On memories whose erased state is 0xFF, pages that are all
+ * 0xFF are not written: the range must have been erased.
+ */
+union write_compressed_mailbox {
+	struct {
+		/** Write offset (in pages) */
+		uint32_t offset;
+		/** Compressed data length (in bytes) */
+		uint32_t length;
+		/** Compression format (APPLET_COMPRESSION_*) */
+		uint32_t format;
+		/** CRC-32 returned by the previous command, 0 for the first one */
+		uint32_t crc;
+	} in;
+
+	struct {
+		/** Pages written or skipped */
+		uint32_t pages;
+		/** Pages skipped because they were all 0xFF */
+		uint32_t skipped;
+		/** CRC-32 of the decompressed data, padding excluded, continuing
+		 * the input CRC-32 */
+		uint32_t crc;
+	} out;
+};
+
+/**
+ * \brief Mailbox content for the 'verify' command.
+ *
+ * The pages are read in the ping-pong buffers, which are overwritten.
+ */
+union verify_mailbox {
+	struct {
+		/** Verify offset (in pages) */
+		uint32_t offset;
+		/** Verify length (in pages) */
+		uint32_t length;
+		/** Digest algorithm (APPLET_VERIFY_*) */
+		uint32_t algo;
+	} in;
+
+	struct {
+		/** Pages read */
+		uint32_t pages;
+		/** CRC-32 in the first word, or SHA-256 digest bytes */
+		uint32_t digest[8];
+	} out;
+};
+
 typedef uint32_t (*applet_command_handler_t)(uint32_t cmd, uint32_t *args);
 
 struct applet_command
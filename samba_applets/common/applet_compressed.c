@@ -0,0 +1,172 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "applet.h"
+#include "applet_compressed.h"
+#include "applet_pingpong.h"
+#include "crc32.h"
+#include "lz4.h"
+#include "trace.h"
+
+/*----------------------------------------------------------------------------
+ *         Local functions
+ *----------------------------------------------------------------------------*/
+
+static bool page_is_erased(const uint8_t *page, uint32_t page_size)
+{
+	const uint32_t *word = (const uint32_t *)page;
+	uint32_t i;
+
+	for (i = 0; i < page_size / 4; i++)
+		if (word[i] != 0xffffffff)
+			return false;
+
+	return true;
+}
+
+static uint32_t write_run(const struct applet_pingpong_ops *ops,
+		uint32_t offset, uint32_t first, uint32_t last,
+		const uint8_t *data, uint32_t page_size, uint32_t *pages)
+{
+	uint32_t written = 0;
+	uint32_t status;
+
+	if (first == last)
+		return APPLET_SUCCESS;
+
+	status = ops->write(offset + first, last - first,
+			data + first * page_size, &written);
+
+	/* the next run must not start while the memory is still busy with
+	 * the last page of this one */
+	if (ops->wait) {
+		uint32_t wait_status = ops->wait();
+		if (status == APPLET_SUCCESS && wait_status != APPLET_SUCCESS) {
+			status = wait_status;
+			written = 0;
+		}
+	}
+
+	if (status != APPLET_SUCCESS)
+		*pages = first + written;
+
+	return status;
+}
+
+/*----------------------------------------------------------------------------
+ *         Global functions
+ *----------------------------------------------------------------------------*/
+
+uint32_t applet_handle_cmd_write_compressed(uint32_t cmd, uint32_t *mailbox)
+{
+	union write_compressed_mailbox *mbx =
+		(union write_compressed_mailbox*)mailbox;
+	const struct applet_pingpong_ops *ops = applet_pingpong_get_ops();
+	uint32_t offset = mbx->in.offset;
+	uint32_t length = mbx->in.length;
+	uint32_t format = mbx->in.format;
+	uint32_t crc = mbx->in.crc;
+	uint32_t page_size, in_size, out_size, count, page, first;
+	uint32_t pages = 0, skipped = 0, status = APPLET_SUCCESS;
+	uint8_t *in, *out;
+	int size;
+
+	assert(cmd == APPLET_CMD_WRITE_COMPRESSED);
+
+	mbx->out.pages = 0;
+	mbx->out.skipped = 0;
+	mbx->out.crc = crc;
+
+	if (!ops) {
+		trace_error("Compressed writes not supported\r\n");
+		return APPLET_FAIL;
+	}
+
+	if (format != APPLET_COMPRESSION_LZ4) {
+		trace_error("Unsupported compression format %u\r\n",
+				(unsigned)format);
+		return APPLET_FAIL;
+	}
+
+	page_size = applet_pingpong_get_page_size();
+	in = applet_pingpong_get_buffer(0, &in_size);
+	out = applet_pingpong_get_buffer(1, &out_size);
+
+	/* check that requested size does not overflow buffer */
+	if (length > in_size) {
+		trace_error("Buffer overflow\r\n");
+		return APPLET_FAIL;
+	}
+
+	size = lz4_decompress(in, length, out, out_size);
+	if (size < 0) {
+		trace_error("Invalid compressed data (%d)\r\n", size);
+		return APPLET_FAIL;
+	}
+
+	/* the CRC covers the data only, not the padding of the last page */
+	crc = crc32_update(crc, out, size);
+	count = ((uint32_t)size + page_size - 1) / page_size;
+	memset(out + size, 0xff, count * page_size - size);
+
+	/* write runs of non-erased pages */
+	first = 0;
+	for (page = 0; page < count; page++) {
+		if (!ops->erased_ff ||
+		    !page_is_erased(out + page * page_size, page_size))
+			continue;
+		status = write_run(ops, offset, first, page, out, page_size, &pages);
+		if (status != APPLET_SUCCESS)
+			break;
+		skipped++;
+		first = page + 1;
+	}
+	if (status == APPLET_SUCCESS)
+		status = write_run(ops, offset, first, count, out, page_size, &pages);
+
+	if (status != APPLET_SUCCESS) {
+		trace_error("Write error\r\n");
+		mbx->out.pages = pages;
+		return status;
+	}
+
+	trace_info_wp("Wrote %u pages (%u erased skipped) at page %u from "
+			"%u compressed bytes\r\n", (unsigned)count,
+			(unsigned)skipped, (unsigned)offset, (unsigned)length);
+
+	mbx->out.pages = count;
+	mbx->out.skipped = skipped;
+	mbx->out.crc = crc;
+
+	return APPLET_SUCCESS;
+}
@@ -31,6 +31,7 @@
 
 #include "applet.h"
 #include "applet_legacy.h"
+#include "applet_pingpong.h"
 #include "board.h"
 #include "board_console.h"
 #include "board_timer.h"
@@ -215,6 +216,7 @@ applet_command_handler_t get_applet_command_handler(uint8_t cmd)
 void applet_main(void)
 {
 	applet_command_handler_t handler;
+	uint32_t pingpong_status = APPLET_SUCCESS;
 
 	if (applet_first_run) {
 		/* Let's do some setup */
@@ -232,9 +234,16 @@ void applet_main(void)
 	/* set default status */
 	applet_mailbox.status = APPLET_FAIL;
 
+	/* any other command needs the ping-pong write to be complete */
+	if (applet_mailbox.command != APPLET_CMD_WRITE_PAGES_PP)
+		pingpong_status = applet_pingpong_sync();
+
 	/* look for handler and call it */
 	handler = get_applet_command_handler(applet_mailbox.command);
-	if (handler) {
+	if (pingpong_status != APPLET_SUCCESS) {
+		trace_error_wp("Ping-pong write failed\r\n");
+		applet_mailbox.status = pingpong_status;
+	} else if (handler) {
 		if (applet_mailbox.command == APPLET_CMD_INITIALIZE) {
 			applet_mailbox.status = handler(applet_mailbox.command, applet_mailbox.data);
 			applet_initialized = (applet_mailbox.status == APPLET_SUCCESS);
@@ -0,0 +1,176 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "applet.h"
+#include "applet_pingpong.h"
+#include "timer.h"
+#include "trace.h"
+
+/*----------------------------------------------------------------------------
+ *         Local variables
+ *----------------------------------------------------------------------------*/
+
+static struct {
+	const struct applet_pingpong_ops *ops;
+	uint8_t *buffer;
+	uint32_t size;          /* size of each ping-pong buffer (in bytes) */
+	uint32_t page_size;
+	bool pending;           /* a write may still be in progress */
+	uint64_t last_return;   /* end of the previous command (in us) */
+} _pingpong;
+
+/*----------------------------------------------------------------------------
+ *         Local functions
+ *----------------------------------------------------------------------------*/
+
+static uint32_t _elapsed_us(uint64_t start)
+{
+	uint64_t elapsed = timer_get_us() - start;
+
+	return elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+}
+
+/*----------------------------------------------------------------------------
+ *         Global functions
+ *----------------------------------------------------------------------------*/
+
+bool applet_pingpong_init(const struct applet_pingpong_ops *ops,
+		uint8_t *buffer, uint32_t buffer_size, uint32_t page_size)
+{
+	assert(ops && ops->write);
+
+	memset(&_pingpong, 0, sizeof(_pingpong));
+	_pingpong.size = (buffer_size / 2 / page_size) * page_size;
+	if (_pingpong.size == 0)
+		return false;
+
+	_pingpong.ops = ops;
+	_pingpong.buffer = buffer;
+	_pingpong.page_size = page_size;
+
+	return true;
+}
+
+uint32_t applet_pingpong_sync(void)
+{
+	if (!_pingpong.pending)
+		return APPLET_SUCCESS;
+
+	_pingpong.pending = false;
+	return _pingpong.ops->wait();
+}
+
+const struct applet_pingpong_ops *applet_pingpong_get_ops(void)
+{
+	return _pingpong.ops;
+}
+
+uint8_t *applet_pingpong_get_buffer(uint32_t index, uint32_t *size)
+{
+	*size = _pingpong.size;
+	return _pingpong.buffer + index * _pingpong.size;
+}
+
+uint32_t applet_pingpong_get_page_size(void)
+{
+	return _pingpong.page_size;
+}
+
+uint32_t applet_handle_cmd_write_pages_pp(uint32_t cmd, uint32_t *mailbox)
+{
+	union write_pages_pp_mailbox *mbx =
+		(union write_pages_pp_mailbox*)mailbox;
+	uint32_t offset = mbx->in.offset;
+	uint32_t length = mbx->in.length;
+	uint32_t index = mbx->in.buffer;
+	uint64_t start = timer_get_us();
+	uint32_t host_time, status, pages = 0;
+
+	assert(cmd == APPLET_CMD_WRITE_PAGES_PP);
+
+	host_time = _pingpong.last_return ? _elapsed_us(_pingpong.last_return) : 0;
+	mbx->out.wait_time = 0;
+	mbx->out.write_time = 0;
+
+	if (!_pingpong.ops) {
+		trace_error("Ping-pong buffers not supported\r\n");
+		status = APPLET_FAIL;
+		goto exit;
+	}
+
+	/* complete the write of the other buffer before reporting anything */
+	status = applet_pingpong_sync();
+	mbx->out.wait_time = _elapsed_us(start);
+	if (status != APPLET_SUCCESS) {
+		trace_error("Previous ping-pong write failed\r\n");
+		goto exit;
+	}
+
+	if (length == 0)
+		goto exit;
+
+	if (index > 1) {
+		trace_error("Invalid ping-pong buffer %u\r\n", (unsigned)index);
+		status = APPLET_FAIL;
+		goto exit;
+	}
+
+	/* check that requested size does not overflow buffer */
+	if (length > _pingpong.size / _pingpong.page_size) {
+		trace_error("Buffer overflow\r\n");
+		status = APPLET_FAIL;
+		goto exit;
+	}
+
+	start = timer_get_us();
+	status = _pingpong.ops->write(offset, length,
+			_pingpong.buffer + index * _pingpong.size, &pages);
+	mbx->out.write_time = _elapsed_us(start);
+
+	if (_pingpong.ops->wait) {
+		if (status == APPLET_SUCCESS)
+			_pingpong.pending = true;
+		else
+			_pingpong.ops->wait();
+	}
+
+	if (status == APPLET_SUCCESS)
+		trace_info_wp("Started write of %u pages at page %u from buffer %u\r\n",
+				(unsigned)pages, (unsigned)offset, (unsigned)index);
+
+exit:
+	mbx->out.pages = pages;
+	mbx->out.host_time = host_time;
+	_pingpong.last_return = timer_get_us();
+
+	return status;
+}
@@ -0,0 +1,106 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _APPLET_PINGPONG_H_
+#define _APPLET_PINGPONG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*----------------------------------------------------------------------------
+ *         Global types
+ *----------------------------------------------------------------------------*/
+
+/** Media operations for the ping-pong, compressed write and verify commands */
+struct applet_pingpong_ops {
+	/** Write length pages at offset (in pages) from buf and set *pages
+	 * to the number of pages written. May return while the memory is
+	 * still busy with the last page. Returns an APPLET_* status. */
+	uint32_t (*write)(uint32_t offset, uint32_t length, const uint8_t *buf,
+			uint32_t *pages);
+
+	/** Wait for the end of the last write and return its APPLET_*
+	 * status. NULL if write() only returns once done. */
+	uint32_t (*wait)(void);
+
+	/** Erased pages read as 0xFF, so all-0xFF pages need not be written */
+	bool erased_ff;
+
+	/** Read length pages at offset (in pages) to buf and set *pages to
+	 * the number of pages read. Returns an APPLET_* status. */
+	uint32_t (*read)(uint32_t offset, uint32_t length, uint8_t *buf,
+			uint32_t *pages);
+};
+
+/*----------------------------------------------------------------------------
+ *         Global functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Split the applet buffer in two ping-pong buffers.
+ * \param ops  Media operations
+ * \param buffer  Applet buffer
+ * \param buffer_size  Applet buffer size (in bytes)
+ * \param page_size  Page size (in bytes)
+ * \return true if each ping-pong buffer can hold at least one page
+ */
+extern bool applet_pingpong_init(const struct applet_pingpong_ops *ops,
+		uint8_t *buffer, uint32_t buffer_size, uint32_t page_size);
+
+/**
+ * \brief Wait for the end of the pending ping-pong write, if any.
+ * \return APPLET_SUCCESS, or the status of the failed write
+ */
+extern uint32_t applet_pingpong_sync(void);
+
+/**
+ * \brief Get the media operations given to applet_pingpong_init()
+ * \return the operations, NULL if the buffer is too small or not set up
+ */
+extern const struct applet_pingpong_ops *applet_pingpong_get_ops(void);
+
+/**
+ * \brief Get a ping-pong buffer
+ * \param index  Buffer index (0 or 1)
+ * \param size  Set to the buffer size (in bytes)
+ */
+extern uint8_t *applet_pingpong_get_buffer(uint32_t index, uint32_t *size);
+
+/**
+ * \brief Get the page size given to applet_pingpong_init() (in bytes)
+ */
+extern uint32_t applet_pingpong_get_page_size(void);
+
+/**
+ * \brief Handler for APPLET_CMD_WRITE_PAGES_PP, to be added to the command
+ * list of the applets that call applet_pingpong_init().
+ */
+extern uint32_t applet_handle_cmd_write_pages_pp(uint32_t cmd, uint32_t *mailbox);
+
+#endif /* _APPLET_PINGPONG_H_ */
@@ -0,0 +1,207 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "applet.h"
+#include "applet_pingpong.h"
+#include "applet_verify.h"
+#include "chip.h"
+#include "compiler.h"
+#include "crc32.h"
+#include "intmath.h"
+#include "trace.h"
+
+#ifdef CONFIG_HAVE_SHA
+#include "crypto/shad.h"
+#include "mm/cache.h"
+#endif
+
+/*----------------------------------------------------------------------------
+ *         Local variables
+ *----------------------------------------------------------------------------*/
+
+#ifdef CONFIG_HAVE_SHA
+static struct _shad_desc shad = {
+	.cfg = {
+		.transfer_mode = SHAD_TRANS_DMA,
+		.algo = ALGO_SHA_256,
+	},
+};
+
+static bool shad_initialized;
+
+CACHE_ALIGNED static uint8_t sha_digest[32];
+#endif
+
+/*----------------------------------------------------------------------------
+ *         Local functions
+ *----------------------------------------------------------------------------*/
+
+#ifdef CONFIG_HAVE_SHA
+static bool verify_sha_start(void)
+{
+	if (!shad_initialized) {
+		shad_init(&shad);
+		shad_initialized = true;
+	}
+
+	return shad_start(&shad) == 0;
+}
+
+/* Queue a chunk: the engine hashes it by DMA while the next one is read */
+static bool verify_sha_update(uint8_t *data, uint32_t size)
+{
+	struct _buffer buf = {
+		.data = data,
+		.size = size,
+	};
+
+	shad_wait_completion(&shad);
+	return shad_update(&shad, &buf, false, NULL) == 0;
+}
+
+static bool verify_sha_finish(uint32_t *digest)
+{
+	struct _buffer buf = {
+		.data = sha_digest,
+		.size = sizeof(sha_digest),
+	};
+
+	shad_wait_completion(&shad);
+	if (shad_finish(&shad, &buf, false, NULL) < 0)
+		return false;
+	shad_wait_completion(&shad);
+
+	memcpy(digest, sha_digest, sizeof(sha_digest));
+	return true;
+}
+#endif
+
+/*----------------------------------------------------------------------------
+ *         Global functions
+ *----------------------------------------------------------------------------*/
+
+uint32_t applet_handle_cmd_verify(uint32_t cmd, uint32_t *mailbox)
+{
+	union verify_mailbox *mbx = (union verify_mailbox*)mailbox;
+	const struct applet_pingpong_ops *ops = applet_pingpong_get_ops();
+	uint32_t offset = mbx->in.offset;
+	uint32_t length = mbx->in.length;
+	uint32_t algo = mbx->in.algo;
+	uint32_t page_size, size, misalign, chunk, count, done, pages;
+	uint32_t crc = 0, status = APPLET_SUCCESS;
+	uint8_t *buf[2];
+	int i;
+
+	assert(cmd == APPLET_CMD_VERIFY);
+
+	memset(&mbx->out, 0, sizeof(mbx->out));
+
+	if (!ops || !ops->read) {
+		trace_error("Verify not supported\r\n");
+		return APPLET_FAIL;
+	}
+
+	/* the SHA DMA needs cache-aligned buffers, give up a page for it */
+	page_size = applet_pingpong_get_page_size();
+	buf[0] = applet_pingpong_get_buffer(0, &size);
+	buf[1] = applet_pingpong_get_buffer(1, &size);
+	misalign = ROUND_UP_MULT((uint32_t)buf[0], L1_CACHE_BYTES) - (uint32_t)buf[0];
+	buf[0] += misalign;
+	buf[1] += misalign;
+	chunk = (size - misalign) / page_size;
+	if (chunk == 0) {
+		trace_error("Buffer too small\r\n");
+		return APPLET_FAIL;
+	}
+
+	switch (algo) {
+	case APPLET_VERIFY_CRC32:
+		break;
+#ifdef CONFIG_HAVE_SHA
+	case APPLET_VERIFY_SHA256:
+		if (!verify_sha_start()) {
+			trace_error("SHA initialization failed\r\n");
+			return APPLET_FAIL;
+		}
+		break;
+#endif
+	default:
+		trace_error("Unsupported digest algorithm %u\r\n", (unsigned)algo);
+		return APPLET_FAIL;
+	}
+
+	/* read each chunk in the buffer the previous chunk is not hashed from */
+	for (done = 0, i = 0; done < length; done += count, i ^= 1) {
+		count = min_u32(chunk, length - done);
+		pages = 0;
+		status = ops->read(offset + done, count, buf[i], &pages);
+		if (status != APPLET_SUCCESS) {
+			done += pages;
+			break;
+		}
+
+		if (algo == APPLET_VERIFY_CRC32) {
+			crc = crc32_update(crc, buf[i], count * page_size);
+		}
+#ifdef CONFIG_HAVE_SHA
+		else if (!verify_sha_update(buf[i], count * page_size)) {
+			status = APPLET_FAIL;
+			break;
+		}
+#endif
+	}
+
+	if (algo == APPLET_VERIFY_CRC32) {
+		mbx->out.digest[0] = crc;
+	}
+#ifdef CONFIG_HAVE_SHA
+	else if (status != APPLET_SUCCESS) {
+		/* the chunk being hashed must not be reused before the end */
+		shad_wait_completion(&shad);
+	} else if (!verify_sha_finish(mbx->out.digest)) {
+		status = APPLET_FAIL;
+	}
+#endif
+
+	mbx->out.pages = done;
+
+	if (status != APPLET_SUCCESS) {
+		trace_error("Verify failed after %u pages\r\n", (unsigned)done);
+		return status;
+	}
+
+	trace_info_wp("Verified %u pages at page %u\r\n",
+			(unsigned)length, (unsigned)offset);
+
+	return APPLET_SUCCESS;
+}
@@ -32,6 +32,9 @@
  *----------------------------------------------------------------------------*/
 
 #include "applet.h"
+#include "applet_compressed.h"
+#include "applet_pingpong.h"
+#include "applet_verify.h"
 #include "board.h"
 #include "chip.h"
 #include "trace.h"
@@ -265,6 +268,112 @@ static void board_cfg_matrix_for_nand_ex(bool nfd0_on_d16)
 }
 #endif
 
+static uint32_t write_pages(uint32_t offset, uint32_t length,
+		const uint8_t *buf, uint32_t *pages, bool wait_last)
+{
+	uint32_t i;
+	uint16_t block, page;
+
+	block = offset / block_size;
+	page = offset - block * block_size;
+
+	for (i = 0; i < length; i++, buf += page_size) {
+		trace_debug_wp("Writing %u bytes at block %u page %u (offset 0x%08x)\r\n",
+				(unsigned)page_size, block, page,
+				(unsigned)((block * block_size + page) * page_size));
+		uint8_t status = nand_skipblock_write_page_start(&nand, block, page, (void*)buf, NULL);
+		if (status == 0 && (wait_last || i + 1 < length))
+			status = nand_raw_write_page_wait(&nand);
+		if (status == NAND_ERROR_BADBLOCK) {
+			trace_error("Cannot write bad block %u (page %u)\r\n",
+					block, page);
+			*pages = i;
+			return APPLET_BAD_BLOCK;
+		} else if (status != 0) {
+			trace_error("Write error at block %u, page %u\r\n",
+					block, page);
+			*pages = 0;
+			return APPLET_WRITE_FAIL;
+		}
+
+		page++;
+		if (page == block_size) {
+			page = 0;
+			block++;
+		}
+	}
+
+	trace_info_wp("Wrote %u bytes at offset 0x%08x\r\n",
+			(unsigned)(length * page_size),
+			(unsigned)(offset * page_size));
+
+	*pages = length;
+
+	return APPLET_SUCCESS;
+}
+
+static uint32_t read_pages(uint32_t offset, uint32_t length,
+		uint8_t *buf, uint32_t *pages)
+{
+	uint32_t i;
+	uint16_t block, page;
+
+	block = offset / block_size;
+	page = offset - block * block_size;
+
+	for (i = 0; i < length; i++, buf += page_size) {
+		uint8_t status = nand_skipblock_read_page(&nand, block, page, buf, NULL);
+		if (status == NAND_ERROR_BADBLOCK) {
+			trace_error("Cannot read bad block %u\r\n", block);
+			*pages = i;
+			return APPLET_BAD_BLOCK;
+		} else if (status != 0) {
+			trace_error("Read error at block %u, page %u\r\n",
+					block, page);
+			*pages = 0;
+			return APPLET_READ_FAIL;
+		}
+
+		page++;
+		if (page == block_size) {
+			page = 0;
+			block++;
+		}
+	}
+
+	trace_info_wp("Read %u bytes at offset 0x%08x\r\n",
+			(unsigned)(length * page_size),
+			(unsigned)(offset * page_size));
+
+	*pages = length;
+
+	return APPLET_SUCCESS;
+}
+
+static uint32_t pingpong_write(uint32_t offset, uint32_t length,
+		const uint8_t *buf, uint32_t *pages)
+{
+	/* the last page program completes in pingpong_wait() */
+	return write_pages(offset, length, buf, pages, false);
+}
+
+static uint32_t pingpong_wait(void)
+{
+	if (nand_raw_write_page_wait(&nand)) {
+		trace_error("Write error\r\n");
+		return APPLET_WRITE_FAIL;
+	}
+
+	return APPLET_SUCCESS;
+}
+
+static const struct applet_pingpong_ops pingpong_ops = {
+	.write = pingpong_write,
+	.wait = pingpong_wait,
+	.erased_ff = true,
+	.read = read_pages,
+};
+
 static uint32_t handle_cmd_initialize(uint32_t cmd, uint32_t *mailbox)
 {
 	union initialize_mailbox *mbx = (union initialize_mailbox*)mailbox;
@@ -358,6 +467,9 @@ static uint32_t handle_cmd_initialize(uint32_t cmd, uint32_t *mailbox)
 	trace_warning_wp("Buffer Address: 0x%08x\r\n", (unsigned)buffer);
 	trace_warning_wp("Buffer Size: %u bytes\r\n", (unsigned)buffer_size);
 
+	if (!applet_pingpong_init(&pingpong_ops, buffer, buffer_size, page_size))
+		trace_warning_wp("Buffer too small for ping-pong writes\r\n");
+
 	mbx->out.buf_addr = (uint32_t)buffer;
 	mbx->out.buf_size = buffer_size;
 	mbx->out.page_size = page_size;
@@ -393,9 +505,6 @@ static uint32_t handle_cmd_write_pages(uint32_t cmd, uint32_t *mailbox)
 {
 	union read_write_erase_pages_mailbox *mbx =
 		(union read_write_erase_pages_mailbox*)mailbox;
-	uint32_t i;
-	uint8_t *buf;
-	uint16_t block, page;
 
 	assert(cmd == APPLET_CMD_WRITE_PAGES);
 
@@ -405,41 +514,8 @@ static uint32_t handle_cmd_write_pages(uint32_t cmd, uint32_t *mailbox)
 		return APPLET_FAIL;
 	}
 
-	block = mbx->in.offset / block_size;
-	page = mbx->in.offset - block * block_size;
-
-	for (i = 0, buf = buffer; i < mbx->in.length; i++, buf += page_size) {
-		trace_debug_wp("Writing %u bytes at block %u page %u (offset 0x%08x)\r\n",
-				(unsigned)page_size, block, page,
-				(unsigned)((block * block_size + page) * page_size));
-		uint8_t status = nand_skipblock_write_page(&nand, block, page, buf, NULL);
-		if (status == NAND_ERROR_BADBLOCK) {
-			trace_error("Cannot write bad block %u (page %u)\r\n",
-					block, page);
-			mbx->out.pages = i;
-			return APPLET_BAD_BLOCK;
-		} else if (status != 0) {
-			trace_error("Write error at block %u, page %u\r\n",
-					block, page);
-			mbx->out.pages = 0;
-			return APPLET_WRITE_FAIL;
-		}
-
-		page++;
-		if (page == block_size) {
-			page = 0;
-			block++;
-		}
-	}
-
-
-	trace_info_wp("Wrote %u bytes at offset 0x%08x\r\n",
-			(unsigned)(mbx->in.length * page_size),
-			(unsigned)(mbx->in.offset * page_size));
-
-	mbx->out.pages = mbx->in.length;
-
-	return APPLET_SUCCESS;
+	return write_pages(mbx->in.offset, mbx->in.length, buffer,
+			&mbx->out.pages, true);
 }
 
 /*
@@ -449,9 +525,6 @@ static uint32_t handle_cmd_read_pages(uint32_t cmd, uint32_t *mailbox)
 {
 	union read_write_erase_pages_mailbox *mbx =
 		(union read_write_erase_pages_mailbox*)mailbox;
-	uint32_t i;
-	uint8_t *buf;
-	uint16_t block, page;
 
 	assert(cmd == APPLET_CMD_READ_PAGES);
 
@@ -461,36 +534,8 @@ static uint32_t handle_cmd_read_pages(uint32_t cmd, uint32_t *mailbox)
 		return APPLET_FAIL;
 	}
 
-	block = mbx->in.offset / block_size;
-	page = mbx->in.offset - block * block_size;
-
-	for (i = 0, buf = buffer; i < mbx->in.length; i++, buf += page_size) {
-		uint8_t status = nand_skipblock_read_page(&nand, block, page, buf, NULL);
-		if (status == NAND_ERROR_BADBLOCK) {
-			trace_error("Cannot read bad block %u\r\n", block);
-			mbx->out.pages = i;
-			return APPLET_BAD_BLOCK;
-		} else if (status != 0) {
-			trace_error("Read error at block %u, page %u\r\n",
-					block, page);
-			mbx->out.pages = 0;
-			return APPLET_READ_FAIL;
-		}
-
-		page++;
-		if (page == block_size) {
-			page = 0;
-			block++;
-		}
-	}
-
-	trace_info_wp("Read %u bytes at offset 0x%08x\r\n",
-			(unsigned)(mbx->in.length * page_size),
-			(unsigned)(mbx->in.offset * page_size));
-
-	mbx->out.pages = mbx->in.length;
-
-	return APPLET_SUCCESS;
+	return read_pages(mbx->in.offset, mbx->in.length, buffer,
+			&mbx->out.pages);
 }
 
 /*
@@ -581,6 +626,9 @@ const struct applet_command applet_commands[] = {
 	{ APPLET_CMD_ERASE_PAGES, handle_cmd_erase_pages },
 	{ APPLET_CMD_READ_PAGES, handle_cmd_read_pages },
 	{ APPLET_CMD_WRITE_PAGES, handle_cmd_write_pages },
+	{ APPLET_CMD_WRITE_PAGES_PP, applet_handle_cmd_write_pages_pp },
+	{ APPLET_CMD_WRITE_COMPRESSED, applet_handle_cmd_write_compressed },
+	{ APPLET_CMD_VERIFY, applet_handle_cmd_verify },
 	{ APPLET_CMD_TAG_BLOCK, handle_cmd_tag_block },
 	{ 0, NULL }
 };
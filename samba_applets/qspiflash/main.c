@@ -37,6 +37,9 @@
 #include <string.h>
 
 #include "applet.h"
+#include "applet_compressed.h"
+#include "applet_pingpong.h"
+#include "applet_verify.h"
 #include "board.h"
 #include "chip.h"
 #include "gpio/pio.h"
@@ -97,6 +100,52 @@ static bool configure_instance_pio(uint32_t instance, uint32_t ioset, Qspi** add
 	return false;
 }
 
+static uint32_t pingpong_write(uint32_t offset, uint32_t length,
+		const uint8_t *buf, uint32_t *pages)
+{
+	/* the last page program completes in pingpong_wait() */
+	if (spi_nor_write_start(&flash, offset * flash.page_size, buf,
+				length * flash.page_size) < 0) {
+		trace_error("Write error\r\n");
+		*pages = 0;
+		return APPLET_WRITE_FAIL;
+	}
+
+	*pages = length;
+	return APPLET_SUCCESS;
+}
+
+static uint32_t pingpong_wait(void)
+{
+	if (spi_flash_wait_till_ready(&flash) < 0) {
+		trace_error("Write error\r\n");
+		return APPLET_WRITE_FAIL;
+	}
+
+	return APPLET_SUCCESS;
+}
+
+static uint32_t pingpong_read(uint32_t offset, uint32_t length,
+		uint8_t *buf, uint32_t *pages)
+{
+	if (spi_nor_read(&flash, offset * flash.page_size, buf,
+				length * flash.page_size) < 0) {
+		trace_error("Read error\r\n");
+		*pages = 0;
+		return APPLET_READ_FAIL;
+	}
+
+	*pages = length;
+	return APPLET_SUCCESS;
+}
+
+static const struct applet_pingpong_ops pingpong_ops = {
+	.write = pingpong_write,
+	.wait = pingpong_wait,
+	.erased_ff = true,
+	.read = pingpong_read,
+};
+
 static uint32_t handle_cmd_initialize(uint32_t cmd, uint32_t *mailbox)
 {
 	union initialize_mailbox *mbx = (union initialize_mailbox*)mailbox;
@@ -155,6 +204,9 @@ static uint32_t handle_cmd_initialize(uint32_t cmd, uint32_t *mailbox)
 	trace_warning_wp("Buffer Address: 0x%08x\r\n", (unsigned)buffer);
 	trace_warning_wp("Buffer Size: %u bytes\r\n", (unsigned)buffer_size);
 
+	if (!applet_pingpong_init(&pingpong_ops, buffer, buffer_size, page_size))
+		trace_warning_wp("Buffer too small for ping-pong writes\r\n");
+
 	mbx->out.buf_addr = (uint32_t)buffer;
 	mbx->out.buf_size = buffer_size;
 	mbx->out.page_size = page_size;
@@ -292,5 +344,8 @@ const struct applet_command applet_commands[] = {
 	{ APPLET_CMD_ERASE_PAGES, handle_cmd_erase_pages },
 	{ APPLET_CMD_READ_PAGES, handle_cmd_read_pages },
 	{ APPLET_CMD_WRITE_PAGES, handle_cmd_write_pages },
+	{ APPLET_CMD_WRITE_PAGES_PP, applet_handle_cmd_write_pages_pp },
+	{ APPLET_CMD_WRITE_COMPRESSED, applet_handle_cmd_write_compressed },
+	{ APPLET_CMD_VERIFY, applet_handle_cmd_verify },
 	{ 0, NULL }
 };
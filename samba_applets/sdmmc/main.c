@@ -32,6 +32,9 @@
  *----------------------------------------------------------------------------*/
 
 #include "applet.h"
+#include "applet_compressed.h"
+#include "applet_pingpong.h"
+#include "applet_verify.h"
 
 #include "board.h"
 #include "chip.h"
@@ -301,6 +304,66 @@ static int sdmmc_pre_init(uint32_t id)
 #endif /* CONFIG_SOC_SAM9X60 */
 #endif /* CONFIG_HAVE_SDMMC */
 
+static uint32_t write_pages(uint32_t offset, uint32_t length,
+		const uint8_t *buf, uint32_t *pages)
+{
+	/* check that requested offset/size does not overflow memory */
+	if (offset + length > mem_size) {
+		trace_error("Memory overflow\r\n");
+		return APPLET_FAIL;
+	}
+
+	if (SD_Write(&lib, offset, buf, length, NULL, NULL) != SDMMC_OK) {
+		trace_error("Error while writing %u bytes at offset 0x%08x\r\n",
+				(unsigned)(length * BLOCK_SIZE),
+				(unsigned)(offset * BLOCK_SIZE));
+		*pages = 0;
+		return APPLET_READ_FAIL;
+	}
+
+	trace_info_wp("Wrote %u bytes at offset 0x%08x\r\n",
+			(unsigned)(length * BLOCK_SIZE),
+			(unsigned)(offset * BLOCK_SIZE));
+	*pages = length;
+
+	return APPLET_SUCCESS;
+}
+
+static uint32_t read_pages(uint32_t offset, uint32_t length,
+		uint8_t *buf, uint32_t *pages)
+{
+	/* check that requested offset/size does not overflow memory */
+	if (offset + length > mem_size) {
+		trace_error("Memory overflow\r\n");
+		return APPLET_FAIL;
+	}
+
+	if (SD_Read(&lib, offset, buf, length, NULL, NULL) != SDMMC_OK) {
+		trace_error("Error while reading %u bytes at offset 0x%08x\r\n",
+				(unsigned)(length * BLOCK_SIZE),
+				(unsigned)(offset * BLOCK_SIZE));
+		*pages = 0;
+		return APPLET_READ_FAIL;
+	}
+
+	trace_info_wp("Read %u bytes at offset 0x%08x\r\n",
+			(unsigned)(length * BLOCK_SIZE),
+			(unsigned)(offset * BLOCK_SIZE));
+	*pages = length;
+
+	return APPLET_SUCCESS;
+}
+
+/* SD_Write() is blocking, so there is nothing left to wait for. The
+ * applet does not erase, and erased cards may read as 0x00 anyway, so
+ * all-0xFF pages are written too. */
+static const struct applet_pingpong_ops pingpong_ops = {
+	.write = write_pages,
+	.wait = NULL,
+	.erased_ff = false,
+	.read = read_pages,
+};
+
 static uint32_t handle_cmd_initialize(uint32_t cmd, uint32_t *mailbox)
 {
 	union initialize_mailbox *mbx = (union initialize_mailbox*)mailbox;
@@ -458,6 +521,9 @@ static uint32_t handle_cmd_initialize(uint32_t cmd, uint32_t *mailbox)
 		return APPLET_FAIL;
 	}
 
+	if (!applet_pingpong_init(&pingpong_ops, buffer, buffer_size, BLOCK_SIZE))
+		trace_warning_wp("Buffer too small for ping-pong writes\r\n");
+
 	mbx->out.buf_addr = (uint32_t)buffer;
 	mbx->out.buf_size = buffer_size;
 	mbx->out.page_size = BLOCK_SIZE;
@@ -495,74 +561,34 @@ static uint32_t handle_cmd_write_pages(uint32_t cmd, uint32_t *mailbox)
 {
 	union read_write_erase_pages_mailbox *mbx =
 		(union read_write_erase_pages_mailbox*)mailbox;
-	uint32_t offset = mbx->in.offset;
-	uint32_t length = mbx->in.length;
 
 	assert(cmd == APPLET_CMD_WRITE_PAGES);
 
 	/* check that requested size does not overflow buffer */
-	if ((length * BLOCK_SIZE) > buffer_size) {
+	if ((mbx->in.length * BLOCK_SIZE) > buffer_size) {
 		trace_error("Buffer overflow\r\n");
 		return APPLET_FAIL;
 	}
 
-	/* check that requested offset/size does not overflow memory */
-	if (offset + length > mem_size) {
-		trace_error("Memory overflow\r\n");
-		return APPLET_FAIL;
-	}
-
-	if (SD_Write(&lib, offset, buffer, length, NULL, NULL) != SDMMC_OK) {
-		trace_error("Error while writing %u bytes at offset 0x%08x\r\n",
-				(unsigned)(mbx->in.length * BLOCK_SIZE),
-				(unsigned)(mbx->in.offset * BLOCK_SIZE));
-		mbx->out.pages = 0;
-		return APPLET_READ_FAIL;
-	}
-
-	trace_info_wp("Wrote %u bytes at offset 0x%08x\r\n",
-			(unsigned)(mbx->in.length * BLOCK_SIZE),
-			(unsigned)(mbx->in.offset * BLOCK_SIZE));
-	mbx->out.pages = mbx->in.length;
-
-	return APPLET_SUCCESS;
+	return write_pages(mbx->in.offset, mbx->in.length, buffer,
+			&mbx->out.pages);
 }
 
 static uint32_t handle_cmd_read_pages(uint32_t cmd, uint32_t *mailbox)
 {
 	union read_write_erase_pages_mailbox *mbx =
 		(union read_write_erase_pages_mailbox*)mailbox;
-	uint32_t offset = mbx->in.offset;
-	uint32_t length = mbx->in.length;
 
 	assert(cmd == APPLET_CMD_READ_PAGES);
 
 	/* check that requested size does not overflow buffer */
-	if ((length * BLOCK_SIZE) > buffer_size) {
+	if ((mbx->in.length * BLOCK_SIZE) > buffer_size) {
 		trace_error("Buffer overflow\r\n");
 		return APPLET_FAIL;
 	}
 
-	/* check that requested offset/size does not overflow memory */
-	if (offset + length > mem_size) {
-		trace_error("Memory overflow\r\n");
-		return APPLET_FAIL;
-	}
-
-	if (SD_Read(&lib, offset, buffer, length, NULL, NULL) != SDMMC_OK) {
-		trace_error("Error while reading %u bytes at offset 0x%08x\r\n",
-				(unsigned)(mbx->in.length * BLOCK_SIZE),
-				(unsigned)(mbx->in.offset * BLOCK_SIZE));
-		mbx->out.pages = 0;
-		return APPLET_READ_FAIL;
-	}
-
-	trace_info_wp("Read %u bytes at offset 0x%08x\r\n",
-			(unsigned)(mbx->in.length * BLOCK_SIZE),
-			(unsigned)(mbx->in.offset * BLOCK_SIZE));
-	mbx->out.pages = mbx->in.length;
-
-	return APPLET_SUCCESS;
+	return read_pages(mbx->in.offset, mbx->in.length, buffer,
+			&mbx->out.pages);
 }
 
 static uint32_t handle_cmd_enable_boot_part(uint32_t cmd, uint32_t *mailbox)
@@ -623,6 +649,9 @@ const struct applet_command applet_commands[] = {
 	{ APPLET_CMD_INITIALIZE, handle_cmd_initialize },
 	{ APPLET_CMD_READ_INFO, handle_cmd_read_info },
 	{ APPLET_CMD_WRITE_PAGES, handle_cmd_write_pages },
+	{ APPLET_CMD_WRITE_PAGES_PP, applet_handle_cmd_write_pages_pp },
+	{ APPLET_CMD_WRITE_COMPRESSED, applet_handle_cmd_write_compressed },
+	{ APPLET_CMD_VERIFY, applet_handle_cmd_verify },
 	{ APPLET_CMD_READ_PAGES, handle_cmd_read_pages },
 	{ APPLET_CMD_ENABLE_BOOT_PART, handle_cmd_enable_boot_part },
 	{ 0, NULL }
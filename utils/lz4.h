@@ -0,0 +1,67 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2019, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*------------------------------------------------------------------------------
+ *  \file
+ *
+ *  \section Purpose
+ *  LZ4 block format decompression.
+ *
+ *------------------------------------------------------------------------------*/
+
+#ifndef _LZ4_H
+#define _LZ4_H
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *         Global Functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ *  Decompress an LZ4 block (as produced by LZ4_compress_default(), without
+ *  the frame header). Malformed input is rejected, nothing is ever written
+ *  past dst + dst_size nor read past src + src_size.
+ *
+ *  \param src  Compressed block
+ *  \param src_size  Compressed block size, in bytes
+ *  \param dst  Output buffer
+ *  \param dst_size  Output buffer size, in bytes
+ *  \return the decompressed size, -EINVAL if the block is malformed or
+ *  -ENOSPC if it does not fit in the output buffer
+ */
+extern int lz4_decompress(const uint8_t* src, size_t src_size,
+		uint8_t* dst, size_t dst_size);
+
+#endif /* #ifndef _LZ4_H */
@@ -43,6 +43,8 @@
 
 static uint32_t _rand_next = 1;
 
+static int (*_rand_source)(uint32_t* value);
+
 /*------------------------------------------------------------------------------
  *         Exported Functions
  *------------------------------------------------------------------------------*/
@@ -54,6 +56,7 @@ static uint32_t _rand_next = 1;
  */
 void srand(uint32_t seed)
 {
+	_rand_source = NULL;
 	_rand_next = seed;
 }
 
@@ -62,7 +65,17 @@ void srand(uint32_t seed)
  */
 uint32_t rand(void)
 {
+	uint32_t value;
+
+	if (_rand_source && _rand_source(&value) == 0)
+		return value % 65536;
+
 	_rand_next = _rand_next * 1103515245 + 12345;
 
 	return (uint32_t)(_rand_next / 131072) % 65536;
 }
+
+void rand_set_source(int (*source)(uint32_t* value))
+{
+	_rand_source = source;
+}
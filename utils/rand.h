@@ -52,4 +52,13 @@ extern void srand(uint32_t seed);
 
 extern uint32_t rand(void);
 
+/**
+ *  Serve rand() from another generator (e.g. the rngd service) instead of
+ *  the LCG, or go back to the LCG if source is NULL. srand() also goes back
+ *  to the LCG, so that seeded sequences stay reproducible.
+ *  The source returns 0 and sets *value on success. When it returns a
+ *  negative error, rand() takes that value from the LCG instead.
+ */
+extern void rand_set_source(int (*source)(uint32_t* value));
+
 #endif /* #ifndef _RAND_H */
@@ -31,22 +31,75 @@
  *         Headers
  *----------------------------------------------------------------------------*/
 
+#include <string.h>
+
 #include "board.h"
+#include "compiler.h"
 #include "irqflags.h"
 #include "irq/irq.h"
 #include "peripherals/pmc.h"
 #include "peripherals/tc.h"
 #include "timer.h"
 
+/*----------------------------------------------------------------------------
+ *         Local definitions
+ *----------------------------------------------------------------------------*/
+
+/* Software timers: 4 levels of 64 slots, covering 2^24 ticks (4.6 hours at
+ * 1 tick/ms). Later deadlines are parked in the last level and re-filed
+ * when it cascades. */
+#define TIMER_WHEEL_BITS    6
+#define TIMER_WHEEL_SIZE    (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK    (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS  4
+#define TIMER_WHEEL_RANGE   (1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+#if TC_CHANNEL_SIZE == 32
+#define TIMER_CV_MASK       0xffffffffu
+#else
+#define TIMER_CV_MASK       ((1u << TC_CHANNEL_SIZE) - 1)
+#endif
+
 /*----------------------------------------------------------------------------
  *         Local type definitions
  *----------------------------------------------------------------------------*/
 
+/* Conversion factor: value * mult >> shift, mult in [2^31, 2^32) */
+struct _timer_conv {
+	uint32_t mult;
+	uint8_t shift;
+};
+
 struct _timer {
 	Tc* tc;
 	uint8_t channel;
 	uint32_t channel_freq;
 	volatile uint32_t upper;
+
+	/* Division-free conversions from and to counter cycles */
+	struct _timer_conv cycles_to_ms;
+	struct _timer_conv cycles_to_us;
+	struct _timer_conv cycles_to_ns;
+	struct _timer_conv us_to_cycles;
+
+	/* Time at base_cycles, moved on master clock changes */
+	uint64_t base_cycles;
+	uint64_t base_ms;
+	uint64_t base_us;
+	uint64_t base_ns;
+	struct _pmc_clock_notifier clock_notifier;
+
+	/* RC compare for software timers */
+	volatile bool compare_hit;
+	bool in_handler;
+	uint32_t compare_guard;
+};
+
+struct _timer_wheel {
+	uint64_t now;		/* next tick to process */
+	uint32_t pending;
+	uint64_t occupied[TIMER_WHEEL_LEVELS];
+	struct _timer_event* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
 };
 
 /*----------------------------------------------------------------------------
@@ -56,6 +109,9 @@ struct _timer {
 /** System timer */
 static struct _timer _timer;
 
+/** Software timers */
+static struct _timer_wheel _wheel;
+
 /*----------------------------------------------------------------------------
  *         Local Functions
  *----------------------------------------------------------------------------*/
@@ -65,6 +121,19 @@ static void timer_update_upper_tick_counter(void)
 	uint32_t status = tc_get_status(_timer.tc, _timer.channel);
 	if ((status & TC_SR_COVFS) == TC_SR_COVFS)
 		_timer.upper++;
+#ifndef CONFIG_TIMER_POLLING
+	if ((status & TC_SR_CPCS) == TC_SR_CPCS) {
+		_timer.compare_hit = true;
+		/* Reading the status outside of the handler cleared the
+		 * interrupt: re-arm the compare shortly after so that the
+		 * handler still runs */
+		if (!_timer.in_handler) {
+			uint32_t rc = (tc_get_cv(_timer.tc, _timer.channel) +
+				       _timer.compare_guard) & TIMER_CV_MASK;
+			tc_set_ra_rb_rc(_timer.tc, _timer.channel, NULL, NULL, &rc);
+		}
+	}
+#endif
 }
 
 static uint32_t timer_get_upper_tick_counter(void)
@@ -73,28 +142,304 @@ static uint32_t timer_get_upper_tick_counter(void)
 	return _timer.upper;
 }
 
+static uint64_t _timer_get_tick(void)
+{
+	uint32_t upper, lower;
+
+	do {
+		upper = timer_get_upper_tick_counter();
+		COMPILER_BARRIER();
+		lower = tc_get_cv(_timer.tc, _timer.channel);
+	} while (upper != timer_get_upper_tick_counter());
+	return (((uint64_t)upper) << TC_CHANNEL_SIZE) | lower;
+}
+
+/* Compute the factor converting values at rate from to values at rate to.
+ * The largest shift keeping mult on 32 bits is used, and mult is rounded up
+ * so that converted values are never below the exact quotient; the relative
+ * error is below 2^-31. */
+static void _timer_conv_init(struct _timer_conv* conv, uint32_t from, uint32_t to)
+{
+	uint64_t max = ((uint64_t)from << 32) / to;
+	uint64_t mult;
+	uint8_t shift = 0;
+
+	while (shift < 63 && (max >> (shift + 1)))
+		shift++;
+	for (;;) {
+		mult = (((uint64_t)to << shift) + from - 1) / from;
+		if (mult <= 0xffffffffu || shift == 0)
+			break;
+		shift--;
+	}
+	conv->mult = (uint32_t)mult;
+	conv->shift = shift;
+}
+
+/* value * mult >> shift with a 96-bit intermediate product */
+static uint64_t _timer_conv(const struct _timer_conv* conv, uint64_t value)
+{
+	uint64_t hi = (value >> 32) * conv->mult;
+	uint64_t lo = (uint32_t)value * (uint64_t)conv->mult;
+	uint32_t shift = conv->shift;
+
+	if (shift <= 32)
+		return (hi << (32 - shift)) + (lo >> shift);
+	shift -= 32;
+	return (hi >> shift) +
+		(((hi & ((1ull << shift) - 1)) + (lo >> 32)) >> shift);
+}
+
+static uint32_t _timer_ctz64(uint64_t value)
+{
+	uint32_t word = (uint32_t)value;
+
+	if (word)
+		return 31 - CLZ(word & -word);
+	word = (uint32_t)(value >> 32);
+	return 63 - CLZ(word & -word);
+}
+
+/* Rotate a slot bitmap so that bit 0 is slot index */
+static uint64_t _timer_wheel_rotate(uint64_t occupied, uint32_t index)
+{
+	if (index == 0)
+		return occupied;
+	return (occupied >> index) | (occupied << (TIMER_WHEEL_SIZE - index));
+}
+
+static void _timer_event_link(struct _timer_event* event)
+{
+	uint64_t delta, when;
+	uint8_t level = 0;
+	uint8_t slot;
+
+	delta = event->expires > _wheel.now ? event->expires - _wheel.now : 0;
+	if (delta >= TIMER_WHEEL_RANGE)
+		delta = TIMER_WHEEL_RANGE - 1;
+	when = _wheel.now + delta;
+	while (level < TIMER_WHEEL_LEVELS - 1 &&
+	       delta >= (1ull << (TIMER_WHEEL_BITS * (level + 1))))
+		level++;
+	slot = (when >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+
+	event->level = level;
+	event->slot = slot;
+	event->prev = NULL;
+	event->next = _wheel.slots[level][slot];
+	if (event->next)
+		event->next->prev = event;
+	_wheel.slots[level][slot] = event;
+	_wheel.occupied[level] |= 1ull << slot;
+	_wheel.pending++;
+	event->pending = true;
+}
+
+static void _timer_event_unlink(struct _timer_event* event)
+{
+	if (event->prev)
+		event->prev->next = event->next;
+	else
+		_wheel.slots[event->level][event->slot] = event->next;
+	if (event->next)
+		event->next->prev = event->prev;
+	if (!_wheel.slots[event->level][event->slot])
+		_wheel.occupied[event->level] &= ~(1ull << event->slot);
+	_wheel.pending--;
+	event->pending = false;
+}
+
+/* Re-file the events of a slot against the current tick */
+static void _timer_wheel_cascade(uint8_t level, uint8_t slot)
+{
+	struct _timer_event* event = _wheel.slots[level][slot];
+	struct _timer_event* next;
+
+	_wheel.slots[level][slot] = NULL;
+	_wheel.occupied[level] &= ~(1ull << slot);
+	for (; event; event = next) {
+		next = event->next;
+		_wheel.pending--;
+		_timer_event_link(event);
+	}
+}
+
+/* First tick from _wheel.now on at which a slot must be run or cascaded */
+static uint64_t _timer_wheel_next(void)
+{
+	uint64_t next = UINT64_MAX;
+	uint64_t occupied, base, tick;
+	uint32_t shift, offset;
+	uint8_t level;
+
+	if (_wheel.occupied[0]) {
+		occupied = _timer_wheel_rotate(_wheel.occupied[0],
+				_wheel.now & TIMER_WHEEL_MASK);
+		next = _wheel.now + _timer_ctz64(occupied);
+	}
+
+	for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+		if (!_wheel.occupied[level])
+			continue;
+		shift = TIMER_WHEEL_BITS * level;
+		base = _wheel.now >> shift;
+		occupied = _timer_wheel_rotate(_wheel.occupied[level],
+				base & TIMER_WHEEL_MASK);
+		/* The current slot already cascaded unless now is on its
+		 * boundary: its events wait for the next turn */
+		if (_wheel.now & ((1ull << shift) - 1))
+			occupied &= ~1ull;
+		offset = occupied ? _timer_ctz64(occupied) : TIMER_WHEEL_SIZE;
+		tick = (base + offset) << shift;
+		if (tick < next)
+			next = tick;
+	}
+	return next;
+}
+
+/* Run the events expired at tick, callbacks are called with interrupts
+ * enabled as found on entry */
+static void _timer_wheel_run(uint64_t tick)
+{
+	struct _timer_event* event;
+	struct _callback cb;
+	uint32_t flags;
+	uint64_t next;
+	uint8_t level;
+
+	flags = arch_irq_save();
+	while (_wheel.pending) {
+		next = _timer_wheel_next();
+		if (next > tick)
+			break;
+		_wheel.now = next;
+
+		for (level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+			if ((_wheel.now & ((1ull << (TIMER_WHEEL_BITS * level)) - 1)) == 0)
+				_timer_wheel_cascade(level,
+					(_wheel.now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK);
+		}
+
+		while ((event = _wheel.slots[0][_wheel.now & TIMER_WHEEL_MASK])) {
+			_timer_event_unlink(event);
+			if (event->expires > _wheel.now) {
+				_timer_event_link(event);
+				continue;
+			}
+			if (event->period) {
+				while (event->expires <= _wheel.now)
+					event->expires += event->period;
+				_timer_event_link(event);
+			}
+			cb = event->callback;
+			arch_irq_restore(flags);
+			callback_call(&cb, event);
+			flags = arch_irq_save();
+		}
+		_wheel.now++;
+	}
+	if (!_wheel.pending && _wheel.now <= tick)
+		_wheel.now = tick + 1;
+	arch_irq_restore(flags);
+}
+
 #ifndef CONFIG_TIMER_POLLING
 
+/* Program the RC compare for the earliest software timer deadline */
+static void _timer_update_compare(void)
+{
+	uint64_t next, deadline;
+	uint32_t flags, rc, guard;
+
+	flags = arch_irq_save();
+	if (!_wheel.pending) {
+		tc_disable_it(_timer.tc, _timer.channel, TC_IDR_CPCS);
+		arch_irq_restore(flags);
+		return;
+	}
+
+	/* First counter value of tick next, 64-bit safe */
+	next = _timer_wheel_next();
+	next = next > _timer.base_ms ? next - _timer.base_ms : 0;
+	deadline = _timer.base_cycles + (next / 1000) * _timer.channel_freq +
+		((next % 1000) * _timer.channel_freq + 999) / 1000;
+
+	guard = _timer.compare_guard;
+	for (;;) {
+		uint64_t now = _timer_get_tick();
+		if ((int64_t)(deadline - now) < (int64_t)guard)
+			deadline = now + guard;
+		rc = (uint32_t)deadline & TIMER_CV_MASK;
+		tc_set_ra_rb_rc(_timer.tc, _timer.channel, NULL, NULL, &rc);
+		/* Retry further away if the counter went by while writing */
+		if ((int64_t)(deadline - _timer_get_tick()) > 0)
+			break;
+		guard *= 2;
+	}
+	tc_enable_it(_timer.tc, _timer.channel, TC_IER_CPCS);
+	arch_irq_restore(flags);
+}
+
 /**
  *  \brief Handler for timer interrupt.
  */
 static void timer_irq_handler(uint32_t source, void* user_arg)
 {
+	_timer.in_handler = true;
 	timer_update_upper_tick_counter();
+	_timer.in_handler = false;
+
+	if (_timer.compare_hit) {
+		_timer.compare_hit = false;
+		_timer_wheel_run(timer_get_tick());
+		_timer_update_compare();
+	}
+}
+
+#else
+
+static void _timer_update_compare(void)
+{
 }
 
 #endif /* !CONFIG_TIMER_POLLING */
 
-static uint64_t _timer_get_tick(void)
+static void _timer_update_conv(void)
 {
-	uint32_t upper, lower;
+	_timer.channel_freq = tc_get_channel_freq(_timer.tc, _timer.channel);
+	_timer_conv_init(&_timer.cycles_to_ms, _timer.channel_freq, 1000);
+	_timer_conv_init(&_timer.cycles_to_us, _timer.channel_freq, 1000000);
+	_timer_conv_init(&_timer.cycles_to_ns, _timer.channel_freq, 1000000000);
+	_timer_conv_init(&_timer.us_to_cycles, 1000000, _timer.channel_freq);
+	/* About 10us between the compare value and the counter */
+	_timer.compare_guard = _timer.channel_freq / 100000 + 2;
+}
 
-	do {
-		upper = timer_get_upper_tick_counter();
-		COMPILER_BARRIER();
-		lower = tc_get_cv(_timer.tc, _timer.channel);
-	} while (upper != timer_get_upper_tick_counter());
-	return (((uint64_t)upper) << TC_CHANNEL_SIZE) | lower;
+/* The TC clock follows MCK: keep the time running across the change. The
+ * time spent switching clocks is not accounted for. */
+static int _timer_clock_notifier(void* arg, void* arg2)
+{
+	struct _pmc_clock_change* change = (struct _pmc_clock_change*)arg2;
+
+	switch (change->event) {
+	case PMC_CLOCK_PRE_CHANGE:
+#ifndef CONFIG_TIMER_POLLING
+		tc_disable_it(_timer.tc, _timer.channel, TC_IDR_CPCS);
+#endif
+		_timer.base_ns = timer_get_ns();
+		break;
+	case PMC_CLOCK_POST_CHANGE:
+		_timer_update_conv();
+		_timer.base_cycles = _timer_get_tick();
+		_timer.base_ms = _timer.base_ns / 1000000;
+		_timer.base_us = _timer.base_ns / 1000;
+		_timer_update_compare();
+		break;
+	case PMC_CLOCK_ABORT_CHANGE:
+		_timer_update_compare();
+		break;
+	}
+	return 0;
 }
 
 /*----------------------------------------------------------------------------
@@ -113,7 +458,14 @@ void timer_configure(Tc* tc, uint8_t channel, uint32_t clock_source)
 
 	tc_configure(tc, channel, TC_CMR_WAVE | TC_CMR_WAVSEL_UP |
 			(clock_source & TC_CMR_TCCLKS_Msk));
-	_timer.channel_freq = tc_get_channel_freq(tc, channel);
+	_timer_update_conv();
+	_timer.base_cycles = 0;
+	_timer.base_ms = 0;
+	_timer.base_us = 0;
+	_timer.base_ns = 0;
+	memset(&_wheel, 0, sizeof(_wheel));
+	callback_set(&_timer.clock_notifier.callback, _timer_clock_notifier, NULL);
+	pmc_register_clock_notifier(&_timer.clock_notifier);
 #ifndef CONFIG_TIMER_POLLING
 	irq_add_handler(tc_id, timer_irq_handler, &_timer);
 	irq_enable(tc_id);
@@ -154,7 +506,93 @@ void timer_sleep(uint64_t count)
 
 uint64_t timer_get_tick(void)
 {
-	return (_timer_get_tick() * 1000) / _timer.channel_freq;
+	return _timer.base_ms + _timer_conv(&_timer.cycles_to_ms,
+			_timer_get_tick() - _timer.base_cycles);
+}
+
+uint64_t timer_get_us(void)
+{
+	return _timer.base_us + _timer_conv(&_timer.cycles_to_us,
+			_timer_get_tick() - _timer.base_cycles);
+}
+
+uint64_t timer_get_ns(void)
+{
+	return _timer.base_ns + _timer_conv(&_timer.cycles_to_ns,
+			_timer_get_tick() - _timer.base_cycles);
+}
+
+uint64_t timer_get_cycles(void)
+{
+	return _timer_get_tick();
+}
+
+uint32_t timer_get_cycles_freq(void)
+{
+	return _timer.channel_freq;
+}
+
+uint64_t timer_cycles_to_ms(uint64_t cycles)
+{
+	return _timer_conv(&_timer.cycles_to_ms, cycles);
+}
+
+uint64_t timer_cycles_to_us(uint64_t cycles)
+{
+	return _timer_conv(&_timer.cycles_to_us, cycles);
+}
+
+uint64_t timer_cycles_to_ns(uint64_t cycles)
+{
+	return _timer_conv(&_timer.cycles_to_ns, cycles);
+}
+
+void timer_event_init(struct _timer_event* event)
+{
+	memset(event, 0, sizeof(*event));
+}
+
+void timer_event_start(struct _timer_event* event, uint32_t delay,
+		uint32_t period, struct _callback* cb)
+{
+	uint64_t tick = timer_get_tick();
+	uint32_t flags;
+
+	flags = arch_irq_save();
+	if (event->pending)
+		_timer_event_unlink(event);
+	if (!_wheel.pending)
+		_wheel.now = tick;
+	event->expires = tick + delay;
+	event->period = period;
+	callback_copy(&event->callback, cb);
+	_timer_event_link(event);
+	arch_irq_restore(flags);
+
+	_timer_update_compare();
+}
+
+void timer_event_cancel(struct _timer_event* event)
+{
+	uint32_t flags;
+
+	flags = arch_irq_save();
+	if (event->pending)
+		_timer_event_unlink(event);
+	arch_irq_restore(flags);
+
+	_timer_update_compare();
+}
+
+bool timer_event_is_pending(const struct _timer_event* event)
+{
+	return event->pending;
+}
+
+void timer_poll_events(void)
+{
+	_timer_wheel_run(timer_get_tick());
+	_timer_update_compare();
 }
 
 void sleep(uint32_t count)
@@ -176,7 +614,7 @@ void usleep(uint32_t count)
 
 	/* Compute deadline */
 	deadline = _timer_get_tick();
-	deadline += ROUND_INT_DIV((_timer.channel_freq / 1000) * count, 1000);
+	deadline += _timer_conv(&_timer.us_to_cycles, count);
 
 	/* Wait for deadline to be reached */
 	while ((int64_t)(_timer_get_tick() - deadline) < 0);
@@ -34,9 +34,11 @@
  *         Headers
  *----------------------------------------------------------------------------*/
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "board.h"
+#include "callback.h"
 
 /*----------------------------------------------------------------------------
  *         Type definitions
@@ -48,6 +50,23 @@ struct _timeout
 	uint64_t count;
 };
 
+/**
+ * \brief Software timer, see timer_event_start().
+ *
+ * All fields are private to the timer service.
+ */
+struct _timer_event
+{
+	struct _timer_event* next;
+	struct _timer_event* prev;
+	uint64_t expires;          /*< deadline, in timer ticks */
+	uint32_t period;           /*< 0 for a one-shot event */
+	uint8_t level;             /*< timer wheel level and slot */
+	uint8_t slot;
+	bool pending;
+	struct _callback callback;
+};
+
 /*----------------------------------------------------------------------------
  *         Global functions
  *----------------------------------------------------------------------------*/
@@ -60,6 +79,8 @@ struct _timeout
  * counter will be updated from the TC when requested.
  *
  * \note TC is enabled automatically in this function.
+ * \note The TC clock follows MCK: the timer registers a PMC clock notifier so
+ * that time keeps running across pmc_change_pck_mck().
  * \warning If interrupts are used, this function also reconfigures the TC
  * handler in AIC.
  *
@@ -105,6 +126,80 @@ extern uint64_t timer_get_interval(uint64_t start, uint64_t end);
  */
 extern uint64_t timer_get_tick(void);
 
+/**
+ * \brief Returns the time elapsed since timer_configure(), in microseconds
+ */
+extern uint64_t timer_get_us(void);
+
+/**
+ * \brief Returns the time elapsed since timer_configure(), in nanoseconds
+ */
+extern uint64_t timer_get_ns(void);
+
+/**
+ * \brief Returns the raw TC cycle count, for timestamping and profiling.
+ * Use timer_cycles_to_ns() and the like to convert intervals.
+ */
+extern uint64_t timer_get_cycles(void);
+
+/**
+ * \brief Returns the TC cycle frequency, in Hz
+ */
+extern uint32_t timer_get_cycles_freq(void);
+
+/**
+ * \brief Convert a TC cycle count to milliseconds, microseconds or
+ * nanoseconds.
+ *
+ * Conversions use a multiplier and shift computed in timer_configure()
+ * instead of a 64-bit division. The product is computed on 96 bits so any
+ * 64-bit cycle count can be converted, and the result is never below the
+ * exact quotient, within a relative error of 2^-31.
+ */
+extern uint64_t timer_cycles_to_ms(uint64_t cycles);
+extern uint64_t timer_cycles_to_us(uint64_t cycles);
+extern uint64_t timer_cycles_to_ns(uint64_t cycles);
+
+/**
+ * \brief Initialize a software timer event.
+ */
+extern void timer_event_init(struct _timer_event* event);
+
+/**
+ * \brief Arm a software timer event.
+ *
+ * The callback is called with the event as second argument once delay
+ * timer ticks have elapsed, then every period ticks if period is not 0.
+ * Arming a pending event reschedules it. Events are kept in a hierarchical
+ * timer wheel, so arming and cancelling take constant time, and the TC
+ * RC compare is programmed for the earliest deadline. Callbacks run from
+ * the TC interrupt, or from timer_poll_events() if CONFIG_TIMER_POLLING is
+ * defined.
+ *
+ * \param event Event initialized with timer_event_init()
+ * \param delay Ticks until the first expiry
+ * \param period Ticks between expiries of a periodic event, 0 for one-shot
+ * \param cb Callback, copied into the event
+ */
+extern void timer_event_start(struct _timer_event* event, uint32_t delay,
+		uint32_t period, struct _callback* cb);
+
+/**
+ * \brief Cancel a software timer event. Does nothing if it is not pending.
+ */
+extern void timer_event_cancel(struct _timer_event* event);
+
+/**
+ * \brief Tells if a software timer event is armed.
+ */
+extern bool timer_event_is_pending(const struct _timer_event* event);
+
+/**
+ * \brief Run the callbacks of expired software timer events. Required with
+ * CONFIG_TIMER_POLLING, where no interrupt runs them.
+ */
+extern void timer_poll_events(void);
+
 /**
  *  \brief Wait for at least count seconds.
  */